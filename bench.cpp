@@ -0,0 +1,203 @@
+/*******************************************************************************
+ * Internet of Things (IoT) smart monitoring
+ * device for agriculture using LoRaWAN technology.
+ *
+ * Microbenchmark harness with stored baselines.
+ *
+ * SEE bench.h file for the description of each function.
+ *
+ *******************************************************************************/
+
+#if defined(__MBED__)
+#include "mbed.h"
+#else
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#endif
+#include "lmic.h"
+#include "bench.h"
+
+static const char* names[BENCH_MAX];
+static u4_t costs[BENCH_MAX];
+static u1_t count = 0;
+static u4_t rounds = 0;
+static u4_t overhead = 0;   // Cost of the empty loop per call.
+
+/*
+ * bench_counter function of type unsigned int.
+ *
+ * Input parameters: None
+ * Return: CPU cycle counter on Cortex-M, nanoseconds elsewhere.
+ *
+ */
+u4_t bench_counter (void) {
+#if defined(__CORTEX_M) && ( __CORTEX_M >= 3 )
+    return DWT->CYCCNT;
+#else
+    struct timespec ts;
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return (u4_t)( ts.tv_sec * 1000000000ULL + ts.tv_nsec );
+#endif
+}// end of bench_counter function.
+
+/*
+ * bench_micros function of type unsigned int.
+ *
+ * Input parameters: None
+ * Return: microsecond timer.
+ *
+ */
+u4_t bench_micros (void) {
+#if defined(__MBED__)
+    return us_ticker_read( );
+#else
+    struct timespec ts;
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return (u4_t)( ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000 );
+#endif
+}// end of bench_micros function.
+
+/*
+ * emptyCall function of type void.
+ *
+ * Input parameters: unsigned int i
+ */
+static void emptyCall (u4_t i) {
+    (void)i;
+}// end of emptyCall function.
+
+/*
+ * measure function of type unsigned int.
+ *
+ * Input parameters: bench_fn_t fn
+ * Return: cheapest cost per call over BENCH_REPEATS repetitions.
+ */
+static u4_t measure (bench_fn_t fn) {
+    u4_t best = 0xFFFFFFFF;
+
+    for( u1_t r = 0; r < BENCH_REPEATS; r++ ) {
+        u4_t start = bench_counter( );
+        for( u4_t i = 0; i < rounds; i++ ) {
+            fn( i );
+        }
+        u4_t cost = ( bench_counter( ) - start ) / rounds;
+        if( cost < best ) {
+            best = cost;
+        }
+    }
+    return best;
+}// end of measure function.
+
+/*
+ * bench_init function of type void.
+ *
+ * Input parameters: unsigned int n
+ *
+ */
+void bench_init (u4_t n) {
+#if defined(__CORTEX_M) && ( __CORTEX_M >= 3 )
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+#endif
+    count = 0;
+    rounds = n ? n : 1;
+    overhead = measure( emptyCall );
+}// end of bench_init function.
+
+/*
+ * bench_rounds function of type void.
+ *
+ * Input parameters: unsigned int n
+ *
+ */
+void bench_rounds (u4_t n) {
+    rounds = n ? n : 1;
+}// end of bench_rounds function.
+
+/*
+ * bench_run function of type unsigned int.
+ *
+ * Input parameters: const char name
+ *                   bench_fn_t fn
+ * Return: cost per call.
+ *
+ */
+u4_t bench_run (const char* name, bench_fn_t fn) {
+    u4_t cost = measure( fn );
+
+    cost = cost > overhead ? cost - overhead : 0;
+    if( count < BENCH_MAX ) {
+        names[count] = name;
+        costs[count] = cost;
+        count++;
+    }
+    return cost;
+}// end of bench_run function.
+
+/*
+ * bench_unit function of type const char pointer.
+ *
+ * Input parameters: None
+ * Return: unit of the costs.
+ *
+ */
+const char* bench_unit (void) {
+#if defined(__CORTEX_M) && ( __CORTEX_M >= 3 )
+    return "cycles";
+#else
+    return "ns";
+#endif
+}// end of bench_unit function.
+
+/*
+ * bench_json function of type void.
+ *
+ * Input parameters: None
+ *
+ */
+void bench_json (void) {
+    printf("BENCH {\"unit\":\"%s\",\"results\":{", bench_unit( ));
+    for( u1_t i = 0; i < count; i++ ) {
+        printf("%s\"%s\":%u", i ? "," : "", names[i], (unsigned int)costs[i]);
+    }
+    printf("}}\r\n");
+}// end of bench_json function.
+
+/*
+ * bench_compare function of type unsigned char.
+ *
+ * Input parameters: const char unit
+ *                   const bench_baseline_t base
+ *                   unsigned char n
+ *                   unsigned char threshold
+ * Return: number of regressions.
+ *
+ */
+u1_t bench_compare (const char* unit, const bench_baseline_t* base, u1_t n, u1_t threshold) {
+    u1_t regressions = 0;
+
+    if( strcmp( unit, bench_unit( ) ) != 0 ) {
+        printf("Benchmark baseline in %s, results in %s: not compared\r\n", unit, bench_unit( ));
+        return 0;
+    }
+    for( u1_t i = 0; i < count; i++ ) {
+        const bench_baseline_t* b = NULL;
+        for( u1_t k = 0; k < n; k++ ) {
+            if( strcmp( base[k].name, names[i] ) == 0 ) {
+                b = &base[k];
+            }
+        }
+        if( b == NULL ) {
+            printf("  %-12s %8u %s, no baseline\r\n", names[i], (unsigned int)costs[i], unit);
+            continue;
+        }
+        bit_t slower = costs[i] > b->cost + BENCH_NOISE &&
+                       (unsigned long long)costs[i] * 100 > (unsigned long long)b->cost * ( 100 + threshold );
+        printf("  %-12s %8u %s, baseline %8u%s\r\n", names[i], (unsigned int)costs[i], unit,
+               (unsigned int)b->cost, slower ? ", REGRESSION" : "");
+        regressions += slower;
+    }
+    printf("Benchmarks: %u regressions over %u%%\r\n", regressions, threshold);
+    return regressions;
+}// end of bench_compare function.
@@ -0,0 +1,135 @@
+/*******************************************************************************
+ * Internet of Things (IoT) smart monitoring
+ * device for agriculture using LoRaWAN technology.
+ *
+ * Microbenchmark harness with stored baselines.
+ *
+ * - bench_run times one operation over many calls and keeps the cost per
+ * call (CPU cycles on Cortex-M, nanoseconds elsewhere, where the hardware
+ * is mocked). Each benchmark is repeated BENCH_REPEATS times and the
+ * cheapest repetition is kept, as interrupts and caches only ever add time;
+ * the cost of the empty benchmark loop is subtracted.
+ *
+ * - bench_json writes all results as one line, "BENCH" followed by a JSON
+ * object, to the UART. bench2h.sh turns such a capture into
+ * bench_baseline.h, the stored baseline.
+ *
+ * - bench_compare checks the results against a baseline and flags every
+ * benchmark slower than the baseline by more than a threshold in percent.
+ *
+ * - bench_counter and bench_micros are the timers of every benchmark of the
+ * firmware and of the host tools.
+ *
+ *******************************************************************************/
+#ifndef _bench_hpp_
+#define _bench_hpp_
+
+#include "lmic.h"
+
+// Maximum number of benchmarks in one suite.
+#define BENCH_MAX 16
+
+// Repetitions of every benchmark; the cheapest one is kept.
+#define BENCH_REPEATS 5
+
+// Differences up to this cost per call are taken as noise by bench_compare.
+#define BENCH_NOISE 2
+
+// Regression threshold of bench_compare in percent.
+#ifndef BENCH_THRESHOLD
+#define BENCH_THRESHOLD 10
+#endif
+
+// One call of the measured operation; i is the call index.
+typedef void (*bench_fn_t) (u4_t i);
+
+/*
+ * bench_baseline_t structure.
+ *
+ * Stored cost of one benchmark.
+ */
+typedef struct {
+    const char* name;     // Benchmark name.
+    u4_t cost;            // Cost per call.
+} bench_baseline_t;
+
+/*
+ * bench_counter function of type unsigned int.
+ *
+ * Input parameters: None
+ * Return: CPU cycle counter on Cortex-M (started by bench_init), nanoseconds
+ *         elsewhere.
+ */
+u4_t bench_counter (void);
+
+/*
+ * bench_micros function of type unsigned int.
+ *
+ * Input parameters: None
+ * Return: microsecond timer (us_ticker on mbed, monotonic clock elsewhere).
+ */
+u4_t bench_micros (void);
+
+/*
+ * bench_init function of type void.
+ *
+ * Starts the CPU cycle counter on Cortex-M, clears the results and measures
+ * the cost of the empty benchmark loop.
+ *
+ * Input parameters: unsigned int rounds (calls per repetition)
+ */
+void bench_init (u4_t rounds);
+
+/*
+ * bench_rounds function of type void.
+ *
+ * Changes the calls per repetition of the following benchmarks, e.g. fewer
+ * for operations writing to the UART.
+ *
+ * Input parameters: unsigned int rounds
+ */
+void bench_rounds (u4_t rounds);
+
+/*
+ * bench_run function of type unsigned int.
+ *
+ * Times rounds calls of fn and records the cost per call under name.
+ *
+ * Input parameters: const char name
+ *                   bench_fn_t fn
+ * Return: cost per call.
+ */
+u4_t bench_run (const char* name, bench_fn_t fn);
+
+/*
+ * bench_unit function of type const char pointer.
+ *
+ * Input parameters: None
+ * Return: unit of the costs ("cycles" or "ns").
+ */
+const char* bench_unit (void);
+
+/*
+ * bench_json function of type void.
+ *
+ * Writes the results as one "BENCH {...}" line to the UART.
+ *
+ * Input parameters: None
+ */
+void bench_json (void);
+
+/*
+ * bench_compare function of type unsigned char.
+ *
+ * Writes every result next to its baseline to the UART and flags the ones
+ * slower by more than threshold percent.
+ *
+ * Input parameters: const char unit (unit of the baseline)
+ *                   const bench_baseline_t base
+ *                   unsigned char count
+ *                   unsigned char threshold (percent)
+ * Return: number of regressions.
+ */
+u1_t bench_compare (const char* unit, const bench_baseline_t* base, u1_t count, u1_t threshold);
+
+#endif // _bench_hpp_
@@ -0,0 +1,49 @@
+#!/bin/sh
+###############################################################################
+# Internet of Things (IoT) smart monitoring
+# device for agriculture using LoRaWAN technology.
+#
+# Converts a bench_json() capture into bench_baseline.h, the baseline that
+# BENCH_COMPARE builds check their results against.
+#
+# The capture is the UART output holding the "BENCH {...}" line (any other
+# terminal output is ignored). When the capture holds several such lines,
+# the last one is used.
+#
+# Usage: ./bench2h.sh capture.txt > bench_baseline.h
+###############################################################################
+
+if [ $# -ne 1 ] || [ ! -r "$1" ]; then
+    echo "usage: $0 capture.txt > bench_baseline.h" >&2
+    exit 1
+fi
+
+tr -d '\r' < "$1" | awk '
+/^BENCH \{/ { last = substr($0, 7); found = 1 }
+END {
+    if( !found ) { print "no benchmark results found" > "/dev/stderr"; exit 1 }
+    unit = last
+    sub(/^.*"unit":"/, "", unit)
+    sub(/".*$/, "", unit)
+    results = last
+    sub(/^.*"results":\{/, "", results)
+    sub(/\}\}$/, "", results)
+    n = split(results, pairs, ",")
+    print "// Generated by bench2h.sh, do not edit."
+    print "#ifndef _bench_baseline_hpp_"
+    print "#define _bench_baseline_hpp_"
+    print ""
+    print "#include \"bench.h\""
+    print ""
+    printf "// Unit of the stored costs.\nstatic const char BENCH_BASELINE_UNIT[] = \"%s\";\n\n", unit
+    printf "// Cost per call of %d benchmarks.\nstatic const bench_baseline_t BENCH_BASELINE[] = {\n", n
+    for( i = 1; i <= n; i++ ) {
+        split(pairs[i], kv, ":")
+        printf "    { %s, %s },\n", kv[1], kv[2]
+    }
+    print "};"
+    print ""
+    print "#define BENCH_BASELINE_COUNT ( sizeof( BENCH_BASELINE ) / sizeof( BENCH_BASELINE[0] ) )"
+    print ""
+    print "#endif // _bench_baseline_hpp_"
+}'
@@ -0,0 +1,293 @@
+/*******************************************************************************
+ * Internet of Things (IoT) smart monitoring
+ * device for agriculture using LoRaWAN technology.
+ *
+ * Channel plans, random channel hopping and duty-cycle accounting.
+ *
+ * Airtime is accounted in milliseconds and the accounting period is
+ * advanced at every uplink, so that neither wraps like the os time.
+ *
+ * SEE channels.h file for the description of each function.
+ *
+ *******************************************************************************/
+
+#if defined(__MBED__)
+#include "mbed.h"
+#else
+#include <stdio.h>
+#include <string.h>
+#endif
+#include "lmic.h"
+#include "memstat.h"
+#include "channels.h"
+
+// Channels of an EU868 8-channel gateway.
+static const u4_t EU8_FREQ[] = { 868100000, 868300000, 868500000,
+                                 867100000, 867300000, 867500000, 867700000, 867900000 };
+
+/*
+ * subband_t structure.
+ *
+ * ETSI EN 300 220 sub-band and its duty-cycle limit.
+ */
+typedef struct {
+    u4_t low;             // Lowest frequency in Hz.
+    u4_t high;            // Highest frequency in Hz.
+    u2_t limit;           // Duty-cycle limit in basis points (1/100 %).
+    const char* name;     // Sub-band name.
+} subband_t;
+
+static const subband_t SUBBANDS[] = {
+    { 863000000, 868000000, 100,  "g"  },
+    { 868000000, 868600000, 100,  "g1" },
+    { 868700000, 869200000, 10,   "g2" },
+    { 869400000, 869650000, 1000, "g3" },
+    { 869700000, 870000000, 100,  "g4" }
+};
+#define SUBBAND_COUNT ( sizeof( SUBBANDS ) / sizeof( SUBBANDS[0] ) )
+
+static u1_t plan = CHANNELS_SINGLE;
+static u4_t uplinks[MAX_CHANNELS];      // Uplinks per channel.
+static u4_t channelAir[MAX_CHANNELS];   // Airtime per channel (ms).
+static u4_t subbandAir[SUBBAND_COUNT];  // Airtime per sub-band (ms).
+static unsigned long long period = 0;   // Accounted period (ms).
+static ostime_t periodEnd = 0;          // Time the accounted period ends at.
+
+/*
+ * applyPlan function of type void.
+ *
+ * Sets up the channels of a plan and enables only them. The bands, hence
+ * their duty-cycle state, are left alone.
+ *
+ * Input parameters: unsigned char p
+ */
+static void applyPlan (u1_t p) {
+    plan = p;
+    if( plan == CHANNELS_EU8 ) {
+        for( u1_t i = 0; i < sizeof( EU8_FREQ ) / sizeof( EU8_FREQ[0] ); i++ ) {
+            LMIC_setupChannel( i, EU8_FREQ[i], DR_RANGE_MAP( DR_SF12, DR_SF7 ),
+                               EU8_FREQ[i] < 868000000 ? BAND_AUX : BAND_CENTI );
+        }
+        LMIC.channelMap = 0x00FF;
+    } else {
+        // Channel 0 only, applied in one step.
+        LMIC_setupChannel( 0, EU8_FREQ[0], DR_RANGE_MAP( DR_SF12, DR_SF7 ), BAND_CENTI );
+        LMIC.channelMap = 0x0001;
+    }
+}// end of applyPlan function.
+
+/*
+ * channels_init function of type void.
+ *
+ * Input parameters: unsigned char p
+ *
+ */
+void channels_init (u1_t p) {
+    // 867 MHz channels in sub-band g get the auxiliary band and its own 1%.
+    LMIC_setupBand( BAND_AUX, 14, 100 );
+    applyPlan( p );
+    memset( uplinks, 0, sizeof( uplinks ) );
+    memset( channelAir, 0, sizeof( channelAir ) );
+    memset( subbandAir, 0, sizeof( subbandAir ) );
+    period = 0;
+    periodEnd = os_getTime( );
+    memstat_region( "channel stats", sizeof( uplinks ) + sizeof( channelAir ) + sizeof( subbandAir ) );
+}// end of channels_init function.
+
+/*
+ * channels_select function of type void.
+ *
+ * Input parameters: unsigned char p
+ *
+ */
+void channels_select (u1_t p) {
+    if( p == plan ) {
+        return;
+    }
+    applyPlan( p );
+    // Channels now map to other frequencies; the sub-band airtime still holds.
+    memset( uplinks, 0, sizeof( uplinks ) );
+    memset( channelAir, 0, sizeof( channelAir ) );
+}// end of channels_select function.
+
+/*
+ * channels_plan function of type unsigned char.
+ *
+ * Input parameters: None
+ * Return: channel plan in use.
+ *
+ */
+u1_t channels_plan (void) {
+    return plan;
+}// end of channels_plan function.
+
+/*
+ * channels_hop function of type void.
+ *
+ * Input parameters: None
+ *
+ */
+void channels_hop (void) {
+    for( u1_t band = 0; band < MAX_BANDS; band++ ) {
+        u1_t usable[MAX_CHANNELS];
+        u1_t n = 0;
+
+        for( u1_t ch = 0; ch < MAX_CHANNELS; ch++ ) {
+            if( ( LMIC.channelMap & ( 1 << ch ) ) != 0 &&
+                ( LMIC.channelDrMap[ch] & ( 1 << ( LMIC.datarate & 0xF ) ) ) != 0 &&
+                ( LMIC.channelFreq[ch] & 0x3 ) == band ) {
+                usable[n++] = ch;
+            }
+        }
+        if( n > 1 ) {
+            // LMiC takes the channel following lastchnl.
+            LMIC.bands[band].lastchnl = ( usable[os_getRndU1( ) % n] + MAX_CHANNELS - 1 ) % MAX_CHANNELS;
+        }
+    }
+}// end of channels_hop function.
+
+/*
+ * channels_txDone function of type void.
+ *
+ * Input parameters: ostime_t start
+ *                   ostime_t end
+ *
+ */
+void channels_txDone (ostime_t start, ostime_t end) {
+    u1_t ch = LMIC.txChnl;
+    u4_t freq = LMIC.channelFreq[ch] & ~(u4_t)0x3;
+    u4_t air = osticks2ms( end - start );
+
+    period += osticks2ms( end - periodEnd );
+    periodEnd = end;
+    uplinks[ch]++;
+    channelAir[ch] += air;
+    for( u1_t i = 0; i < SUBBAND_COUNT; i++ ) {
+        if( freq >= SUBBANDS[i].low && freq < SUBBANDS[i].high ) {
+            subbandAir[i] += air;
+        }
+    }
+}// end of channels_txDone function.
+
+/*
+ * channels_airtime function of type unsigned int.
+ *
+ * Input parameters: unsigned char sf
+ *                   unsigned char len
+ * Return: time on air in microseconds.
+ *
+ */
+u4_t channels_airtime (u1_t sf, u1_t len) {
+    // LoRa at 125 kHz, coding rate 4/5, 8-symbol preamble, explicit header
+    // and CRC; low data rate optimisation from SF11.
+    u4_t symbol = ( 1UL << sf ) * 8;
+    s4_t de = sf >= 11 ? 1 : 0;
+    s4_t bits = 8 * len - 4 * sf + 28 + 16;
+    s4_t per = 4 * ( sf - 2 * de );
+    s4_t blocks = bits > 0 ? ( bits + per - 1 ) / per : 0;
+    u4_t symbols = 8 + blocks * 5;
+
+    return symbol * 49 / 4 + symbols * symbol;
+}// end of channels_airtime function.
+
+/*
+ * channels_report function of type void.
+ *
+ * Input parameters: None
+ *
+ */
+void channels_report (void) {
+    printf("Channels (%s plan):\r\n", plan == CHANNELS_EU8 ? "8-channel" : "single-channel");
+    for( u1_t ch = 0; ch < MAX_CHANNELS; ch++ ) {
+        if( uplinks[ch] != 0 ) {
+            printf("  %u.%u MHz: %u uplinks, %u ms on air\r\n",
+                   (unsigned int)( LMIC.channelFreq[ch] / 1000000 ),
+                   (unsigned int)( LMIC.channelFreq[ch] / 100000 % 10 ),
+                   (unsigned int)uplinks[ch], (unsigned int)channelAir[ch]);
+        }
+    }
+    for( u1_t i = 0; i < SUBBAND_COUNT; i++ ) {
+        if( subbandAir[i] == 0 || period == 0 ) {
+            continue;
+        }
+        // Duty cycle in basis points.
+        u4_t duty = (u4_t)( subbandAir[i] * 10000ULL / period );
+        printf("  sub-band %-2s duty %u.%02u%% of %u.%02u%%%s\r\n", SUBBANDS[i].name,
+               (unsigned int)( duty / 100 ), (unsigned int)( duty % 100 ),
+               SUBBANDS[i].limit / 100, SUBBANDS[i].limit % 100,
+               duty > SUBBANDS[i].limit ? ", OVER LIMIT" : "");
+    }
+    printf("\r\n");
+}// end of channels_report function.
+
+/*
+ * simRandom function of type unsigned int.
+ *
+ * Input parameters: unsigned int seed
+ * Return: next pseudo-random value, deterministic across runs.
+ */
+static u4_t simRandom (u4_t* seed) {
+    *seed = *seed * 1664525 + 1013904223;
+    return *seed;
+}// end of simRandom function.
+
+/*
+ * channels_simulate function of type void.
+ *
+ * Input parameters: unsigned short nodes
+ *                   unsigned short interval
+ *                   unsigned char len
+ *                   unsigned short rounds
+ *
+ */
+void channels_simulate (u2_t nodes, u2_t interval, u1_t len, u2_t rounds) {
+    static u4_t start[CHANNELS_SIM_NODES];
+    static u1_t channel[CHANNELS_SIM_NODES];
+    static const u1_t CHANNEL_COUNT[] = { 1, 8 };
+    u4_t air = channels_airtime( 7, len );
+
+    if( nodes > CHANNELS_SIM_NODES ) {
+        nodes = CHANNELS_SIM_NODES;
+    }
+    if( nodes == 0 || interval == 0 || rounds == 0 ) {
+        return;
+    }
+    printf("Channel plans: %u nodes, %u-byte SF7 frame (%u us) every %u s\r\n", nodes, len,
+           (unsigned int)air, interval);
+    for( u1_t p = 0; p < sizeof( CHANNEL_COUNT ); p++ ) {
+        u1_t count = CHANNEL_COUNT[p];
+        u4_t seed = 1;
+        u4_t lost = 0;
+
+        for( u2_t r = 0; r < rounds; r++ ) {
+            // Every node sends once per interval at a random time and channel.
+            for( u2_t i = 0; i < nodes; i++ ) {
+                start[i] = simRandom( &seed ) % ( (u4_t)interval * 1000000 );
+                channel[i] = ( simRandom( &seed ) >> 16 ) % count;
+            }
+            // A frame overlapping another one on its channel is lost.
+            for( u2_t i = 0; i < nodes; i++ ) {
+                for( u2_t j = 0; j < nodes; j++ ) {
+                    if( i != j && channel[i] == channel[j] &&
+                        ( start[i] > start[j] ? start[i] - start[j] : start[j] - start[i] ) < air ) {
+                        lost++;
+                        break;
+                    }
+                }
+            }
+        }
+        u4_t sent = (u4_t)nodes * rounds;
+        // Collision rate in tenths of a percent.
+        u4_t rate = (u4_t)( (unsigned long long)lost * 1000 / sent );
+        // Load per channel in thousandths of the channel time.
+        u4_t load = (u4_t)( (unsigned long long)nodes * air * 1000 / ( (unsigned long long)interval * 1000000 * count ) );
+        // Pure ALOHA peaks at 1 / (2e) of the channel time; the duty cycle
+        // allows 1% of the hour per band (one band for one channel, two for eight).
+        u4_t alohaMax = (u4_t)( 3600ULL * 1000000 * 1000 * count / ( 5437ULL * air ) );
+        u4_t dutyMax = (u4_t)( 36ULL * 1000000 * ( count > 1 ? 2 : 1 ) / air );
+        printf("  %u channel%s: load %u.%03u, %u of %u frames collided (%u.%u%%), gateway capacity %u frames/h, %u uplinks/h per node\r\n",
+               count, count > 1 ? "s" : "", (unsigned int)( load / 1000 ), (unsigned int)( load % 1000 ),
+               (unsigned int)lost, (unsigned int)sent, (unsigned int)( rate / 10 ),
+               (unsigned int)( rate % 10 ), (unsigned int)alohaMax, (unsigned int)dutyMax);
+    }
+}// end of channels_simulate function.
@@ -0,0 +1,125 @@
+/*******************************************************************************
+ * Internet of Things (IoT) smart monitoring
+ * device for agriculture using LoRaWAN technology.
+ *
+ * Channel plans, random channel hopping and duty-cycle accounting.
+ *
+ * - Two channel plans can be selected at any time: channel 0 (868.1 MHz)
+ * only, for the single-channel gateway, or the eight EU868 channels of an
+ * 8-channel gateway (868.1, 868.3, 868.5 and 867.1 ... 867.9 MHz). The
+ * 867 MHz channels use LMiC's auxiliary band with its own 1% duty cycle, as
+ * they lie in sub-band g while 868.x MHz lies in sub-band g1, which doubles
+ * the airtime available against one channel.
+ *
+ * - LMiC steps through the channels of a band in turn; channels_hop makes
+ * the next channel of every band a uniformly random enabled one, so that
+ * nodes sharing a gateway do not collide channel after channel.
+ *
+ * - The airtime of every uplink is accounted per channel and per regulatory
+ * sub-band (ETSI EN 300 220: g, g1 and g4 1%, g2 0.1%, g3 10%), and
+ * channels_report flags any sub-band over its duty-cycle limit.
+ *
+ * - channels_simulate compares the collision rate and the capacity of both
+ * plans for a population of nodes sharing one gateway (pure ALOHA).
+ *
+ *******************************************************************************/
+#ifndef _channels_hpp_
+#define _channels_hpp_
+
+#include "lmic.h"
+
+// Largest node population simulated by channels_simulate.
+#define CHANNELS_SIM_NODES 256
+
+// Channel plans.
+enum {
+    CHANNELS_SINGLE = 0,  // 868.1 MHz only.
+    CHANNELS_EU8          // Eight EU868 channels.
+};
+
+/*
+ * channels_init function of type void.
+ *
+ * Sets up the auxiliary band of the 867 MHz channels, applies a channel
+ * plan and clears the airtime accounting. To be called once the session is
+ * set, as LMIC_setSession and a join reset the channels and bands.
+ *
+ * Input parameters: unsigned char plan (CHANNELS_SINGLE or CHANNELS_EU8)
+ */
+void channels_init (u1_t plan);
+
+/*
+ * channels_select function of type void.
+ *
+ * Switches to a channel plan at run time. The duty-cycle state of the bands
+ * and the sub-band airtime are kept; the per-channel statistics restart if
+ * the plan changes.
+ *
+ * Input parameters: unsigned char plan (CHANNELS_SINGLE or CHANNELS_EU8)
+ */
+void channels_select (u1_t plan);
+
+/*
+ * channels_plan function of type unsigned char.
+ *
+ * Input parameters: None
+ * Return: channel plan in use.
+ */
+u1_t channels_plan (void);
+
+/*
+ * channels_hop function of type void.
+ *
+ * Picks a random enabled channel as the next channel of every band. To be
+ * called before an uplink is handed over to LMiC.
+ *
+ * Input parameters: None
+ */
+void channels_hop (void);
+
+/*
+ * channels_txDone function of type void.
+ *
+ * Accounts the airtime of the completed uplink to its channel (LMIC.txChnl)
+ * and sub-band.
+ *
+ * Input parameters: ostime_t start (time the transmission started)
+ *                   ostime_t end (time the transmission ended)
+ */
+void channels_txDone (ostime_t start, ostime_t end);
+
+/*
+ * channels_airtime function of type unsigned int.
+ *
+ * Input parameters: unsigned char sf (spreading factor 7 ... 12, 125 kHz)
+ *                   unsigned char len (PHY payload length in bytes)
+ * Return: time on air of a LoRa frame in microseconds.
+ */
+u4_t channels_airtime (u1_t sf, u1_t len);
+
+/*
+ * channels_report function of type void.
+ *
+ * Writes the uplinks and airtime per channel and the duty cycle of every
+ * used sub-band against its limit to the UART.
+ *
+ * Input parameters: None
+ */
+void channels_report (void);
+
+/*
+ * channels_simulate function of type void.
+ *
+ * Simulates nodes sending one len-byte SF7 frame every interval seconds at
+ * random times over rounds intervals, on one channel and on eight randomly
+ * hopped channels, and writes the collision rate and the capacity of both
+ * plans to the UART.
+ *
+ * Input parameters: unsigned short nodes (at most CHANNELS_SIM_NODES)
+ *                   unsigned short interval (s)
+ *                   unsigned char len (PHY payload length in bytes)
+ *                   unsigned short rounds
+ */
+void channels_simulate (u2_t nodes, u2_t interval, u1_t len, u2_t rounds);
+
+#endif // _channels_hpp_
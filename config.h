@@ -0,0 +1,201 @@
+/*******************************************************************************
+ * Internet of Things (IoT) smart monitoring
+ * device for agriculture using LoRaWAN technology.
+ *
+ * Compile-time application policy.
+ *
+ * - Every behaviour switch is a preprocessor macro with a default value, so
+ * that a variant can be built from the same source by overriding it on the
+ * compiler command line (e.g. mbed compile -DDEBUG_LEVEL=1).
+ *
+ * - The selected macros are folded into the app_policy type. Its members are
+ * integral constants, so branches on them are resolved by the compiler and
+ * code of disabled features is not emitted into the image.
+ *
+ * - SEE footprint.sh for the flash/RAM footprint report of each variant.
+ *
+ *******************************************************************************/
+#ifndef _config_hpp_
+#define _config_hpp_
+
+#include "lmic.h"
+
+///////////////////////////////////////////////////
+// DEFINITION DECLARATIONS                      //
+/////////////////////////////////////////////////
+
+// Frequency channels automatically initialized for EU reqion.
+#ifndef MAX_EU_CHANNELS
+#define MAX_EU_CHANNELS 16
+#endif
+
+// Set to 1 to force the 868.1 MHz frequency band only due to
+// Dragino LG01-P LoRa Gateway hardware limitation, or to 0 for the eight
+// channels of an 8-channel gateway (SEE channels.h). The plan can also be
+// changed at runtime through a downlink on port 3.
+#ifndef SINGLE_CHANNEL_GATEWAY
+#define SINGLE_CHANNEL_GATEWAY 1
+#endif
+
+// Transmit interval in seconds, too often may get traffic ignored.
+#ifndef TRANSMIT_INTERVAL
+#define TRANSMIT_INTERVAL 300
+#endif
+
+// Sample periods in seconds of the temperature/humidity, light intensity
+// and soil moisture sensors (SEE sensors.h). Sensors are sampled faster than
+// the transmit interval to feed the window summaries.
+#ifndef TEMPHUM_PERIOD
+#define TEMPHUM_PERIOD 60
+#endif
+#ifndef LIGHT_PERIOD
+#define LIGHT_PERIOD 30
+#endif
+#ifndef SOIL_PERIOD
+#define SOIL_PERIOD 600
+#endif
+
+// Window in seconds summarised by every summary uplink (port 2).
+#ifndef SUMMARY_WINDOW
+#define SUMMARY_WINDOW 3600
+#endif
+
+// Statistics of each channel carried by the summary uplink (SEE stats.h).
+#ifndef SUMMARY_TEMPERATURE
+#define SUMMARY_TEMPERATURE ( STATS_COUNT | STATS_MIN | STATS_MAX | STATS_MEAN )
+#endif
+#ifndef SUMMARY_HUMIDITY
+#define SUMMARY_HUMIDITY ( STATS_MIN | STATS_MAX | STATS_MEAN )
+#endif
+#ifndef SUMMARY_LIGHT
+#define SUMMARY_LIGHT ( STATS_MEAN | STATS_STDDEV )
+#endif
+#ifndef SUMMARY_SOIL
+#define SUMMARY_SOIL ( STATS_MIN | STATS_MEAN )
+#endif
+
+// Soil moisture (Volts * 100) below which the soil is reported dry on the
+// alarm port (4), and above which the alarm is cleared again.
+#ifndef SOIL_DRY_ALARM
+#define SOIL_DRY_ALARM 50
+#endif
+#ifndef SOIL_DRY_CLEAR
+#define SOIL_DRY_CLEAR 70
+#endif
+
+// Airtime quotas of the summary (port 2) and diagnostics (port 5) uplinks
+// in milliseconds per hour, 0 for none (SEE uplink.h). Alarms and telemetry
+// are never held back.
+#ifndef QUOTA_SUMMARY
+#define QUOTA_SUMMARY 1000
+#endif
+#ifndef QUOTA_DIAG
+#define QUOTA_DIAG 500
+#endif
+
+// First and longest retry backoff in milliseconds when an uplink slot finds
+// the radio busy with a pending TX/RX; the backoff doubles on every retry.
+#ifndef RETRY_BACKOFF
+#define RETRY_BACKOFF 1000
+#endif
+#ifndef RETRY_BACKOFF_MAX
+#define RETRY_BACKOFF_MAX 30000
+#endif
+
+// Set to 1 to raise an LMiC assertion (hal_failed) or to 2 to hang the
+// node in uplink slot FAULT_INJECT_SLOT after every power-on, to exercise
+// the watchdog recovery (SEE recovery.h).
+#ifndef FAULT_INJECT
+#define FAULT_INJECT 0
+#endif
+#ifndef FAULT_INJECT_SLOT
+#define FAULT_INJECT_SLOT 3
+#endif
+
+// Set to 1 to send the samples restored after a reset at once instead of at
+// the first slot (SEE host/boot_timeline.cpp). Only a warm restart with
+// pending samples is affected; the boot itself is not shortened: the first
+// uplink of a cold boot waits for the first sensor acquisition
+// (sensors_leadTime, about 1 s) in both modes, and the session and channel
+// setup before it takes the same time.
+#ifndef FAST_START
+#define FAST_START 0
+#endif
+
+// Set debug level to 1 for outputting messages to the UART Terminal (e.g. Tera Term).
+#ifndef DEBUG_LEVEL
+#define DEBUG_LEVEL 0
+#endif
+
+// Set activation method to 0 for ABP (Activation By Personalization)
+// Set activation method to 1 for OTAA (Over The Air Activation)
+#ifndef ACTIVATION_METHOD
+#define ACTIVATION_METHOD 0
+#endif
+
+// LoRa Node's transmission power in dBm.
+#ifndef TX_POWER
+#define TX_POWER 14
+#endif
+
+// Set to 1 to run the on-target benchmarks at start-up and output
+// their results to the UART Terminal.
+#ifndef RUN_BENCHMARKS
+#define RUN_BENCHMARKS 0
+#endif
+
+// Set to 1 to compare the benchmark results against the stored baseline
+// (bench_baseline.h, generated by bench2h.sh) and flag every benchmark
+// slower by more than BENCH_THRESHOLD percent. Requires RUN_BENCHMARKS 1.
+#ifndef BENCH_COMPARE
+#define BENCH_COMPARE 0
+#endif
+
+///////////////////////////////////////////////////
+// POLICY DECLARATIONS                          //
+/////////////////////////////////////////////////
+
+/*
+ * node_policy template structure.
+ *
+ * Collects the compile-time configuration of one firmware variant.
+ * All members are integral constant expressions.
+ *
+ * Template parameters: int Activation     (ACTIVATION_METHOD)
+ *                      int Debug          (DEBUG_LEVEL)
+ *                      int SingleChannel  (SINGLE_CHANNEL_GATEWAY)
+ *                      int Interval       (TRANSMIT_INTERVAL)
+ *                      int Power          (TX_POWER)
+ */
+template <int Activation, int Debug, int SingleChannel, int Interval, int Power>
+struct node_policy {
+    // Over The Air Activation instead of Activation By Personalization.
+    static const bit_t otaa = ( Activation == 1 );
+
+    // UART debug messages enabled.
+    static const bit_t debug = ( Debug == 1 );
+
+    // All channels but 0 (868.1 MHz) disabled.
+    static const bit_t singleChannel = ( SingleChannel == 1 );
+
+    // Transmit interval in seconds.
+    static const u2_t transmitInterval = Interval;
+
+    // Transmission power in dBm.
+    static const s1_t txPower = Power;
+
+    // Data rate adaption (1 to enable).
+    static const bit_t adrMode = 0;
+
+    // Link check validation (1 to enable).
+    static const bit_t linkCheck = 0;
+
+    // Confirmation of transmitted LMiC data (1 to enable).
+    static const u1_t confirmed = 0;
+};
+
+// Policy of the variant being built.
+typedef node_policy<ACTIVATION_METHOD, DEBUG_LEVEL, SINGLE_CHANNEL_GATEWAY,
+                    TRANSMIT_INTERVAL, TX_POWER> app_policy;
+
+#endif // _config_hpp_
@@ -0,0 +1,448 @@
+/*******************************************************************************
+ * Internet of Things (IoT) smart monitoring
+ * device for agriculture using LoRaWAN technology.
+ *
+ * AES-128 backend with cached key schedules for LoRaWAN crypto.
+ *
+ * Software block cipher: state and round keys are big-endian 32-bit
+ * columns; each round is 16 T-table lookups (TE0 rotated by 0/8/16/24 bits)
+ * and the final round uses the S-box.
+ *
+ * SEE crypto.h file for the description of each function.
+ *
+ *******************************************************************************/
+
+#if defined(__MBED__)
+#include "mbed.h"
+#else
+#include <stdio.h>
+#include <string.h>
+#endif
+#include "lmic.h"
+#include "crypto.h"
+#include "bench.h"
+
+#if defined(TARGET_K64F) && defined(__has_include)
+#if __has_include("fsl_mmcau.h")
+#include "fsl_mmcau.h"
+#define CRYPTO_MMCAU 1
+#endif
+#endif
+#ifndef CRYPTO_MMCAU
+#define CRYPTO_MMCAU 0
+#endif
+
+#define ROR(x, n) ( ( (x) >> (n) ) | ( (x) << ( 32 - (n) ) ) )
+
+// AES S-box.
+static const u1_t SBOX[256] = {
+    0x63, 0x7C, 0x77, 0x7B, 0xF2, 0x6B, 0x6F, 0xC5, 0x30, 0x01, 0x67, 0x2B, 0xFE, 0xD7, 0xAB, 0x76,
+    0xCA, 0x82, 0xC9, 0x7D, 0xFA, 0x59, 0x47, 0xF0, 0xAD, 0xD4, 0xA2, 0xAF, 0x9C, 0xA4, 0x72, 0xC0,
+    0xB7, 0xFD, 0x93, 0x26, 0x36, 0x3F, 0xF7, 0xCC, 0x34, 0xA5, 0xE5, 0xF1, 0x71, 0xD8, 0x31, 0x15,
+    0x04, 0xC7, 0x23, 0xC3, 0x18, 0x96, 0x05, 0x9A, 0x07, 0x12, 0x80, 0xE2, 0xEB, 0x27, 0xB2, 0x75,
+    0x09, 0x83, 0x2C, 0x1A, 0x1B, 0x6E, 0x5A, 0xA0, 0x52, 0x3B, 0xD6, 0xB3, 0x29, 0xE3, 0x2F, 0x84,
+    0x53, 0xD1, 0x00, 0xED, 0x20, 0xFC, 0xB1, 0x5B, 0x6A, 0xCB, 0xBE, 0x39, 0x4A, 0x4C, 0x58, 0xCF,
+    0xD0, 0xEF, 0xAA, 0xFB, 0x43, 0x4D, 0x33, 0x85, 0x45, 0xF9, 0x02, 0x7F, 0x50, 0x3C, 0x9F, 0xA8,
+    0x51, 0xA3, 0x40, 0x8F, 0x92, 0x9D, 0x38, 0xF5, 0xBC, 0xB6, 0xDA, 0x21, 0x10, 0xFF, 0xF3, 0xD2,
+    0xCD, 0x0C, 0x13, 0xEC, 0x5F, 0x97, 0x44, 0x17, 0xC4, 0xA7, 0x7E, 0x3D, 0x64, 0x5D, 0x19, 0x73,
+    0x60, 0x81, 0x4F, 0xDC, 0x22, 0x2A, 0x90, 0x88, 0x46, 0xEE, 0xB8, 0x14, 0xDE, 0x5E, 0x0B, 0xDB,
+    0xE0, 0x32, 0x3A, 0x0A, 0x49, 0x06, 0x24, 0x5C, 0xC2, 0xD3, 0xAC, 0x62, 0x91, 0x95, 0xE4, 0x79,
+    0xE7, 0xC8, 0x37, 0x6D, 0x8D, 0xD5, 0x4E, 0xA9, 0x6C, 0x56, 0xF4, 0xEA, 0x65, 0x7A, 0xAE, 0x08,
+    0xBA, 0x78, 0x25, 0x2E, 0x1C, 0xA6, 0xB4, 0xC6, 0xE8, 0xDD, 0x74, 0x1F, 0x4B, 0xBD, 0x8B, 0x8A,
+    0x70, 0x3E, 0xB5, 0x66, 0x48, 0x03, 0xF6, 0x0E, 0x61, 0x35, 0x57, 0xB9, 0x86, 0xC1, 0x1D, 0x9E,
+    0xE1, 0xF8, 0x98, 0x11, 0x69, 0xD9, 0x8E, 0x94, 0x9B, 0x1E, 0x87, 0xE9, 0xCE, 0x55, 0x28, 0xDF,
+    0x8C, 0xA1, 0x89, 0x0D, 0xBF, 0xE6, 0x42, 0x68, 0x41, 0x99, 0x2D, 0x0F, 0xB0, 0x54, 0xBB, 0x16
+};
+
+// AES encryption T-table (MixColumns of the S-box), big-endian columns.
+// The other three tables are byte rotations of this one.
+static const u4_t TE0[256] = {
+    0xC66363A5, 0xF87C7C84, 0xEE777799, 0xF67B7B8D, 0xFFF2F20D, 0xD66B6BBD, 0xDE6F6FB1, 0x91C5C554,
+    0x60303050, 0x02010103, 0xCE6767A9, 0x562B2B7D, 0xE7FEFE19, 0xB5D7D762, 0x4DABABE6, 0xEC76769A,
+    0x8FCACA45, 0x1F82829D, 0x89C9C940, 0xFA7D7D87, 0xEFFAFA15, 0xB25959EB, 0x8E4747C9, 0xFBF0F00B,
+    0x41ADADEC, 0xB3D4D467, 0x5FA2A2FD, 0x45AFAFEA, 0x239C9CBF, 0x53A4A4F7, 0xE4727296, 0x9BC0C05B,
+    0x75B7B7C2, 0xE1FDFD1C, 0x3D9393AE, 0x4C26266A, 0x6C36365A, 0x7E3F3F41, 0xF5F7F702, 0x83CCCC4F,
+    0x6834345C, 0x51A5A5F4, 0xD1E5E534, 0xF9F1F108, 0xE2717193, 0xABD8D873, 0x62313153, 0x2A15153F,
+    0x0804040C, 0x95C7C752, 0x46232365, 0x9DC3C35E, 0x30181828, 0x379696A1, 0x0A05050F, 0x2F9A9AB5,
+    0x0E070709, 0x24121236, 0x1B80809B, 0xDFE2E23D, 0xCDEBEB26, 0x4E272769, 0x7FB2B2CD, 0xEA75759F,
+    0x1209091B, 0x1D83839E, 0x582C2C74, 0x341A1A2E, 0x361B1B2D, 0xDC6E6EB2, 0xB45A5AEE, 0x5BA0A0FB,
+    0xA45252F6, 0x763B3B4D, 0xB7D6D661, 0x7DB3B3CE, 0x5229297B, 0xDDE3E33E, 0x5E2F2F71, 0x13848497,
+    0xA65353F5, 0xB9D1D168, 0x00000000, 0xC1EDED2C, 0x40202060, 0xE3FCFC1F, 0x79B1B1C8, 0xB65B5BED,
+    0xD46A6ABE, 0x8DCBCB46, 0x67BEBED9, 0x7239394B, 0x944A4ADE, 0x984C4CD4, 0xB05858E8, 0x85CFCF4A,
+    0xBBD0D06B, 0xC5EFEF2A, 0x4FAAAAE5, 0xEDFBFB16, 0x864343C5, 0x9A4D4DD7, 0x66333355, 0x11858594,
+    0x8A4545CF, 0xE9F9F910, 0x04020206, 0xFE7F7F81, 0xA05050F0, 0x783C3C44, 0x259F9FBA, 0x4BA8A8E3,
+    0xA25151F3, 0x5DA3A3FE, 0x804040C0, 0x058F8F8A, 0x3F9292AD, 0x219D9DBC, 0x70383848, 0xF1F5F504,
+    0x63BCBCDF, 0x77B6B6C1, 0xAFDADA75, 0x42212163, 0x20101030, 0xE5FFFF1A, 0xFDF3F30E, 0xBFD2D26D,
+    0x81CDCD4C, 0x180C0C14, 0x26131335, 0xC3ECEC2F, 0xBE5F5FE1, 0x359797A2, 0x884444CC, 0x2E171739,
+    0x93C4C457, 0x55A7A7F2, 0xFC7E7E82, 0x7A3D3D47, 0xC86464AC, 0xBA5D5DE7, 0x3219192B, 0xE6737395,
+    0xC06060A0, 0x19818198, 0x9E4F4FD1, 0xA3DCDC7F, 0x44222266, 0x542A2A7E, 0x3B9090AB, 0x0B888883,
+    0x8C4646CA, 0xC7EEEE29, 0x6BB8B8D3, 0x2814143C, 0xA7DEDE79, 0xBC5E5EE2, 0x160B0B1D, 0xADDBDB76,
+    0xDBE0E03B, 0x64323256, 0x743A3A4E, 0x140A0A1E, 0x924949DB, 0x0C06060A, 0x4824246C, 0xB85C5CE4,
+    0x9FC2C25D, 0xBDD3D36E, 0x43ACACEF, 0xC46262A6, 0x399191A8, 0x319595A4, 0xD3E4E437, 0xF279798B,
+    0xD5E7E732, 0x8BC8C843, 0x6E373759, 0xDA6D6DB7, 0x018D8D8C, 0xB1D5D564, 0x9C4E4ED2, 0x49A9A9E0,
+    0xD86C6CB4, 0xAC5656FA, 0xF3F4F407, 0xCFEAEA25, 0xCA6565AF, 0xF47A7A8E, 0x47AEAEE9, 0x10080818,
+    0x6FBABAD5, 0xF0787888, 0x4A25256F, 0x5C2E2E72, 0x381C1C24, 0x57A6A6F1, 0x73B4B4C7, 0x97C6C651,
+    0xCBE8E823, 0xA1DDDD7C, 0xE874749C, 0x3E1F1F21, 0x964B4BDD, 0x61BDBDDC, 0x0D8B8B86, 0x0F8A8A85,
+    0xE0707090, 0x7C3E3E42, 0x71B5B5C4, 0xCC6666AA, 0x904848D8, 0x06030305, 0xF7F6F601, 0x1C0E0E12,
+    0xC26161A3, 0x6A35355F, 0xAE5757F9, 0x69B9B9D0, 0x17868691, 0x99C1C158, 0x3A1D1D27, 0x279E9EB9,
+    0xD9E1E138, 0xEBF8F813, 0x2B9898B3, 0x22111133, 0xD26969BB, 0xA9D9D970, 0x078E8E89, 0x339494A7,
+    0x2D9B9BB6, 0x3C1E1E22, 0x15878792, 0xC9E9E920, 0x87CECE49, 0xAA5555FF, 0x50282878, 0xA5DFDF7A,
+    0x038C8C8F, 0x59A1A1F8, 0x09898980, 0x1A0D0D17, 0x65BFBFDA, 0xD7E6E631, 0x844242C6, 0xD06868B8,
+    0x824141C3, 0x299999B0, 0x5A2D2D77, 0x1E0F0F11, 0x7BB0B0CB, 0xA85454FC, 0x6DBBBBD6, 0x2C16163A
+};
+
+/*
+ * load32 function of type unsigned int.
+ *
+ * Input parameters: const unsigned char p
+ * Return: big-endian word at p
+ */
+static inline u4_t load32 (const u1_t* p) {
+    return ( (u4_t)p[0] << 24 ) | ( (u4_t)p[1] << 16 ) | ( (u4_t)p[2] << 8 ) | p[3];
+}// end of load32 function.
+
+/*
+ * store32 function of type void.
+ *
+ * Input parameters: unsigned char p
+ *                   unsigned int v
+ */
+static inline void store32 (u1_t* p, u4_t v) {
+    p[0] = v >> 24;
+    p[1] = v >> 16;
+    p[2] = v >> 8;
+    p[3] = v;
+}// end of store32 function.
+
+/*
+ * subWord function of type unsigned int.
+ *
+ * Input parameters: unsigned int w
+ * Return: S-box applied to every byte of w
+ */
+static inline u4_t subWord (u4_t w) {
+    return ( (u4_t)SBOX[w >> 24] << 24 ) | ( (u4_t)SBOX[( w >> 16 ) & 0xFF] << 16 ) |
+           ( (u4_t)SBOX[( w >> 8 ) & 0xFF] << 8 ) | SBOX[w & 0xFF];
+}// end of subWord function.
+
+/*
+ * shiftLeft function of type void.
+ *
+ * CMAC subkey derivation: out = in << 1, xor 0x87 on carry.
+ *
+ * Input parameters: const unsigned char in
+ *                   unsigned char out
+ */
+static void shiftLeft (const u1_t* in, u1_t* out) {
+    u1_t carry = in[0] >> 7;
+    for( u1_t i = 0; i < 15; i++ ) {
+        out[i] = (u1_t)( ( in[i] << 1 ) | ( in[i + 1] >> 7 ) );
+    }
+    out[15] = (u1_t)( ( in[15] << 1 ) ^ ( carry ? 0x87 : 0x00 ) );
+}// end of shiftLeft function.
+
+/*
+ * crypto_setKey function of type void.
+ *
+ * Input parameters: crypto_ctx_t ctx
+ *                   const unsigned char key
+ *
+ */
+void crypto_setKey (crypto_ctx_t* ctx, const u1_t* key) {
+    u1_t l[16];
+
+    memcpy( ctx->key, key, 16 );
+#if CRYPTO_MMCAU
+    MMCAU_AES_SetKey( key, 16, (uint8_t*)ctx->rk );
+#else
+    u4_t rcon = 0x01000000;
+    for( u1_t i = 0; i < 4; i++ ) {
+        ctx->rk[i] = load32( key + 4 * i );
+    }
+    for( u1_t i = 4; i < 44; i++ ) {
+        u4_t t = ctx->rk[i - 1];
+        if( ( i & 3 ) == 0 ) {
+            t = subWord( ( t << 8 ) | ( t >> 24 ) ) ^ rcon;
+            rcon = ( rcon & 0x80000000 ) ? 0x1B000000 : rcon << 1;
+        }
+        ctx->rk[i] = ctx->rk[i - 4] ^ t;
+    }
+#endif
+    // CMAC subkeys from L = AES(K, 0).
+    memset( l, 0, 16 );
+    crypto_encrypt( ctx, l, l );
+    shiftLeft( l, ctx->k1 );
+    shiftLeft( ctx->k1, ctx->k2 );
+}// end of crypto_setKey function.
+
+/*
+ * crypto_encrypt function of type void.
+ *
+ * Input parameters: const crypto_ctx_t ctx
+ *                   const unsigned char in
+ *                   unsigned char out
+ *
+ */
+void crypto_encrypt (const crypto_ctx_t* ctx, const u1_t* in, u1_t* out) {
+#if CRYPTO_MMCAU
+    MMCAU_AES_EncryptEcb( in, (const uint8_t*)ctx->rk, 10, out );
+#else
+    const u4_t* rk = ctx->rk;
+    u4_t s0 = load32( in ) ^ rk[0];
+    u4_t s1 = load32( in + 4 ) ^ rk[1];
+    u4_t s2 = load32( in + 8 ) ^ rk[2];
+    u4_t s3 = load32( in + 12 ) ^ rk[3];
+    u4_t t0, t1, t2, t3;
+
+    for( u1_t r = 1; r < 10; r++ ) {
+        rk += 4;
+        t0 = TE0[s0 >> 24] ^ ROR( TE0[( s1 >> 16 ) & 0xFF], 8 ) ^
+             ROR( TE0[( s2 >> 8 ) & 0xFF], 16 ) ^ ROR( TE0[s3 & 0xFF], 24 ) ^ rk[0];
+        t1 = TE0[s1 >> 24] ^ ROR( TE0[( s2 >> 16 ) & 0xFF], 8 ) ^
+             ROR( TE0[( s3 >> 8 ) & 0xFF], 16 ) ^ ROR( TE0[s0 & 0xFF], 24 ) ^ rk[1];
+        t2 = TE0[s2 >> 24] ^ ROR( TE0[( s3 >> 16 ) & 0xFF], 8 ) ^
+             ROR( TE0[( s0 >> 8 ) & 0xFF], 16 ) ^ ROR( TE0[s1 & 0xFF], 24 ) ^ rk[2];
+        t3 = TE0[s3 >> 24] ^ ROR( TE0[( s0 >> 16 ) & 0xFF], 8 ) ^
+             ROR( TE0[( s1 >> 8 ) & 0xFF], 16 ) ^ ROR( TE0[s2 & 0xFF], 24 ) ^ rk[3];
+        s0 = t0;
+        s1 = t1;
+        s2 = t2;
+        s3 = t3;
+    }
+    rk += 4;
+    store32( out,      ( ( (u4_t)SBOX[s0 >> 24] << 24 ) | ( (u4_t)SBOX[( s1 >> 16 ) & 0xFF] << 16 ) |
+                         ( (u4_t)SBOX[( s2 >> 8 ) & 0xFF] << 8 ) | SBOX[s3 & 0xFF] ) ^ rk[0] );
+    store32( out + 4,  ( ( (u4_t)SBOX[s1 >> 24] << 24 ) | ( (u4_t)SBOX[( s2 >> 16 ) & 0xFF] << 16 ) |
+                         ( (u4_t)SBOX[( s3 >> 8 ) & 0xFF] << 8 ) | SBOX[s0 & 0xFF] ) ^ rk[1] );
+    store32( out + 8,  ( ( (u4_t)SBOX[s2 >> 24] << 24 ) | ( (u4_t)SBOX[( s3 >> 16 ) & 0xFF] << 16 ) |
+                         ( (u4_t)SBOX[( s0 >> 8 ) & 0xFF] << 8 ) | SBOX[s1 & 0xFF] ) ^ rk[2] );
+    store32( out + 12, ( ( (u4_t)SBOX[s3 >> 24] << 24 ) | ( (u4_t)SBOX[( s0 >> 16 ) & 0xFF] << 16 ) |
+                         ( (u4_t)SBOX[( s1 >> 8 ) & 0xFF] << 8 ) | SBOX[s2 & 0xFF] ) ^ rk[3] );
+#endif
+}// end of crypto_encrypt function.
+
+/*
+ * crypto_cmac function of type unsigned int.
+ *
+ * Input parameters: const crypto_ctx_t ctx
+ *                   const unsigned char aux
+ *                   const unsigned char msg
+ *                   unsigned short len
+ * Return: first 4 bytes of the tag.
+ *
+ */
+u4_t crypto_cmac (const crypto_ctx_t* ctx, const u1_t* aux, const u1_t* msg, u2_t len) {
+    u1_t x[16];
+    u1_t i;
+
+    memset( x, 0, 16 );
+    if( aux != NULL ) {
+        for( i = 0; i < 16; i++ ) {
+            x[i] = aux[i];
+        }
+        if( len == 0 ) { // aux is the complete last block
+            for( i = 0; i < 16; i++ ) {
+                x[i] ^= ctx->k1[i];
+            }
+            crypto_encrypt( ctx, x, x );
+            return load32( x );
+        }
+        crypto_encrypt( ctx, x, x );
+    }
+    while( len > 16 ) {
+        for( i = 0; i < 16; i++ ) {
+            x[i] ^= msg[i];
+        }
+        crypto_encrypt( ctx, x, x );
+        msg += 16;
+        len -= 16;
+    }
+    if( len == 16 ) {
+        for( i = 0; i < 16; i++ ) {
+            x[i] ^= msg[i] ^ ctx->k1[i];
+        }
+    } else {
+        for( i = 0; i < len; i++ ) {
+            x[i] ^= msg[i];
+        }
+        x[len] ^= 0x80;
+        for( i = 0; i < 16; i++ ) {
+            x[i] ^= ctx->k2[i];
+        }
+    }
+    crypto_encrypt( ctx, x, x );
+    return load32( x );
+}// end of crypto_cmac function.
+
+/*
+ * crypto_ctr function of type void.
+ *
+ * Input parameters: const crypto_ctx_t ctx
+ *                   unsigned char ctr
+ *                   unsigned char buf
+ *                   unsigned short len
+ *
+ */
+void crypto_ctr (const crypto_ctx_t* ctx, u1_t* ctr, u1_t* buf, u2_t len) {
+    u1_t s[16];
+
+    while( len != 0 ) {
+        u1_t n = len < 16 ? (u1_t)len : 16;
+        crypto_encrypt( ctx, ctr, s );
+        for( u1_t i = 0; i < n; i++ ) {
+            buf[i] ^= s[i];
+        }
+        ctr[15]++;
+        buf += n;
+        len -= n;
+    }
+}// end of crypto_ctr function.
+
+/*
+ * crypto_backend function of type const char pointer.
+ *
+ * Input parameters: None
+ * Return: name of the block cipher implementation.
+ *
+ */
+const char* crypto_backend (void) {
+#if CRYPTO_MMCAU
+    return "MMCAU";
+#else
+    return "T-table";
+#endif
+}// end of crypto_backend function.
+
+#if CRYPTO_LMIC_AES
+
+// LMiC's AES key and auxiliary block (SEE oslmic.h); sized as in LMiC's aes.c.
+u4_t AESAUX[16 / sizeof( u4_t )];
+u4_t AESKEY[11 * 16 / sizeof( u4_t )];
+
+static crypto_ctx_t lmicCache[CRYPTO_LMIC_CACHE];
+static u1_t lmicCached = 0;  // number of valid entries
+static u1_t lmicVictim = 0;  // next entry to replace
+
+/*
+ * lmicContext function of type crypto_ctx_t pointer.
+ *
+ * Input parameters: None
+ * Return: cached context of the key currently in AESkey.
+ */
+static const crypto_ctx_t* lmicContext (void) {
+    for( u1_t i = 0; i < lmicCached; i++ ) {
+        if( memcmp( lmicCache[i].key, AESkey, 16 ) == 0 ) {
+            return &lmicCache[i];
+        }
+    }
+    crypto_ctx_t* ctx = &lmicCache[lmicVictim];
+    lmicVictim = ( lmicVictim + 1 ) % CRYPTO_LMIC_CACHE;
+    if( lmicCached < CRYPTO_LMIC_CACHE ) {
+        lmicCached++;
+    }
+    crypto_setKey( ctx, AESkey );
+    return ctx;
+}// end of lmicContext function.
+
+/*
+ * os_aes function of type unsigned int.
+ *
+ * LMiC AES primitive: AES_MIC (CMAC over AESaux and buf, or over buf only
+ * with AES_MICNOAUX), AES_CTR (buf xored with the AESaux key stream) or
+ * plain ECB encryption of buf in place, all with the key in AESkey.
+ *
+ * Input parameters: unsigned char mode
+ *                   unsigned char buf
+ *                   unsigned short len
+ * Return: MIC for AES_MIC, 0 otherwise
+ */
+u4_t os_aes (u1_t mode, xref2u1_t buf, u2_t len) {
+    const crypto_ctx_t* ctx = lmicContext( );
+
+    if( mode & AES_MIC ) {
+        return crypto_cmac( ctx, ( mode & AES_MICNOAUX ) ? NULL : AESaux, buf, len );
+    }
+    if( mode & AES_CTR ) {
+        crypto_ctr( ctx, AESaux, buf, len );
+        return 0;
+    }
+    for( ; len >= 16; len -= 16, buf += 16 ) {
+        crypto_encrypt( ctx, buf, buf );
+    }
+    return 0;
+}// end of os_aes function.
+
+#endif // CRYPTO_LMIC_AES
+
+/*
+ * uplinkBlocks function of type void.
+ *
+ * Fills the A_1 and B0 blocks of the benchmark uplink.
+ *
+ * Input parameters: unsigned char a1
+ *                   unsigned char b0
+ */
+static void uplinkBlocks (u1_t* a1, u1_t* b0) {
+    memset( a1, 0, 16 );
+    memset( b0, 0, 16 );
+    a1[0] = 0x01;
+    a1[15] = 0x01;
+    b0[0] = 0x49;
+    b0[15] = 21;
+}// end of uplinkBlocks function.
+
+/*
+ * crypto_benchmark function of type void.
+ *
+ * Input parameters: unsigned int rounds
+ *                   const unsigned char nwkKey
+ *                   const unsigned char artKey
+ *
+ */
+void crypto_benchmark (u4_t rounds, const u1_t* nwkKey, const u1_t* artKey) {
+    static crypto_ctx_t nwk, art;
+    u1_t frame[21], a1[16], b0[16];
+    u4_t mic = 0;
+    u4_t lmic, uncached, cached, start;
+
+    if( rounds == 0 ) {
+        return;
+    }
+    memset( frame, 0x5A, sizeof( frame ) );
+
+    // LMiC's os_aes, loading both keys for every uplink.
+    start = bench_counter( );
+    for( u4_t r = 0; r < rounds; r++ ) {
+        uplinkBlocks( AESaux, b0 );
+        memcpy( AESkey, artKey, 16 );
+        os_aes( AES_CTR, frame + 9, 8 );
+        memcpy( AESaux, b0, 16 );
+        memcpy( AESkey, nwkKey, 16 );
+        mic += os_aes( AES_MIC, frame, 17 );
+    }
+    lmic = bench_counter( ) - start;
+
+    // This backend, expanding both keys for every uplink.
+    start = bench_counter( );
+    for( u4_t r = 0; r < rounds; r++ ) {
+        uplinkBlocks( a1, b0 );
+        crypto_setKey( &art, artKey );
+        crypto_ctr( &art, a1, frame + 9, 8 );
+        crypto_setKey( &nwk, nwkKey );
+        mic += crypto_cmac( &nwk, b0, frame, 17 );
+    }
+    uncached = bench_counter( ) - start;
+
+    // This backend with the key schedules cached once per session.
+    start = bench_counter( );
+    for( u4_t r = 0; r < rounds; r++ ) {
+        uplinkBlocks( a1, b0 );
+        crypto_ctr( &art, a1, frame + 9, 8 );
+        mic += crypto_cmac( &nwk, b0, frame, 17 );
+    }
+    cached = bench_counter( ) - start;
+
+    printf("Uplink crypto (%s): os_aes %u, uncached %u, cached %u %s per uplink (%08X)\r\n",
+           crypto_backend( ), (unsigned int)( lmic / rounds ), (unsigned int)( uncached / rounds ),
+           (unsigned int)( cached / rounds ), bench_unit( ), (unsigned int)mic);
+}// end of crypto_benchmark function.
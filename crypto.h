@@ -0,0 +1,119 @@
+/*******************************************************************************
+ * Internet of Things (IoT) smart monitoring
+ * device for agriculture using LoRaWAN technology.
+ *
+ * AES-128 backend with cached key schedules for LoRaWAN crypto.
+ *
+ * - A crypto_ctx_t holds the expanded key schedule and the CMAC subkeys
+ * (K1, K2) of one key. They are computed once per session by crypto_setKey
+ * instead of once per operation.
+ *
+ * - Block encryption uses the K64F's MMCAU crypto unit when the KSDK driver
+ * (fsl_mmcau.h) is available, and a table-driven software implementation
+ * (one T-table, rotated) otherwise, e.g. on a host.
+ *
+ * - With CRYPTO_LMIC_AES set to 1 this module also provides LMiC's os_aes
+ * primitive, so that the uplink payload encryption (AES-CTR) and MIC
+ * (AES-CMAC) computed by LMiC for the NWKSKEY/APPSKEY session run on the
+ * cached schedules. LMiC's own aes.c must then be left out of the build
+ * (e.g. listed in .mbedignore).
+ *
+ *******************************************************************************/
+#ifndef _crypto_hpp_
+#define _crypto_hpp_
+
+#include "lmic.h"
+
+// Set to 1 to provide LMiC's os_aes from this module (requires LMiC's aes.c
+// to be excluded from the build).
+#ifndef CRYPTO_LMIC_AES
+#define CRYPTO_LMIC_AES 0
+#endif
+
+// Number of key schedules cached by os_aes (network and application keys).
+#define CRYPTO_LMIC_CACHE 2
+
+/*
+ * crypto_ctx_t structure.
+ *
+ * Cached key material of one AES-128 key.
+ */
+typedef struct {
+    u4_t rk[44];  // Expanded key schedule (11 round keys).
+    u1_t key[16]; // Raw key, identifies the cached schedule.
+    u1_t k1[16];  // CMAC subkey for complete last blocks.
+    u1_t k2[16];  // CMAC subkey for padded last blocks.
+} crypto_ctx_t;
+
+/*
+ * crypto_setKey function of type void.
+ *
+ * Expands key into ctx and derives its CMAC subkeys.
+ *
+ * Input parameters: crypto_ctx_t ctx
+ *                   const unsigned char key (16 bytes)
+ */
+void crypto_setKey (crypto_ctx_t* ctx, const u1_t* key);
+
+/*
+ * crypto_encrypt function of type void.
+ *
+ * Encrypts one 16-byte block (in and out may be the same buffer).
+ *
+ * Input parameters: const crypto_ctx_t ctx
+ *                   const unsigned char in
+ *                   unsigned char out
+ */
+void crypto_encrypt (const crypto_ctx_t* ctx, const u1_t* in, u1_t* out);
+
+/*
+ * crypto_cmac function of type unsigned int.
+ *
+ * AES-CMAC over the 16-byte aux block (if not NULL) followed by len bytes
+ * of msg, as used for the LoRaWAN MIC (aux holding block B0).
+ *
+ * Input parameters: const crypto_ctx_t ctx
+ *                   const unsigned char aux (16 bytes or NULL)
+ *                   const unsigned char msg
+ *                   unsigned short len
+ * Return: first 4 bytes of the tag, first byte in the most significant position.
+ */
+u4_t crypto_cmac (const crypto_ctx_t* ctx, const u1_t* aux, const u1_t* msg, u2_t len);
+
+/*
+ * crypto_ctr function of type void.
+ *
+ * Encrypts or decrypts len bytes of buf in place with the LoRaWAN AES-CTR
+ * scheme. ctr holds block A_1; its last byte is incremented per block.
+ *
+ * Input parameters: const crypto_ctx_t ctx
+ *                   unsigned char ctr (16 bytes)
+ *                   unsigned char buf
+ *                   unsigned short len
+ */
+void crypto_ctr (const crypto_ctx_t* ctx, u1_t* ctr, u1_t* buf, u2_t len);
+
+/*
+ * crypto_backend function of type const char pointer.
+ *
+ * Input parameters: None
+ * Return: name of the block cipher implementation in use.
+ */
+const char* crypto_backend (void);
+
+/*
+ * crypto_benchmark function of type void.
+ *
+ * Measures the crypto cost of one uplink as issued by LMiC (AES-CTR over an
+ * 8-byte payload with AppSKey and AES-CMAC over the 17 bytes of a 21-byte
+ * frame with NwkSKey), averaged over rounds, for LMiC's os_aes and for this backend
+ * with and without cached key schedules, and writes it to the UART
+ * (CPU cycles on Cortex-M, nanoseconds elsewhere).
+ *
+ * Input parameters: unsigned int rounds
+ *                   const unsigned char nwkKey
+ *                   const unsigned char artKey
+ */
+void crypto_benchmark (u4_t rounds, const u1_t* nwkKey, const u1_t* artKey);
+
+#endif // _crypto_hpp_
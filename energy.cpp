@@ -0,0 +1,199 @@
+/*******************************************************************************
+ * Internet of Things (IoT) smart monitoring
+ * device for agriculture using LoRaWAN technology.
+ *
+ * Energy accounting model.
+ *
+ * Charge is accumulated in microampere-ticks (one HAL tick is 64 us) per
+ * component and converted to microampere-hours when reported.
+ *
+ * SEE energy.h file for the description of each function.
+ *
+ *******************************************************************************/
+
+#if defined(__MBED__)
+#include "mbed.h"
+#else
+#include <stdio.h>
+#include <string.h>
+#endif
+#include "lmic.h"
+#include "hal.h"
+#include "energy.h"
+
+// HAL ticks per hour (64 us per tick).
+#define TICKS_PER_HOUR 56250000ULL
+
+// SX1272 RegOpMode mode bits.
+#define OPMODE_MASK     0x07
+#define OPMODE_SLEEP    0x00
+#define OPMODE_STANDBY  0x01
+#define OPMODE_FSTX     0x02
+#define OPMODE_TX       0x03
+#define OPMODE_FSRX     0x04
+
+static const char* const NAMES[ENERGY_COMPONENTS] = { "MCU", "radio", "sensors", "UART" };
+
+static u4_t current[ENERGY_COMPONENTS];           // Present current of each component.
+static unsigned long long charge[ENERGY_COMPONENTS]; // Integrated charge (uA * ticks).
+static unsigned long long elapsed;                // Integrated time (ticks).
+static u4_t last;                                 // Time integrated up to.
+static u4_t txStart;                              // Last change to transmit mode.
+
+/*
+ * integrate function of type void.
+ *
+ * Adds the charge drawn by every component since the last call. Runs
+ * with interrupts disabled, as the radio hook is also called from the
+ * DIO interrupt handlers.
+ *
+ * Input parameters: None
+ */
+static void integrate (void) {
+    hal_disableIRQs( );
+    u4_t now = hal_ticks( );
+    u4_t dt = now - last;
+
+    for( u1_t i = 0; i < ENERGY_COMPONENTS; i++ ) {
+        charge[i] += (unsigned long long)current[i] * dt;
+    }
+    elapsed += dt;
+    last = now;
+    hal_enableIRQs( );
+}// end of integrate function.
+
+/*
+ * energy_init function of type void.
+ *
+ * Input parameters: None
+ *
+ */
+void energy_init (void) {
+    memset( current, 0, sizeof( current ) );
+    memset( charge, 0, sizeof( charge ) );
+    current[ENERGY_MCU] = ENERGY_MCU_RUN;
+    current[ENERGY_RADIO] = ENERGY_RADIO_SLEEP;
+    elapsed = 0;
+    last = hal_ticks( );
+}// end of energy_init function.
+
+/*
+ * energy_set function of type void.
+ *
+ * Input parameters: unsigned char component
+ *                   unsigned int uA
+ *
+ */
+void energy_set (u1_t component, u4_t uA) {
+    hal_disableIRQs( );
+    integrate( );
+    current[component] = uA;
+    hal_enableIRQs( );
+}// end of energy_set function.
+
+/*
+ * energy_txCurrent function of type unsigned int.
+ *
+ * Input parameters: signed char power
+ * Return: SX1272 transmit current in microamperes.
+ *
+ */
+u4_t energy_txCurrent (s1_t power) {
+    // Datasheet points (dBm, uA), interpolated linearly.
+    static const s1_t DBM[] = { 7, 13, 17, 20 };
+    static const u4_t UA[] = { 18000, 28000, 90000, 125000 };
+
+    if( power <= DBM[0] ) {
+        return UA[0];
+    }
+    for( u1_t i = 1; i < sizeof( DBM ); i++ ) {
+        if( power <= DBM[i] ) {
+            return UA[i - 1] + ( UA[i] - UA[i - 1] ) * ( power - DBM[i - 1] ) / ( DBM[i] - DBM[i - 1] );
+        }
+    }
+    return UA[sizeof( DBM ) - 1];
+}// end of energy_txCurrent function.
+
+/*
+ * energy_radioMode function of type void.
+ *
+ * Input parameters: unsigned char opmode
+ *
+ */
+void energy_radioMode (u1_t opmode) {
+    u4_t uA;
+
+    switch( opmode & OPMODE_MASK ) {
+        case OPMODE_SLEEP:
+            uA = ENERGY_RADIO_SLEEP;
+            break;
+        case OPMODE_STANDBY:
+            uA = ENERGY_RADIO_STDBY;
+            break;
+        case OPMODE_FSTX:
+        case OPMODE_FSRX:
+            uA = ENERGY_RADIO_FS;
+            break;
+        case OPMODE_TX:
+            uA = energy_txCurrent( LMIC.txpow );
+            break;
+        default: // RXCONTINUOUS, RXSINGLE, CAD
+            uA = ENERGY_RADIO_RX;
+            break;
+    }
+    energy_set( ENERGY_RADIO, uA );
+    if( ( opmode & OPMODE_MASK ) == OPMODE_TX ) {
+        txStart = last;
+    }
+}// end of energy_radioMode function.
+
+/*
+ * energy_lastTx function of type ostime_t.
+ *
+ * Input parameters: None
+ * Return: time at which the radio last entered transmit mode.
+ *
+ */
+ostime_t energy_lastTx (void) {
+    return (ostime_t)txStart;
+}// end of energy_lastTx function.
+
+/*
+ * energy_charge function of type unsigned int.
+ *
+ * Input parameters: unsigned char component
+ * Return: charge drawn in microcoulombs.
+ *
+ */
+u4_t energy_charge (u1_t component) {
+    integrate( );
+    // 64 us per tick.
+    return (u4_t)( charge[component] * 64 / 1000000 );
+}// end of energy_charge function.
+
+/*
+ * energy_report function of type void.
+ *
+ * Input parameters: None
+ *
+ */
+void energy_report (void) {
+    unsigned long long total = 0;
+
+    integrate( );
+    if( elapsed == 0 ) {
+        return;
+    }
+    printf("Energy over %u s:\r\n", (unsigned int)( elapsed * 64 / 1000000 ));
+    for( u1_t i = 0; i < ENERGY_COMPONENTS; i++ ) {
+        total += charge[i];
+        printf("  %-8s %8u uAh, %6u uAh/day\r\n", NAMES[i],
+               (unsigned int)( charge[i] / TICKS_PER_HOUR ),
+               (unsigned int)( charge[i] * 24 / elapsed ));
+    }
+    // Daily charge: mean current (charge / elapsed) over 24 hours.
+    u4_t perDay = (u4_t)( total * 24 / elapsed );
+    printf("  total %u mAh/day, battery life %u days (%u mAh)%s\r\n\r\n", (unsigned int)( perDay / 1000 ),
+           (unsigned int)( perDay ? BATTERY_CAPACITY * 1000ULL / perDay : 0 ), BATTERY_CAPACITY,
+           perDay > ENERGY_BUDGET * 1000UL ? ", ENERGY REGRESSION: over budget" : "");
+}// end of energy_report function.
@@ -0,0 +1,123 @@
+/*******************************************************************************
+ * Internet of Things (IoT) smart monitoring
+ * device for agriculture using LoRaWAN technology.
+ *
+ * Energy accounting model.
+ *
+ * - The node is split into components (MCU, SX1272 radio, sensors, UART),
+ * each drawing a modelled current that depends on its state. Hooks in the
+ * HAL and the application report every state change, and the charge drawn
+ * by every component is integrated over HAL time (hal_ticks), so that it
+ * also follows a replayed or simulated HAL clock.
+ *
+ * - The radio state is taken from the RegOpMode writes issued by LMiC on
+ * the SPI bus (hal_spi); the transmit current follows LMIC.txpow.
+ *
+ * - energy_report extrapolates the integrated charge to mAh per day and to
+ * the battery life for BATTERY_CAPACITY, and flags an energy regression when
+ * the daily charge exceeds ENERGY_BUDGET, so that changes to transmit(),
+ * loop() or the HAL can be checked against the budget.
+ *
+ * - Currents are typical datasheet values (FRDM-K64F / MK64FN1M0 at 120 MHz,
+ * SX1272 with PA_BOOST as configured by LMiC).
+ *
+ *******************************************************************************/
+#ifndef _energy_hpp_
+#define _energy_hpp_
+
+#include "lmic.h"
+
+// Battery capacity in mAh used for the battery-life estimate (2 x AA).
+#ifndef BATTERY_CAPACITY
+#define BATTERY_CAPACITY 2400
+#endif
+
+// Daily charge budget in mAh; energy_report flags any excess as a regression.
+#ifndef ENERGY_BUDGET
+#define ENERGY_BUDGET 900
+#endif
+
+// Modelled currents in microamperes.
+#define ENERGY_MCU_RUN      36000  // Core running from flash at 120 MHz (busy waits included).
+#define ENERGY_MCU_SLEEP    6000   // WFI sleep, peripherals clocked.
+#define ENERGY_RADIO_SLEEP  1      // SX1272 sleep.
+#define ENERGY_RADIO_STDBY  1400   // SX1272 standby.
+#define ENERGY_RADIO_FS     4500   // SX1272 frequency synthesis (FSTX/FSRX).
+#define ENERGY_RADIO_RX     10500  // SX1272 receive or channel activity detection.
+#define ENERGY_UART_ON      1000   // Debug UART enabled.
+
+// Modelled components.
+enum {
+    ENERGY_MCU = 0,
+    ENERGY_RADIO,
+    ENERGY_SENSORS,
+    ENERGY_UART,
+    ENERGY_COMPONENTS
+};
+
+/*
+ * energy_init function of type void.
+ *
+ * Clears the accounted charge and starts integrating, with the MCU running
+ * and every other component off.
+ *
+ * Input parameters: None
+ */
+void energy_init (void);
+
+/*
+ * energy_set function of type void.
+ *
+ * Integrates the charge drawn up to now and sets the current of one
+ * component.
+ *
+ * Input parameters: unsigned char component (ENERGY_MCU ... ENERGY_UART)
+ *                   unsigned int uA (microamperes)
+ */
+void energy_set (u1_t component, u4_t uA);
+
+/*
+ * energy_radioMode function of type void.
+ *
+ * HAL hook: sets the radio current from a value written to RegOpMode.
+ *
+ * Input parameters: unsigned char opmode
+ */
+void energy_radioMode (u1_t opmode);
+
+/*
+ * energy_lastTx function of type ostime_t.
+ *
+ * Input parameters: None
+ * Return: time at which the radio last entered transmit mode.
+ */
+ostime_t energy_lastTx (void);
+
+/*
+ * energy_txCurrent function of type unsigned int.
+ *
+ * Input parameters: signed char power (dBm)
+ * Return: SX1272 transmit current in microamperes at the given power.
+ */
+u4_t energy_txCurrent (s1_t power);
+
+/*
+ * energy_charge function of type unsigned int.
+ *
+ * Input parameters: unsigned char component (ENERGY_MCU ... ENERGY_UART)
+ * Return: charge drawn by the component since energy_init in microcoulombs
+ *         (microampere-seconds).
+ */
+u4_t energy_charge (u1_t component);
+
+/*
+ * energy_report function of type void.
+ *
+ * Writes the charge drawn by every component, the extrapolated mAh per day,
+ * the battery life in days and the budget check to the UART.
+ *
+ * Input parameters: None
+ */
+void energy_report (void);
+
+#endif // _energy_hpp_
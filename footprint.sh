@@ -0,0 +1,65 @@
+#!/bin/sh
+###############################################################################
+# Internet of Things (IoT) smart monitoring
+# device for agriculture using LoRaWAN technology.
+#
+# Flash/RAM footprint report per firmware variant.
+#
+# Builds every variant listed below from the same source with mbed CLI,
+# overriding the config.h macros on the command line, and reports the
+# .text/.data/.bss size of each image together with its flash (text + data)
+# and RAM (data + bss) cost relative to the first (baseline) variant.
+#
+# Usage: ./footprint.sh [target] [toolchain]   (default: K64F GCC_ARM)
+#
+# Requires mbed CLI (after "mbed deploy") and arm-none-eabi-size in PATH.
+###############################################################################
+
+TARGET=${1:-K64F}
+TOOLCHAIN=${2:-GCC_ARM}
+PROFILE=${PROFILE:-release}
+BUILD_ROOT=BUILD/footprint
+
+# name|macro overrides
+VARIANTS="
+abp-release|-DACTIVATION_METHOD=0 -DDEBUG_LEVEL=0
+abp-debug|-DACTIVATION_METHOD=0 -DDEBUG_LEVEL=1
+otaa-release|-DACTIVATION_METHOD=1 -DDEBUG_LEVEL=0
+otaa-debug|-DACTIVATION_METHOD=1 -DDEBUG_LEVEL=1
+abp-multichannel|-DACTIVATION_METHOD=0 -DDEBUG_LEVEL=0 -DSINGLE_CHANNEL_GATEWAY=0
+"
+
+printf "%-18s %9s %7s %7s %9s %9s\n" variant .text .data .bss "d.flash" "d.ram"
+
+mkdir -p "$BUILD_ROOT"
+
+baseFlash=""
+baseRam=""
+echo "$VARIANTS" | while IFS='|' read name flags; do
+    [ -z "$name" ] && continue
+    out="$BUILD_ROOT/$name"
+    defs=""
+    for f in $flags; do
+        defs="$defs -D ${f#-D}"
+    done
+    if ! mbed compile -m "$TARGET" -t "$TOOLCHAIN" --profile "$PROFILE" \
+            --build "$out" $defs > "$out.log" 2>&1; then
+        printf "%-18s build failed, see %s.log\n" "$name" "$out"
+        continue
+    fi
+    elf=$(ls "$out"/*.elf 2>/dev/null | head -n 1)
+    if [ -z "$elf" ]; then
+        printf "%-18s no ELF image produced\n" "$name"
+        continue
+    fi
+    set -- $(arm-none-eabi-size -B "$elf" | tail -n 1)
+    text=$1; data=$2; bss=$3
+    flash=$((text + data))
+    ram=$((data + bss))
+    if [ -z "$baseFlash" ]; then
+        baseFlash=$flash
+        baseRam=$ram
+    fi
+    printf "%-18s %9u %7u %7u %+9d %+9d\n" "$name" "$text" "$data" "$bss" \
+        $((flash - baseFlash)) $((ram - baseRam))
+done
@@ -36,12 +36,29 @@
  * NRESET          A0
  *
  * - Added some external comments for meeting good principles of 
- *   source code re-usability. 
+ *   source code re-usability.
+ *
+ * - RegOpMode writes are forwarded to the energy model (energy.h).
+ *
+ * - DIO edges, SPI bytes and tick readings are recorded (HAL_TRACE) or
+ *   served from a recorded trace (HAL_REPLAY), SEE trace.h. 
+ *
+ * - hal_failed saves a crash record and resets the MCU instead of hanging,
+ *   SEE recovery.h.
+ *
+ * - Register accesses go through a shadow of the SX1272 registers that
+ *   keeps redundant configuration traffic off the SPI bus (HAL_REGCACHE),
+ *   SEE regcache.h. Traces hold the bus traffic, hence are replayed with
+ *   the HAL_REGCACHE setting they were recorded with.
  *******************************************************************************/
  
 #include "mbed.h"
 #include "lmic.h"
 #include "mbed_debug.h"
+#include "energy.h"
+#include "trace.h"
+#include "recovery.h"
+#include "regcache.h"
 
 #if !USE_SMTC_RADIO_DRIVER
 
@@ -57,6 +74,12 @@ static InterruptIn dio0( D2 ); // dio0
 static InterruptIn dio1( D3 ); // dio1
 static InterruptIn dio2( D4 ); // dio2 
 
+// SX1272 RegOpMode address, written with the write bit set.
+#define REG_OPMODE_WRITE ( 0x01 | 0x80 )
+
+static u1_t spiIndex = 0; // byte position within the current NSS frame
+static u1_t spiAddr = 0;  // first byte (register address) of the frame
+
 /* 
  * dio0Irq function of type void.
  *
@@ -64,6 +87,9 @@ static InterruptIn dio2( D4 ); // dio2
  *
  */ 
 static void dio0Irq( void ) {
+#if HAL_TRACE
+    trace_irq( 0 );
+#endif
     radio_irq_handler( 0 );
 }// end of dio0Irq function.
 
@@ -74,6 +100,9 @@ static void dio0Irq( void ) {
  *
  */ 
 static void dio1Irq( void ) {
+#if HAL_TRACE
+    trace_irq( 1 );
+#endif
     radio_irq_handler( 1 );
 }// end of dio1Irq funtion.
 
@@ -84,9 +113,68 @@ static void dio1Irq( void ) {
  *
  */ 
 static void dio2Irq( void ) {
+#if HAL_TRACE
+    trace_irq( 2 );
+#endif
     radio_irq_handler( 2 );
 }// end of dio2Irq function.
 
+#if HAL_REPLAY
+/* 
+ * replayIrqs function of type void.
+ *
+ * Runs the radio interrupt handler for every DIO edge due at this
+ * point of the replayed trace.
+ *
+ * Input parameters: None
+ *
+ */ 
+static void replayIrqs( void ) {
+    static bit_t inIrq = 0;
+    u1_t dio;
+    if( inIrq )
+    { // the handler's own HAL calls do not nest interrupts
+        return;
+    }
+    inIrq = 1;
+    while( trace_replayIrq( &dio ) )
+    {
+        radio_irq_handler( dio );
+    }
+    inIrq = 0;
+}// end of replayIrqs function.
+#endif
+
+/* 
+ * spiNss function of type void.
+ *
+ * Input parameters: unsigned char val
+ *
+ */ 
+static void spiNss( u1_t val ) {
+    nss = val;
+}// end of spiNss function.
+
+/* 
+ * spiBus function of type unsigned char.
+ *
+ * Input parameters: unsigned char out
+ *
+ * Return: spi in value
+ */ 
+static u1_t spiBus( u1_t out ) {
+#if HAL_REPLAY
+    replayIrqs( );
+    u1_t in = trace_replaySpi( out );
+#else
+    u1_t in = spi.write( out );
+#endif
+#if HAL_TRACE
+    trace_spi( out, in );
+#endif
+    return in;
+}// end of spiBus function.
+
 #endif
 
 static u1_t irqlevel = 0;
@@ -95,6 +183,14 @@ static u4_t ticks = 0;
 static Timer timer;
 static Ticker ticker;
 
+// Longest sleep in hal_sleep, well within the watchdog timeout so that the
+// loop keeps kicking it while no job is due.
+#define HAL_SLEEP_MAX ms2osticks( RECOVERY_TIMEOUT / 4 )
+
+static Timeout sleepTimer;
+static u4_t sleepUntil = 0;     // Deadline of the first scheduled job.
+static bit_t sleepArmed = 0;    // Set while sleepUntil is valid.
+
 /* 
  * reset_timer function of type void.
  *
@@ -106,6 +202,19 @@ static void reset_timer( void ) {
     timer.reset( );
 }// end of reset_timer function.
 
+#if !HAL_REPLAY || USE_SMTC_RADIO_DRIVER
+/* 
+ * wakeUp function of type void.
+ *
+ * Sleep timer callback: the interrupt itself ends the sleep.
+ *
+ * Input parameters: None
+ *
+ */ 
+static void wakeUp( void ) {
+}// end of wakeUp function.
+#endif
+
 /* 
  * hal_init function of type void.
  *
@@ -133,6 +242,7 @@ void hal_init( void ) {
     spi.frequency( 8000000 );
     spi.format( 8, 0 );
     nss = 1;
+    regcache_init( regcache_radio( ), spiNss, spiBus, HAL_REGCACHE );
 #endif
     // Configure timer.
     timer.start( );
@@ -159,7 +269,8 @@ void hal_pin_rxtx( u1_t val ) {
  *
  */ 
 void hal_pin_nss( u1_t val ) {
-    nss = val;
+    regcache_select( regcache_radio( ), val );
+    spiIndex = 0;
 }// end of hal_pin_nss function.
 
 /* 
@@ -170,7 +281,8 @@ void hal_pin_nss( u1_t val ) {
  */ 
 void hal_pin_rst( u1_t val ) {
     if( val == 0 || val == 1 )
-    { // drive pin
+    { // drive pin, resetting the radio registers
+        regcache_invalidate( regcache_radio( ) );
         rst.output( );
         rst = val;
     } 
@@ -185,10 +297,20 @@ void hal_pin_rst( u1_t val ) {
  *
  * Input parameters: unsigned char out
  *
- * Return: spi out value
+ * Return: spi out value, from the radio or its register shadow
  */ 
 u1_t hal_spi( u1_t out ) {
-    return spi.write( out );
+    // Follow radio mode changes for the energy model.
+    if( spiIndex == 0 )
+    {
+        spiAddr = out;
+    }
+    else if( spiIndex == 1 && spiAddr == REG_OPMODE_WRITE )
+    {
+        energy_radioMode( out );
+    }
+    spiIndex++;
+    return regcache_spi( regcache_radio( ), out );
 }// end of hal_spi function.
 
 #endif
@@ -224,7 +346,24 @@ void hal_enableIRQs( void ) {
  *
  */ 
 void hal_sleep( void ) {
-    // NOP
+    // Called with interrupts disabled: a pending interrupt still ends WFI and
+    // is served once os_runloop_once enables them again.
+    s4_t d = sleepArmed ? (s4_t)( sleepUntil - os_getTime( ) ) : HAL_SLEEP_MAX;
+    sleepArmed = 0;
+    if( d <= 0 ) {
+        return;
+    }
+    if( d > HAL_SLEEP_MAX ) {
+        d = HAL_SLEEP_MAX;
+    }
+    energy_set( ENERGY_MCU, ENERGY_MCU_SLEEP );
+#if !HAL_REPLAY || USE_SMTC_RADIO_DRIVER
+    // On replay time comes from the trace, so there is nothing to wait for.
+    sleepTimer.attach_us( wakeUp, osticks2us( d ) );
+    sleep( );
+    sleepTimer.detach( );
+#endif
+    energy_set( ENERGY_MCU, ENERGY_MCU_RUN );
 }// end of hal_sleep function.
 
 /* 
@@ -235,10 +374,18 @@ void hal_sleep( void ) {
  *
  */ 
 u4_t hal_ticks( void ) {
+#if HAL_REPLAY && !USE_SMTC_RADIO_DRIVER
+    replayIrqs( );
+    return trace_replayTicks( );
+#else
     hal_disableIRQs( );
     int t = ticks + ( timer.read_us( ) >> 6 );
     hal_enableIRQs( );
+#if HAL_TRACE
+    trace_ticks( t );
+#endif
     return t;
+#endif
 }//end of hal_ticks function.
 
 /* 
@@ -277,7 +424,10 @@ void hal_waitUntil( u4_t time ) {
  *
  */ 
 u1_t hal_checkTimer( u4_t time ) {
-    return ( deltaticks( time ) < 2 );
+    // Remembered for hal_sleep, which follows when the job is not due yet.
+    sleepUntil = time;
+    sleepArmed = deltaticks( time ) >= 2;
+    return !sleepArmed;
 }// end of hal_checkTimer function.
 
 /* 
@@ -287,5 +437,6 @@ u1_t hal_checkTimer( u4_t time ) {
  *
  */ 
 void hal_failed( void ) {
-    while( 1 );
+    // The caller is the failing LMiC function.
+    recovery_fail( RECOVERY_ASSERT, (u4_t)(size_t)__builtin_return_address( 0 ) );
 }// end of hal_failed function.
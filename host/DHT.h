@@ -0,0 +1,40 @@
+/*******************************************************************************
+ * Internet of Things (IoT) smart monitoring
+ * device for agriculture using LoRaWAN technology.
+ *
+ * Host stand-in for the DHT11 library (DHT.h).
+ *
+ * - readData() takes the 23 ms of the start signal and 40-bit transfer on
+ * the virtual clock and returns the reading set by sim_setDht (SEE sim.h).
+ *
+ * - Not part of the firmware image (SEE .mbedignore).
+ *
+ *******************************************************************************/
+#ifndef DHT_H
+#define DHT_H
+
+#include "mbed.h"
+
+typedef enum eType { DHT11 = 11, DHT22 = 22 } eType;
+typedef enum eError { ERROR_NONE = 0, BUS_BUSY, ERROR_NOT_PRESENT, ERROR_ACK_TOO_LONG,
+                      ERROR_SYNC_TIMEOUT, ERROR_DATA_TIMEOUT, ERROR_CHECKSUM,
+                      ERROR_NO_PATIENCE } eError;
+typedef enum eScale { CELCIUS = 0, FARENHEIT, KELVIN } eScale;
+
+/*
+ * DHT class.
+ *
+ * Temperature and humidity sensor on one data pin.
+ */
+class DHT {
+public:
+    DHT (PinName pin, eType type) : _pin( pin ), _type( type ) { }
+    eError readData (void);
+    float ReadTemperature (eScale scale);
+    float ReadHumidity (void);
+private:
+    PinName _pin;
+    eType _type;
+};
+
+#endif // DHT_H
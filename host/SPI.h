@@ -0,0 +1,15 @@
+/*******************************************************************************
+ * Internet of Things (IoT) smart monitoring
+ * device for agriculture using LoRaWAN technology.
+ *
+ * Host stand-in for the mbed SPI header (SPI.h), declared in mbed.h.
+ *
+ * - Not part of the firmware image (SEE .mbedignore).
+ *
+ *******************************************************************************/
+#ifndef SPI_H
+#define SPI_H
+
+#include "mbed.h"
+
+#endif // SPI_H
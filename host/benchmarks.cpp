@@ -0,0 +1,55 @@
+/*******************************************************************************
+ * Internet of Things (IoT) smart monitoring
+ * device for agriculture using LoRaWAN technology.
+ *
+ * Host run of the benchmark suite.
+ *
+ * - Runs the node (main.cpp) built with RUN_BENCHMARKS 1 on the mocked
+ * hardware: setUp runs benchmarkSuite (bench.cpp and the benchmarks and
+ * simulations of the modules) before the first uplink, writing the results
+ * to the UART (stdout) in nanoseconds.
+ *
+ * - Fails if the node sent no uplink after the suite. The stored baseline is
+ * in CPU cycles of the board and is not compared on a host.
+ *
+ * Usage: benchmarks
+ *
+ *******************************************************************************/
+#undef main
+
+#include "mbed.h"
+#include "lmic.h"
+#include "config.h"
+#include "sim.h"
+
+// Node entry point (main.cpp built with -Dmain=node_main).
+int node_main (int argc, char** argv);
+
+// Simulated run time in seconds: the suite and the first uplinks.
+#define RUN_TIME ( 3 * TRANSMIT_INTERVAL )
+
+/*
+ * main function of type integer.
+ *
+ * Input parameters: integer argc.
+ *                   char **argv.
+ * Return: 0 if the node sent uplinks after the suite, 1 otherwise.
+ */
+int main (int argc, char** argv) {
+    (void)argc;
+    (void)argv;
+
+    // Wet soil, daylight, mild weather: no alarms.
+    sim_setAnalog( A1, 20000 );
+    sim_setAnalog( A3, 30000 );
+    sim_setDht( 21.5f, 48.0f, 0 );
+    sim_run( node_main, (uint64_t)RUN_TIME * 1000000 );
+
+    printf("%u uplinks after the benchmark suite\r\n", (unsigned int)sim_uplinks( ));
+    if( sim_uplinks( ) == 0 ) {
+        printf("Benchmarks: FAILED\r\n");
+        return 1;
+    }
+    printf("Benchmarks: passed\r\n");
+    return 0;
+}// end of main function.
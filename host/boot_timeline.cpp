@@ -0,0 +1,145 @@
+/*******************************************************************************
+ * Internet of Things (IoT) smart monitoring
+ * device for agriculture using LoRaWAN technology.
+ *
+ * Host measurement of the boot timeline.
+ *
+ * - Runs the node (main.cpp) built with FAULT_INJECT 1 for one simulated
+ * hour: a cold boot, then a warm restart with the sample of the faulting
+ * slot still queued (SEE recovery.h).
+ *
+ * - Writes, for both boots, the time from os_init to the first uplink on
+ * air and to the first uplink carrying a sample taken after the boot, and
+ * how many restored samples went out before it. Build it with FAST_START 0
+ * and 1 to compare both modes (SEE config.h).
+ *
+ * Usage: boot_timeline
+ *
+ *******************************************************************************/
+#undef main
+
+#include "mbed.h"
+#include "lmic.h"
+#include "config.h"
+#include "sim.h"
+
+// Node entry point (main.cpp built with -Dmain=node_main).
+int node_main (int argc, char** argv);
+
+// Simulated run time in seconds.
+#define RUN_TIME 3600
+
+// Telemetry port (SEE main.cpp).
+#define TELEMETRY_PORT 1
+
+// Number of boots followed.
+#define BOOTS 2
+
+/*
+ * boot_t structure.
+ *
+ * Timeline of one boot in microseconds from os_init.
+ */
+typedef struct {
+    uint64_t firstUplink;   // First uplink on air.
+    uint64_t firstSample;   // First uplink carrying a sample of this boot.
+    u1_t restored;          // Restored samples sent before it.
+    bit_t seen;             // Set once the first uplink went on air.
+} boot_t;
+
+static boot_t boots[BOOTS];
+static s2_t temperature = 0;       // Temperature of the last DHT11 read (Celsius * 100).
+static s2_t bootTemperature = 0;   // Temperature of the last read before the present boot.
+static u4_t bootSeen = 0;          // Boot the temperature above refers to.
+
+/*
+ * onRead function of type void.
+ *
+ * Sensor read hook: every DHT11 read returns the next temperature, so that
+ * samples taken before and after a boot can be told apart.
+ *
+ * Input parameters: PinName pin
+ *                   int value
+ */
+static void onRead (PinName pin, int value) {
+    (void)value;
+
+    if( pin != D6 ) {
+        return;
+    }
+    if( bootSeen != sim_boots( ) ) {
+        bootSeen = sim_boots( );
+        bootTemperature = temperature;
+    }
+    temperature += 25;
+    sim_setDht( temperature / 100.0f, 48.0f, 0 );
+}// end of onRead function.
+
+/*
+ * onUplink function of type void.
+ *
+ * Uplink hook: records the first uplinks of every boot.
+ *
+ * Input parameters: unsigned char port
+ *                   const unsigned char data
+ *                   unsigned char len
+ */
+static void onUplink (u1_t port, const u1_t* data, u1_t len) {
+    u4_t n = sim_boots( );
+
+    if( n == 0 || n > BOOTS ) {
+        return;
+    }
+    boot_t* b = &boots[n - 1];
+    uint64_t t = sim_now( ) - sim_bootTime( );
+    if( !b->seen ) {
+        b->seen = 1;
+        b->firstUplink = t;
+    }
+    if( port != TELEMETRY_PORT || len < 2 || b->firstSample != 0 ) {
+        return;
+    }
+    s2_t sampled = (s2_t)( ( data[0] << 8 ) | data[1] );
+    if( bootSeen == n && sampled > bootTemperature ) {
+        b->firstSample = t;
+    } else {
+        b->restored++;
+    }
+}// end of onUplink function.
+
+/*
+ * main function of type integer.
+ *
+ * Input parameters: integer argc.
+ *                   char **argv.
+ * Return: 0, or 1 if a boot sent nothing.
+ */
+int main (int argc, char** argv) {
+    static const char* const NAMES[BOOTS] = { "cold boot", "warm restart" };
+    int result = 0;
+    (void)argc;
+    (void)argv;
+
+    // Wet soil, daylight: no alarms.
+    sim_setAnalog( A1, 20000 );
+    sim_setAnalog( A3, 30000 );
+    sim_onRead( onRead );
+    sim_onUplink( onUplink );
+    sim_run( node_main, (uint64_t)RUN_TIME * 1000000 );
+    sim_onRead( NULL );
+    sim_onUplink( NULL );
+
+    printf("Boot timeline (ms from os_init), fast start %s:\r\n", FAST_START ? "on" : "off");
+    for( u1_t i = 0; i < BOOTS; i++ ) {
+        const boot_t* b = &boots[i];
+        if( !b->seen || b->firstSample == 0 ) {
+            printf("  %-13s no uplink\r\n", NAMES[i]);
+            result = 1;
+            continue;
+        }
+        printf("  %-13s first uplink %5u, first new sample %5u, %u restored samples before it\r\n",
+               NAMES[i], (unsigned int)( b->firstUplink / 1000 ), (unsigned int)( b->firstSample / 1000 ),
+               (unsigned int)b->restored);
+    }
+    return result;
+}// end of main function.
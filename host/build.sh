@@ -0,0 +1,121 @@
+#!/bin/sh
+###############################################################################
+# Internet of Things (IoT) smart monitoring
+# device for agriculture using LoRaWAN technology.
+#
+# Host targets.
+#
+# Builds the host-only tools and tests of this directory together with the
+# portable firmware modules they link, against the LMiC and mbed stand-ins
+# in host/, runs each of them and exits non-zero if a build or a run fails.
+# Nothing in host/ is part of the firmware image (SEE .mbedignore).
+#
+# Targets:
+#   ingest         ingestion tool: batch payload decoding, time-series
+#                  store, network-server load test.
+#   test_regcache  SX1272 register shadow against mock radios on 1 to 8
+#                  channels and under a randomized access sequence.
+#   test_persist   flash journal: wrap-around, frame counter reservation
+#                  and power losses during every erase and program.
+#   test_memstat   memory budget: stack high-water mark, heap peak and guard
+#                  with the allocator wrapped (MEMSTAT_HEAP_WRAP 1), report.
+#   test_sensors   node simulation: sensor supply wiring and gating.
+#   test_assert    node simulation: restart and sample recovery after an
+#                  LMiC assertion (FAULT_INJECT 1).
+#   test_watchdog  node simulation: restart and sample recovery after a
+#                  hang caught by the host watchdog (FAULT_INJECT 2, takes
+#                  RECOVERY_TIMEOUT of wall-clock time).
+#   boot_timeline  node simulation: time from os_init to the first uplinks
+#                  after a cold boot and after a warm restart, with
+#                  FAST_START 0 (boot_timeline) and 1 (boot_timeline_fast).
+#   benchmarks     node simulation: benchmark suite (RUN_BENCHMARKS 1) on
+#                  the mocked hardware.
+#   trace_record   node simulation: HAL trace from boot to the first
+#                  transmission (HAL_TRACE 1).
+#   trace_replay   node simulation: replay of the trace_record output, turned
+#                  into trace_data.h by trace2h.sh (HAL_REPLAY 1); must end
+#                  with the trace and without divergence.
+#
+# Each target runs in its build directory, so that the files it writes (e.g.
+# the time-series store of ingest) stay under BUILD/, and its output is kept
+# there in <name>.log. A target may prepare its build with a command run
+# from the repository root (e.g. a header generated from another target's
+# log).
+#
+# Usage: host/build.sh [target ...]   (default: every target)
+#
+# Requires a host C++ compiler ($CXX, default g++).
+###############################################################################
+
+cd "$(dirname "$0")/.." || exit 1
+
+CXX=${CXX:-g++}
+CXXFLAGS=${CXXFLAGS:-"-std=gnu++98 -O2 -Wall -Wextra -pthread"}
+BUILD_ROOT=BUILD/host
+
+# Node simulation: the application, its modules and the HAL on the mbed and
+# LMiC stand-ins (SEE host/sim.h). main.cpp is built with -Dmain=node_main.
+NODE="main.cpp hal.cpp host/mbed.cpp host/sim.cpp host/lmic.cpp samples.cpp persist.cpp \
+memstat.cpp sensors.cpp energy.cpp trace.cpp timing.cpp stats.cpp recovery.cpp \
+channels.cpp uplink.cpp regcache.cpp bench.cpp"
+
+# name|sources|macro overrides and link options|arguments|prepare
+TARGETS="
+ingest|host/ingest.cpp host/payload.cpp host/tsdb.cpp host/netserver.cpp crypto.cpp bench.cpp host/lmic.cpp samples.cpp memstat.cpp|-DCRYPTO_LMIC_AES=1|
+test_regcache|host/test_regcache.cpp regcache.cpp memstat.cpp host/lmic.cpp||
+test_persist|host/test_persist.cpp persist.cpp samples.cpp memstat.cpp host/mbed.cpp host/lmic.cpp||
+test_memstat|host/test_memstat.cpp memstat.cpp|-DMEMSTAT_HEAP_WRAP=1 -DMEMSTAT_HEAP_LIMIT=4096 -Wl,--wrap,malloc,--wrap,free,--wrap,calloc,--wrap,realloc|
+test_sensors|host/test_sensors.cpp $NODE|-Dmain=node_main|
+test_assert|host/test_recovery.cpp $NODE|-Dmain=node_main -DFAULT_INJECT=1|
+test_watchdog|host/test_recovery.cpp $NODE|-Dmain=node_main -DFAULT_INJECT=2|
+boot_timeline|host/boot_timeline.cpp $NODE|-Dmain=node_main -DFAULT_INJECT=1 -DFAST_START=0|
+boot_timeline_fast|host/boot_timeline.cpp $NODE|-Dmain=node_main -DFAULT_INJECT=1 -DFAST_START=1|
+benchmarks|host/benchmarks.cpp $NODE host/debug.cpp crypto.cpp|-Dmain=node_main -DRUN_BENCHMARKS=1 -DCRYPTO_LMIC_AES=1|
+trace_record|host/test_trace.cpp $NODE|-Dmain=node_main -DHAL_TRACE=1|
+trace_replay|host/test_trace.cpp $NODE|-Dmain=node_main -DHAL_REPLAY=1 -I$BUILD_ROOT/trace_replay||sh trace2h.sh $BUILD_ROOT/trace_record/trace_record.log > $BUILD_ROOT/trace_replay/trace_data.h
+"
+
+# build name sources defines prepare: compiles and links one target.
+build() {
+    out="$BUILD_ROOT/$1"
+    mkdir -p "$out"
+    if [ -n "$4" ] && ! eval "$4"; then
+        return 1
+    fi
+    objs=""
+    for src in $2; do
+        obj="$out/$(echo "$src" | tr '/' '_').o"
+        if ! $CXX $CXXFLAGS $3 -Ihost -I. -c "$src" -o "$obj"; then
+            return 1
+        fi
+        objs="$objs $obj"
+    done
+    $CXX $CXXFLAGS $3 -o "$out/$1" $objs
+}
+
+failed=""
+echo "$TARGETS" | {
+    while IFS='|' read name sources defines args prepare; do
+        [ -z "$name" ] && continue
+        if [ $# -gt 0 ] && ! echo " $* " | grep -q " $name "; then
+            continue
+        fi
+        echo "=== $name"
+        if ! build "$name" "$sources" "$defines" "$prepare"; then
+            echo "=== $name: build FAILED"
+            failed="$failed $name"
+            continue
+        fi
+        if ! ( cd "$BUILD_ROOT/$name" && "./$name" $args > "$name.log"; status=$?; cat "$name.log"; exit $status ); then
+            echo "=== $name: FAILED"
+            failed="$failed $name"
+            continue
+        fi
+        echo "=== $name: passed"
+    done
+    if [ -n "$failed" ]; then
+        echo "Host targets failed:$failed"
+        exit 1
+    fi
+    echo "All host targets passed"
+}
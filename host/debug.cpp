@@ -0,0 +1,133 @@
+/*******************************************************************************
+ * Internet of Things (IoT) smart monitoring
+ * device for agriculture using LoRaWAN technology.
+ *
+ * Host stand-in for LMiC's debug.cpp.
+ *
+ * - Same output as debug.cpp; the event names are looked up without the
+ * array designated initializers of debug.cpp, which host C++ compilers do
+ * not accept.
+ *
+ * SEE debug.h file for the description of each function.
+ *
+ *******************************************************************************/
+
+#include <stdio.h>
+#include "lmic.h"
+#include "debug.h"
+
+/*
+ * debug_init function of type void.
+ *
+ * Input parameters: None
+ *
+ */
+void debug_init (void) {
+    debug_str( (const u1_t*)"\r\n============== DEBUG STARTED ==============\r\n" );
+}// end of debug_init function.
+
+/*
+ * debug_led function of type void.
+ *
+ * Input parameters: unsigned char val.
+ *
+ */
+void debug_led (u1_t val) {
+    debug_val( (const u1_t*)"LED = ", val );
+}// end of debug_led function.
+
+/*
+ * debug_char function of type void.
+ *
+ * Input parameters: unsigned char c.
+ *
+ */
+void debug_char (u1_t c) {
+    fprintf(stderr, "%c", c );
+}// end of debug_char function.
+
+/*
+ * debug_hex function of type void.
+ *
+ * Input parameters: unsigned char b.
+ *
+ */
+void debug_hex (u1_t b) {
+    fprintf(stderr, "%02X", b );
+}// end of debug_hex function.
+
+/*
+ * debug_buf function of type void.
+ *
+ * Input parameters: unsigned char buf
+ *                   unsigned short len
+ *
+ */
+void debug_buf (const u1_t* buf, u2_t len) {
+    while( len-- ) {
+        debug_hex( *buf++ );
+        debug_char( ' ' );
+    }
+    debug_char( '\r' );
+    debug_char( '\n' );
+}// end of debug_buf function.
+
+/*
+ * debug_uint function of type void.
+ *
+ * Input parameters: unsigned int v
+ *
+ */
+void debug_uint (u4_t v) {
+    for( s1_t n = 24; n >= 0; n -= 8 ) {
+        debug_hex( v >> n );
+    }
+}// end of debug_uint function.
+
+/*
+ * debug_str function of type void.
+ *
+ * Input parameters: const unsigned char str
+ *
+ */
+void debug_str (const u1_t* str) {
+    while( *str ) {
+        debug_char( *str++ );
+    }
+}// end of debug_str function.
+
+/*
+ * debug_val function of type void.
+ *
+ * Input parameters: const unsigned char label
+ *                   unsigned int val
+ *
+ */
+void debug_val (const u1_t* label, u4_t val) {
+    debug_str( label );
+    debug_uint( val );
+    debug_char( '\r' );
+    debug_char( '\n' );
+}// end of debug_val function.
+
+/*
+ * debug_event function of type void.
+ *
+ * Input parameters: int ev
+ *
+ */
+void debug_event (int ev) {
+    // In ev_t order from EV_SCAN_TIMEOUT.
+    static const char* const EVNAMES[] = {
+        "SCAN_TIMEOUT", "BEACON_FOUND", "BEACON_MISSED", "BEACON_TRACKED", "JOINING",
+        "JOINED", "RFU1", "JOIN_FAILED", "REJOIN_FAILED", "TXCOMPLETE", "LOST_TSYNC",
+        "RESET", "RXCOMPLETE", "LINK_DEAD", "LINK_ALIVE"
+    };
+    int i = ev - EV_SCAN_TIMEOUT;
+
+    if( i >= 0 && i < (int)( sizeof( EVNAMES ) / sizeof( EVNAMES[0] ) ) ) {
+        debug_str( (const u1_t*)EVNAMES[i] );
+    }
+    debug_char( '\r' );
+    debug_char( '\n' );
+}// end of debug_event function.
@@ -0,0 +1,28 @@
+/*******************************************************************************
+ * Internet of Things (IoT) smart monitoring
+ * device for agriculture using LoRaWAN technology.
+ *
+ * Host stand-in for the LMiC HAL interface (hal.h), implemented by hal.cpp.
+ *
+ * - Not part of the firmware image (SEE .mbedignore).
+ *
+ *******************************************************************************/
+#ifndef _hal_hpp_
+#define _hal_hpp_
+
+#include "lmic.h"
+
+void hal_init (void);
+void hal_pin_rxtx (u1_t val);
+void hal_pin_nss (u1_t val);
+void hal_pin_rst (u1_t val);
+u1_t hal_spi (u1_t outval);
+void hal_disableIRQs (void);
+void hal_enableIRQs (void);
+void hal_sleep (void);
+u4_t hal_ticks (void);
+void hal_waitUntil (u4_t time);
+u1_t hal_checkTimer (u4_t targettime);
+void hal_failed (void);
+
+#endif // _hal_hpp_
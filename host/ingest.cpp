@@ -0,0 +1,172 @@
+/*******************************************************************************
+ * Internet of Things (IoT) smart monitoring
+ * device for agriculture using LoRaWAN technology.
+ *
+ * Host ingestion tool.
+ *
+ * - Decodes batches of uplink frames of many nodes into per-measurement
+ * columns (payload.cpp), for ingestion outside All Things Talk, and stores
+ * them per node in a columnar time-series store (tsdb.cpp).
+ *
+ * - Verifies and decrypts the uplinks of a simulated fleet on a worker pool
+ * (netserver.cpp), standing in for the network server.
+ *
+ * - Run without arguments it checks the batch decoder against the node's
+ * own frame codec (samples.cpp) and the fixed-point conversion against the
+ * scalar one, splits an alarm uplink carrying a sample and a summary into
+ * its records, loads a day of readings of a fleet into the time-series
+ * store and checks its queries, runs the network-server load test on one
+ * worker and on one worker per processor and reports the decode rates and
+ * the speed-up; the exit status is non-zero on any mismatch, so that
+ * host/build.sh can use it as a test.
+ *
+ * Usage: ingest [rounds [workers]]   (default workers: one per processor)
+ *
+ *******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <math.h>
+#include "lmic.h"
+#include "samples.h"
+#include "payload.h"
+#include "tsdb.h"
+#include "netserver.h"
+#include "bench.h"
+
+// Time-series store load: nodes, days of readings and interval (s).
+#define STORE_NODES PAYLOAD_BENCH_BATCH
+#define STORE_DAYS 1
+#define STORE_INTERVAL 300
+
+// Simulated fleet: first device address and session keys (test values).
+#define LOAD_DEVICES 1024
+#define LOAD_ROUNDS 16
+static const devaddr_t LOAD_DEVADDR = 0x26011000;
+static const u1_t LOAD_NWKSKEY[16] = { 0x2B, 0x7E, 0x15, 0x16, 0x28, 0xAE, 0xD2, 0xA6,
+                                       0xAB, 0xF7, 0x15, 0x88, 0x09, 0xCF, 0x4F, 0x3C };
+static const u1_t LOAD_APPSKEY[16] = { 0x3C, 0x4F, 0xCF, 0x09, 0x88, 0x15, 0xF7, 0xAB,
+                                       0xA6, 0xD2, 0xAE, 0x28, 0x16, 0x15, 0x7E, 0x2B };
+
+// Telemetry and summary ports (SEE main.cpp).
+#define TELEMETRY_PORT 1
+#define SUMMARY_PORT 2
+
+/*
+ * checkCarrier function of type unsigned int.
+ *
+ * Splits an alarm uplink carrying a sample and a summary, in class order,
+ * and decodes the sample; a frame cut inside a record must be rejected.
+ *
+ * Input parameters: None
+ * Return: number of failed checks.
+ */
+static u4_t checkCarrier (void) {
+    static const u1_t ALARM[3] = { 0x01, 0x01, 0x2C };
+    static const u1_t SUMMARY[4] = { 0x08, 0x34, 0x08, 0x98 };
+    sample_t sample = { -250, 4800, 230, 180, 0 };
+    payload_record_t recs[PAYLOAD_RECORDS_MAX];
+    u1_t frame[2 + sizeof( ALARM ) + 2 + PAYLOAD_FRAME_LENGTH + 2 + sizeof( SUMMARY )];
+    u1_t len = 0;
+    u4_t failures = 0;
+    s2_t temperature, humidity, light, soil;
+    const payload_columns_t cols = { &temperature, &humidity, &light, &soil };
+
+    frame[len++] = PAYLOAD_CARRIER_PORT;
+    frame[len++] = sizeof( ALARM );
+    memcpy( frame + len, ALARM, sizeof( ALARM ) );
+    len += sizeof( ALARM );
+    frame[len++] = TELEMETRY_PORT;
+    frame[len++] = PAYLOAD_FRAME_LENGTH;
+    samples_encode( &sample, frame + len );
+    len += PAYLOAD_FRAME_LENGTH;
+    frame[len++] = SUMMARY_PORT;
+    frame[len++] = sizeof( SUMMARY );
+    memcpy( frame + len, SUMMARY, sizeof( SUMMARY ) );
+    len += sizeof( SUMMARY );
+
+    u1_t n = payload_records( frame, len, recs );
+    if( n != 3 || recs[0].port != PAYLOAD_CARRIER_PORT || recs[1].port != TELEMETRY_PORT ||
+        recs[1].len != PAYLOAD_FRAME_LENGTH || recs[2].port != SUMMARY_PORT ||
+        memcmp( recs[2].data, SUMMARY, sizeof( SUMMARY ) ) != 0 ) {
+        printf("FAIL: carrier frame split into %u records\r\n", n);
+        return 1;
+    }
+    payload_decodeBatch( recs[1].data, 1, PAYLOAD_FRAME_LENGTH, &cols );
+    if( temperature != sample.temperature || humidity != sample.humidity ||
+        light != sample.light || soil != sample.soil ) {
+        printf("FAIL: sample carried by the alarm decoded differently\r\n");
+        failures++;
+    }
+    if( payload_records( frame, len - 1, recs ) != 0 ) {
+        printf("FAIL: truncated carrier frame accepted\r\n");
+        failures++;
+    }
+    printf("Carrier frame: %u records, %s\r\n", n, failures ? "FAILED" : "passed");
+    return failures;
+}// end of checkCarrier function.
+
+/*
+ * checkFixed function of type unsigned int.
+ *
+ * Converts every 16-bit value to fixed point with 0 to 15 fractional bits
+ * and compares with the scalar conversion.
+ *
+ * Input parameters: None
+ * Return: number of mismatches.
+ */
+static u4_t checkFixed (void) {
+    static s2_t in[65536];
+    static s4_t out[65536];
+    u4_t errors = 0;
+
+    for( u4_t i = 0; i < 65536; i++ ) {
+        in[i] = (s2_t)( i - 32768 );
+    }
+    for( u1_t frac = 0; frac < 16; frac++ ) {
+        payload_toFixed( in, out, 65536, frac );
+        for( u4_t i = 0; i < 65536; i++ ) {
+            if( out[i] != lround( (double)in[i] * ( 1 << frac ) / 100.0 ) ) {
+                errors++;
+            }
+        }
+    }
+    printf("Fixed point: %u values, %u mismatches\r\n", 65536 * 16, (unsigned int)errors);
+    return errors;
+}// end of checkFixed function.
+
+/*
+ * main function of type integer.
+ *
+ * Input parameters: integer argc.
+ *                   char **argv.
+ * Return: 0 if every check passed, 1 otherwise.
+ */
+int main (int argc, char** argv) {
+    u4_t rounds = argc > 1 ? (u4_t)atoi( argv[1] ) : 4096;
+    u4_t failures = 0;
+
+    failures += payload_benchmark( rounds );
+    failures += checkFixed( );
+    failures += checkCarrier( );
+    failures += tsdb_benchmark( STORE_NODES, STORE_DAYS, STORE_INTERVAL );
+
+    long cpus = sysconf( _SC_NPROCESSORS_ONLN );
+    if( argc > 2 ) {
+        cpus = atol( argv[2] );
+    }
+    u1_t workers = cpus < 1 ? 1 : cpus > NETSERVER_MAX_WORKERS ? NETSERVER_MAX_WORKERS : (u1_t)cpus;
+    u4_t start = bench_micros( );
+    failures += netserver_loadTest( LOAD_DEVICES, LOAD_ROUNDS, 1, LOAD_DEVADDR, LOAD_NWKSKEY, LOAD_APPSKEY );
+    u4_t single = bench_micros( ) - start;
+    start = bench_micros( );
+    failures += netserver_loadTest( LOAD_DEVICES, LOAD_ROUNDS, workers, LOAD_DEVADDR, LOAD_NWKSKEY, LOAD_APPSKEY );
+    u4_t pooled = bench_micros( ) - start;
+    printf("Network server: %u workers %.2fx faster than 1 (including uplink generation)\r\n",
+           workers, pooled > 0 ? (double)single / pooled : 0.0);
+
+    printf("Ingestion: %s\r\n", failures ? "FAILED" : "passed");
+    return failures != 0;
+}// end of main function.
@@ -0,0 +1,59 @@
+/*******************************************************************************
+ * Internet of Things (IoT) smart monitoring
+ * device for agriculture using LoRaWAN technology.
+ *
+ * Host stand-in for the LMiC 1.5 library.
+ *
+ * SEE lmic.h file for the description.
+ *
+ *******************************************************************************/
+
+#include "lmic.h"
+
+/*
+ * os_rlsbf4, os_rmsbf4 and os_rlsbf2 functions.
+ *
+ * Read a little-endian (lsbf) or big-endian (msbf) value from buf.
+ *
+ * Input parameters: const unsigned char buf
+ * Return: value read.
+ */
+u4_t os_rlsbf4 (xref2cu1_t buf) {
+    return (u4_t)( buf[0] | ( buf[1] << 8 ) | ( (u4_t)buf[2] << 16 ) | ( (u4_t)buf[3] << 24 ) );
+}// end of os_rlsbf4 function.
+
+u4_t os_rmsbf4 (xref2cu1_t buf) {
+    return (u4_t)( buf[3] | ( buf[2] << 8 ) | ( (u4_t)buf[1] << 16 ) | ( (u4_t)buf[0] << 24 ) );
+}// end of os_rmsbf4 function.
+
+u2_t os_rlsbf2 (xref2cu1_t buf) {
+    return (u2_t)( buf[0] | ( buf[1] << 8 ) );
+}// end of os_rlsbf2 function.
+
+/*
+ * os_wlsbf4, os_wmsbf4 and os_wlsbf2 functions of type void.
+ *
+ * Write value to buf in little-endian (lsbf) or big-endian (msbf) order.
+ *
+ * Input parameters: unsigned char buf
+ *                   value
+ */
+void os_wlsbf4 (xref2u1_t buf, u4_t v) {
+    buf[0] = v;
+    buf[1] = v >> 8;
+    buf[2] = v >> 16;
+    buf[3] = v >> 24;
+}// end of os_wlsbf4 function.
+
+void os_wmsbf4 (xref2u1_t buf, u4_t v) {
+    buf[3] = v;
+    buf[2] = v >> 8;
+    buf[1] = v >> 16;
+    buf[0] = v >> 24;
+}// end of os_wmsbf4 function.
+
+void os_wlsbf2 (xref2u1_t buf, u2_t v) {
+    buf[0] = v;
+    buf[1] = v >> 8;
+}// end of os_wlsbf2 function.
+
@@ -0,0 +1,192 @@
+/*******************************************************************************
+ * Internet of Things (IoT) smart monitoring
+ * device for agriculture using LoRaWAN technology.
+ *
+ * Host stand-in for the LMiC 1.5 library (lmic.h, oslmic.h).
+ *
+ * - Declares the types, constants, MAC state and API of LMiC that the
+ * application and its modules use, so that the portable modules build on a
+ * host without the library sources.
+ *
+ * - The byte order helpers are implemented in lmic.cpp, the job scheduler
+ * and a simplified MAC in sim.cpp (SEE sim.h), linked by the host targets
+ * that need them.
+ *
+ * - Not part of the firmware image (SEE .mbedignore).
+ *
+ *******************************************************************************/
+#ifndef _lmic_h_
+#define _lmic_h_
+
+#include <stdint.h>
+#include <string.h>
+
+///////////////////////////////////////////////////
+// TYPES (oslmic.h)                             //
+/////////////////////////////////////////////////
+
+typedef uint8_t        bit_t;
+typedef uint8_t        u1_t;
+typedef int8_t         s1_t;
+typedef uint16_t       u2_t;
+typedef int16_t        s2_t;
+typedef uint32_t       u4_t;
+typedef int32_t        s4_t;
+typedef unsigned int   uint;
+typedef const char*    str_t;
+typedef s4_t           ostime_t;
+typedef u4_t           devaddr_t;
+typedef u1_t*          xref2u1_t;
+typedef const u1_t*    xref2cu1_t;
+
+#define OSTICKS_PER_SEC 15625
+#define us2osticks(us)   ((ostime_t)( ((int64_t)(us) * OSTICKS_PER_SEC) / 1000000))
+#define ms2osticks(ms)   ((ostime_t)( ((int64_t)(ms) * OSTICKS_PER_SEC)    / 1000))
+#define sec2osticks(sec) ((ostime_t)( (int64_t)(sec) * OSTICKS_PER_SEC))
+#define osticks2ms(os)   ((s4_t)(((os)*(int64_t)1000    ) / OSTICKS_PER_SEC))
+#define osticks2us(os)   ((s4_t)(((os)*(int64_t)1000000 ) / OSTICKS_PER_SEC))
+
+#define USE_SMTC_RADIO_DRIVER 0
+
+struct osjob_t;
+typedef void (*osjobcb_t) (struct osjob_t*);
+struct osjob_t {
+    struct osjob_t* next;
+    ostime_t deadline;
+    osjobcb_t func;
+};
+
+///////////////////////////////////////////////////
+// AES (oslmic.h)                               //
+/////////////////////////////////////////////////
+
+extern u4_t AESAUX[];
+extern u4_t AESKEY[];
+#define AESkey ((u1_t*)AESKEY)
+#define AESaux ((u1_t*)AESAUX)
+#define AES_ENC       0x00
+#define AES_DEC       0x80
+#define AES_MIC       0x40
+#define AES_CTR       0x20
+#define AES_MICNOAUX  0x08
+
+///////////////////////////////////////////////////
+// MAC CONSTANTS AND STATE (lmic.h)             //
+/////////////////////////////////////////////////
+
+enum { MAX_CHANNELS = 16, MAX_BANDS = 4 };
+enum { BAND_MILLI = 0, BAND_CENTI = 1, BAND_DECI = 2, BAND_AUX = 3 };
+enum _dr_eu868_t { DR_SF12 = 0, DR_SF11, DR_SF10, DR_SF9, DR_SF8, DR_SF7, DR_SF7B, DR_FSK, DR_NONE };
+#define DR_RANGE_MAP(drlo,drhi) (((u2_t)0xFFFF<<(drlo)) & ((u2_t)0xFFFF>>(15-(drhi))))
+enum { MAX_LEN_FRAME = 64, MAX_LEN_PAYLOAD = 51 };
+
+enum { OP_NONE     = 0x0000, OP_SCAN    = 0x0001, OP_TRACK   = 0x0002, OP_JOINING = 0x0004,
+       OP_TXDATA   = 0x0008, OP_POLL    = 0x0010, OP_REJOIN  = 0x0020, OP_SHUTDOWN = 0x0040,
+       OP_TXRXPEND = 0x0080, OP_RNDTX   = 0x0100, OP_PINGINI = 0x0200, OP_PINGABLE = 0x0400,
+       OP_NEXTCHNL = 0x0800, OP_LINKDEAD = 0x1000, OP_TESTMODE = 0x2000 };
+
+enum { TXRX_ACK = 0x80, TXRX_NACK = 0x40, TXRX_NOPORT = 0x20, TXRX_PORT = 0x10,
+       TXRX_DNW1 = 0x01, TXRX_DNW2 = 0x02, TXRX_PING = 0x04 };
+
+enum _ev_t { EV_SCAN_TIMEOUT = 1, EV_BEACON_FOUND, EV_BEACON_MISSED, EV_BEACON_TRACKED, EV_JOINING,
+             EV_JOINED, EV_RFU1, EV_JOIN_FAILED, EV_REJOIN_FAILED, EV_TXCOMPLETE, EV_LOST_TSYNC,
+             EV_RESET, EV_RXCOMPLETE, EV_LINK_DEAD, EV_LINK_ALIVE };
+typedef enum _ev_t ev_t;
+
+struct band_t {
+    u2_t txcap;        // duty cycle limitation: 1/txcap
+    s1_t txpow;        // maximum TX power
+    u1_t lastchnl;     // last used channel
+    ostime_t avail;    // channel is blocked until this time
+};
+
+struct lmic_t {
+    ostime_t txend;
+    ostime_t rxtime;
+    u4_t freq;
+    s1_t rssi;
+    s1_t snr;
+    u2_t rps;
+    u1_t rxsyms;
+    u1_t dndr;
+    s1_t txpow;
+    band_t bands[MAX_BANDS];
+    u4_t channelFreq[MAX_CHANNELS];
+    u2_t channelDrMap[MAX_CHANNELS];
+    u2_t channelMap;
+    u1_t txChnl;
+    u1_t globalDutyRate;
+    ostime_t globalDutyAvail;
+    u4_t netid;
+    u2_t opmode;
+    u1_t upRepeat;
+    s1_t adrTxPow;
+    u1_t datarate;
+    u1_t errcr;
+    u1_t rejoinCnt;
+    u1_t pendTxPort;
+    u1_t pendTxConf;
+    u1_t pendTxLen;
+    u1_t pendTxData[MAX_LEN_PAYLOAD];
+    u2_t devNonce;
+    u1_t nwkKey[16];
+    u1_t artKey[16];
+    devaddr_t devaddr;
+    u4_t seqnoDn;
+    u4_t seqnoUp;
+    u1_t dnConf;
+    s1_t adrAckReq;
+    u1_t adrChanged;
+    u1_t txCnt;
+    u1_t txrxFlags;
+    u1_t dataBeg;
+    u1_t dataLen;
+    u1_t frame[MAX_LEN_FRAME];
+};
+extern struct lmic_t LMIC;
+
+///////////////////////////////////////////////////
+// API                                          //
+/////////////////////////////////////////////////
+
+void os_init (void);
+void os_runloop (void);
+void os_runloop_once (void);
+ostime_t os_getTime (void);
+void os_setCallback (osjob_t* job, osjobcb_t cb);
+void os_setTimedCallback (osjob_t* job, ostime_t time, osjobcb_t cb);
+void os_clearCallback (osjob_t* job);
+u1_t os_getRndU1 (void);
+#define os_getRndU2() ((u2_t)((os_getRndU1()<<8)|os_getRndU1()))
+
+u4_t os_rlsbf4 (xref2cu1_t buf);
+u4_t os_rmsbf4 (xref2cu1_t buf);
+u2_t os_rlsbf2 (xref2cu1_t buf);
+void os_wlsbf4 (xref2u1_t buf, u4_t value);
+void os_wmsbf4 (xref2u1_t buf, u4_t value);
+void os_wlsbf2 (xref2u1_t buf, u2_t value);
+u4_t os_aes (u1_t mode, xref2u1_t buf, u2_t len);
+
+void os_getArtEui (xref2u1_t buf);
+void os_getDevEui (xref2u1_t buf);
+void os_getDevKey (xref2u1_t buf);
+
+void LMIC_reset (void);
+bit_t LMIC_setupBand (u1_t bandidx, s1_t txpow, u2_t txcap);
+bit_t LMIC_setupChannel (u1_t channel, u4_t freq, u2_t drmap, s1_t band);
+void LMIC_disableChannel (u1_t channel);
+void LMIC_setAdrMode (bit_t enabled);
+void LMIC_setLinkCheckMode (bit_t enabled);
+void LMIC_setDrTxpow (u1_t dr, s1_t txpow);
+void LMIC_disableTracking (void);
+void LMIC_stopPingable (void);
+void LMIC_setSession (u4_t netid, devaddr_t devaddr, xref2u1_t nwkKey, xref2u1_t artKey);
+bit_t LMIC_startJoining (void);
+void LMIC_setTxData (void);
+int LMIC_setTxData2 (u1_t port, xref2u1_t data, u1_t dlen, u1_t confirmed);
+void LMIC_clrTxData (void);
+
+// Application callback.
+void onEvent (ev_t ev);
+
+#endif // _lmic_h_
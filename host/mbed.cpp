@@ -0,0 +1,603 @@
+/*******************************************************************************
+ * Internet of Things (IoT) smart monitoring
+ * device for agriculture using LoRaWAN technology.
+ *
+ * Host stand-in for the mbed 2 SDK and the DHT11 library, on a virtual
+ * microsecond clock, and the simulation controls.
+ *
+ * Timer events (Ticker, Timeout) are kept in a small table and run as the
+ * clock passes them; while interrupts are masked they are queued and run
+ * when unmasked, like a pending NVIC interrupt.
+ *
+ * SEE mbed.h and sim.h files for the description.
+ *
+ *******************************************************************************/
+
+#include <setjmp.h>
+#include <sys/time.h>
+#include "mbed.h"
+#include "DHT.h"
+#include "lmic.h"
+#include "sim.h"
+
+// Maximum number of attached timer events and of events pending while masked.
+#define SIM_MAX_EVENTS 8
+#define SIM_MAX_PENDING 16
+
+// Radio NSS pin of the SX1272MB2xAS (SEE hal.cpp).
+#define SIM_RADIO_NSS D10
+
+// Internal flash size and sector size of the K64F.
+#define SIM_FLASH_SIZE 0x100000
+#define SIM_FLASH_SECTOR 0x1000
+
+static uint64_t now = 0;                       // Virtual clock (us).
+static uint64_t until = 0;                     // End of the present run (us).
+static jmp_buf stop;                           // Return point of sim_run.
+static bit_t masked = 0;                       // Interrupts masked.
+static bit_t firing = 0;                       // Running timer events.
+static Timeout* events[SIM_MAX_EVENTS];        // Attached timer events.
+static void (*pending[SIM_MAX_PENDING]) (void); // Events due while masked.
+static u1_t pendingCount = 0;
+
+static sim_hook_t writeHook = NULL;
+static sim_hook_t readHook = NULL;
+
+// Output levels and analog inputs, per port pin.
+static signed char levels[5 * 32];
+static u2_t analog[5 * 32];
+
+// DHT11 reading.
+static float dhtTemperature = 20.0f;
+static float dhtHumidity = 50.0f;
+static int dhtError = ERROR_NONE;
+
+// Internal flash of the K64F, erased on the first FlashIAP::init.
+static u1_t flash[SIM_FLASH_SIZE];
+static bit_t flashErased = 0;
+static u4_t flashErases[SIM_FLASH_SIZE / SIM_FLASH_SECTOR];
+static u4_t flashCut = 0;     // Erases and programs left until a power loss, 0 for none.
+static bit_t flashDown = 0;   // Power lost: every erase and program fails.
+
+// SX1272 register file and present SPI frame.
+static u1_t radio[128];
+static u1_t spiIndex = 0;
+static u1_t spiAddr = 0;
+
+/*
+ * pinIndex function of type integer.
+ *
+ * Input parameters: PinName pin
+ * Return: index of pin into the per-pin tables, -1 if not a port pin.
+ */
+static int pinIndex (PinName pin) {
+    return pin >= 0 && pin < 5 * 32 ? pin : -1;
+}// end of pinIndex function.
+
+/*
+ * runEvents function of type void.
+ *
+ * Runs (or queues while masked) every timer event due up to the clock.
+ *
+ * Input parameters: None
+ */
+static void runEvents (void) {
+    if( firing ) {
+        return;
+    }
+    firing = 1;
+    for( ;; ) {
+        Timeout* next = NULL;
+        for( u1_t i = 0; i < SIM_MAX_EVENTS; i++ ) {
+            if( events[i] != NULL && ( next == NULL || events[i]->_at < next->_at ) ) {
+                next = events[i];
+            }
+        }
+        if( next == NULL || next->_at > now ) {
+            break;
+        }
+        void (*fptr) (void) = next->_fptr;
+        if( next->_period != 0 ) {
+            next->_at += next->_period;
+        } else {
+            next->detach( );
+        }
+        if( masked ) {
+            if( pendingCount < SIM_MAX_PENDING ) {
+                pending[pendingCount++] = fptr;
+            }
+        } else {
+            fptr( );
+        }
+    }
+    firing = 0;
+}// end of runEvents function.
+
+/*
+ * advance function of type void.
+ *
+ * Moves the clock to t, running the timer events passed on the way.
+ *
+ * Input parameters: unsigned long long t
+ */
+static void advance (uint64_t t) {
+    for( ;; ) {
+        uint64_t next = t;
+        for( u1_t i = 0; i < SIM_MAX_EVENTS; i++ ) {
+            if( events[i] != NULL && events[i]->_at < next ) {
+                next = events[i]->_at;
+            }
+        }
+        if( next > now ) {
+            now = next;
+        }
+        runEvents( );
+        if( now >= t ) {
+            break;
+        }
+    }
+}// end of advance function.
+
+/*
+ * checkStop function of type void.
+ *
+ * Ends the present run once the clock has reached its end.
+ *
+ * Input parameters: None
+ */
+static void checkStop (void) {
+    if( now >= until ) {
+        longjmp( stop, 1 );
+    }
+}// end of checkStop function.
+
+///////////////////////////////////////////////////
+// INTERRUPTS AND WAITING                       //
+/////////////////////////////////////////////////
+
+void __disable_irq (void) {
+    masked = 1;
+}
+
+void __enable_irq (void) {
+    masked = 0;
+    while( pendingCount != 0 ) {
+        void (*fptr) (void) = pending[0];
+        pendingCount--;
+        memmove( pending, pending + 1, pendingCount * sizeof( pending[0] ) );
+        fptr( );
+    }
+}
+
+void wait (float s) {
+    wait_us( (int)( s * 1000000.0f ) );
+}
+
+void wait_ms (int ms) {
+    wait_us( ms * 1000 );
+}
+
+void wait_us (int us) {
+    advance( now + us );
+    checkStop( );
+}
+
+void sleep (void) {
+    uint64_t next = until;
+    for( u1_t i = 0; i < SIM_MAX_EVENTS; i++ ) {
+        if( events[i] != NULL && events[i]->_at < next ) {
+            next = events[i]->_at;
+        }
+    }
+    advance( next > now ? next : now );
+    checkStop( );
+}
+
+///////////////////////////////////////////////////
+// DIGITAL AND ANALOG PINS                      //
+/////////////////////////////////////////////////
+
+DigitalOut::DigitalOut (PinName pin, int value) : _pin( pin ), _value( 0 ) {
+    write( value );
+}
+
+void DigitalOut::write (int value) {
+    _value = value != 0;
+    if( pinIndex( _pin ) >= 0 ) {
+        levels[pinIndex( _pin )] = (signed char)_value;
+    }
+    if( _pin == SIM_RADIO_NSS ) {
+        // A falling NSS starts a new SPI frame.
+        spiIndex = 0;
+    }
+    if( writeHook != NULL ) {
+        writeHook( _pin, _value );
+    }
+}
+
+int DigitalOut::read (void) {
+    return _value;
+}
+
+DigitalInOut::DigitalInOut (PinName pin) : _pin( pin ), _value( 0 ), _output( 0 ) {
+}
+
+void DigitalInOut::write (int value) {
+    _value = value != 0;
+    if( _output && writeHook != NULL ) {
+        writeHook( _pin, _value );
+    }
+}
+
+InterruptIn::InterruptIn (PinName pin) : _pin( pin ), _rise( NULL ), _enabled( 0 ) {
+}
+
+AnalogIn::AnalogIn (PinName pin) : _pin( pin ) {
+}
+
+unsigned short AnalogIn::read_u16 (void) {
+    u2_t value = pinIndex( _pin ) >= 0 ? analog[pinIndex( _pin )] : 0;
+    // Conversion time.
+    advance( now + 20 );
+    if( readHook != NULL ) {
+        readHook( _pin, value );
+    }
+    return value;
+}
+
+///////////////////////////////////////////////////
+// SPI                                          //
+/////////////////////////////////////////////////
+
+SPI::SPI (PinName, PinName, PinName) {
+}
+
+int SPI::write (int value) {
+    u1_t in = 0;
+
+    if( spiIndex == 0 ) {
+        spiAddr = (u1_t)value;
+    } else {
+        u1_t reg = (u1_t)( ( spiAddr & 0x7F ) + spiIndex - 1 ) & 0x7F;
+        if( spiAddr & 0x80 ) {
+            radio[reg] = (u1_t)value;
+        } else {
+            in = radio[reg];
+        }
+    }
+    spiIndex++;
+    // One byte at 8 MHz.
+    advance( now + 1 );
+    return in;
+}
+
+///////////////////////////////////////////////////
+// TIMERS                                       //
+/////////////////////////////////////////////////
+
+void Timer::start (void) {
+    if( !_running ) {
+        _start = now;
+        _running = 1;
+    }
+}
+
+void Timer::stop (void) {
+    if( _running ) {
+        _elapsed += now - _start;
+        _running = 0;
+    }
+}
+
+void Timer::reset (void) {
+    _start = now;
+    _elapsed = 0;
+}
+
+int Timer::read_us (void) {
+    advance( now + 1 );
+    return (int)( _elapsed + ( _running ? now - _start : 0 ) );
+}
+
+void Timeout::attach_us (void (*fptr) (void), uint32_t us) {
+    detach( );
+    _fptr = fptr;
+    _at = now + us;
+    _period = 0;
+    for( u1_t i = 0; i < SIM_MAX_EVENTS; i++ ) {
+        if( events[i] == NULL ) {
+            events[i] = this;
+            return;
+        }
+    }
+    fprintf(stderr, "sim: more than %u timer events\n", SIM_MAX_EVENTS);
+    abort( );
+}
+
+void Timeout::detach (void) {
+    for( u1_t i = 0; i < SIM_MAX_EVENTS; i++ ) {
+        if( events[i] == this ) {
+            events[i] = NULL;
+        }
+    }
+}
+
+void Ticker::attach_us (void (*fptr) (void), uint32_t us) {
+    Timeout::attach_us( fptr, us );
+    _period = us;
+}
+
+///////////////////////////////////////////////////
+// INTERNAL FLASH                               //
+/////////////////////////////////////////////////
+
+/*
+ * flashPower function of type integer.
+ *
+ * Counts one erase or program towards the power loss set by sim_flashCut.
+ *
+ * Input parameters: None
+ * Return: 1 if the operation completes, 0 if the power is lost during it
+ *         (only part of it takes effect), -1 if the power is already lost.
+ */
+static int flashPower (void) {
+    if( flashDown ) {
+        return -1;
+    }
+    if( flashCut != 0 && --flashCut == 0 ) {
+        flashDown = 1;
+        return 0;
+    }
+    return 1;
+}// end of flashPower function.
+
+int FlashIAP::init (void) {
+    if( !flashErased ) {
+        memset( flash, 0xFF, sizeof( flash ) );
+        flashErased = 1;
+    }
+    return 0;
+}
+
+int FlashIAP::read (void* buffer, uint32_t addr, uint32_t size) {
+    if( addr > SIM_FLASH_SIZE || size > SIM_FLASH_SIZE - addr ) {
+        return -1;
+    }
+    memcpy( buffer, flash + addr, size );
+    return 0;
+}
+
+int FlashIAP::program (const void* buffer, uint32_t addr, uint32_t size) {
+    if( addr % get_page_size( ) != 0 || size % get_page_size( ) != 0 ||
+        addr > SIM_FLASH_SIZE || size > SIM_FLASH_SIZE - addr ) {
+        return -1;
+    }
+    int power = flashPower( );
+    if( power < 0 ) {
+        return -1;
+    }
+    // A power loss leaves the first half programmed.
+    uint32_t done = power ? size : size / 2;
+    for( uint32_t i = 0; i < done; i++ ) {
+        flash[addr + i] &= ( (const u1_t*)buffer )[i];
+    }
+    return power ? 0 : -1;
+}
+
+int FlashIAP::erase (uint32_t addr, uint32_t size) {
+    if( addr % SIM_FLASH_SECTOR != 0 || size % SIM_FLASH_SECTOR != 0 ||
+        addr > SIM_FLASH_SIZE || size > SIM_FLASH_SIZE - addr ) {
+        return -1;
+    }
+    for( uint32_t sector = addr; sector < addr + size; sector += SIM_FLASH_SECTOR ) {
+        int power = flashPower( );
+        if( power < 0 ) {
+            return -1;
+        }
+        // A power loss leaves the second half of the sector as it was.
+        memset( flash + sector, 0xFF, power ? SIM_FLASH_SECTOR : SIM_FLASH_SECTOR / 2 );
+        flashErases[sector / SIM_FLASH_SECTOR]++;
+        if( !power ) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+uint32_t FlashIAP::get_sector_size (uint32_t addr) const {
+    return addr < SIM_FLASH_SIZE ? SIM_FLASH_SECTOR : 0;
+}
+
+uint32_t FlashIAP::get_flash_size (void) const {
+    return SIM_FLASH_SIZE;
+}
+
+///////////////////////////////////////////////////
+// DHT11                                        //
+/////////////////////////////////////////////////
+
+eError DHT::readData (void) {
+    // 18 ms start signal and the 40-bit transfer.
+    advance( now + 23000 );
+    if( readHook != NULL ) {
+        readHook( _pin, dhtError );
+    }
+    return (eError)dhtError;
+}
+
+float DHT::ReadTemperature (eScale scale) {
+    return scale == KELVIN ? dhtTemperature + 273.15f :
+           scale == FARENHEIT ? dhtTemperature * 9 / 5 + 32 : dhtTemperature;
+}
+
+float DHT::ReadHumidity (void) {
+    return dhtHumidity;
+}
+
+///////////////////////////////////////////////////
+// SIMULATION CONTROLS                          //
+/////////////////////////////////////////////////
+
+/*
+ * sim_run function of type integer.
+ *
+ * Input parameters: int entry (int, char**)
+ *                   unsigned long long end
+ * Return: 0 once end has been reached, or the return value of entry.
+ *
+ */
+int sim_run (int (*entry) (int, char**), uint64_t end) {
+    static char name[] = "node";
+    static char* argv[] = { name, NULL };
+    struct itimerval off;
+    volatile int result = 0;
+
+    until = end;
+    if( setjmp( stop ) == 0 ) {
+        result = entry( 1, argv );
+    }
+    // Drop the state of the run: timer events, masked interrupts and the
+    // host watchdog of recovery.cpp.
+    memset( events, 0, sizeof( events ) );
+    pendingCount = 0;
+    masked = 0;
+    firing = 0;
+    memset( &off, 0, sizeof( off ) );
+    setitimer( ITIMER_REAL, &off, NULL );
+    return result;
+}// end of sim_run function.
+
+/*
+ * sim_now function of type unsigned long long.
+ *
+ * Input parameters: None
+ * Return: virtual clock in microseconds.
+ *
+ */
+uint64_t sim_now (void) {
+    return now;
+}// end of sim_now function.
+
+/*
+ * sim_onWrite and sim_onRead functions of type void.
+ *
+ * Input parameters: sim_hook_t hook
+ *
+ */
+void sim_onWrite (sim_hook_t hook) {
+    writeHook = hook;
+}// end of sim_onWrite function.
+
+void sim_onRead (sim_hook_t hook) {
+    readHook = hook;
+}// end of sim_onRead function.
+
+/*
+ * sim_pin function of type integer.
+ *
+ * Input parameters: PinName pin
+ * Return: level last written.
+ *
+ */
+int sim_pin (PinName pin) {
+    return pinIndex( pin ) >= 0 ? levels[pinIndex( pin )] : 0;
+}// end of sim_pin function.
+
+/*
+ * sim_pinName function of type const char pointer.
+ *
+ * Input parameters: PinName pin
+ * Return: board name of pin.
+ *
+ */
+const char* sim_pinName (PinName pin) {
+    static const struct { PinName pin; const char* name; } HEADER[] = {
+        { D0, "D0" }, { D1, "D1" }, { D2, "D2" }, { D3, "D3" }, { D4, "D4" }, { D5, "D5" },
+        { D6, "D6" }, { D7, "D7" }, { D8, "D8" }, { D9, "D9" }, { D10, "D10" }, { D11, "D11" },
+        { D12, "D12" }, { D13, "D13" }, { D14, "D14" }, { D15, "D15" }, { A0, "A0" },
+        { A1, "A1" }, { A2, "A2" }, { A3, "A3" }, { A4, "A4" }, { A5, "A5" }
+    };
+    static char name[8];
+
+    for( u1_t i = 0; i < sizeof( HEADER ) / sizeof( HEADER[0] ); i++ ) {
+        if( HEADER[i].pin == pin ) {
+            return HEADER[i].name;
+        }
+    }
+    if( pinIndex( pin ) < 0 ) {
+        return "NC";
+    }
+    snprintf( name, sizeof( name ), "PT%c%d", 'A' + ( pin >> 5 ), pin & 31 );
+    return name;
+}// end of sim_pinName function.
+
+/*
+ * sim_setAnalog function of type void.
+ *
+ * Input parameters: PinName pin
+ *                   unsigned short value
+ *
+ */
+void sim_setAnalog (PinName pin, u2_t value) {
+    if( pinIndex( pin ) >= 0 ) {
+        analog[pinIndex( pin )] = value;
+    }
+}// end of sim_setAnalog function.
+
+/*
+ * sim_setDht function of type void.
+ *
+ * Input parameters: float temperature
+ *                   float humidity
+ *                   int error
+ *
+ */
+void sim_setDht (float temperature, float humidity, int error) {
+    dhtTemperature = temperature;
+    dhtHumidity = humidity;
+    dhtError = error;
+}// end of sim_setDht function.
+
+/*
+ * sim_flashCut function of type void.
+ *
+ * Input parameters: unsigned int ops
+ *
+ */
+void sim_flashCut (u4_t ops) {
+    flashCut = ops;
+    flashDown = 0;
+}// end of sim_flashCut function.
+
+/*
+ * sim_flashLost function of type bit_t.
+ *
+ * Input parameters: None
+ * Return: 1 if the power is cut.
+ *
+ */
+bit_t sim_flashLost (void) {
+    return flashDown;
+}// end of sim_flashLost function.
+
+/*
+ * sim_flashErases function of type unsigned int.
+ *
+ * Input parameters: unsigned int addr
+ * Return: erase count of the sector.
+ *
+ */
+u4_t sim_flashErases (u4_t addr) {
+    return addr < SIM_FLASH_SIZE ? flashErases[addr / SIM_FLASH_SECTOR] : 0;
+}// end of sim_flashErases function.
+
+/*
+ * sim_radioReg function of type unsigned char.
+ *
+ * Input parameters: unsigned char addr
+ * Return: register value.
+ *
+ */
+u1_t sim_radioReg (u1_t addr) {
+    return radio[addr & 0x7F];
+}// end of sim_radioReg function.
@@ -0,0 +1,299 @@
+/*******************************************************************************
+ * Internet of Things (IoT) smart monitoring
+ * device for agriculture using LoRaWAN technology.
+ *
+ * Host stand-in for the mbed 2 SDK (mbed.h).
+ *
+ * - Lets the portable modules that include mbed.h build on a host.
+ *
+ * - The peripherals used by the node (DigitalOut, DigitalInOut, InterruptIn,
+ * AnalogIn, SPI, Timer, Ticker, Timeout) run on a virtual microsecond clock
+ * implemented in mbed.cpp. The clock only moves when the node waits, sleeps
+ * or reads a timer, so that a simulated day takes a fraction of a second
+ * and every run is deterministic. SEE sim.h for the simulation controls.
+ *
+ * - The internal flash (FlashIAP) is kept in RAM across runs.
+ *
+ * - Pin names are FRDM-K64F port pins, the Arduino header names (D0..D15,
+ * A0..A5) being aliases of them as on the board.
+ *
+ * - Not part of the firmware image (SEE .mbedignore).
+ *
+ *******************************************************************************/
+#ifndef MBED_H
+#define MBED_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+///////////////////////////////////////////////////
+// PINS (FRDM-K64F PinNames.h)                  //
+/////////////////////////////////////////////////
+
+typedef int PinName;
+#define PIN_NAME(port, pin) ( ( (port) << 5 ) | (pin) )
+
+#define PTA1  PIN_NAME( 0, 1 )
+#define PTA2  PIN_NAME( 0, 2 )
+#define PTB2  PIN_NAME( 1, 2 )
+#define PTB3  PIN_NAME( 1, 3 )
+#define PTB9  PIN_NAME( 1, 9 )
+#define PTB10 PIN_NAME( 1, 10 )
+#define PTB11 PIN_NAME( 1, 11 )
+#define PTB16 PIN_NAME( 1, 16 )
+#define PTB17 PIN_NAME( 1, 17 )
+#define PTB23 PIN_NAME( 1, 23 )
+#define PTC2  PIN_NAME( 2, 2 )
+#define PTC3  PIN_NAME( 2, 3 )
+#define PTC4  PIN_NAME( 2, 4 )
+#define PTC5  PIN_NAME( 2, 5 )
+#define PTC7  PIN_NAME( 2, 7 )
+#define PTC10 PIN_NAME( 2, 10 )
+#define PTC11 PIN_NAME( 2, 11 )
+#define PTC12 PIN_NAME( 2, 12 )
+#define PTC16 PIN_NAME( 2, 16 )
+#define PTC17 PIN_NAME( 2, 17 )
+#define PTD0  PIN_NAME( 3, 0 )
+#define PTD1  PIN_NAME( 3, 1 )
+#define PTD2  PIN_NAME( 3, 2 )
+#define PTD3  PIN_NAME( 3, 3 )
+#define PTE24 PIN_NAME( 4, 24 )
+#define PTE25 PIN_NAME( 4, 25 )
+
+// Arduino header.
+#define D0  PTC16
+#define D1  PTC17
+#define D2  PTB9
+#define D3  PTA1
+#define D4  PTB23
+#define D5  PTA2
+#define D6  PTC2
+#define D7  PTC3
+#define D8  PTC12
+#define D9  PTC4
+#define D10 PTD0
+#define D11 PTD2
+#define D12 PTD3
+#define D13 PTD1
+#define D14 PTE25
+#define D15 PTE24
+#define A0  PTB2
+#define A1  PTB3
+#define A2  PTB10
+#define A3  PTB11
+#define A4  PTC11
+#define A5  PTC10
+
+#define NC ( -1 )
+
+typedef enum { PullNone = 0, PullDown, PullUp } PinMode;
+
+///////////////////////////////////////////////////
+// INTERRUPTS AND WAITING                       //
+/////////////////////////////////////////////////
+
+/*
+ * __disable_irq and __enable_irq functions of type void.
+ *
+ * Mask and unmask the timer and pin interrupts of the simulation. Events
+ * due while masked run when unmasked.
+ */
+void __disable_irq (void);
+void __enable_irq (void);
+
+/*
+ * wait, wait_ms and wait_us functions of type void.
+ *
+ * Busy waits: advance the virtual clock, running the events due meanwhile.
+ */
+void wait (float s);
+void wait_ms (int ms);
+void wait_us (int us);
+
+/*
+ * sleep function of type void.
+ *
+ * WFI: advances the virtual clock to the next timer event, which runs at
+ * once or, with interrupts masked, once they are unmasked.
+ */
+void sleep (void);
+
+///////////////////////////////////////////////////
+// DIGITAL AND ANALOG PINS                      //
+/////////////////////////////////////////////////
+
+/*
+ * DigitalOut class.
+ *
+ * Output pin. Every write is passed to the simulation (SEE sim_onWrite).
+ */
+class DigitalOut {
+public:
+    DigitalOut (PinName pin, int value = 0);
+    void write (int value);
+    int read (void);
+    DigitalOut& operator= (int value) { write( value ); return *this; }
+    operator int () { return read( ); }
+private:
+    PinName _pin;
+    int _value;
+};
+
+/*
+ * DigitalInOut class.
+ *
+ * Bidirectional pin; only writes in output mode reach the simulation.
+ */
+class DigitalInOut {
+public:
+    DigitalInOut (PinName pin);
+    void output (void) { _output = 1; }
+    void input (void) { _output = 0; }
+    void mode (PinMode) { }
+    void write (int value);
+    int read (void) { return _value; }
+    DigitalInOut& operator= (int value) { write( value ); return *this; }
+    operator int () { return read( ); }
+private:
+    PinName _pin;
+    int _value;
+    int _output;
+};
+
+/*
+ * InterruptIn class.
+ *
+ * Edge-triggered input pin. The simulated radio reports through register
+ * reads (SEE sim.cpp), so no edge is ever raised.
+ */
+class InterruptIn {
+public:
+    InterruptIn (PinName pin);
+    void mode (PinMode) { }
+    void rise (void (*fptr) (void)) { _rise = fptr; }
+    void fall (void (*) (void)) { }
+    void enable_irq (void) { _enabled = 1; }
+    void disable_irq (void) { _enabled = 0; }
+    PinName _pin;
+    void (*_rise) (void);
+    int _enabled;
+};
+
+/*
+ * AnalogIn class.
+ *
+ * Analog input pin returning the value set by sim_setAnalog. Every read is
+ * passed to the simulation (SEE sim_onRead) and takes 20 microseconds.
+ */
+class AnalogIn {
+public:
+    AnalogIn (PinName pin);
+    unsigned short read_u16 (void);
+    float read (void) { return read_u16( ) / 65535.0f; }
+    operator float () { return read( ); }
+private:
+    PinName _pin;
+};
+
+///////////////////////////////////////////////////
+// SPI                                          //
+/////////////////////////////////////////////////
+
+/*
+ * SPI class.
+ *
+ * SPI master wired to a simulated SX1272 register file: the first byte of
+ * every NSS (D10) frame is the register address, with bit 7 set for a
+ * write, and the following bytes access consecutive registers.
+ */
+class SPI {
+public:
+    SPI (PinName mosi, PinName miso, PinName sclk);
+    void format (int, int = 0) { }
+    void frequency (int) { }
+    int write (int value);
+};
+
+///////////////////////////////////////////////////
+// TIMERS                                       //
+/////////////////////////////////////////////////
+
+/*
+ * Timer class.
+ *
+ * Stopwatch on the virtual clock. Every read advances the clock by one
+ * microsecond, the time the read itself takes, so that busy waits end.
+ */
+class Timer {
+public:
+    Timer (void) : _start( 0 ), _elapsed( 0 ), _running( 0 ) { }
+    void start (void);
+    void stop (void);
+    void reset (void);
+    int read_us (void);
+    int read_ms (void) { return read_us( ) / 1000; }
+    float read (void) { return read_us( ) / 1000000.0f; }
+private:
+    uint64_t _start;
+    uint64_t _elapsed;
+    int _running;
+};
+
+/*
+ * Timeout class.
+ *
+ * One-shot timer event on the virtual clock.
+ */
+class Timeout {
+public:
+    Timeout (void) : _fptr( NULL ), _at( 0 ), _period( 0 ) { }
+    virtual ~Timeout (void) { detach( ); }
+    void attach_us (void (*fptr) (void), uint32_t us);
+    void attach (void (*fptr) (void), float s) { attach_us( fptr, (uint32_t)( s * 1000000.0f ) ); }
+    void detach (void);
+    void (*_fptr) (void);
+    uint64_t _at;
+    uint32_t _period;   // 0 for a one-shot event.
+};
+
+/*
+ * Ticker class.
+ *
+ * Periodic timer event on the virtual clock.
+ */
+class Ticker : public Timeout {
+public:
+    void attach_us (void (*fptr) (void), uint32_t us);
+    void attach (void (*fptr) (void), float s) { attach_us( fptr, (uint32_t)( s * 1000000.0f ) ); }
+};
+
+///////////////////////////////////////////////////
+// INTERNAL FLASH                               //
+/////////////////////////////////////////////////
+
+#define DEVICE_FLASH 1
+
+/*
+ * FlashIAP class.
+ *
+ * Internal flash of the K64F (1 MB, 4 KB sectors, 8-byte program unit)
+ * kept in RAM, so that its contents survive sim_run calls like a power
+ * cycle. Programming only clears bits, as on NOR flash. SEE sim_flashCut
+ * for power losses during an erase or a program.
+ */
+class FlashIAP {
+public:
+    int init (void);
+    int deinit (void) { return 0; }
+    int read (void* buffer, uint32_t addr, uint32_t size);
+    int program (const void* buffer, uint32_t addr, uint32_t size);
+    int erase (uint32_t addr, uint32_t size);
+    uint32_t get_sector_size (uint32_t addr) const;
+    uint32_t get_flash_start (void) const { return 0; }
+    uint32_t get_flash_size (void) const;
+    uint32_t get_page_size (void) const { return 8; }
+};
+
+#endif // MBED_H
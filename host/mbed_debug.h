@@ -0,0 +1,17 @@
+/*******************************************************************************
+ * Internet of Things (IoT) smart monitoring
+ * device for agriculture using LoRaWAN technology.
+ *
+ * Host stand-in for the mbed debug header (mbed_debug.h).
+ *
+ * - Not part of the firmware image (SEE .mbedignore).
+ *
+ *******************************************************************************/
+#ifndef MBED_DEBUG_H
+#define MBED_DEBUG_H
+
+#include <stdio.h>
+
+#define debug(...) ( (void)0 )
+
+#endif // MBED_DEBUG_H
@@ -0,0 +1,538 @@
+/*******************************************************************************
+ * Internet of Things (IoT) smart monitoring
+ * device for agriculture using LoRaWAN technology.
+ *
+ * Local network-server stand-in.
+ *
+ * Data uplink PHYPayload (LoRaWAN 1.0):
+ *   MHDR (1) | DevAddr (4) | FCtrl (1) | FCnt (2) | FOpts (0..15) |
+ *   FPort (1) | FRMPayload (N) | MIC (4)
+ *
+ * Batches are dispatched to the workers through a generation counter:
+ * netserver_processBatch resolves the device of every uplink, sorts the
+ * uplinks by worker (device slot modulo the number of workers) keeping
+ * their batch order, bumps the generation and waits until every worker has
+ * gone through its share.
+ *
+ * SEE netserver.h file for the description of each function.
+ *
+ *******************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include "lmic.h"
+#include "samples.h"
+#include "crypto.h"
+#include "netserver.h"
+#include "bench.h"
+
+#define MTYPE_UNCONFIRMED_UP 0x40
+#define MTYPE_CONFIRMED_UP   0x80
+#define MTYPE_MASK           0xE0
+
+#define OFF_DEVADDR 1
+#define OFF_FCTRL   5
+#define OFF_FCNT    6
+#define OFF_FOPTS   8
+#define MIC_LEN     4
+
+static netserver_device_t devices[NETSERVER_MAX_DEVICES];
+static u2_t deviceCount = 0;
+
+// Worker pool.
+static pthread_t threads[NETSERVER_MAX_WORKERS];
+static u1_t workerCount = 0;
+static pthread_mutex_t poolLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t workReady = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t workDone = PTHREAD_COND_INITIALIZER;
+static u4_t generation = 0;    // Batches dispatched so far.
+static u1_t pending = 0;       // Workers still busy with the present batch.
+static bit_t stopping = 0;
+
+// Present batch: uplinks, device slot of each and uplink indices sorted by
+// worker, worker w owning order[first[w]] to order[first[w + 1] - 1].
+static netserver_uplink_t* batchUps;
+static u2_t slots[NETSERVER_MAX_BATCH];
+static u4_t order[NETSERVER_MAX_BATCH];
+static u4_t first[NETSERVER_MAX_WORKERS + 1];
+
+/*
+ * cryptoBlock function of type void.
+ *
+ * Fills block with the B0 (MIC) or A_i (cipher) block of an uplink.
+ *
+ * Input parameters: unsigned char block (16 bytes)
+ *                   unsigned char first (0x49 for B0, 0x01 for A_i)
+ *                   devaddr_t devaddr
+ *                   unsigned int fcnt
+ *                   unsigned char last (message length for B0, block index for A_i)
+ */
+static void cryptoBlock (u1_t* block, u1_t first, devaddr_t devaddr, u4_t fcnt, u1_t last) {
+    memset( block, 0, 16 );
+    block[0] = first;
+    block[5] = 0; // uplink direction
+    os_wlsbf4( block + 6, devaddr );
+    os_wlsbf4( block + 10, fcnt );
+    block[15] = last;
+}// end of cryptoBlock function.
+
+/*
+ * computeMic function of type unsigned int.
+ *
+ * Input parameters: const crypto_ctx_t key (NwkSKey)
+ *                   devaddr_t devaddr
+ *                   unsigned int fcnt
+ *                   const unsigned char msg
+ *                   unsigned char len (without MIC)
+ * Return: MIC, first byte in the most significant position.
+ */
+static u4_t computeMic (const crypto_ctx_t* key, devaddr_t devaddr, u4_t fcnt, const u1_t* msg, u1_t len) {
+    u1_t b0[16];
+    cryptoBlock( b0, 0x49, devaddr, fcnt, len );
+    return crypto_cmac( key, b0, msg, len );
+}// end of computeMic function.
+
+/*
+ * cipher function of type void.
+ *
+ * Encrypts or decrypts (same operation) an uplink FRMPayload in place.
+ *
+ * Input parameters: const crypto_ctx_t key (AppSKey, NwkSKey for port 0)
+ *                   devaddr_t devaddr
+ *                   unsigned int fcnt
+ *                   unsigned char buf
+ *                   unsigned char len
+ */
+static void cipher (const crypto_ctx_t* key, devaddr_t devaddr, u4_t fcnt, u1_t* buf, u1_t len) {
+    u1_t a[16];
+    cryptoBlock( a, 0x01, devaddr, fcnt, 1 );
+    crypto_ctr( key, a, buf, len );
+}// end of cipher function.
+
+/*
+ * findSlot function of type unsigned short.
+ *
+ * Binary search of the sorted device table.
+ *
+ * Input parameters: devaddr_t devaddr
+ * Return: index of devaddr, or of the first entry above it.
+ */
+static u2_t findSlot (devaddr_t devaddr) {
+    u2_t lo = 0;
+    u2_t hi = deviceCount;
+    while( lo < hi ) {
+        u2_t mid = ( lo + hi ) / 2;
+        if( devices[mid].devaddr < devaddr ) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}// end of findSlot function.
+
+/*
+ * parseUplink function of type unsigned char.
+ *
+ * Checks the frame layout and looks up the device of an uplink.
+ *
+ * Input parameters: netserver_uplink_t up
+ *                   unsigned short slot (output, device table index)
+ * Return: NETSERVER_OK or rejection reason.
+ */
+static u1_t parseUplink (netserver_uplink_t* up, u2_t* slot) {
+    u1_t len = up->len;
+
+    up->dataLen = 0;
+    up->port = 0;
+    if( len < OFF_FOPTS + MIC_LEN || len > MAX_LEN_FRAME ||
+        ( ( up->phy[0] & MTYPE_MASK ) != MTYPE_UNCONFIRMED_UP &&
+          ( up->phy[0] & MTYPE_MASK ) != MTYPE_CONFIRMED_UP ) ) {
+        return NETSERVER_MALFORMED;
+    }
+    if( OFF_FOPTS + ( up->phy[OFF_FCTRL] & 0x0F ) + MIC_LEN > len ) {
+        return NETSERVER_MALFORMED;
+    }
+    up->devaddr = os_rlsbf4( up->phy + OFF_DEVADDR );
+    *slot = findSlot( up->devaddr );
+    if( *slot == deviceCount || devices[*slot].devaddr != up->devaddr ) {
+        return NETSERVER_UNKNOWN_DEV;
+    }
+    return NETSERVER_OK;
+}// end of parseUplink function.
+
+/*
+ * processUplink function of type unsigned char.
+ *
+ * Verifies, checks and decrypts a parsed uplink of dev.
+ *
+ * Input parameters: netserver_uplink_t up
+ *                   netserver_device_t dev
+ * Return: processing status.
+ */
+static u1_t processUplink (netserver_uplink_t* up, netserver_device_t* dev) {
+    u1_t msg[MAX_LEN_FRAME];
+    u1_t hdr = OFF_FOPTS + ( up->phy[OFF_FCTRL] & 0x0F );
+    u1_t len = up->len - MIC_LEN;
+    u4_t mic = os_rmsbf4( up->phy + len );
+    bit_t rolled = 0;
+
+    // Extend the transmitted 16-bit counter with the upper bits last seen.
+    u4_t fcnt = ( dev->fcntUp & 0xFFFF0000 ) | os_rlsbf2( up->phy + OFF_FCNT );
+    if( dev->seen && fcnt <= dev->fcntUp ) {
+        fcnt += 0x10000;
+        rolled = 1;
+    }
+    up->fcnt = fcnt;
+
+    memcpy( msg, up->phy, len );
+    if( computeMic( &dev->nwk, up->devaddr, fcnt, msg, len ) != mic ) {
+        dev->rejected++;
+        // A counter that only verifies without the roll-over is a replay.
+        if( rolled && computeMic( &dev->nwk, up->devaddr, fcnt - 0x10000, msg, len ) == mic ) {
+            up->fcnt = fcnt - 0x10000;
+            return NETSERVER_BAD_FCNT;
+        }
+        return NETSERVER_BAD_MIC;
+    }
+    if( dev->seen && fcnt - dev->fcntUp > NETSERVER_MAX_FCNT_GAP ) {
+        dev->rejected++;
+        return NETSERVER_BAD_FCNT;
+    }
+    dev->fcntUp = fcnt;
+    dev->seen = 1;
+    dev->accepted++;
+
+    if( len > hdr ) {
+        up->port = msg[hdr];
+        up->dataLen = len - hdr - 1;
+        memcpy( up->data, msg + hdr + 1, up->dataLen );
+        cipher( up->port == 0 ? &dev->nwk : &dev->art, up->devaddr, fcnt, up->data, up->dataLen );
+    }
+    return NETSERVER_OK;
+}// end of processUplink function.
+
+/*
+ * processShare function of type void.
+ *
+ * Processes the uplinks of the present batch owned by one worker.
+ *
+ * Input parameters: unsigned char w (worker)
+ */
+static void processShare (u1_t w) {
+    for( u4_t k = first[w]; k < first[w + 1]; k++ ) {
+        netserver_uplink_t* up = &batchUps[order[k]];
+        up->status = processUplink( up, &devices[slots[order[k]]] );
+    }
+}// end of processShare function.
+
+/*
+ * worker function of type void pointer.
+ *
+ * Worker thread: processes its share of every dispatched batch.
+ *
+ * Input parameters: void arg (worker index)
+ * Return: NULL.
+ */
+static void* worker (void* arg) {
+    u1_t w = (u1_t)(size_t)arg;
+    u4_t seen = 0;   // The pool starts at generation 0 (SEE netserver_init).
+
+    pthread_mutex_lock( &poolLock );
+    for( ;; ) {
+        while( generation == seen && !stopping ) {
+            pthread_cond_wait( &workReady, &poolLock );
+        }
+        if( stopping ) {
+            break;
+        }
+        seen = generation;
+        pthread_mutex_unlock( &poolLock );
+        processShare( w );
+        pthread_mutex_lock( &poolLock );
+        if( --pending == 0 ) {
+            pthread_cond_signal( &workDone );
+        }
+    }
+    pthread_mutex_unlock( &poolLock );
+    return NULL;
+}// end of worker function.
+
+/*
+ * dispatch function of type void.
+ *
+ * Processes up to NETSERVER_MAX_BATCH uplinks on the workers.
+ *
+ * Input parameters: netserver_uplink_t ups
+ *                   unsigned int count
+ */
+static void dispatch (netserver_uplink_t* ups, u4_t count) {
+    u1_t workers = workerCount ? workerCount : 1;
+
+    // Resolve the devices and count the uplinks of every worker.
+    memset( first, 0, sizeof( first ) );
+    for( u4_t i = 0; i < count; i++ ) {
+        ups[i].status = parseUplink( &ups[i], &slots[i] );
+        if( ups[i].status == NETSERVER_OK ) {
+            first[slots[i] % workers + 1]++;
+        }
+    }
+    for( u1_t w = 0; w < workers; w++ ) {
+        first[w + 1] += first[w];
+    }
+    // Stable counting sort, so that every device keeps its batch order.
+    u4_t fill[NETSERVER_MAX_WORKERS];
+    memcpy( fill, first, sizeof( fill ) );
+    for( u4_t i = 0; i < count; i++ ) {
+        if( ups[i].status == NETSERVER_OK ) {
+            order[fill[slots[i] % workers]++] = i;
+        }
+    }
+    batchUps = ups;
+
+    if( workerCount == 0 ) {
+        processShare( 0 );
+        return;
+    }
+    pthread_mutex_lock( &poolLock );
+    pending = workerCount;
+    generation++;
+    pthread_cond_broadcast( &workReady );
+    while( pending != 0 ) {
+        pthread_cond_wait( &workDone, &poolLock );
+    }
+    pthread_mutex_unlock( &poolLock );
+}// end of dispatch function.
+
+/*
+ * netserver_stop function of type void.
+ *
+ * Input parameters: None
+ *
+ */
+void netserver_stop (void) {
+    pthread_mutex_lock( &poolLock );
+    stopping = 1;
+    pthread_cond_broadcast( &workReady );
+    pthread_mutex_unlock( &poolLock );
+    for( u1_t w = 0; w < workerCount; w++ ) {
+        pthread_join( threads[w], NULL );
+    }
+    workerCount = 0;
+    stopping = 0;
+}// end of netserver_stop function.
+
+/*
+ * netserver_init function of type void.
+ *
+ * Input parameters: unsigned char workers
+ *
+ */
+void netserver_init (u1_t workers) {
+    netserver_stop( );
+    deviceCount = 0;
+    generation = 0;
+    if( workers > NETSERVER_MAX_WORKERS ) {
+        workers = NETSERVER_MAX_WORKERS;
+    }
+    if( workers < 2 ) {
+        return;
+    }
+    for( u1_t w = 0; w < workers; w++ ) {
+        if( pthread_create( &threads[w], NULL, worker, (void*)(size_t)w ) != 0 ) {
+            break;
+        }
+        workerCount++;
+    }
+}// end of netserver_init function.
+
+/*
+ * netserver_addDevice function of type netserver_device_t pointer.
+ *
+ * Input parameters: devaddr_t devaddr
+ *                   const unsigned char nwkKey
+ *                   const unsigned char artKey
+ * Return: registered device or NULL.
+ *
+ */
+netserver_device_t* netserver_addDevice (devaddr_t devaddr, const u1_t* nwkKey, const u1_t* artKey) {
+    u2_t i = findSlot( devaddr );
+
+    if( i == deviceCount || devices[i].devaddr != devaddr ) {
+        if( deviceCount == NETSERVER_MAX_DEVICES ) {
+            return NULL;
+        }
+        memmove( &devices[i + 1], &devices[i], ( deviceCount - i ) * sizeof( devices[0] ) );
+        deviceCount++;
+    }
+    netserver_device_t* dev = &devices[i];
+    memset( dev, 0, sizeof( *dev ) );
+    dev->devaddr = devaddr;
+    crypto_setKey( &dev->nwk, nwkKey );
+    crypto_setKey( &dev->art, artKey );
+    return dev;
+}// end of netserver_addDevice function.
+
+/*
+ * netserver_findDevice function of type netserver_device_t pointer.
+ *
+ * Input parameters: devaddr_t devaddr
+ * Return: registered device or NULL.
+ *
+ */
+netserver_device_t* netserver_findDevice (devaddr_t devaddr) {
+    u2_t i = findSlot( devaddr );
+    if( i == deviceCount || devices[i].devaddr != devaddr ) {
+        return NULL;
+    }
+    return &devices[i];
+}// end of netserver_findDevice function.
+
+/*
+ * netserver_buildUplink function of type unsigned char.
+ *
+ * Input parameters: const netserver_device_t dev
+ *                   unsigned int fcnt
+ *                   unsigned char port
+ *                   const unsigned char data
+ *                   unsigned char dataLen
+ *                   unsigned char phy
+ * Return: PHYPayload length.
+ *
+ */
+u1_t netserver_buildUplink (const netserver_device_t* dev, u4_t fcnt, u1_t port,
+                            const u1_t* data, u1_t dataLen, u1_t* phy) {
+    u1_t len = OFF_FOPTS;
+
+    phy[0] = MTYPE_UNCONFIRMED_UP;
+    os_wlsbf4( phy + OFF_DEVADDR, dev->devaddr );
+    phy[OFF_FCTRL] = 0;
+    os_wlsbf2( phy + OFF_FCNT, (u2_t)fcnt );
+    phy[len++] = port;
+    memcpy( phy + len, data, dataLen );
+    cipher( port == 0 ? &dev->nwk : &dev->art, dev->devaddr, fcnt, phy + len, dataLen );
+    len += dataLen;
+    os_wmsbf4( phy + len, computeMic( &dev->nwk, dev->devaddr, fcnt, phy, len ) );
+    return len + MIC_LEN;
+}// end of netserver_buildUplink function.
+
+/*
+ * netserver_processBatch function of type unsigned int.
+ *
+ * Input parameters: netserver_uplink_t ups
+ *                   unsigned int count
+ * Return: number of accepted uplinks.
+ *
+ */
+u4_t netserver_processBatch (netserver_uplink_t* ups, u4_t count) {
+    u4_t accepted = 0;
+
+    for( u4_t i = 0; i < count; i += NETSERVER_MAX_BATCH ) {
+        dispatch( ups + i, count - i < NETSERVER_MAX_BATCH ? count - i : NETSERVER_MAX_BATCH );
+    }
+    for( u4_t i = 0; i < count; i++ ) {
+        if( ups[i].status == NETSERVER_OK ) {
+            accepted++;
+        }
+    }
+    return accepted;
+}// end of netserver_processBatch function.
+
+/*
+ * netserver_loadTest function of type unsigned int.
+ *
+ * Input parameters: unsigned short devices
+ *                   unsigned int rounds
+ *                   unsigned char workers
+ *                   devaddr_t devaddr
+ *                   const unsigned char nwkKey
+ *                   const unsigned char artKey
+ * Return: number of unexpected results.
+ *
+ */
+u4_t netserver_loadTest (u2_t devices, u4_t rounds, u1_t workers, devaddr_t devaddr,
+                         const u1_t* nwkKey, const u1_t* artKey) {
+    static u1_t phys[NETSERVER_MAX_DEVICES * NETSERVER_LOAD_BURST + 1][SAMPLE_FRAME_LENGTH + 13];
+    static u1_t data[NETSERVER_MAX_DEVICES * NETSERVER_LOAD_BURST + 1][SAMPLE_FRAME_LENGTH];
+    static netserver_uplink_t ups[NETSERVER_MAX_DEVICES * NETSERVER_LOAD_BURST + 1];
+    u1_t nwk[16], art[16], frame[SAMPLE_FRAME_LENGTH];
+    u4_t accepted = 0, badMic = 0, replays = 0, unexpected = 0, elapsed = 0;
+    sample_t sample;
+
+    if( devices > NETSERVER_MAX_DEVICES ) {
+        devices = NETSERVER_MAX_DEVICES;
+    }
+    if( devices == 0 ) {
+        return 0;
+    }
+    u4_t batch = (u4_t)devices * NETSERVER_LOAD_BURST;
+
+    // One session per simulated node, derived from the given session.
+    netserver_init( workers );
+    memcpy( nwk, nwkKey, 16 );
+    memcpy( art, artKey, 16 );
+    for( u2_t d = 0; d < devices; d++ ) {
+        nwk[14] = nwkKey[14] ^ (u1_t)( d >> 8 );
+        nwk[15] = nwkKey[15] ^ (u1_t)d;
+        art[14] = artKey[14] ^ (u1_t)( d >> 8 );
+        art[15] = artKey[15] ^ (u1_t)d;
+        netserver_addDevice( devaddr + d, nwk, art );
+    }
+
+    for( u4_t r = 0; r < rounds; r++ ) {
+        // Interleave the nodes, as a gateway would forward them.
+        for( u4_t k = 0; k < batch; k++ ) {
+            netserver_device_t* dev = netserver_findDevice( devaddr + k % devices );
+            u4_t fcnt = r * NETSERVER_LOAD_BURST + k / devices;
+            sample.temperature = (s2_t)k;
+            sample.humidity = (s2_t)r;
+            sample.light = (s2_t)fcnt;
+            sample.soil = (s2_t)( k % devices );
+            samples_encode( &sample, frame );
+            ups[k].phy = phys[k];
+            ups[k].len = netserver_buildUplink( dev, fcnt, 1, frame, SAMPLE_FRAME_LENGTH, phys[k] );
+            ups[k].data = data[k];
+        }
+        // A replay of one uplink at the end of the batch, after the original.
+        u4_t replayed = ( r + 1 ) % batch;
+        memcpy( phys[batch], phys[replayed], ups[replayed].len );
+        ups[batch] = ups[replayed];
+        ups[batch].phy = phys[batch];
+        ups[batch].data = data[batch];
+        // Corrupt the MIC of another one.
+        u4_t corrupted = r % batch;
+        phys[corrupted][ups[corrupted].len - 1] ^= 0x01;
+
+        u4_t start = bench_micros( );
+        accepted += netserver_processBatch( ups, batch + 1 );
+        elapsed += bench_micros( ) - start;
+
+        for( u4_t k = 0; k <= batch; k++ ) {
+            u1_t expected = k == corrupted ? NETSERVER_BAD_MIC : k == batch ? NETSERVER_BAD_FCNT : NETSERVER_OK;
+            badMic += ups[k].status == NETSERVER_BAD_MIC;
+            replays += ups[k].status == NETSERVER_BAD_FCNT;
+            if( ups[k].status != expected ) {
+                unexpected++;
+                continue;
+            }
+            if( expected != NETSERVER_OK ) {
+                continue;
+            }
+            samples_decode( ups[k].data, &sample );
+            if( ups[k].dataLen != SAMPLE_FRAME_LENGTH || sample.temperature != (s2_t)k ||
+                sample.humidity != (s2_t)r || sample.light != (s2_t)ups[k].fcnt ) {
+                unexpected++;
+            }
+        }
+    }
+    netserver_stop( );
+
+    u4_t total = rounds * ( batch + 1 );
+    printf("Network server: %u devices, %u workers, %u uplinks, %u accepted, %u bad MIC, %u replays, %u unexpected\r\n",
+           devices, workers > 1 ? workers : 1, (unsigned int)total, (unsigned int)accepted,
+           (unsigned int)badMic, (unsigned int)replays, (unsigned int)unexpected);
+    printf("Network server: %u us, %u packets/s\r\n", (unsigned int)elapsed,
+           (unsigned int)( elapsed ? (unsigned long long)total * 1000000 / elapsed : 0 ));
+    return unexpected;
+}// end of netserver_loadTest function.
@@ -0,0 +1,183 @@
+/*******************************************************************************
+ * Internet of Things (IoT) smart monitoring
+ * device for agriculture using LoRaWAN technology.
+ *
+ * Local network-server stand-in.
+ *
+ * - Holds the ABP sessions (DevAddr, NwkSKey, AppSKey) of a fleet of
+ * simulated nodes, such as the one installed by setUp() through
+ * LMIC_setSession, sorted by device address.
+ *
+ * - netserver_processBatch verifies the AES-CMAC MIC of a batch of uplink
+ * PHYPayloads, checks and extends their 16-bit frame counters and decrypts
+ * their FRMPayload, replacing the cloud hop in end-to-end load tests.
+ *
+ * - A batch is split by device over a pool of worker threads started by
+ * netserver_init. Every device belongs to one worker, which processes its
+ * uplinks in batch order, so per-device state (frame counter, statistics)
+ * needs no locking and replays are detected as they would be sequentially.
+ *
+ * - Device lookup is a binary search over the sorted table.
+ *
+ * - Crypto follows LoRaWAN 1.0. The key schedules of each session are
+ * expanded once at registration (SEE crypto.h) and reused for every uplink.
+ *
+ * - Part of the host ingestion tool (SEE ingest.cpp), not of the firmware
+ * image.
+ *
+ *******************************************************************************/
+#ifndef _netserver_hpp_
+#define _netserver_hpp_
+
+#include "lmic.h"
+#include "crypto.h"
+
+// Maximum number of registered devices.
+#define NETSERVER_MAX_DEVICES 4096
+
+// Maximum number of worker threads.
+#define NETSERVER_MAX_WORKERS 32
+
+// Uplinks dispatched to the workers at once; larger batches are split.
+#define NETSERVER_MAX_BATCH 16384
+
+// Maximum accepted jump of the uplink frame counter.
+#define NETSERVER_MAX_FCNT_GAP 16384
+
+// Uplinks built per device and round by netserver_loadTest.
+#define NETSERVER_LOAD_BURST 4
+
+// Uplink processing status.
+enum {
+    NETSERVER_OK = 0,        // MIC verified, counter accepted, payload decrypted.
+    NETSERVER_MALFORMED,     // Not a data uplink or too short.
+    NETSERVER_UNKNOWN_DEV,   // Device address not registered.
+    NETSERVER_BAD_MIC,       // MIC verification failed.
+    NETSERVER_BAD_FCNT       // Replayed or out-of-range frame counter.
+};
+
+/*
+ * netserver_device_t structure.
+ *
+ * Session and counters of one registered device.
+ */
+typedef struct {
+    devaddr_t devaddr;  // Device address.
+    crypto_ctx_t nwk;   // Network session key (NwkSKey) schedule.
+    crypto_ctx_t art;   // Application session key (AppSKey) schedule.
+    u4_t fcntUp;        // Last accepted uplink frame counter.
+    bit_t seen;         // Set once the first uplink has been accepted.
+    u4_t accepted;      // Number of accepted uplinks.
+    u4_t rejected;      // Number of rejected uplinks.
+} netserver_device_t;
+
+/*
+ * netserver_uplink_t structure.
+ *
+ * One uplink of a batch. phy, len and data are provided by the caller,
+ * the remaining fields are filled in by netserver_processBatch.
+ */
+typedef struct {
+    const u1_t* phy;    // PHYPayload as received from the gateway.
+    u1_t len;           // PHYPayload length.
+    u1_t* data;         // Output buffer for the decrypted FRMPayload (len - 13 bytes).
+    u1_t dataLen;       // Decrypted FRMPayload length.
+    u1_t port;          // FPort (0 if absent).
+    u1_t status;        // NETSERVER_OK or rejection reason.
+    devaddr_t devaddr;  // Device address.
+    u4_t fcnt;          // Full 32-bit uplink frame counter.
+} netserver_uplink_t;
+
+/*
+ * netserver_init function of type void.
+ *
+ * Removes all registered devices and starts workers worker threads,
+ * stopping those of a previous call. With 0 or 1 workers batches are
+ * processed by the calling thread.
+ *
+ * Input parameters: unsigned char workers (<= NETSERVER_MAX_WORKERS)
+ */
+void netserver_init (u1_t workers);
+
+/*
+ * netserver_stop function of type void.
+ *
+ * Stops the worker threads.
+ *
+ * Input parameters: None
+ */
+void netserver_stop (void);
+
+/*
+ * netserver_addDevice function of type netserver_device_t pointer.
+ *
+ * Registers (or replaces) the ABP session of a device. Not to be called
+ * while a batch is being processed.
+ *
+ * Input parameters: devaddr_t devaddr
+ *                   const unsigned char nwkKey (16 bytes)
+ *                   const unsigned char artKey (16 bytes)
+ * Return: registered device or NULL if the table is full.
+ */
+netserver_device_t* netserver_addDevice (devaddr_t devaddr, const u1_t* nwkKey, const u1_t* artKey);
+
+/*
+ * netserver_findDevice function of type netserver_device_t pointer.
+ *
+ * Input parameters: devaddr_t devaddr
+ * Return: registered device or NULL.
+ */
+netserver_device_t* netserver_findDevice (devaddr_t devaddr);
+
+/*
+ * netserver_buildUplink function of type unsigned char.
+ *
+ * Builds an unconfirmed data uplink PHYPayload the way a node's LMiC would
+ * (no FOpts), encrypting data and appending the MIC.
+ *
+ * Input parameters: const netserver_device_t dev
+ *                   unsigned int fcnt
+ *                   unsigned char port (1..223)
+ *                   const unsigned char data
+ *                   unsigned char dataLen
+ *                   unsigned char phy (output, dataLen + 13 bytes)
+ * Return: PHYPayload length.
+ */
+u1_t netserver_buildUplink (const netserver_device_t* dev, u4_t fcnt, u1_t port,
+                            const u1_t* data, u1_t dataLen, u1_t* phy);
+
+/*
+ * netserver_processBatch function of type unsigned int.
+ *
+ * Verifies, checks and decrypts count uplinks on the worker threads. A
+ * frame whose MIC only verifies with the frame counter it had before the
+ * last accepted one is reported as a replay (NETSERVER_BAD_FCNT).
+ *
+ * Input parameters: netserver_uplink_t ups
+ *                   unsigned int count
+ * Return: number of accepted uplinks.
+ */
+u4_t netserver_processBatch (netserver_uplink_t* ups, u4_t count);
+
+/*
+ * netserver_loadTest function of type unsigned int.
+ *
+ * Registers devices simulated nodes derived from the given session (device
+ * address and keys varied per node) and feeds rounds batches of
+ * NETSERVER_LOAD_BURST uplinks per node through netserver_processBatch on
+ * workers worker threads. Every batch also holds one corrupted MIC and one
+ * replayed uplink, which must be rejected as such. Writes the acceptance
+ * count and packets per second to stdout.
+ *
+ * Input parameters: unsigned short devices (<= NETSERVER_MAX_DEVICES)
+ *                   unsigned int rounds
+ *                   unsigned char workers
+ *                   devaddr_t devaddr
+ *                   const unsigned char nwkKey
+ *                   const unsigned char artKey
+ * Return: number of uplinks with an unexpected status or payload.
+ */
+u4_t netserver_loadTest (u2_t devices, u4_t rounds, u1_t workers, devaddr_t devaddr,
+                         const u1_t* nwkKey, const u1_t* artKey);
+
+#endif // _netserver_hpp_
@@ -0,0 +1,166 @@
+/*******************************************************************************
+ * Internet of Things (IoT) smart monitoring
+ * device for agriculture using LoRaWAN technology.
+ *
+ * Batch decoder for the uplink payload format.
+ *
+ * SEE payload.h file for the description of each function.
+ *
+ *******************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include "lmic.h"
+#include "samples.h"
+#include "payload.h"
+#include "bench.h"
+
+#if defined(__ARM_BIG_ENDIAN) || ( defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__ )
+#define PAYLOAD_BIG_ENDIAN 1
+#else
+#define PAYLOAD_BIG_ENDIAN 0
+#endif
+
+/*
+ * load16x2 function of type unsigned int.
+ *
+ * Loads 4 bytes holding two big-endian 16-bit values and returns them in
+ * native order, first value in the low half and second in the high half.
+ *
+ * Input parameters: const unsigned char p
+ * Return: both values packed in one word
+ */
+static inline u4_t load16x2 (const u1_t* p) {
+    u4_t w;
+    memcpy( &w, p, 4 ); // single (unaligned) word load
+#if PAYLOAD_BIG_ENDIAN
+    return ( w >> 16 ) | ( w << 16 );
+#else
+    return ( ( w & 0x00FF00FF ) << 8 ) | ( ( w >> 8 ) & 0x00FF00FF );
+#endif
+}// end of load16x2 function.
+
+/*
+ * payload_decodeBatch function of type void.
+ *
+ * Input parameters: const unsigned char frames
+ *                   unsigned int count
+ *                   unsigned short stride
+ *                   payload_columns_t cols
+ *
+ */
+void payload_decodeBatch (const u1_t* frames, u4_t count, u2_t stride, const payload_columns_t* cols) {
+    s2_t* temperature = cols->temperature;
+    s2_t* humidity = cols->humidity;
+    s2_t* light = cols->light;
+    s2_t* soil = cols->soil;
+
+    for( u4_t i = 0; i < count; i++ ) {
+        u4_t w0 = load16x2( frames );
+        u4_t w1 = load16x2( frames + 4 );
+        temperature[i] = (s2_t)( w0 & 0xFFFF );
+        humidity[i]    = (s2_t)( w0 >> 16 );
+        light[i]       = (s2_t)( w1 & 0xFFFF );
+        soil[i]        = (s2_t)( w1 >> 16 );
+        frames += stride;
+    }
+}// end of payload_decodeBatch function.
+
+/*
+ * payload_toFixed function of type void.
+ *
+ * Input parameters: const short in
+ *                   int out
+ *                   unsigned int count
+ *                   unsigned char frac
+ *
+ */
+void payload_toFixed (const s2_t* in, s4_t* out, u4_t count, u1_t frac) {
+    // 2^(32+frac) / 100, rounded up; the product is shifted back by 32 bits.
+    // Rounding up keeps the product of an exact half beyond it, away from
+    // zero, and the error below 2^-17, while any other result is at least
+    // 1/100 away from a half.
+    const int64_t recip = ( ( (int64_t)1 << ( 32 + frac ) ) + 99 ) / 100;
+
+    for( u4_t i = 0; i < count; i++ ) {
+        out[i] = (s4_t)( ( in[i] * recip + ( (int64_t)1 << 31 ) ) >> 32 );
+    }
+}// end of payload_toFixed function.
+
+/*
+ * payload_records function of type unsigned char.
+ *
+ * Input parameters: const unsigned char frame
+ *                   unsigned char len
+ *                   payload_record_t recs
+ * Return: number of records, 0 if malformed.
+ *
+ */
+u1_t payload_records (const u1_t* frame, u1_t len, payload_record_t* recs) {
+    u1_t n = 0;
+    u1_t pos = 0;
+
+    while( pos < len ) {
+        if( n == PAYLOAD_RECORDS_MAX || len - pos < 2 || frame[pos + 1] > len - pos - 2 ) {
+            return 0;
+        }
+        recs[n].port = frame[pos];
+        recs[n].len = frame[pos + 1];
+        recs[n].data = frame + pos + 2;
+        pos += 2 + recs[n].len;
+        n++;
+    }
+    return n;
+}// end of payload_records function.
+
+/*
+ * payload_benchmark function of type unsigned int.
+ *
+ * Input parameters: unsigned int rounds
+ * Return: number of mismatches.
+ *
+ */
+u4_t payload_benchmark (u4_t rounds) {
+    static u1_t frames[PAYLOAD_BENCH_BATCH * PAYLOAD_FRAME_LENGTH];
+    static s2_t temperature[PAYLOAD_BENCH_BATCH];
+    static s2_t humidity[PAYLOAD_BENCH_BATCH];
+    static s2_t light[PAYLOAD_BENCH_BATCH];
+    static s2_t soil[PAYLOAD_BENCH_BATCH];
+    const payload_columns_t cols = { temperature, humidity, light, soil };
+    sample_t sample;
+    u4_t errors = 0;
+
+    // One synthetic reading per node, covering negative temperatures.
+    for( u2_t i = 0; i < PAYLOAD_BENCH_BATCH; i++ ) {
+        sample.temperature = (s2_t)( i * 37 - 1000 );
+        sample.humidity = (s2_t)( 2000 + i * 29 );
+        sample.light = (s2_t)( i * 13 );
+        sample.soil = (s2_t)( 500 - i );
+        samples_encode( &sample, frames + i * PAYLOAD_FRAME_LENGTH );
+    }
+
+    u4_t start = bench_micros( );
+    for( u4_t r = 0; r < rounds; r++ ) {
+        payload_decodeBatch( frames, PAYLOAD_BENCH_BATCH, PAYLOAD_FRAME_LENGTH, &cols );
+#if defined(__GNUC__)
+        __asm__ volatile( "" : : : "memory" ); // keep identical rounds from being merged
+#endif
+    }
+    u4_t elapsed = bench_micros( ) - start;
+
+    // Cross-check against the reference single-frame decoder.
+    for( u2_t i = 0; i < PAYLOAD_BENCH_BATCH; i++ ) {
+        samples_decode( frames + i * PAYLOAD_FRAME_LENGTH, &sample );
+        if( sample.temperature != temperature[i] || sample.humidity != humidity[i] ||
+            sample.light != light[i] || sample.soil != soil[i] ) {
+            errors++;
+        }
+    }
+
+    uint64_t decoded = (uint64_t)rounds * PAYLOAD_BENCH_BATCH;
+    printf("Payload decode: %u frames in %u us, %u frames/s per core, %u mismatches\r\n",
+           (unsigned int)decoded, (unsigned int)elapsed,
+           (unsigned int)( elapsed ? decoded * 1000000 / elapsed : 0 ), (unsigned int)errors);
+    return errors;
+}// end of payload_benchmark function.
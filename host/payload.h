@@ -0,0 +1,121 @@
+/*******************************************************************************
+ * Internet of Things (IoT) smart monitoring
+ * device for agriculture using LoRaWAN technology.
+ *
+ * Batch decoder for the uplink payload format.
+ *
+ * - An uplink frame (SEE samples_encode) holds four big-endian 16-bit values:
+ * temperature, humidity, light intensity and soil moisture, each * 100.
+ *
+ * - payload_decodeBatch decodes any number of frames, possibly from many nodes,
+ * into one array (column) per measurement. Each frame is read as two 32-bit
+ * words whose 16-bit halves are byte-swapped in parallel with a masked
+ * shift, so that no per-byte work is done.
+ *
+ * - payload_toFixed rescales a column from hundredths to a binary fixed-point
+ * format with one multiplication by a precomputed reciprocal, without division.
+ *
+ * - payload_records splits an alarm uplink (port PAYLOAD_CARRIER_PORT) into its
+ * records (port, length, data): the alarm itself, then the frames of lower
+ * classes it carries in class order (SEE uplink.h), e.g. a telemetry frame
+ * for payload_decodeBatch.
+ *
+ * - Host only: the node only encodes frames (SEE samples.h); the ingestion
+ * tool (SEE ingest.cpp) links this decoder and runs its benchmark. Not part
+ * of the firmware image (SEE .mbedignore).
+ *
+ *******************************************************************************/
+#ifndef _payload_hpp_
+#define _payload_hpp_
+
+#include "lmic.h"
+
+// Size of an uplink frame in bytes.
+#define PAYLOAD_FRAME_LENGTH 8
+
+// Number of frames decoded by payload_benchmark per batch.
+#define PAYLOAD_BENCH_BATCH 256
+
+// Port of the alarm uplinks, which carry frames of other ports.
+#define PAYLOAD_CARRIER_PORT 4
+
+// Maximum number of records in one carrier frame (51 bytes, 2 per header).
+#define PAYLOAD_RECORDS_MAX 25
+
+/*
+ * payload_columns_t structure.
+ *
+ * Destination columns of a batch decode, each holding at least as many
+ * entries as frames being decoded. Values are in hundredths of a unit.
+ */
+typedef struct {
+    s2_t* temperature; // Temperature (Celcius * 100).
+    s2_t* humidity;    // Humidity (Relative Humidity % * 100).
+    s2_t* light;       // Light intensity (Volts * 100).
+    s2_t* soil;        // Soil moisture (Volts * 100).
+} payload_columns_t;
+
+/*
+ * payload_record_t structure.
+ *
+ * One record of a carrier frame, pointing into the frame.
+ */
+typedef struct {
+    u1_t port;         // Port of the carried frame.
+    u1_t len;          // Length of the carried frame.
+    const u1_t* data;  // Carried frame.
+} payload_record_t;
+
+/*
+ * payload_decodeBatch function of type void.
+ *
+ * Decodes count frames into cols. Frames start stride bytes apart, so that
+ * they can be embedded in larger records (e.g. device address + frame).
+ *
+ * Input parameters: const unsigned char frames
+ *                   unsigned int count
+ *                   unsigned short stride (>= PAYLOAD_FRAME_LENGTH)
+ *                   payload_columns_t cols
+ */
+void payload_decodeBatch (const u1_t* frames, u4_t count, u2_t stride, const payload_columns_t* cols);
+
+/*
+ * payload_toFixed function of type void.
+ *
+ * Converts count values from hundredths to signed fixed point with frac
+ * fractional bits (e.g. frac 8 gives 1/256 units), rounding to nearest and
+ * halves away from zero, as lround.
+ *
+ * Input parameters: const short in
+ *                   int out
+ *                   unsigned int count
+ *                   unsigned char frac (0 to 15)
+ */
+void payload_toFixed (const s2_t* in, s4_t* out, u4_t count, u1_t frac);
+
+/*
+ * payload_records function of type unsigned char.
+ *
+ * Splits a carrier frame into its records.
+ *
+ * Input parameters: const unsigned char frame
+ *                   unsigned char len
+ *                   payload_record_t recs (PAYLOAD_RECORDS_MAX entries)
+ * Return: number of records, 0 if the frame is empty or a record runs past
+ *         its end.
+ */
+u1_t payload_records (const u1_t* frame, u1_t len, payload_record_t* recs);
+
+/*
+ * payload_benchmark function of type unsigned int.
+ *
+ * Decodes rounds batches of PAYLOAD_BENCH_BATCH synthetic frames from
+ * PAYLOAD_BENCH_BATCH distinct nodes, checks them against samples_decode and
+ * writes the decode rate (frames per second on one core) to stdout.
+ *
+ * Input parameters: unsigned int rounds
+ * Return: number of frames decoded differently from samples_decode.
+ */
+u4_t payload_benchmark (u4_t rounds);
+
+#endif // _payload_hpp_
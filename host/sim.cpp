@@ -0,0 +1,648 @@
+/*******************************************************************************
+ * Internet of Things (IoT) smart monitoring
+ * device for agriculture using LoRaWAN technology.
+ *
+ * Host node simulation: LMiC job scheduler and simplified class A MAC.
+ *
+ * The scheduler follows oslmic.c of LMiC 1.5. The MAC keeps the band and
+ * channel selection of lmic.c (EU868) but replaces the radio driver by
+ * RegOpMode writes and fixed receive windows, and does not compute MICs.
+ *
+ * SEE sim.h file for the description.
+ *
+ *******************************************************************************/
+
+#include "lmic.h"
+#include "hal.h"
+#include "sim.h"
+
+///////////////////////////////////////////////////
+// SCHEDULER (oslmic.c)                         //
+/////////////////////////////////////////////////
+
+static struct {
+    osjob_t* scheduledjobs;
+    osjob_t* runnablejobs;
+} OS;
+
+/*
+ * unlinkjob function of type integer.
+ *
+ * Input parameters: osjob_t pnext (queue)
+ *                   osjob_t job
+ * Return: 1 if job was queued and has been removed.
+ */
+static int unlinkjob (osjob_t** pnext, osjob_t* job) {
+    for( ; *pnext; pnext = &( ( *pnext )->next ) ) {
+        if( *pnext == job ) {
+            *pnext = job->next;
+            return 1;
+        }
+    }
+    return 0;
+}// end of unlinkjob function.
+
+/*
+ * os_clearCallback function of type void.
+ *
+ * Input parameters: osjob_t job
+ */
+void os_clearCallback (osjob_t* job) {
+    hal_disableIRQs( );
+    unlinkjob( &OS.scheduledjobs, job ) || unlinkjob( &OS.runnablejobs, job );
+    hal_enableIRQs( );
+}// end of os_clearCallback function.
+
+/*
+ * os_setCallback function of type void.
+ *
+ * Queues job to run at once, removing it from either queue first.
+ *
+ * Input parameters: osjob_t job
+ *                   osjobcb_t cb
+ */
+void os_setCallback (osjob_t* job, osjobcb_t cb) {
+    osjob_t** pnext;
+
+    hal_disableIRQs( );
+    os_clearCallback( job );
+    job->func = cb;
+    job->next = NULL;
+    for( pnext = &OS.runnablejobs; *pnext; pnext = &( ( *pnext )->next ) );
+    *pnext = job;
+    hal_enableIRQs( );
+}// end of os_setCallback function.
+
+/*
+ * os_setTimedCallback function of type void.
+ *
+ * Schedules job at time, removing it from either queue first.
+ *
+ * Input parameters: osjob_t job
+ *                   ostime_t time
+ *                   osjobcb_t cb
+ */
+void os_setTimedCallback (osjob_t* job, ostime_t time, osjobcb_t cb) {
+    osjob_t** pnext;
+
+    hal_disableIRQs( );
+    os_clearCallback( job );
+    job->deadline = time;
+    job->func = cb;
+    job->next = NULL;
+    for( pnext = &OS.scheduledjobs; *pnext; pnext = &( ( *pnext )->next ) ) {
+        if( ( *pnext )->deadline - time > 0 ) {
+            job->next = *pnext;
+            break;
+        }
+    }
+    *pnext = job;
+    hal_enableIRQs( );
+}// end of os_setTimedCallback function.
+
+/*
+ * os_runloop_once function of type void.
+ *
+ * Runs the first runnable job, else the first scheduled job if due, else
+ * lets the HAL sleep.
+ *
+ * Input parameters: None
+ */
+void os_runloop_once (void) {
+    osjob_t* j = NULL;
+
+    hal_disableIRQs( );
+    if( OS.runnablejobs ) {
+        j = OS.runnablejobs;
+        OS.runnablejobs = j->next;
+    } else if( OS.scheduledjobs && hal_checkTimer( OS.scheduledjobs->deadline ) ) {
+        j = OS.scheduledjobs;
+        OS.scheduledjobs = j->next;
+    } else {
+        hal_sleep( );
+    }
+    hal_enableIRQs( );
+    if( j ) {
+        j->func( j );
+    }
+}// end of os_runloop_once function.
+
+/*
+ * os_runloop function of type void.
+ *
+ * Input parameters: None
+ */
+void os_runloop (void) {
+    for( ;; ) {
+        os_runloop_once( );
+    }
+}// end of os_runloop function.
+
+/*
+ * os_getTime function of type ostime_t.
+ *
+ * Input parameters: None
+ * Return: present time in ticks.
+ */
+ostime_t os_getTime (void) {
+    return hal_ticks( );
+}// end of os_getTime function.
+
+/*
+ * os_getRndU1 function of type unsigned char.
+ *
+ * Input parameters: None
+ * Return: pseudo-random byte, deterministic across runs.
+ */
+u1_t os_getRndU1 (void) {
+    static u4_t seed = 1;
+    seed = seed * 1664525 + 1013904223;
+    return (u1_t)( seed >> 24 );
+}// end of os_getRndU1 function.
+
+///////////////////////////////////////////////////
+// RADIO AND MAC (radio.c, lmic.c)              //
+/////////////////////////////////////////////////
+
+struct lmic_t LMIC;
+
+// SX1272 RegOpMode (LoRa mode bit set) values written by the radio driver.
+#define RADIO_OPMODE     0x01
+#define RADIO_SLEEP      0x80
+#define RADIO_TX         0x83
+#define RADIO_RXSINGLE   0x86
+
+// Time from the end of the uplink to the RX1 and RX2 windows.
+#define RX1_DELAY sec2osticks( 1 )
+#define RX2_DELAY sec2osticks( 2 )
+
+// Time the radio listens in a window without a downlink: RX1 at the uplink
+// data rate, RX2 at SF9.
+#define RX1_TIME ms2osticks( 12 )
+#define RX2_TIME ms2osticks( 33 )
+
+// Default channels (EU868) in the centi band.
+static const u4_t DEFAULT_FREQ[] = { 868100000, 868300000, 868500000 };
+
+static osjob_t macjob;
+static u4_t uplinkCount = 0;
+static u4_t bootCount = 0;
+static uint64_t bootTime = 0;
+static sim_uplink_t uplinkHook = NULL;
+
+// Downlink delivered in the RX1 window of the next uplink.
+static bit_t dnPending = 0;
+static u1_t dnPort = 0;
+static u1_t dnLen = 0;
+static u1_t dnData[MAX_LEN_PAYLOAD];
+
+static void engineUpdate (void);
+static void rx1Close (osjob_t* j);
+
+/*
+ * radioMode function of type void.
+ *
+ * Writes RegOpMode over the HAL, as the SX1272 driver does.
+ *
+ * Input parameters: unsigned char mode
+ */
+static void radioMode (u1_t mode) {
+    hal_pin_nss( 0 );
+    hal_spi( RADIO_OPMODE | 0x80 );
+    hal_spi( mode );
+    hal_pin_nss( 1 );
+}// end of radioMode function.
+
+/*
+ * airtime function of type ostime_t.
+ *
+ * Input parameters: unsigned char len (PHYPayload bytes)
+ * Return: time on air at the present data rate (125 kHz, CR 4/5).
+ */
+static ostime_t airtime (u1_t len) {
+    s4_t sf = 12 - ( LMIC.datarate < DR_SF7B ? LMIC.datarate : (u1_t)DR_SF7 );
+    s4_t de = sf >= 11 ? 1 : 0;
+    s4_t bits = 8 * len - 4 * sf + 28 + 16;
+    s4_t per = 4 * ( sf - 2 * de );
+    s4_t blocks = bits > 0 ? ( bits + per - 1 ) / per : 0;
+    u4_t symbol = ( 1UL << sf ) * 8;   // Microseconds at 125 kHz.
+    return us2osticks( symbol * 49 / 4 + ( 8 + blocks * 5 ) * symbol );
+}// end of airtime function.
+
+/*
+ * initDefaultChannels function of type void.
+ *
+ * Input parameters: None
+ */
+static void initDefaultChannels (void) {
+    memset( LMIC.channelFreq, 0, sizeof( LMIC.channelFreq ) );
+    memset( LMIC.channelDrMap, 0, sizeof( LMIC.channelDrMap ) );
+    memset( LMIC.bands, 0, sizeof( LMIC.bands ) );
+    LMIC.channelMap = 0x07;
+    for( u1_t ch = 0; ch < 3; ch++ ) {
+        LMIC.channelFreq[ch] = DEFAULT_FREQ[ch] | BAND_CENTI;
+        LMIC.channelDrMap[ch] = DR_RANGE_MAP( DR_SF12, DR_SF7 );
+    }
+    LMIC.bands[BAND_MILLI].txcap = 1000;
+    LMIC.bands[BAND_MILLI].txpow = 14;
+    LMIC.bands[BAND_CENTI].txcap = 100;
+    LMIC.bands[BAND_CENTI].txpow = 14;
+    LMIC.bands[BAND_DECI].txcap = 10;
+    LMIC.bands[BAND_DECI].txpow = 27;
+    for( u1_t b = 0; b < MAX_BANDS; b++ ) {
+        LMIC.bands[b].lastchnl = os_getRndU1( ) % MAX_CHANNELS;
+        LMIC.bands[b].avail = os_getTime( );
+    }
+}// end of initDefaultChannels function.
+
+/*
+ * nextTx function of type ostime_t.
+ *
+ * Picks the band available first and the next usable channel in it.
+ *
+ * Input parameters: ostime_t now
+ * Return: time the picked channel is available from.
+ */
+static ostime_t nextTx (ostime_t now) {
+    u1_t bmap = 0xF;
+
+    for( ;; ) {
+        ostime_t mintime = now + sec2osticks( 28800 );
+        u1_t band = 0;
+        for( u1_t bi = 0; bi < MAX_BANDS; bi++ ) {
+            if( ( bmap & ( 1 << bi ) ) && mintime - LMIC.bands[bi].avail > 0 ) {
+                mintime = LMIC.bands[band = bi].avail;
+            }
+        }
+        u1_t chnl = LMIC.bands[band].lastchnl;
+        for( u1_t ci = 0; ci < MAX_CHANNELS; ci++ ) {
+            chnl = ( chnl + 1 ) % MAX_CHANNELS;
+            if( ( LMIC.channelMap & ( 1 << chnl ) ) != 0 &&
+                ( LMIC.channelDrMap[chnl] & ( 1 << ( LMIC.datarate & 0xF ) ) ) != 0 &&
+                band == ( LMIC.channelFreq[chnl] & 0x3 ) ) {
+                LMIC.txChnl = LMIC.bands[band].lastchnl = chnl;
+                return mintime;
+            }
+        }
+        if( ( bmap &= ~( 1 << band ) ) == 0 ) {
+            return mintime;
+        }
+    }
+}// end of nextTx function.
+
+/*
+ * txComplete function of type void.
+ *
+ * End of the RX2 window (or of RX1 with a downlink): reports EV_TXCOMPLETE.
+ *
+ * Input parameters: osjob_t j
+ */
+static void txComplete (osjob_t* j) {
+    (void)j;
+    radioMode( RADIO_SLEEP );
+    LMIC.opmode &= ~( OP_TXDATA | OP_TXRXPEND );
+    uplinkCount++;
+    onEvent( EV_TXCOMPLETE );
+    engineUpdate( );
+}// end of txComplete function.
+
+/*
+ * rx2 function of type void.
+ *
+ * Opens the RX2 window.
+ *
+ * Input parameters: osjob_t j
+ */
+static void rx2 (osjob_t* j) {
+    radioMode( RADIO_RXSINGLE );
+    os_setTimedCallback( j, os_getTime( ) + RX2_TIME, txComplete );
+}// end of rx2 function.
+
+/*
+ * rx1 function of type void.
+ *
+ * Opens the RX1 window and receives the queued downlink, if any.
+ *
+ * Input parameters: osjob_t j
+ */
+static void rx1 (osjob_t* j) {
+    radioMode( RADIO_RXSINGLE );
+    if( !dnPending ) {
+        LMIC.txrxFlags = 0;
+        LMIC.dataLen = 0;
+        os_setTimedCallback( j, os_getTime( ) + RX1_TIME, rx1Close );
+        return;
+    }
+    // Downlink frame: MHDR, DevAddr, FCtrl, FCnt, FPort, FRMPayload.
+    u1_t len = 9 + dnLen;
+    LMIC.frame[0] = 0x60;
+    os_wlsbf4( LMIC.frame + 1, LMIC.devaddr );
+    LMIC.frame[5] = 0;
+    os_wlsbf2( LMIC.frame + 6, (u2_t)LMIC.seqnoDn++ );
+    LMIC.frame[8] = dnPort;
+    memcpy( LMIC.frame + 9, dnData, dnLen );
+    LMIC.txrxFlags = TXRX_DNW1 | TXRX_PORT;
+    LMIC.dataBeg = 9;
+    LMIC.dataLen = dnLen;
+    dnPending = 0;
+    os_setTimedCallback( j, os_getTime( ) + airtime( len ), txComplete );
+}// end of rx1 function.
+
+/*
+ * rx1Close function of type void.
+ *
+ * Closes an empty RX1 window and schedules RX2.
+ *
+ * Input parameters: osjob_t j
+ */
+static void rx1Close (osjob_t* j) {
+    radioMode( RADIO_SLEEP );
+    os_setTimedCallback( j, LMIC.txend + RX2_DELAY, rx2 );
+}// end of rx1Close function.
+
+/*
+ * txDone function of type void.
+ *
+ * TX done interrupt: schedules RX1.
+ *
+ * Input parameters: osjob_t j
+ */
+static void txDone (osjob_t* j) {
+    radioMode( RADIO_SLEEP );
+    os_setTimedCallback( j, LMIC.txend + RX1_DELAY, rx1 );
+}// end of txDone function.
+
+/*
+ * startTx function of type void.
+ *
+ * Builds the data frame of the pending uplink and puts it on air.
+ *
+ * Input parameters: None
+ */
+static void startTx (void) {
+    ostime_t now = os_getTime( );
+    band_t* band = &LMIC.bands[LMIC.channelFreq[LMIC.txChnl] & 0x3];
+    u1_t len = 0;
+
+    // MHDR, DevAddr, FCtrl, FCnt, FPort, FRMPayload, MIC (not computed).
+    LMIC.frame[len++] = LMIC.pendTxConf ? 0x80 : 0x40;
+    os_wlsbf4( LMIC.frame + len, LMIC.devaddr );
+    len += 4;
+    LMIC.frame[len++] = 0;
+    os_wlsbf2( LMIC.frame + len, (u2_t)LMIC.seqnoUp );
+    len += 2;
+    LMIC.frame[len++] = LMIC.pendTxPort;
+    memcpy( LMIC.frame + len, LMIC.pendTxData, LMIC.pendTxLen );
+    len += LMIC.pendTxLen;
+    memset( LMIC.frame + len, 0, 4 );
+    len += 4;
+    LMIC.seqnoUp++;
+    LMIC.dataLen = len;
+    if( uplinkHook != NULL ) {
+        uplinkHook( LMIC.pendTxPort, LMIC.pendTxData, LMIC.pendTxLen );
+    }
+
+    LMIC.opmode |= OP_TXRXPEND;
+    LMIC.freq = LMIC.channelFreq[LMIC.txChnl] & ~(u4_t)0x3;
+    LMIC.txpow = LMIC.adrTxPow < band->txpow ? LMIC.adrTxPow : band->txpow;
+    radioMode( RADIO_TX );
+    ostime_t air = airtime( len );
+    LMIC.txend = now + air;
+    band->avail = now + air * band->txcap;
+    if( LMIC.globalDutyRate != 0 ) {
+        LMIC.globalDutyAvail = now + ( air << LMIC.globalDutyRate );
+    }
+    os_setTimedCallback( &macjob, LMIC.txend, txDone );
+}// end of startTx function.
+
+/*
+ * runEngineUpdate function of type void.
+ *
+ * Input parameters: osjob_t j
+ */
+static void runEngineUpdate (osjob_t* j) {
+    (void)j;
+    engineUpdate( );
+}// end of runEngineUpdate function.
+
+/*
+ * engineUpdate function of type void.
+ *
+ * Starts the pending uplink once its channel is free, or waits for it.
+ *
+ * Input parameters: None
+ */
+static void engineUpdate (void) {
+    if( ( LMIC.opmode & ( OP_TXRXPEND | OP_SHUTDOWN ) ) != 0 || ( LMIC.opmode & OP_TXDATA ) == 0 ) {
+        return;
+    }
+    ostime_t now = os_getTime( );
+    ostime_t txbeg = nextTx( now );
+    if( txbeg - LMIC.globalDutyAvail < 0 ) {
+        txbeg = LMIC.globalDutyAvail;
+    }
+    if( txbeg - now > 0 ) {
+        os_setTimedCallback( &macjob, txbeg, runEngineUpdate );
+        return;
+    }
+    startTx( );
+}// end of engineUpdate function.
+
+/*
+ * os_init function of type void.
+ *
+ * Input parameters: None
+ */
+void os_init (void) {
+    bootCount++;
+    bootTime = sim_now( );
+    memset( &OS, 0, sizeof( OS ) );
+    hal_init( );
+    hal_pin_rst( 2 );
+    radioMode( RADIO_SLEEP );
+    memset( &LMIC, 0, sizeof( LMIC ) );
+    LMIC_reset( );
+}// end of os_init function.
+
+/*
+ * LMIC_reset function of type void.
+ *
+ * Input parameters: None
+ */
+void LMIC_reset (void) {
+    radioMode( RADIO_SLEEP );
+    os_clearCallback( &macjob );
+    memset( &LMIC, 0, sizeof( LMIC ) );
+    LMIC.devNonce = os_getRndU2( );
+    LMIC.opmode = OP_NONE;
+    LMIC.adrTxPow = 14;
+    LMIC.txpow = 14;
+    LMIC.datarate = DR_SF12;
+    initDefaultChannels( );
+}// end of LMIC_reset function.
+
+bit_t LMIC_setupBand (u1_t bandidx, s1_t txpow, u2_t txcap) {
+    if( bandidx >= MAX_BANDS ) {
+        return 0;
+    }
+    LMIC.bands[bandidx].txcap = txcap;
+    LMIC.bands[bandidx].txpow = txpow;
+    LMIC.bands[bandidx].lastchnl = os_getRndU1( ) % MAX_CHANNELS;
+    LMIC.bands[bandidx].avail = os_getTime( );
+    return 1;
+}
+
+bit_t LMIC_setupChannel (u1_t chidx, u4_t freq, u2_t drmap, s1_t band) {
+    if( chidx >= MAX_CHANNELS ) {
+        return 0;
+    }
+    if( band == -1 ) {
+        band = freq >= 869400000 && freq <= 869650000 ? BAND_DECI :
+               freq >= 868000000 && freq <= 868600000 ? BAND_CENTI : BAND_MILLI;
+    }
+    LMIC.channelFreq[chidx] = ( freq & ~(u4_t)0x3 ) | band;
+    LMIC.channelDrMap[chidx] = drmap == 0 ? DR_RANGE_MAP( DR_SF12, DR_SF7 ) : drmap;
+    LMIC.channelMap |= 1 << chidx;
+    return 1;
+}
+
+void LMIC_disableChannel (u1_t channel) {
+    LMIC.channelFreq[channel] = 0;
+    LMIC.channelDrMap[channel] = 0;
+    LMIC.channelMap &= ~( 1 << channel );
+}
+
+void LMIC_setAdrMode (bit_t enabled) {
+    (void)enabled;
+}
+
+void LMIC_setLinkCheckMode (bit_t enabled) {
+    LMIC.adrAckReq = enabled ? 0 : -1;
+}
+
+void LMIC_setDrTxpow (u1_t dr, s1_t txpow) {
+    LMIC.datarate = dr;
+    LMIC.adrTxPow = txpow;
+}
+
+void LMIC_disableTracking (void) {
+    LMIC.opmode &= ~( OP_SCAN | OP_TRACK );
+}
+
+void LMIC_stopPingable (void) {
+    LMIC.opmode &= ~( OP_PINGABLE | OP_PINGINI );
+}
+
+void LMIC_setSession (u4_t netid, devaddr_t devaddr, xref2u1_t nwkKey, xref2u1_t artKey) {
+    LMIC.netid = netid;
+    LMIC.devaddr = devaddr;
+    if( nwkKey != NULL ) {
+        memcpy( LMIC.nwkKey, nwkKey, 16 );
+    }
+    if( artKey != NULL ) {
+        memcpy( LMIC.artKey, artKey, 16 );
+    }
+    initDefaultChannels( );
+    LMIC.opmode &= ~( OP_JOINING | OP_TRACK | OP_REJOIN | OP_TXRXPEND | OP_PINGINI );
+    LMIC.opmode |= OP_NEXTCHNL;
+    LMIC.seqnoUp = 0;
+    LMIC.seqnoDn = 0;
+}
+
+bit_t LMIC_startJoining (void) {
+    // ABP sessions only.
+    return 0;
+}
+
+void LMIC_setTxData (void) {
+    LMIC.opmode |= OP_TXDATA;
+    LMIC.txCnt = 0;
+    engineUpdate( );
+}
+
+int LMIC_setTxData2 (u1_t port, xref2u1_t data, u1_t dlen, u1_t confirmed) {
+    if( dlen > MAX_LEN_PAYLOAD ) {
+        return -2;
+    }
+    if( data != NULL ) {
+        memmove( LMIC.pendTxData, data, dlen );
+    }
+    LMIC.pendTxConf = confirmed;
+    LMIC.pendTxPort = port;
+    LMIC.pendTxLen = dlen;
+    LMIC_setTxData( );
+    return 0;
+}
+
+void LMIC_clrTxData (void) {
+    LMIC.opmode &= ~OP_TXDATA;
+}
+
+/*
+ * radio_irq_handler function of type void.
+ *
+ * DIO interrupts are not raised by the simulated radio.
+ *
+ * Input parameters: unsigned char dio
+ */
+void radio_irq_handler (u1_t dio) {
+    (void)dio;
+}// end of radio_irq_handler function.
+
+/*
+ * sim_downlink function of type void.
+ *
+ * Input parameters: unsigned char port
+ *                   const unsigned char data
+ *                   unsigned char len
+ *
+ */
+void sim_downlink (u1_t port, const u1_t* data, u1_t len) {
+    dnPort = port;
+    dnLen = len < MAX_LEN_PAYLOAD ? len : (u1_t)MAX_LEN_PAYLOAD;
+    memcpy( dnData, data, dnLen );
+    dnPending = 1;
+}// end of sim_downlink function.
+
+/*
+ * sim_uplinks function of type unsigned int.
+ *
+ * Input parameters: None
+ * Return: uplinks put on air.
+ *
+ */
+u4_t sim_uplinks (void) {
+    return uplinkCount;
+}// end of sim_uplinks function.
+
+/*
+ * sim_onUplink function of type void.
+ *
+ * Input parameters: sim_uplink_t hook
+ *
+ */
+void sim_onUplink (sim_uplink_t hook) {
+    uplinkHook = hook;
+}// end of sim_onUplink function.
+
+/*
+ * sim_boots function of type unsigned int.
+ *
+ * Input parameters: None
+ * Return: os_init calls since the start.
+ *
+ */
+u4_t sim_boots (void) {
+    return bootCount;
+}// end of sim_boots function.
+
+/*
+ * sim_bootTime function of type unsigned long long.
+ *
+ * Input parameters: None
+ * Return: virtual time of the last boot in microseconds.
+ *
+ */
+uint64_t sim_bootTime (void) {
+    return bootTime;
+}// end of sim_bootTime function.
@@ -0,0 +1,189 @@
+/*******************************************************************************
+ * Internet of Things (IoT) smart monitoring
+ * device for agriculture using LoRaWAN technology.
+ *
+ * Host node simulation.
+ *
+ * - Runs the unmodified application (main.cpp, built with -Dmain=node_main)
+ * together with hal.cpp and the application modules against the mbed and
+ * LMiC stand-ins of this directory, on a virtual clock (SEE mbed.h).
+ *
+ * - The LMiC stand-in (sim.cpp) schedules jobs like LMiC and runs a
+ * simplified class A MAC: an uplink goes on air on the next enabled channel
+ * once its band allows it, the radio is switched through RegOpMode writes
+ * on the SPI bus like the SX1272 driver does (TX, then RX1 and RX2), and
+ * EV_TXCOMPLETE is reported after the RX2 window, with the downlink set by
+ * sim_downlink if any. Duty-cycle limits follow the LMiC bands.
+ *
+ * - Pin writes and sensor reads are passed to hooks, so that host tests can
+ * check the wiring and the current drawn through every pin.
+ *
+ * - The internal flash can lose its power in the middle of an erase or a
+ * program, so that host tests can check the flash journal (persist.cpp).
+ *
+ * - Not part of the firmware image (SEE .mbedignore).
+ *
+ *******************************************************************************/
+#ifndef _sim_hpp_
+#define _sim_hpp_
+
+#include "mbed.h"
+#include "lmic.h"
+
+// Pin hook: pin and value written or read.
+typedef void (*sim_hook_t) (PinName pin, int value);
+
+// Uplink hook: port and FRMPayload of a frame put on air.
+typedef void (*sim_uplink_t) (u1_t port, const u1_t* data, u1_t len);
+
+/*
+ * sim_run function of type integer.
+ *
+ * Runs entry (the node's main) until the virtual clock passes until
+ * microseconds, then returns to the caller. Pending timer events are
+ * dropped and interrupts unmasked, so that the node can be run again, e.g.
+ * for a power cycle.
+ *
+ * Input parameters: int entry (int, char**)
+ *                   unsigned long long until (virtual microseconds)
+ * Return: 0 once until has been reached, the return value of entry if it
+ *         returned before.
+ */
+int sim_run (int (*entry) (int, char**), uint64_t until);
+
+/*
+ * sim_now function of type unsigned long long.
+ *
+ * Input parameters: None
+ * Return: virtual clock in microseconds.
+ */
+uint64_t sim_now (void);
+
+/*
+ * sim_onWrite and sim_onRead functions of type void.
+ *
+ * Set the hook called on every output pin write, and on every sensor read
+ * (analog inputs and the DHT data pin), NULL for none.
+ *
+ * Input parameters: sim_hook_t hook
+ */
+void sim_onWrite (sim_hook_t hook);
+void sim_onRead (sim_hook_t hook);
+
+/*
+ * sim_pin function of type integer.
+ *
+ * Input parameters: PinName pin
+ * Return: level last written to an output pin, 0 if never written.
+ */
+int sim_pin (PinName pin);
+
+/*
+ * sim_pinName function of type const char pointer.
+ *
+ * Input parameters: PinName pin
+ * Return: board name of pin (Arduino name when on the header).
+ */
+const char* sim_pinName (PinName pin);
+
+/*
+ * sim_setAnalog function of type void.
+ *
+ * Input parameters: PinName pin
+ *                   unsigned short value (read_u16 result)
+ */
+void sim_setAnalog (PinName pin, u2_t value);
+
+/*
+ * sim_setDht function of type void.
+ *
+ * Sets the DHT11 reading and the readData() result (0 for ERROR_NONE).
+ *
+ * Input parameters: float temperature (Celsius)
+ *                   float humidity (%)
+ *                   int error
+ */
+void sim_setDht (float temperature, float humidity, int error);
+
+/*
+ * sim_flashCut function of type void.
+ *
+ * Restores the power of the internal flash and, unless ops is 0, cuts it
+ * during the ops-th following erase or program: half of that operation
+ * takes effect and it fails, as do all the following ones until the next
+ * sim_flashCut call.
+ *
+ * Input parameters: unsigned int ops
+ */
+void sim_flashCut (u4_t ops);
+
+/*
+ * sim_flashLost function of type bit_t.
+ *
+ * Input parameters: None
+ * Return: 1 if the power of the flash has been cut by sim_flashCut.
+ */
+bit_t sim_flashLost (void);
+
+/*
+ * sim_flashErases function of type unsigned int.
+ *
+ * Input parameters: unsigned int addr
+ * Return: number of erases of the flash sector holding addr since the start.
+ */
+u4_t sim_flashErases (u4_t addr);
+
+/*
+ * sim_radioReg function of type unsigned char.
+ *
+ * Input parameters: unsigned char addr
+ * Return: value of a register of the simulated SX1272.
+ */
+u1_t sim_radioReg (u1_t addr);
+
+/*
+ * sim_downlink function of type void.
+ *
+ * Queues a downlink received in the RX1 window of the next uplink.
+ *
+ * Input parameters: unsigned char port
+ *                   const unsigned char data
+ *                   unsigned char len
+ */
+void sim_downlink (u1_t port, const u1_t* data, u1_t len);
+
+/*
+ * sim_uplinks function of type unsigned int.
+ *
+ * Input parameters: None
+ * Return: number of uplinks the MAC put on air since the start.
+ */
+u4_t sim_uplinks (void);
+
+/*
+ * sim_onUplink function of type void.
+ *
+ * Sets the hook called for every uplink the MAC puts on air, NULL for none.
+ *
+ * Input parameters: sim_uplink_t hook
+ */
+void sim_onUplink (sim_uplink_t hook);
+
+/*
+ * sim_boots function of type unsigned int.
+ *
+ * Input parameters: None
+ * Return: number of boots (os_init calls) since the start, restarts by
+ *         recovery_fail included.
+ */
+u4_t sim_boots (void);
+
+/*
+ * sim_bootTime function of type unsigned long long.
+ *
+ * Input parameters: None
+ * Return: virtual time of the last boot (os_init call) in microseconds.
+ */
+uint64_t sim_bootTime (void);
+
+#endif // _sim_hpp_
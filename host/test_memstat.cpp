@@ -0,0 +1,202 @@
+/*******************************************************************************
+ * Internet of Things (IoT) smart monitoring
+ * device for agriculture using LoRaWAN technology.
+ *
+ * Host test of the memory budget (memstat.cpp), built with the allocator
+ * wrapped (MEMSTAT_HEAP_WRAP 1) and MEMSTAT_HEAP_LIMIT bytes allowed after
+ * start-up.
+ *
+ * - Stack: a call chain using STACK_DEPTH bytes of stack must raise the
+ * high-water mark by at least as much, within the painted window.
+ *
+ * - Heap: blocks allocated and freed again between two reads of the guard
+ * must still show in the peak, and growing beyond MEMSTAT_HEAP_LIMIT must
+ * trip the guard (hal_failed) once.
+ *
+ * - Report: memstat_report must list the registered region, non-zero
+ * .data/.bss totals and the same heap and stack figures as the getters.
+ *
+ * Usage: test_memstat
+ *
+ *******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "lmic.h"
+#include "memstat.h"
+
+// Stack used by the call chain of testStack, in bytes.
+#define STACK_DEPTH 16384
+#define STACK_FRAME 1024
+
+// Registered region.
+#define REGION_NAME "test"
+
+// Keeps the allocations of the test from being optimized away.
+static void* volatile block;
+// Changed by hal_failed from within malloc.
+static volatile u4_t trips = 0;
+static u1_t owned[200];
+static u4_t failures = 0;
+
+/*
+ * hal_failed function of type void.
+ *
+ * Stand-in for the HAL call made when the heap guard trips.
+ *
+ * Input parameters: None
+ */
+void hal_failed (void) {
+    trips++;
+}// end of hal_failed function.
+
+/*
+ * check function of type void.
+ *
+ * Input parameters: bit_t ok
+ *                   const char what
+ */
+static void check (bit_t ok, const char* what) {
+    if( !ok ) {
+        printf("FAIL: %s\r\n", what);
+        failures++;
+    }
+}// end of check function.
+
+/*
+ * descend function of type unsigned int.
+ *
+ * Input parameters: unsigned int depth (bytes of stack still to use)
+ * Return: byte of the frames, read back after the deeper calls so that
+ *         every frame stays live.
+ */
+static u4_t __attribute__((noinline)) descend (u4_t depth) {
+    volatile u1_t frame[STACK_FRAME];
+    u4_t deeper = 0;
+
+    for( u4_t i = 0; i < STACK_FRAME; i++ ) {
+        frame[i] = (u1_t)i;
+    }
+    if( depth > STACK_FRAME ) {
+        deeper = descend( depth - STACK_FRAME );
+    }
+    return frame[( depth + deeper ) % STACK_FRAME];
+}// end of descend function.
+
+/*
+ * testStack function of type void.
+ *
+ * Input parameters: None
+ */
+static void testStack (void) {
+    u4_t before = memstat_stackPeak( );
+
+    descend( STACK_DEPTH );
+    u4_t after = memstat_stackPeak( );
+    printf("Stack: peak %u bytes before, %u after using %u, of %u\r\n", (unsigned int)before,
+           (unsigned int)after, (unsigned int)STACK_DEPTH, (unsigned int)memstat_stackSize( ));
+    check( memstat_stackSize( ) == MEMSTAT_HOST_STACK, "stack window not painted" );
+    check( after >= before + STACK_DEPTH, "call chain missing from the stack peak" );
+    check( after < memstat_stackSize( ), "stack peak beyond the painted window" );
+}// end of testStack function.
+
+/*
+ * testHeap function of type void.
+ *
+ * Input parameters: None
+ */
+static void testHeap (void) {
+    memstat_heapGuard( 1 );
+    check( memstat_heapGrowth( ) == 0, "heap growth right after arming" );
+
+    // Short-lived blocks, freed before the guard is read.
+    block = malloc( 1000 );
+    free( block );
+    check( memstat_heapGrowth( ) >= 1000, "freed malloc block missing from the peak" );
+    block = calloc( 10, 200 );
+    free( block );
+    check( memstat_heapGrowth( ) >= 2000, "freed calloc block missing from the peak" );
+    block = malloc( 100 );
+    block = realloc( block, 3000 );
+    free( block );
+    u4_t peak = memstat_heapGrowth( );
+    printf("Heap: %u bytes peak after freeing every block, limit %u\r\n",
+           (unsigned int)peak, (unsigned int)MEMSTAT_HEAP_LIMIT);
+    check( peak >= 3000 && peak <= MEMSTAT_HEAP_LIMIT, "realloc block missing from the peak" );
+    check( trips == 0, "guard tripped within the limit" );
+
+    // Beyond the limit: trips once.
+    block = malloc( MEMSTAT_HEAP_LIMIT + 1 );
+    free( block );
+    block = malloc( 2 * MEMSTAT_HEAP_LIMIT );
+    free( block );
+    printf("Heap: guard tripped %u times beyond the limit\r\n", (unsigned int)trips);
+    check( trips == 1, "guard not tripped once beyond the limit" );
+    check( memstat_heapGrowth( ) >= 2 * MEMSTAT_HEAP_LIMIT, "peak not raised beyond the limit" );
+}// end of testHeap function.
+
+/*
+ * testReport function of type void.
+ *
+ * Runs memstat_report into a temporary file and checks its lines.
+ *
+ * Input parameters: None
+ */
+static void testReport (void) {
+    char line[128];
+    u4_t region = 0, data = 0, bss = 0, total = 0, inUse = 1, growth = 0, peak = 0, size = 0;
+    u1_t found = 0;
+    FILE* out = tmpfile( );
+
+    fflush( stdout );
+    int saved = dup( STDOUT_FILENO );
+    if( out == NULL || saved < 0 || dup2( fileno( out ), STDOUT_FILENO ) < 0 ) {
+        check( 0, "report not captured" );
+        return;
+    }
+    memstat_report( );
+    fflush( stdout );
+    dup2( saved, STDOUT_FILENO );
+    close( saved );
+
+    rewind( out );
+    while( fgets( line, sizeof( line ), out ) != NULL ) {
+        fputs( line, stdout );
+        found |= sscanf( line, " " REGION_NAME " %u bytes", &region ) == 1;
+        found |= ( sscanf( line, " .data %u + .bss %u = %u bytes static", &data, &bss, &total ) == 3 ) << 1;
+        found |= ( sscanf( line, " heap %u bytes in use, %u bytes allocated after start-up", &inUse, &growth ) == 2 ) << 2;
+        found |= ( sscanf( line, " stack peak %u of %u bytes", &peak, &size ) == 2 ) << 3;
+    }
+    fclose( out );
+    check( found == 0x0F, "report line missing" );
+    check( region == sizeof( owned ), "registered region not reported" );
+    check( data != 0 && bss != 0 && total == data + bss, "no .data/.bss totals" );
+    check( inUse == 0, "heap still in use after freeing every block" );
+    check( growth == memstat_heapGrowth( ), "heap peak differs from memstat_heapGrowth" );
+    check( peak == memstat_stackPeak( ) && peak != 0, "stack peak differs from memstat_stackPeak" );
+    check( size == MEMSTAT_HOST_STACK, "stack size differs from the painted window" );
+}// end of testReport function.
+
+/*
+ * main function of type integer.
+ *
+ * Input parameters: integer argc.
+ *                   char **argv.
+ * Return: 0 if every check passed, 1 otherwise.
+ */
+int main (int argc, char** argv) {
+    (void)argc;
+    (void)argv;
+
+    memstat_paintStack( );
+    memstat_region( REGION_NAME, sizeof( owned ) );
+
+    testStack( );
+    testHeap( );
+    testReport( );
+
+    printf("Memory budget: %s\r\n", failures ? "FAILED" : "passed");
+    return failures != 0;
+}// end of main function.
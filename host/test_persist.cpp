@@ -0,0 +1,342 @@
+/*******************************************************************************
+ * Internet of Things (IoT) smart monitoring
+ * device for agriculture using LoRaWAN technology.
+ *
+ * Host test of the flash journal (persist.cpp) on the FlashIAP stand-in.
+ *
+ * - Wrap: runs the journal around its sectors several times, queueing a new
+ * sample and sending the oldest one at every slot, and reboots every few
+ * slots. Every reboot must restore the session written once at the start,
+ * an uplink counter no lower than the next one to be used and at most
+ * PERSIST_SEQNO_STEP above it, and the pending samples. The sectors must
+ * have been erased evenly.
+ *
+ * - Frame counter reservation: uplinks that leave the sample queue as it
+ * was must write one record every PERSIST_SEQNO_STEP uplinks.
+ *
+ * - Power loss: cuts the power during each erase and program in turn while
+ * the journal moves on to the next sectors, then reboots. The session must
+ * survive, the uplink counter must not go back, and the pending samples
+ * must be those before or after the slot cut short. The journal must keep
+ * working across a full wrap afterwards.
+ *
+ * Usage: test_persist
+ *
+ *******************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include "mbed.h"
+#include "lmic.h"
+#include "samples.h"
+#include "persist.h"
+#include "sim.h"
+
+// Session of the test node.
+#define NETID   0x13
+#define DEVADDR 0x26011BDA
+
+// Samples pending at every slot, all kept in a record.
+#define QUEUE_DEPTH 3
+
+// Wrap test: slots and reboot period.
+#define WRAP_SLOTS 1200
+#define REBOOT_EVERY 37
+
+// Power loss test: slots before the first cut, erases and programs cut in
+// turn, and slots run after the reboot.
+#define PRELUDE_SLOTS 185
+#define CUT_OPS 140
+#define AFTER_SLOTS 300
+
+static const u1_t NWKSKEY[16] = { 0x2B, 0x7E, 0x15, 0x16, 0x28, 0xAE, 0xD2, 0xA6,
+                                  0xAB, 0xF7, 0x15, 0x88, 0x09, 0xCF, 0x4F, 0x3C };
+static const u1_t APPSKEY[16] = { 0x3C, 0x4F, 0xCF, 0x09, 0x88, 0x15, 0xF7, 0xAB,
+                                  0xA6, 0xD2, 0xAE, 0x28, 0x16, 0x15, 0x7E, 0x2B };
+
+/*
+ * queue_t structure.
+ *
+ * Temperatures of the pending samples, oldest first.
+ */
+typedef struct {
+    u1_t count;
+    s2_t temperature[QUEUE_DEPTH + 1];
+} queue_t;
+
+struct lmic_t LMIC;
+
+static FlashIAP flash;
+static u4_t base = 0;          // First journal sector.
+static u4_t sectorSize = 0;
+static s2_t reading = 0;       // Temperature of the next sample.
+static u4_t failures = 0;
+
+/*
+ * LMIC_setSession function of type void.
+ *
+ * Stand-in for the LMiC call used by persist_restoreSession.
+ *
+ * Input parameters: unsigned int netid
+ *                   devaddr_t devaddr
+ *                   unsigned char nwkKey
+ *                   unsigned char artKey
+ */
+void LMIC_setSession (u4_t netid, devaddr_t devaddr, xref2u1_t nwkKey, xref2u1_t artKey) {
+    LMIC.netid = netid;
+    LMIC.devaddr = devaddr;
+    memcpy( LMIC.nwkKey, nwkKey, 16 );
+    memcpy( LMIC.artKey, artKey, 16 );
+    LMIC.seqnoUp = 0;
+    LMIC.seqnoDn = 0;
+}// end of LMIC_setSession function.
+
+/*
+ * capture function of type queue_t.
+ *
+ * Input parameters: None
+ * Return: pending samples.
+ */
+static queue_t capture (void) {
+    queue_t q;
+
+    memset( &q, 0, sizeof( q ) );
+    q.count = samples_count( );
+    for( u1_t i = 0; i < q.count && i <= QUEUE_DEPTH; i++ ) {
+        q.temperature[i] = samples_at( i )->temperature;
+    }
+    return q;
+}// end of capture function.
+
+/*
+ * wipe function of type void.
+ *
+ * Restores the power and erases the journal sectors.
+ *
+ * Input parameters: None
+ */
+static void wipe (void) {
+    sim_flashCut( 0 );
+    flash.init( );
+    u4_t limit = flash.get_flash_start( ) + flash.get_flash_size( );
+    sectorSize = flash.get_sector_size( limit - 1 );
+    base = limit - PERSIST_SECTORS * sectorSize;
+    flash.erase( base, PERSIST_SECTORS * sectorSize );
+}// end of wipe function.
+
+/*
+ * boot function of type bit_t.
+ *
+ * Power-on: RAM is lost, then the journal is reopened and the session and
+ * pending samples restored as in setUp (main.cpp).
+ *
+ * Input parameters: None
+ * Return: 1 if the session was restored.
+ */
+static bit_t boot (void) {
+    memset( &LMIC, 0, sizeof( LMIC ) );
+    samples_init( );
+    persist_init( );
+    bit_t session = persist_restoreSession( );
+    persist_restore( );
+    persist_checkpoint( );
+    return session && LMIC.netid == NETID && LMIC.devaddr == DEVADDR &&
+           memcmp( LMIC.nwkKey, NWKSKEY, 16 ) == 0 && memcmp( LMIC.artKey, APPSKEY, 16 ) == 0;
+}// end of boot function.
+
+/*
+ * join function of type void.
+ *
+ * Starts a new session on an empty journal and queues a first sample.
+ *
+ * Input parameters: None
+ */
+static void join (void) {
+    boot( );
+    LMIC_setSession( NETID, DEVADDR, (xref2u1_t)NWKSKEY, (xref2u1_t)APPSKEY );
+    persist_saveSession( );
+    persist_checkpoint( );
+}// end of join function.
+
+/*
+ * slot function of type void.
+ *
+ * One uplink slot: a new sample is queued and, once QUEUE_DEPTH are
+ * pending, the oldest one is sent.
+ *
+ * Input parameters: None
+ */
+static void slot (void) {
+    sample_t sample = { reading++, 4800, 230, 180, 0 };
+
+    samples_push( &sample );
+    if( samples_count( ) > QUEUE_DEPTH ) {
+        LMIC.seqnoUp++;
+        samples_pop( );
+    }
+    persist_checkpoint( );
+}// end of slot function.
+
+/*
+ * reboot function of type void.
+ *
+ * Reboots and checks the restored state against one of two queues.
+ *
+ * Input parameters: const char label
+ *                   const queue_t before (queue before the last slot)
+ *                   const queue_t after (queue after it)
+ */
+static void reboot (const char* label, const queue_t* before, const queue_t* after) {
+    u4_t next = LMIC.seqnoUp;
+
+    if( !boot( ) ) {
+        printf("FAIL: %s: session lost\r\n", label);
+        failures++;
+    }
+    if( LMIC.seqnoUp < next || LMIC.seqnoUp > next + PERSIST_SEQNO_STEP ) {
+        printf("FAIL: %s: uplink counter %u restored, %u next\r\n", label,
+               (unsigned int)LMIC.seqnoUp, (unsigned int)next);
+        failures++;
+    }
+    queue_t q = capture( );
+    if( memcmp( &q, before, sizeof( q ) ) != 0 && memcmp( &q, after, sizeof( q ) ) != 0 ) {
+        printf("FAIL: %s: %u samples restored, %u or %u pending\r\n", label,
+               q.count, before->count, after->count);
+        failures++;
+    }
+}// end of reboot function.
+
+/*
+ * records function of type unsigned int.
+ *
+ * Input parameters: None
+ * Return: number of written slots in the journal.
+ */
+static u4_t records (void) {
+    u1_t slot[PERSIST_RECORD_SIZE];
+    u4_t n = 0;
+
+    for( u4_t addr = base; addr < base + PERSIST_SECTORS * sectorSize; addr += PERSIST_RECORD_SIZE ) {
+        flash.read( slot, addr, PERSIST_RECORD_SIZE );
+        for( u1_t i = 0; i < PERSIST_RECORD_SIZE; i++ ) {
+            if( slot[i] != 0xFF ) {
+                n++;
+                break;
+            }
+        }
+    }
+    return n;
+}// end of records function.
+
+/*
+ * testWrap function of type void.
+ *
+ * Input parameters: None
+ */
+static void testWrap (void) {
+    u4_t erases[PERSIST_SECTORS];
+    u4_t least = 0xFFFFFFFF;
+    u4_t most = 0;
+
+    wipe( );
+    for( u1_t k = 0; k < PERSIST_SECTORS; k++ ) {
+        erases[k] = sim_flashErases( base + k * sectorSize );
+    }
+    join( );
+    for( u4_t i = 1; i <= WRAP_SLOTS; i++ ) {
+        slot( );
+        if( i % REBOOT_EVERY == 0 ) {
+            queue_t q = capture( );
+            reboot( "wrap", &q, &q );
+        }
+    }
+    for( u1_t k = 0; k < PERSIST_SECTORS; k++ ) {
+        u4_t n = sim_flashErases( base + k * sectorSize ) - erases[k];
+        least = n < least ? n : least;
+        most = n > most ? n : most;
+    }
+    printf("Wrap: %u slots, %u to %u erases per sector\r\n",
+           (unsigned int)WRAP_SLOTS, (unsigned int)least, (unsigned int)most);
+    if( least < 2 || most - least > 1 ) {
+        printf("FAIL: sectors not erased evenly\r\n");
+        failures++;
+    }
+}// end of testWrap function.
+
+/*
+ * testReservation function of type void.
+ *
+ * Input parameters: None
+ */
+static void testReservation (void) {
+    wipe( );
+    join( );
+    u4_t written = records( );
+    for( u4_t i = 0; i < 10 * PERSIST_SEQNO_STEP; i++ ) {
+        LMIC.seqnoUp++;
+        persist_checkpoint( );
+    }
+    written = records( ) - written;
+    printf("Reservation: %u records for %u uplinks\r\n",
+           (unsigned int)written, (unsigned int)( 10 * PERSIST_SEQNO_STEP ));
+    if( written != 10 ) {
+        printf("FAIL: expected one record every %u uplinks\r\n", PERSIST_SEQNO_STEP);
+        failures++;
+    }
+    queue_t q = capture( );
+    reboot( "reservation", &q, &q );
+}// end of testReservation function.
+
+/*
+ * testPowerLoss function of type void.
+ *
+ * Input parameters: None
+ */
+static void testPowerLoss (void) {
+    u4_t before = failures;
+
+    for( u4_t cut = 1; cut <= CUT_OPS; cut++ ) {
+        wipe( );
+        join( );
+        for( u4_t i = 0; i < PRELUDE_SLOTS; i++ ) {
+            slot( );
+        }
+        queue_t committed;
+        queue_t attempted;
+        sim_flashCut( cut );
+        do {
+            committed = capture( );
+            slot( );
+            attempted = capture( );
+        } while( !sim_flashLost( ) );
+        sim_flashCut( 0 );
+        reboot( "power loss", &committed, &attempted );
+
+        for( u4_t i = 0; i < AFTER_SLOTS; i++ ) {
+            slot( );
+        }
+        queue_t q = capture( );
+        reboot( "after power loss", &q, &q );
+    }
+    printf("Power loss: %u erases and programs cut, %u failures\r\n",
+           (unsigned int)CUT_OPS, (unsigned int)( failures - before ));
+}// end of testPowerLoss function.
+
+/*
+ * main function of type integer.
+ *
+ * Input parameters: integer argc.
+ *                   char **argv.
+ * Return: 0 if every check passed, 1 otherwise.
+ */
+int main (int argc, char** argv) {
+    (void)argc;
+    (void)argv;
+
+    testWrap( );
+    testReservation( );
+    testPowerLoss( );
+
+    printf("Flash journal: %s\r\n", failures ? "FAILED" : "passed");
+    return failures != 0;
+}// end of main function.
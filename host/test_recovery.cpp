@@ -0,0 +1,134 @@
+/*******************************************************************************
+ * Internet of Things (IoT) smart monitoring
+ * device for agriculture using LoRaWAN technology.
+ *
+ * Host test of the fault recovery restart path.
+ *
+ * - Runs the node (main.cpp) built with FAULT_INJECT 1 (assertion) or 2
+ * (hang, caught by the host watchdog after RECOVERY_TIMEOUT of wall-clock
+ * time) for one simulated hour. recovery_fail jumps back to the restart
+ * point in main (sigsetjmp), standing in for the MCU reset.
+ *
+ * - Every DHT11 read returns a new temperature, so that each telemetry
+ * uplink tells which sample it carries.
+ *
+ * - Fails unless the node restarted exactly once, the crash record survived
+ * the restart (recovery_count), the sample queued by the faulting slot went
+ * on air after the restart, no sample went on air twice or out of order, and
+ * the uplink slots carried on after the restart.
+ *
+ * Usage: test_recovery
+ *
+ *******************************************************************************/
+#undef main
+
+#include "mbed.h"
+#include "lmic.h"
+#include "config.h"
+#include "recovery.h"
+#include "sim.h"
+
+// Node entry point (main.cpp built with -Dmain=node_main).
+int node_main (int argc, char** argv);
+
+// Simulated run time in seconds.
+#define RUN_TIME 3600
+
+// Telemetry port (SEE main.cpp).
+#define TELEMETRY_PORT 1
+
+// Temperature of the first DHT11 read and step per read (Celsius * 100).
+#define TEMPERATURE_START 500
+#define TEMPERATURE_STEP 25
+
+static s2_t temperature = TEMPERATURE_START - TEMPERATURE_STEP;
+static s2_t faultTemperature = 0;   // Latest reading before the restart.
+static s2_t lastSent = -32768;      // Temperature of the last telemetry uplink.
+static bit_t faultSent = 0;         // Sample of the faulting slot sent after the restart.
+static u4_t sentAfter = 0;          // Telemetry uplinks after the restart.
+static u4_t failures = 0;
+
+/*
+ * onRead function of type void.
+ *
+ * Sensor read hook: every DHT11 read returns the next temperature.
+ *
+ * Input parameters: PinName pin
+ *                   int value
+ */
+static void onRead (PinName pin, int value) {
+    (void)value;
+
+    if( pin != D6 ) {
+        return;
+    }
+    temperature += TEMPERATURE_STEP;
+    sim_setDht( temperature / 100.0f, 48.0f, 0 );
+    if( sim_boots( ) == 1 ) {
+        faultTemperature = temperature;
+    }
+}// end of onRead function.
+
+/*
+ * onUplink function of type void.
+ *
+ * Uplink hook: follows the samples carried by the telemetry uplinks.
+ *
+ * Input parameters: unsigned char port
+ *                   const unsigned char data
+ *                   unsigned char len
+ */
+static void onUplink (u1_t port, const u1_t* data, u1_t len) {
+    if( port != TELEMETRY_PORT || len < 2 ) {
+        return;
+    }
+    s2_t t = (s2_t)( ( data[0] << 8 ) | data[1] );
+    if( t <= lastSent ) {
+        printf("FAIL: sample of %d sent after the one of %d\r\n", t, lastSent);
+        failures++;
+    }
+    lastSent = t;
+    if( sim_boots( ) > 1 ) {
+        sentAfter++;
+        faultSent |= ( t == faultTemperature );
+    }
+}// end of onUplink function.
+
+/*
+ * main function of type integer.
+ *
+ * Input parameters: integer argc.
+ *                   char **argv.
+ * Return: 0 if every check passed, 1 otherwise.
+ */
+int main (int argc, char** argv) {
+    (void)argc;
+    (void)argv;
+
+    // Wet soil, daylight: no alarms.
+    sim_setAnalog( A1, 20000 );
+    sim_setAnalog( A3, 30000 );
+    sim_onRead( onRead );
+    sim_onUplink( onUplink );
+    sim_run( node_main, (uint64_t)RUN_TIME * 1000000 );
+    sim_onRead( NULL );
+    sim_onUplink( NULL );
+
+    printf("%u boots, %u recoveries, %u telemetry uplinks after the restart\r\n",
+           (unsigned int)sim_boots( ), (unsigned int)recovery_count( ), (unsigned int)sentAfter);
+    if( sim_boots( ) != 2 || recovery_count( ) != 1 ) {
+        printf("FAIL: expected one restart and one recovery\r\n");
+        failures++;
+    }
+    if( !faultSent ) {
+        printf("FAIL: sample of %d queued at the fault not sent after the restart\r\n", faultTemperature);
+        failures++;
+    }
+    if( sentAfter < RUN_TIME / TRANSMIT_INTERVAL - FAULT_INJECT_SLOT - 2 ) {
+        printf("FAIL: uplink slots did not carry on after the restart\r\n");
+        failures++;
+    }
+
+    printf("Recovery (FAULT_INJECT %d): %s\r\n", FAULT_INJECT, failures ? "FAILED" : "passed");
+    return failures != 0;
+}// end of main function.
@@ -0,0 +1,337 @@
+/*******************************************************************************
+ * Internet of Things (IoT) smart monitoring
+ * device for agriculture using LoRaWAN technology.
+ *
+ * Host test of the SX1272 register shadow (regcache.cpp).
+ *
+ * - Runs regcache_benchmark on 1 to 8 channels; every run must leave the
+ * mock radio with the same registers with and without the shadow.
+ *
+ * - Fuzzes the shadow: the same random sequence of single and burst register
+ * reads and writes, RegOpMode changes (LoRa and FSK register pages) and
+ * radio resets goes to two mock SX1272, once straight through and once
+ * through the shadow. Registers the radio changes on its own return a new
+ * value at every step. Every byte read and the final registers of both
+ * radios must match, and no byte may reach a radio while NSS is high.
+ *
+ * Usage: test_regcache [steps [seed]]
+ *
+ *******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "lmic.h"
+#include "regcache.h"
+
+// Uplinks of every regcache_benchmark run.
+#define BENCH_UPLINKS 100
+
+// Default fuzz steps and seed.
+#define FUZZ_STEPS 200000
+#define FUZZ_SEED 1
+
+// Longest burst in bytes.
+#define FUZZ_BURST 6
+
+#define REG_FIFO         0x00
+#define REG_OPMODE       0x01
+#define OPMODE_LORA      0x80
+
+/*
+ * mock_t structure.
+ *
+ * Mock SX1272: both register pages, the FIFO and the SPI frame state.
+ */
+typedef struct {
+    u1_t page[2][128];    // FSK and LoRa register pages (RegOpMode shared).
+    u1_t fifo[256];
+    u1_t opmode;
+    bit_t selected;       // NSS low.
+    u1_t index;           // Byte position within the present frame.
+    u1_t addr;            // Address byte of the present frame.
+    u4_t strays;          // Bytes clocked while NSS is high.
+} mock_t;
+
+static mock_t mocks[2];
+static regcache_t caches[2];
+static u4_t step = 0;     // Fuzz step, the clock of the self-changing registers.
+
+// Configuration registers of LMiC's sequences, for shadow hits.
+static const u1_t CONFIG[] = { 0x06, 0x07, 0x08, 0x09, 0x0C, 0x0E, 0x11, 0x1D,
+                               0x1E, 0x1F, 0x22, 0x23, 0x33, 0x39, 0x40, 0x5A };
+
+// Registers of the LoRa page the radio changes on its own.
+static const u1_t LIVE[] = { 0x10, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17, 0x18,
+                             0x19, 0x1A, 0x1B, 0x1C, 0x25, 0x28, 0x29, 0x2A, 0x2C };
+
+// Values written, few so that writes often repeat the register.
+static const u1_t VALUES[] = { 0x00, 0x34, 0x72, 0x74, 0x94, 0xFF };
+
+/*
+ * live function of type bit_t.
+ *
+ * Input parameters: unsigned char reg
+ * Return: 1 if the radio changes reg on its own in LoRa mode.
+ */
+static bit_t live (u1_t reg) {
+    for( u1_t i = 0; i < sizeof( LIVE ); i++ ) {
+        if( LIVE[i] == reg ) {
+            return 1;
+        }
+    }
+    return 0;
+}// end of live function.
+
+/*
+ * mockReset function of type void.
+ *
+ * Power-on state: FSK standby, every register holding a known value.
+ *
+ * Input parameters: mock_t m
+ */
+static void mockReset (mock_t* m) {
+    for( u1_t p = 0; p < 2; p++ ) {
+        for( u1_t r = 0; r < 128; r++ ) {
+            m->page[p][r] = (u1_t)( r * 7 + p * 13 );
+        }
+    }
+    memset( m->fifo, 0, sizeof( m->fifo ) );
+    m->opmode = 0x01;
+    m->selected = 0;
+    m->index = 0;
+}// end of mockReset function.
+
+/*
+ * mockNss function of type void.
+ *
+ * Input parameters: mock_t m
+ *                   unsigned char val
+ */
+static void mockNss (mock_t* m, u1_t val) {
+    m->selected = val == 0;
+    m->index = 0;
+}// end of mockNss function.
+
+/*
+ * mockBus function of type unsigned char.
+ *
+ * Input parameters: mock_t m
+ *                   unsigned char out
+ * Return: byte received.
+ */
+static u1_t mockBus (mock_t* m, u1_t out) {
+    bit_t lora = ( m->opmode & OPMODE_LORA ) != 0;
+    u1_t* regs = m->page[lora];
+
+    if( !m->selected ) {
+        m->strays++;
+        return 0xFF;
+    }
+    if( m->index++ == 0 ) {
+        m->addr = out;
+        return 0;
+    }
+    bit_t write = ( m->addr & 0x80 ) != 0;
+    u1_t reg = m->addr & 0x7F;
+    if( reg == REG_FIFO && lora ) {
+        if( write ) {
+            m->fifo[regs[0x0D]++] = out;
+            return 0;
+        }
+        return m->fifo[regs[0x0D]++];
+    }
+    reg = ( reg + m->index - 2 ) & 0x7F;
+    if( reg == REG_OPMODE ) {
+        if( write ) {
+            m->opmode = out;
+        }
+        return write ? 0 : m->opmode;
+    }
+    if( write ) {
+        regs[reg] = out;
+        return 0;
+    }
+    if( lora && live( reg ) ) {
+        return (u1_t)( ( step * 131 + reg * 29 ) >> 3 );
+    }
+    return regs[reg];
+}// end of mockBus function.
+
+/*
+ * nss0, nss1, bus0 and bus1 functions: callbacks of both mock radios.
+ */
+static void nss0 (u1_t val) {
+    mockNss( &mocks[0], val );
+}// end of nss0 function.
+
+static void nss1 (u1_t val) {
+    mockNss( &mocks[1], val );
+}// end of nss1 function.
+
+static u1_t bus0 (u1_t out) {
+    return mockBus( &mocks[0], out );
+}// end of bus0 function.
+
+static u1_t bus1 (u1_t out) {
+    return mockBus( &mocks[1], out );
+}// end of bus1 function.
+
+/*
+ * fuzzRandom function of type unsigned int.
+ *
+ * Input parameters: unsigned int seed
+ * Return: next pseudo-random value, deterministic across runs.
+ */
+static u4_t fuzzRandom (u4_t* seed) {
+    *seed = *seed * 1664525 + 1013904223;
+    return *seed >> 8;
+}// end of fuzzRandom function.
+
+/*
+ * frame function of type unsigned int.
+ *
+ * Sends one SPI frame through both caches.
+ *
+ * Input parameters: unsigned char addr (address byte, 0x80 set to write)
+ *                   const unsigned char data (bytes written)
+ *                   unsigned char len
+ * Return: number of bytes read differently through both caches.
+ */
+static u4_t frame (u1_t addr, const u1_t* data, u1_t len) {
+    u1_t in[2][FUZZ_BURST];
+    u4_t mismatches = 0;
+
+    for( u1_t k = 0; k < 2; k++ ) {
+        regcache_select( &caches[k], 0 );
+        regcache_spi( &caches[k], addr );
+        for( u1_t i = 0; i < len; i++ ) {
+            in[k][i] = regcache_spi( &caches[k], ( addr & 0x80 ) ? data[i] : 0x00 );
+        }
+        regcache_select( &caches[k], 1 );
+    }
+    if( ( addr & 0x80 ) == 0 ) {
+        for( u1_t i = 0; i < len; i++ ) {
+            mismatches += in[0][i] != in[1][i];
+        }
+    }
+    return mismatches;
+}// end of frame function.
+
+/*
+ * fuzz function of type unsigned int.
+ *
+ * Input parameters: unsigned int steps
+ *                   unsigned int seed
+ * Return: number of failed checks.
+ */
+static u4_t fuzz (u4_t steps, u4_t seed) {
+    u4_t mismatches = 0;
+    u4_t failures = 0;
+
+    for( u1_t k = 0; k < 2; k++ ) {
+        mockReset( &mocks[k] );
+        mocks[k].strays = 0;
+    }
+    regcache_init( &caches[0], nss0, bus0, 0 );
+    regcache_init( &caches[1], nss1, bus1, 1 );
+    for( step = 0; step < steps; step++ ) {
+        u4_t r = fuzzRandom( &seed );
+        u1_t op = r % 100;
+        u1_t data[FUZZ_BURST] = { 0 };
+        u1_t reg;
+
+        if( op < 2 ) {
+            // Radio reset.
+            for( u1_t k = 0; k < 2; k++ ) {
+                mockReset( &mocks[k] );
+                regcache_invalidate( &caches[k] );
+            }
+            continue;
+        }
+        if( op < 12 ) {
+            // RegOpMode: mostly the same page, sometimes the other one.
+            bit_t lora = ( mocks[0].opmode & OPMODE_LORA ) != 0;
+            if( ( r >> 8 ) % 5 == 0 ) {
+                lora = !lora;
+            }
+            data[0] = ( lora ? OPMODE_LORA : 0 ) | ( ( r >> 12 ) & 0x07 );
+            mismatches += frame( REG_OPMODE | 0x80, data, 1 );
+            continue;
+        }
+        u1_t pick = ( r >> 8 ) % 10;
+        if( pick < 6 ) {
+            reg = CONFIG[( r >> 12 ) % sizeof( CONFIG )];
+        } else if( pick < 8 ) {
+            reg = LIVE[( r >> 12 ) % sizeof( LIVE )];
+        } else if( pick < 9 ) {
+            reg = REG_FIFO;
+        } else {
+            reg = ( r >> 12 ) & 0x7F;
+        }
+        u1_t len = 1;
+        if( op >= 82 ) {
+            len = 2 + ( r >> 20 ) % ( FUZZ_BURST - 1 );
+            if( reg != REG_FIFO && reg + len > 0x80 ) {
+                reg = 0x80 - len;
+            }
+        }
+        if( op < 52 || ( op >= 82 && ( r & 0x80 ) ) ) {
+            for( u1_t i = 0; i < len; i++ ) {
+                data[i] = VALUES[fuzzRandom( &seed ) % sizeof( VALUES )];
+            }
+            mismatches += frame( reg | 0x80, data, len );
+        } else {
+            mismatches += frame( reg, data, len );
+        }
+    }
+
+    bit_t same = mocks[0].opmode == mocks[1].opmode &&
+                 memcmp( mocks[0].page, mocks[1].page, sizeof( mocks[0].page ) ) == 0 &&
+                 memcmp( mocks[0].fifo, mocks[1].fifo, sizeof( mocks[0].fifo ) ) == 0;
+    printf("Fuzz: %u steps, %u bus bytes straight, %u through the shadow (%u writes skipped, %u reads served), %u invalidations\r\n",
+           (unsigned int)steps, (unsigned int)caches[0].busBytes, (unsigned int)caches[1].busBytes,
+           (unsigned int)caches[1].skipped, (unsigned int)caches[1].served,
+           (unsigned int)caches[1].invalidations);
+    if( mismatches != 0 ) {
+        printf("FAIL: %u bytes read differently through the shadow\r\n", (unsigned int)mismatches);
+        failures++;
+    }
+    if( !same ) {
+        printf("FAIL: radio registers differ after the fuzz\r\n");
+        failures++;
+    }
+    if( mocks[0].strays != 0 || mocks[1].strays != 0 ) {
+        printf("FAIL: %u bytes clocked with NSS high\r\n", (unsigned int)( mocks[0].strays + mocks[1].strays ));
+        failures++;
+    }
+    if( caches[1].skipped == 0 || caches[1].served == 0 ) {
+        printf("FAIL: the shadow never skipped a write or served a read\r\n");
+        failures++;
+    }
+    return failures;
+}// end of fuzz function.
+
+/*
+ * main function of type integer.
+ *
+ * Input parameters: integer argc.
+ *                   char **argv.
+ * Return: 0 if every check passed, 1 otherwise.
+ */
+int main (int argc, char** argv) {
+    u4_t steps = argc > 1 ? (u4_t)atol( argv[1] ) : FUZZ_STEPS;
+    u4_t seed = argc > 2 ? (u4_t)atol( argv[2] ) : FUZZ_SEED;
+    u4_t failures = 0;
+
+    for( u1_t channels = 1; channels <= 8; channels++ ) {
+        if( !regcache_benchmark( BENCH_UPLINKS, channels ) ) {
+            printf("FAIL: registers differ on %u channels\r\n", channels);
+            failures++;
+        }
+    }
+    failures += fuzz( steps, seed );
+
+    printf("Register shadow: %s\r\n", failures ? "FAILED" : "passed");
+    return failures != 0;
+}// end of main function.
@@ -0,0 +1,216 @@
+/*******************************************************************************
+ * Internet of Things (IoT) smart monitoring
+ * device for agriculture using LoRaWAN technology.
+ *
+ * Host test of the sensor supply wiring and gating.
+ *
+ * - Runs the node (main.cpp) for two simulated hours and follows every pin
+ * write and sensor read against a model of the board: the pin switching
+ * each sensor supply, the current that pin sources and the current the
+ * sensor draws from the battery while powered.
+ *
+ * - Fails if a supply pin is wired to the SX1272MB2xAS shield, sources more
+ * than a K64F pin can, stays on longer than its sensor's warm-up and read,
+ * if a sensor is read while unpowered, if a pin not in the model is
+ * switched, or if the sensor charge of the energy model (energy.cpp)
+ * differs from the charge drawn through the switched pins.
+ *
+ * Usage: test_sensors
+ *
+ *******************************************************************************/
+#undef main
+
+#include "mbed.h"
+#include "lmic.h"
+#include "config.h"
+#include "energy.h"
+#include "sim.h"
+
+// Node entry point (main.cpp built with -Dmain=node_main).
+int node_main (int argc, char** argv);
+
+// Simulated run time in seconds.
+#define RUN_TIME 7200
+
+// Current a K64F pin can source at normal drive strength in microamperes.
+#define PIN_LIMIT 5000
+
+// Time a supply may stay on beyond its sensor's warm-up in milliseconds:
+// reads plus the delay of a due job.
+#define WINDOW_SLACK 50
+
+/*
+ * supply_t structure.
+ *
+ * One switched sensor supply of the board.
+ */
+typedef struct {
+    PinName pin;        // Supply pin.
+    PinName input;      // Pin the sensor is read on.
+    const char* load;   // What the pin drives.
+    u4_t pinCurrent;    // Current sourced by the pin while on (uA).
+    u4_t railCurrent;   // Current drawn by the sensor while on (uA).
+    u4_t warmup;        // Warm-up of the sensor (ms).
+} supply_t;
+
+static const supply_t BOARD[] = {
+    { D7,   D6, "DHT11",                            1500, 1500,  1000 },
+    { PTC5, A1, "light sensor",                     500,  500,   10   },
+    // TPS22917 enable input leakage is below 0.1 uA.
+    { PTC7, A3, "TPS22917 enable (soil probe rail)", 1,    35000, 100  }
+};
+#define SUPPLIES ( sizeof( BOARD ) / sizeof( BOARD[0] ) )
+
+// Pins of the SX1272MB2xAS shield (SX1272Lib defaults): MOSI, MISO, SCLK,
+// NSS, RESET, DIO0..DIO5 and the antenna switch.
+static const PinName SHIELD[] = { D11, D12, D13, D10, A0, D2, D3, D4, D5, D8, D9, A4 };
+
+// Radio pins driven by hal.cpp.
+static const PinName RADIO[] = { D10, A0, A4 };
+
+static uint64_t onSince[SUPPLIES];
+static uint64_t longest[SUPPLIES];
+static u4_t windows[SUPPLIES];
+static u4_t reads[SUPPLIES];
+static double charge = 0;   // Drawn through the switched supplies (uC).
+static u4_t failures = 0;
+
+/*
+ * findSupply function of type integer.
+ *
+ * Input parameters: PinName pin
+ *                   bit_t input (1 to look pin up as sensor input)
+ * Return: index of the supply of pin, -1 if none.
+ */
+static int findSupply (PinName pin, bit_t input) {
+    for( u1_t i = 0; i < SUPPLIES; i++ ) {
+        if( ( input ? BOARD[i].input : BOARD[i].pin ) == pin ) {
+            return i;
+        }
+    }
+    return -1;
+}// end of findSupply function.
+
+/*
+ * onWrite function of type void.
+ *
+ * Pin write hook: accounts supply windows and their charge.
+ *
+ * Input parameters: PinName pin
+ *                   int value
+ */
+static void onWrite (PinName pin, int value) {
+    int i = findSupply( pin, 0 );
+
+    if( i < 0 ) {
+        for( u1_t r = 0; r < sizeof( RADIO ) / sizeof( RADIO[0] ); r++ ) {
+            if( RADIO[r] == pin ) {
+                return;
+            }
+        }
+        printf("FAIL: %s switched but not in the board model\r\n", sim_pinName( pin ));
+        failures++;
+        return;
+    }
+    if( value && onSince[i] == 0 ) {
+        onSince[i] = sim_now( );
+    } else if( !value && onSince[i] != 0 ) {
+        uint64_t on = sim_now( ) - onSince[i];
+        charge += (double)BOARD[i].railCurrent * on / 1e6;
+        longest[i] = on > longest[i] ? on : longest[i];
+        windows[i]++;
+        onSince[i] = 0;
+    }
+}// end of onWrite function.
+
+/*
+ * onRead function of type void.
+ *
+ * Sensor read hook: the sensor must be powered.
+ *
+ * Input parameters: PinName pin
+ *                   int value
+ */
+static void onRead (PinName pin, int value) {
+    (void)value;
+    int i = findSupply( pin, 1 );
+
+    if( i < 0 ) {
+        return;
+    }
+    reads[i]++;
+    if( !sim_pin( BOARD[i].pin ) ) {
+        printf("FAIL: %s read at %u ms while %s is off\r\n", sim_pinName( pin ),
+               (unsigned int)( sim_now( ) / 1000 ), sim_pinName( BOARD[i].pin ));
+        failures++;
+    }
+}// end of onRead function.
+
+/*
+ * main function of type integer.
+ *
+ * Input parameters: integer argc.
+ *                   char **argv.
+ * Return: 0 if every check passed, 1 otherwise.
+ */
+int main (int argc, char** argv) {
+    (void)argc;
+    (void)argv;
+
+    // Static wiring: off the shield and within the pin drive strength.
+    for( u1_t i = 0; i < SUPPLIES; i++ ) {
+        for( u1_t s = 0; s < sizeof( SHIELD ) / sizeof( SHIELD[0] ); s++ ) {
+            if( BOARD[i].pin == SHIELD[s] ) {
+                printf("FAIL: %s supply %s is a pin of the radio shield\r\n", BOARD[i].load,
+                       sim_pinName( BOARD[i].pin ));
+                failures++;
+            }
+        }
+        if( BOARD[i].pinCurrent > PIN_LIMIT ) {
+            printf("FAIL: %s sources %u uA from %s, over the %u uA pin limit\r\n", BOARD[i].load,
+                   (unsigned int)BOARD[i].pinCurrent, sim_pinName( BOARD[i].pin ), PIN_LIMIT);
+            failures++;
+        }
+    }
+
+    // Wet soil, daylight, mild weather: no alarms.
+    sim_setAnalog( A1, 20000 );
+    sim_setAnalog( A3, 30000 );
+    sim_setDht( 21.5f, 48.0f, 0 );
+    sim_onWrite( onWrite );
+    sim_onRead( onRead );
+    sim_run( node_main, (uint64_t)RUN_TIME * 1000000 );
+    sim_onWrite( NULL );
+    sim_onRead( NULL );
+
+    for( u1_t i = 0; i < SUPPLIES; i++ ) {
+        printf("%-5s %-34s %4u windows, longest %4u ms, %4u reads\r\n", sim_pinName( BOARD[i].pin ),
+               BOARD[i].load, (unsigned int)windows[i], (unsigned int)( longest[i] / 1000 ),
+               (unsigned int)reads[i]);
+        if( windows[i] == 0 || reads[i] == 0 ) {
+            printf("FAIL: %s never switched or read\r\n", BOARD[i].load);
+            failures++;
+        }
+        if( longest[i] > ( BOARD[i].warmup + WINDOW_SLACK ) * 1000ULL ) {
+            printf("FAIL: %s on for %u ms, over its %u ms warm-up plus %u ms\r\n", BOARD[i].load,
+                   (unsigned int)( longest[i] / 1000 ), (unsigned int)BOARD[i].warmup, WINDOW_SLACK);
+            failures++;
+        }
+    }
+
+    // Current model against the switched pins: within 1%.
+    u4_t model = energy_charge( ENERGY_SENSORS );
+    printf("Sensor charge: %u uC through the supply pins, %u uC in the energy model\r\n",
+           (unsigned int)charge, (unsigned int)model);
+    if( model < charge * 0.99 || model > charge * 1.01 ) {
+        printf("FAIL: energy model off by more than 1%%\r\n");
+        failures++;
+    }
+    if( sim_uplinks( ) < RUN_TIME / TRANSMIT_INTERVAL - 1 ) {
+        printf("FAIL: %u uplinks in %u s\r\n", (unsigned int)sim_uplinks( ), RUN_TIME);
+        failures++;
+    }
+
+    printf("Sensor supplies: %s\r\n", failures ? "FAILED" : "passed");
+    return failures != 0;
+}// end of main function.
@@ -0,0 +1,103 @@
+/*******************************************************************************
+ * Internet of Things (IoT) smart monitoring
+ * device for agriculture using LoRaWAN technology.
+ *
+ * Host test of the HAL recorder and replay (trace.cpp).
+ *
+ * - Built with HAL_TRACE 1 (trace_record), runs the node (main.cpp) until
+ * its first uplinks, so that it dumps the HAL events from boot to the first
+ * transmission to the UART (stdout); host/build.sh keeps the output and
+ * turns it into trace_data.h with trace2h.sh.
+ *
+ * - Built with HAL_REPLAY 1 and that trace_data.h (trace_replay), runs the
+ * node on the recorded trace. The node must stop once the trace is over,
+ * having replayed every record without divergence. Time then comes from the
+ * trace alone, so a node running on past it is caught by a CPU time limit.
+ *
+ * - Both runs set the same sensor inputs, as the sample values reach the
+ * radio over SPI.
+ *
+ * Usage: test_trace
+ *
+ *******************************************************************************/
+#undef main
+
+#include <signal.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include "mbed.h"
+#include "lmic.h"
+#include "config.h"
+#include "trace.h"
+#include "sim.h"
+
+// Node entry point (main.cpp built with -Dmain=node_main).
+int node_main (int argc, char** argv);
+
+// Simulated run time in seconds: the first uplinks.
+#define RUN_TIME ( 2 * TRANSMIT_INTERVAL )
+
+// CPU time limit of the replay in seconds.
+#define REPLAY_LIMIT 10
+
+#if HAL_REPLAY == 1
+/*
+ * overrun function of type void.
+ *
+ * SIGVTALRM handler: the replay did not end with the trace.
+ *
+ * Input parameters: int sig
+ */
+static void overrun (int sig) {
+    static const char msg[] = "FAIL: the node ran on past the end of the trace\r\nTrace replay: FAILED\r\n";
+
+    (void)sig;
+    ssize_t n = write( STDOUT_FILENO, msg, sizeof( msg ) - 1 );
+    (void)n;
+    _exit( 1 );
+}// end of overrun function.
+#endif
+
+/*
+ * main function of type integer.
+ *
+ * Input parameters: integer argc.
+ *                   char **argv.
+ * Return: 0 if every check passed, 1 otherwise.
+ */
+int main (int argc, char** argv) {
+    (void)argc;
+    (void)argv;
+
+    // Wet soil, daylight, mild weather: no alarms.
+    sim_setAnalog( A1, 20000 );
+    sim_setAnalog( A3, 30000 );
+    sim_setDht( 21.5f, 48.0f, 0 );
+#if HAL_REPLAY == 1
+    // The virtual clock does not move on replay: bound the CPU time instead
+    // (ITIMER_REAL is the host watchdog of recovery.cpp).
+    struct itimerval limit;
+    memset( &limit, 0, sizeof( limit ) );
+    limit.it_value.tv_sec = REPLAY_LIMIT;
+    signal( SIGVTALRM, overrun );
+    setitimer( ITIMER_VIRTUAL, &limit, NULL );
+#endif
+    int result = sim_run( node_main, (uint64_t)RUN_TIME * 1000000 );
+
+#if HAL_REPLAY == 1
+    if( !trace_replayDone( ) ) {
+        printf("FAIL: the node stopped before the end of the trace\r\n");
+        result = 1;
+    } else if( result != 0 ) {
+        printf("FAIL: the replay diverged from the trace\r\n");
+    }
+    printf("Trace replay: %s\r\n", result ? "FAILED" : "passed");
+#else
+    if( sim_uplinks( ) == 0 ) {
+        printf("FAIL: no uplink, no trace dumped\r\n");
+        result = 1;
+    }
+    printf("Trace record: %s\r\n", result ? "FAILED" : "passed");
+#endif
+    return result != 0;
+}// end of main function.
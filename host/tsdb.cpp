@@ -0,0 +1,678 @@
+/*******************************************************************************
+ * Internet of Things (IoT) smart monitoring
+ * device for agriculture using LoRaWAN technology.
+ *
+ * Append-only columnar time-series store for decoded fleet readings.
+ *
+ * Segments are plain structures mapped from their files; the chains of
+ * segments per node and the sorted node table are rebuilt from the segment
+ * headers when the store is opened.
+ *
+ * SEE tsdb.h file for the description of each function.
+ *
+ *******************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "lmic.h"
+#include "samples.h"
+#include "payload.h"
+#include "tsdb.h"
+#include "bench.h"
+
+// Segment header magic, "TSD1".
+#define TSDB_MAGIC 0x31445354
+
+// Longest varint (32-bit zig-zag value).
+#define VARINT_MAX 5
+
+#define BLOCKS ( ( TSDB_SEGMENT_ROWS + TSDB_BLOCK_ROWS - 1 ) / TSDB_BLOCK_ROWS )
+
+// No segment.
+#define NO_SEGMENT 0xFFFF
+
+// Nodes simulated by tsdb_benchmark at most.
+#define BENCH_FLEET ( TSDB_MAX_NODES < PAYLOAD_BENCH_BATCH ? TSDB_MAX_NODES : PAYLOAD_BENCH_BATCH )
+
+/*
+ * segment_t structure.
+ *
+ * One segment of a node.
+ */
+typedef struct {
+    u4_t magic;           // TSDB_MAGIC.
+    devaddr_t node;       // Node address.
+    u4_t seq;             // Position in the chain of the node.
+    u4_t rows;            // Rows stored.
+    u4_t first;           // Time of the first row.
+    u4_t last;            // Time of the latest row.
+    s4_t delta;           // Latest timestamp delta.
+    u4_t tsBytes;         // Bytes used in the timestamp column.
+    u4_t anchor[BLOCKS];  // Time of the first row of every block.
+    u4_t offset[BLOCKS];  // Timestamp column offset of every block.
+    s2_t values[TSDB_COLUMNS][TSDB_SEGMENT_ROWS];
+    u1_t ts[TSDB_SEGMENT_ROWS * 2];
+} segment_t;
+
+/*
+ * node_t structure.
+ *
+ * First and latest segment of a node.
+ */
+typedef struct {
+    devaddr_t node;
+    u2_t head;
+    u2_t tail;
+} node_t;
+
+static segment_t* segments[TSDB_MAX_SEGMENTS];
+static u2_t nextSegment[TSDB_MAX_SEGMENTS];
+static u2_t segmentCount = 0;
+static node_t nodes[TSDB_MAX_NODES];
+static u2_t nodeCount = 0;
+
+static char root[PATH_MAX];
+
+/*
+ * putVarint function of type unsigned char.
+ *
+ * Input parameters: unsigned char p
+ *                   unsigned int v
+ * Return: bytes written.
+ */
+static inline u1_t putVarint (u1_t* p, u4_t v) {
+    u1_t n = 0;
+
+    while( v >= 0x80 ) {
+        p[n++] = (u1_t)( v | 0x80 );
+        v >>= 7;
+    }
+    p[n++] = (u1_t)v;
+    return n;
+}// end of putVarint function.
+
+/*
+ * getVarint function of type unsigned int.
+ *
+ * Input parameters: const unsigned char p (advanced past the value)
+ * Return: value read.
+ */
+static inline u4_t getVarint (const u1_t** p) {
+    u4_t v = 0;
+    u1_t shift = 0;
+    u1_t b;
+
+    do {
+        b = *( *p )++;
+        v |= (u4_t)( b & 0x7F ) << shift;
+        shift += 7;
+    } while( b & 0x80 );
+    return v;
+}// end of getVarint function.
+
+/*
+ * findNode function of type node_t pointer.
+ *
+ * Binary search of the sorted node table.
+ *
+ * Input parameters: devaddr_t node
+ *                   unsigned short at (insertion index when not found)
+ * Return: node or NULL.
+ */
+static node_t* findNode (devaddr_t node, u2_t* at) {
+    u2_t lo = 0, hi = nodeCount;
+
+    while( lo < hi ) {
+        u2_t mid = ( lo + hi ) / 2;
+        if( nodes[mid].node < node ) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    if( at != NULL ) {
+        *at = lo;
+    }
+    return lo < nodeCount && nodes[lo].node == node ? &nodes[lo] : NULL;
+}// end of findNode function.
+
+/*
+ * addNode function of type node_t pointer.
+ *
+ * Input parameters: devaddr_t node
+ * Return: node, added if new, or NULL if the table is full.
+ */
+static node_t* addNode (devaddr_t node) {
+    u2_t at;
+    node_t* n = findNode( node, &at );
+
+    if( n != NULL ) {
+        return n;
+    }
+    if( nodeCount == TSDB_MAX_NODES ) {
+        return NULL;
+    }
+    memmove( &nodes[at + 1], &nodes[at], ( nodeCount - at ) * sizeof( nodes[0] ) );
+    nodeCount++;
+    nodes[at].node = node;
+    nodes[at].head = nodes[at].tail = NO_SEGMENT;
+    return &nodes[at];
+}// end of addNode function.
+
+/*
+ * linkSegment function of type bit_t.
+ *
+ * Adds a mapped segment to the chain of its node, in sequence order.
+ *
+ * Input parameters: unsigned short idx
+ * Return: 1 on success, 0 if the node table is full.
+ */
+static bit_t linkSegment (u2_t idx) {
+    node_t* n = addNode( segments[idx]->node );
+    u2_t* p;
+
+    if( n == NULL ) {
+        return 0;
+    }
+    p = &n->head;
+    while( *p != NO_SEGMENT && segments[*p]->seq < segments[idx]->seq ) {
+        p = &nextSegment[*p];
+    }
+    nextSegment[idx] = *p;
+    *p = idx;
+    if( nextSegment[idx] == NO_SEGMENT ) {
+        n->tail = idx;
+    }
+    return 1;
+}// end of linkSegment function.
+
+/*
+ * mapSegment function of type segment_t pointer.
+ *
+ * Input parameters: devaddr_t node
+ *                   unsigned int seq
+ * Return: new empty segment or NULL.
+ */
+static segment_t* mapSegment (devaddr_t node, u4_t seq) {
+    char path[PATH_MAX];
+    int len = snprintf( path, sizeof( path ), "%s/%08X-%04u.seg", root, (unsigned int)node, (unsigned int)seq );
+    if( len < 0 || len >= (int)sizeof( path ) ) {
+        return NULL;
+    }
+    int fd = open( path, O_RDWR | O_CREAT | O_TRUNC, 0644 );
+    if( fd < 0 ) {
+        return NULL;
+    }
+    if( ftruncate( fd, sizeof( segment_t ) ) != 0 ) {
+        close( fd );
+        return NULL;
+    }
+    void* m = mmap( NULL, sizeof( segment_t ), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 );
+    close( fd );
+    if( m == MAP_FAILED ) {
+        return NULL;
+    }
+    segment_t* s = (segment_t*)m;
+    memset( s, 0, offsetof( segment_t, values ) );
+    s->node = node;
+    s->seq = seq;
+    s->magic = TSDB_MAGIC;
+    return s;
+}// end of mapSegment function.
+
+/*
+ * tsdb_open function of type bit_t.
+ *
+ * Input parameters: const char dir
+ *                   bit_t fresh
+ * Return: 1 on success, 0 otherwise.
+ *
+ */
+bit_t tsdb_open (const char* dir, bit_t fresh) {
+    DIR* d;
+    struct dirent* e;
+
+    segmentCount = 0;
+    nodeCount = 0;
+    if( strlen( dir ) >= sizeof( root ) ) {
+        return 0;
+    }
+    strcpy( root, dir );
+    mkdir( root, 0755 );
+    d = opendir( root );
+    if( d == NULL ) {
+        return 0;
+    }
+    while( ( e = readdir( d ) ) != NULL ) {
+        char path[PATH_MAX];
+        size_t len = strlen( e->d_name );
+        if( len < 4 || strcmp( e->d_name + len - 4, ".seg" ) != 0 ) {
+            continue;
+        }
+        int n = snprintf( path, sizeof( path ), "%s/%s", root, e->d_name );
+        if( n < 0 || n >= (int)sizeof( path ) ) {
+            continue;
+        }
+        if( fresh ) {
+            unlink( path );
+            continue;
+        }
+        int fd = open( path, O_RDWR );
+        if( fd < 0 ) {
+            continue;
+        }
+        struct stat st;
+        void* m = MAP_FAILED;
+        if( fstat( fd, &st ) == 0 && st.st_size == (off_t)sizeof( segment_t ) ) {
+            m = mmap( NULL, sizeof( segment_t ), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 );
+        }
+        close( fd );
+        if( m == MAP_FAILED ) {
+            continue;
+        }
+        if( ( (segment_t*)m )->magic != TSDB_MAGIC || segmentCount == TSDB_MAX_SEGMENTS ) {
+            munmap( m, sizeof( segment_t ) );
+            continue;
+        }
+        segments[segmentCount] = (segment_t*)m;
+        if( linkSegment( segmentCount ) ) {
+            segmentCount++;
+        } else {
+            munmap( m, sizeof( segment_t ) );
+        }
+    }
+    closedir( d );
+    return 1;
+}// end of tsdb_open function.
+
+/*
+ * tsdb_close function of type void.
+ *
+ * Input parameters: None
+ *
+ */
+void tsdb_close (void) {
+    for( u2_t i = 0; i < segmentCount; i++ ) {
+        munmap( segments[i], sizeof( segment_t ) );
+    }
+    segmentCount = 0;
+    nodeCount = 0;
+}// end of tsdb_close function.
+
+/*
+ * tsdb_append function of type bit_t.
+ *
+ * Input parameters: devaddr_t node
+ *                   unsigned int time
+ *                   const short values
+ * Return: 1 if stored, 0 otherwise.
+ *
+ */
+bit_t tsdb_append (devaddr_t node, u4_t time, const s2_t* values) {
+    node_t* n = addNode( node );
+    segment_t* s;
+    u4_t row;
+
+    if( n == NULL ) {
+        return 0;
+    }
+    s = n->tail != NO_SEGMENT ? segments[n->tail] : NULL;
+    if( s != NULL && s->rows != 0 && time < s->last ) {
+        return 0;
+    }
+    // Next segment once the rows or the timestamp column run out.
+    if( s == NULL || s->rows == TSDB_SEGMENT_ROWS || s->tsBytes + VARINT_MAX > sizeof( s->ts ) ) {
+        if( segmentCount == TSDB_MAX_SEGMENTS ) {
+            return 0;
+        }
+        segment_t* next = mapSegment( node, s != NULL ? s->seq + 1 : 0 );
+        if( next == NULL ) {
+            return 0;
+        }
+        segments[segmentCount] = next;
+        linkSegment( segmentCount++ );
+        s = next;
+    }
+    row = s->rows;
+    if( row % TSDB_BLOCK_ROWS == 0 ) {
+        // Block start: absolute anchor, delta-of-delta restarts.
+        s->anchor[row / TSDB_BLOCK_ROWS] = time;
+        s->offset[row / TSDB_BLOCK_ROWS] = s->tsBytes;
+        s->delta = 0;
+    } else {
+        s4_t delta = (s4_t)( time - s->last );
+        s4_t dod = delta - s->delta;
+        s->tsBytes += putVarint( s->ts + s->tsBytes, ( (u4_t)dod << 1 ) ^ (u4_t)( dod >> 31 ) );
+        s->delta = delta;
+    }
+    for( u1_t c = 0; c < TSDB_COLUMNS; c++ ) {
+        s->values[c][row] = values[c];
+    }
+    if( row == 0 ) {
+        s->first = time;
+    }
+    s->last = time;
+    // The row becomes visible last.
+    s->rows = row + 1;
+    return 1;
+}// end of tsdb_append function.
+
+/*
+ * tsdb_ingest function of type unsigned int.
+ *
+ * Input parameters: const devaddr_t nodeAddr
+ *                   const unsigned int times
+ *                   const payload_columns_t cols
+ *                   unsigned int count
+ * Return: number of rows stored.
+ *
+ */
+u4_t tsdb_ingest (const devaddr_t* nodeAddr, const u4_t* times, const payload_columns_t* cols, u4_t count) {
+    u4_t stored = 0;
+
+    for( u4_t i = 0; i < count; i++ ) {
+        s2_t values[TSDB_COLUMNS] = { cols->temperature[i], cols->humidity[i], cols->light[i], cols->soil[i] };
+        stored += tsdb_append( nodeAddr[i], times[i], values );
+    }
+    return stored;
+}// end of tsdb_ingest function.
+
+/*
+ * decodeBlock function of type unsigned int.
+ *
+ * Decodes the timestamps of one block up to the segment's last row.
+ *
+ * Input parameters: const segment_t s
+ *                   unsigned int block
+ *                   unsigned int times (TSDB_BLOCK_ROWS entries)
+ * Return: rows decoded.
+ */
+static u4_t decodeBlock (const segment_t* s, u4_t block, u4_t* times) {
+    const u1_t* p = s->ts + s->offset[block];
+    u4_t start = block * TSDB_BLOCK_ROWS;
+    u4_t n = s->rows - start < TSDB_BLOCK_ROWS ? s->rows - start : TSDB_BLOCK_ROWS;
+    u4_t t = s->anchor[block];
+    s4_t delta = 0;
+
+    times[0] = t;
+    for( u4_t i = 1; i < n; i++ ) {
+        u4_t z = getVarint( &p );
+        delta += (s4_t)( z >> 1 ) ^ -(s4_t)( z & 1 );
+        t += delta;
+        times[i] = t;
+    }
+    return n;
+}// end of decodeBlock function.
+
+/*
+ * findRow function of type unsigned int.
+ *
+ * Input parameters: const segment_t s
+ *                   unsigned int t
+ * Return: first row of the segment at or after time t (rows if none).
+ */
+static u4_t findRow (const segment_t* s, u4_t t) {
+    u4_t times[TSDB_BLOCK_ROWS];
+    u4_t blocks = ( s->rows + TSDB_BLOCK_ROWS - 1 ) / TSDB_BLOCK_ROWS;
+    u4_t lo = 0, hi = blocks;
+
+    if( s->rows == 0 || t > s->last ) {
+        return s->rows;
+    }
+    if( t <= s->first ) {
+        return 0;
+    }
+    // Last block anchored at or before t.
+    while( hi - lo > 1 ) {
+        u4_t mid = ( lo + hi ) / 2;
+        if( s->anchor[mid] <= t ) {
+            lo = mid;
+        } else {
+            hi = mid;
+        }
+    }
+    u4_t n = decodeBlock( s, lo, times );
+    for( u4_t i = 0; i < n; i++ ) {
+        if( times[i] >= t ) {
+            return lo * TSDB_BLOCK_ROWS + i;
+        }
+    }
+    return ( lo + 1 ) * TSDB_BLOCK_ROWS;
+}// end of findRow function.
+
+/*
+ * aggregateColumn function of type void.
+ *
+ * Adds n values to an aggregate, two at a time.
+ *
+ * Input parameters: const short v
+ *                   unsigned int n
+ *                   tsdb_agg_t agg
+ */
+static void aggregateColumn (const s2_t* v, u4_t n, tsdb_agg_t* agg) {
+    u4_t i = 0;
+    s2_t mn = agg->count ? agg->min : 32767;
+    s2_t mx = agg->count ? agg->max : -32768;
+    long long sum = 0, sumSq = 0;
+
+    for( ; i + 2 <= n; i += 2 ) {
+        s4_t a = v[i], b = v[i + 1];
+        sum += a + b;
+        sumSq += (long long)( a * a ) + b * b;
+        mn = a < mn ? a : mn;
+        mn = b < mn ? b : mn;
+        mx = a > mx ? a : mx;
+        mx = b > mx ? b : mx;
+    }
+    agg->sum += sum;
+    agg->sumSq += sumSq;
+    // Odd value left over.
+    for( ; i < n; i++ ) {
+        agg->sum += v[i];
+        agg->sumSq += (s4_t)v[i] * v[i];
+        mn = v[i] < mn ? v[i] : mn;
+        mx = v[i] > mx ? v[i] : mx;
+    }
+    agg->min = mn;
+    agg->max = mx;
+    agg->count += n;
+}// end of aggregateColumn function.
+
+/*
+ * tsdb_aggregate function of type bit_t.
+ *
+ * Input parameters: devaddr_t node
+ *                   unsigned int from
+ *                   unsigned int to
+ *                   unsigned char column
+ *                   tsdb_agg_t agg
+ * Return: 1 if the range holds any row, 0 otherwise.
+ *
+ */
+bit_t tsdb_aggregate (devaddr_t node, u4_t from, u4_t to, u1_t column, tsdb_agg_t* agg) {
+    node_t* n = findNode( node, NULL );
+
+    memset( agg, 0, sizeof( *agg ) );
+    if( n == NULL || column >= TSDB_COLUMNS ) {
+        return 0;
+    }
+    for( u2_t idx = n->head; idx != NO_SEGMENT; idx = nextSegment[idx] ) {
+        const segment_t* s = segments[idx];
+        if( s->rows == 0 || s->last < from ) {
+            continue;
+        }
+        if( s->first >= to ) {
+            break;
+        }
+        // The rows in range are one contiguous slice of the column.
+        u4_t r0 = findRow( s, from );
+        u4_t r1 = findRow( s, to );
+        if( r1 > r0 ) {
+            aggregateColumn( s->values[column] + r0, r1 - r0, agg );
+        }
+    }
+    return agg->count != 0;
+}// end of tsdb_aggregate function.
+
+/*
+ * tsdb_read function of type unsigned int.
+ *
+ * Input parameters: devaddr_t node
+ *                   unsigned int from
+ *                   unsigned int to
+ *                   unsigned char column
+ *                   unsigned int times
+ *                   short values
+ *                   unsigned int max
+ * Return: number of rows copied.
+ *
+ */
+u4_t tsdb_read (devaddr_t node, u4_t from, u4_t to, u1_t column, u4_t* times, s2_t* values, u4_t max) {
+    node_t* n = findNode( node, NULL );
+    u4_t copied = 0;
+    u4_t block[TSDB_BLOCK_ROWS];
+
+    if( n == NULL || column >= TSDB_COLUMNS ) {
+        return 0;
+    }
+    for( u2_t idx = n->head; idx != NO_SEGMENT && copied < max; idx = nextSegment[idx] ) {
+        const segment_t* s = segments[idx];
+        if( s->rows == 0 || s->last < from ) {
+            continue;
+        }
+        if( s->first >= to ) {
+            break;
+        }
+        u4_t r = findRow( s, from );
+        u4_t end = findRow( s, to );
+        while( r < end && copied < max ) {
+            // Decode the block holding row r and copy its rows in range.
+            u4_t b = r / TSDB_BLOCK_ROWS;
+            u4_t rows = decodeBlock( s, b, block );
+            for( u4_t i = r - b * TSDB_BLOCK_ROWS; i < rows && r < end && copied < max; i++, r++ ) {
+                times[copied] = block[i];
+                values[copied++] = s->values[column][r];
+            }
+        }
+    }
+    return copied;
+}// end of tsdb_read function.
+
+/*
+ * fleetValue function of type short.
+ *
+ * Input parameters: unsigned short node
+ *                   unsigned int row
+ *                   unsigned char column
+ * Return: simulated reading of a node.
+ */
+static s2_t fleetValue (u2_t node, u4_t row, u1_t column) {
+    static const s2_t BASE[TSDB_COLUMNS] = { 1500, 5500, 250, 180 };
+    // A daily swing of +-5 units (at 5-minute rows) plus a node offset.
+    s4_t swing = (s4_t)( ( row + node * 7 ) % 288 ) - 144;
+    return (s2_t)( BASE[column] + node % 50 * ( column + 1 ) + swing * ( column == TSDB_TEMPERATURE ? 7 : 3 ) );
+}// end of fleetValue function.
+
+/*
+ * tsdb_benchmark function of type unsigned int.
+ *
+ * Input parameters: unsigned short fleet
+ *                   unsigned short days
+ *                   unsigned short interval
+ * Return: number of mismatches, 1 if the store cannot be opened.
+ *
+ */
+u4_t tsdb_benchmark (u2_t fleet, u2_t days, u2_t interval) {
+    static u1_t frames[BENCH_FLEET * PAYLOAD_FRAME_LENGTH];
+    static s2_t temperature[BENCH_FLEET];
+    static s2_t humidity[BENCH_FLEET];
+    static s2_t light[BENCH_FLEET];
+    static s2_t soil[BENCH_FLEET];
+    static devaddr_t addr[BENCH_FLEET];
+    static u4_t times[BENCH_FLEET];
+    const payload_columns_t cols = { temperature, humidity, light, soil };
+    const u4_t BASE_TIME = 1700000000;
+    u4_t rows, stored = 0, elapsed = 0, mismatches = 0;
+    unsigned long long tsBytes = 0;
+
+    rows = interval != 0 ? (u4_t)days * 86400 / interval : 0;
+    if( fleet == 0 || fleet > BENCH_FLEET || rows == 0 ) {
+        return 0;
+    }
+    if( !tsdb_open( TSDB_BENCH_DIR, 1 ) ) {
+        printf("TSDB: cannot open %s\r\n", TSDB_BENCH_DIR);
+        return 1;
+    }
+    // One uplink of every node per interval, with a few seconds of jitter.
+    for( u4_t r = 0; r < rows; r++ ) {
+        for( u2_t i = 0; i < fleet; i++ ) {
+            sample_t sample;
+            sample.temperature = fleetValue( i, r, TSDB_TEMPERATURE );
+            sample.humidity = fleetValue( i, r, TSDB_HUMIDITY );
+            sample.light = fleetValue( i, r, TSDB_LIGHT );
+            sample.soil = fleetValue( i, r, TSDB_SOIL );
+            sample.taken = 0;
+            samples_encode( &sample, frames + i * PAYLOAD_FRAME_LENGTH );
+            addr[i] = 0x26010000 + i;
+            times[i] = BASE_TIME + r * interval + ( r * 31 + i ) % 5;
+        }
+        u4_t start = bench_micros( );
+        payload_decodeBatch( frames, fleet, PAYLOAD_FRAME_LENGTH, &cols );
+        stored += tsdb_ingest( addr, times, &cols, fleet );
+        elapsed += bench_micros( ) - start;
+    }
+    for( u2_t i = 0; i < segmentCount; i++ ) {
+        tsBytes += segments[i]->tsBytes;
+    }
+    printf("TSDB: %u of %u rows from %u nodes ingested in %u us, %u rows/s, %u segments, timestamps %u.%02u bytes/row\r\n",
+           (unsigned int)stored, (unsigned int)( rows * fleet ), fleet, (unsigned int)elapsed,
+           (unsigned int)( elapsed ? (unsigned long long)stored * 1000000 / elapsed : 0 ), segmentCount,
+           (unsigned int)( stored ? tsBytes / stored : 0 ), (unsigned int)( stored ? tsBytes * 100 / stored % 100 : 0 ));
+
+    // Aggregates over the last day and the full range of every node,
+    // checked against the generated readings.
+    u4_t dayTime = 0, fullTime = 0;
+    unsigned long long scanned = 0;
+    for( u2_t i = 0; i < fleet; i++ ) {
+        tsdb_agg_t day, full;
+        u4_t end = BASE_TIME + rows * interval;
+        u4_t start = bench_micros( );
+        tsdb_aggregate( 0x26010000 + i, end - 86400, end, TSDB_TEMPERATURE, &day );
+        u4_t mid = bench_micros( );
+        tsdb_aggregate( 0x26010000 + i, 0, 0xFFFFFFFF, TSDB_TEMPERATURE, &full );
+        fullTime += bench_micros( ) - mid;
+        dayTime += mid - start;
+        scanned += full.count;
+
+        long long sum = 0;
+        for( u4_t r = 0; r < rows; r++ ) {
+            sum += fleetValue( i, r, TSDB_TEMPERATURE );
+        }
+        u4_t dayRows = 86400 / interval < rows ? 86400 / interval : rows;
+        if( full.count != rows || full.sum != sum || day.count < dayRows - 1 || day.count > dayRows + 1 ) {
+            mismatches++;
+        }
+    }
+    // Round trip of the timestamps and values of one node.
+    static u4_t readTimes[TSDB_BLOCK_ROWS * 3];
+    static s2_t readValues[TSDB_BLOCK_ROWS * 3];
+    u4_t n = tsdb_read( 0x26010000, 0, 0xFFFFFFFF, TSDB_SOIL, readTimes, readValues, TSDB_BLOCK_ROWS * 3 );
+    for( u4_t r = 0; r < n; r++ ) {
+        if( readTimes[r] != BASE_TIME + r * interval + ( r * 31 ) % 5 || readValues[r] != fleetValue( 0, r, TSDB_SOIL ) ) {
+            mismatches++;
+        }
+    }
+    printf("TSDB queries: 1-day aggregate %u us, full-range aggregate %u us (%u rows/ms), %u mismatches\r\n",
+           (unsigned int)( dayTime / fleet ), (unsigned int)( fullTime / fleet ),
+           (unsigned int)( fullTime ? scanned * 1000 / fullTime : 0 ), (unsigned int)mismatches);
+    tsdb_close( );
+    return mismatches;
+}// end of tsdb_benchmark function.
@@ -0,0 +1,169 @@
+/*******************************************************************************
+ * Internet of Things (IoT) smart monitoring
+ * device for agriculture using LoRaWAN technology.
+ *
+ * Append-only columnar time-series store for decoded fleet readings.
+ *
+ * - Every node gets its own chain of fixed-size segments. A segment holds up
+ * to TSDB_SEGMENT_ROWS rows as one timestamp column and four value columns
+ * (temperature, humidity, light intensity, soil moisture, each * 100, as
+ * decoded by payload_decodeBatch). Each segment is a file
+ * (<dir>/<devaddr>-<seq>.seg) mapped into memory, so the store survives a
+ * restart and the OS pages it in and out.
+ *
+ * - Timestamps (seconds) are stored as the zig-zag varint of their
+ * delta-of-delta: one byte per row for readings on a fixed interval. Every
+ * TSDB_BLOCK_ROWS rows the encoding restarts from an absolute anchor, so
+ * that a range lookup only decodes one block. Values are stored raw, so
+ * that a range of rows is one contiguous slice of each column.
+ *
+ * - tsdb_aggregate computes count, minimum, maximum, sum and sum of squares
+ * of one column over a time range two values at a time, in plain loops the
+ * compiler vectorises. tsdb_read returns the rows of a range.
+ *
+ * - Rows only become visible once all their columns are written, so an
+ * interrupted append leaves the segment consistent. Rows older than the
+ * latest row of their node are rejected.
+ *
+ * - POSIX host only: part of the ingestion tool (SEE ingest.cpp), not of the
+ * firmware image (SEE .mbedignore).
+ *
+ *******************************************************************************/
+#ifndef _tsdb_hpp_
+#define _tsdb_hpp_
+
+#include "lmic.h"
+#include "payload.h"
+
+// Store limits.
+#ifndef TSDB_MAX_NODES
+#define TSDB_MAX_NODES 1024
+#endif
+#ifndef TSDB_MAX_SEGMENTS
+#define TSDB_MAX_SEGMENTS 8192
+#endif
+#ifndef TSDB_SEGMENT_ROWS
+#define TSDB_SEGMENT_ROWS 4096
+#endif
+
+// Rows per timestamp block, decoded from its own anchor.
+#define TSDB_BLOCK_ROWS 64
+
+// Directory of the store written by tsdb_benchmark.
+#ifndef TSDB_BENCH_DIR
+#define TSDB_BENCH_DIR "tsdb_bench"
+#endif
+
+// Value columns.
+enum {
+    TSDB_TEMPERATURE = 0, // Temperature (Celcius * 100).
+    TSDB_HUMIDITY,        // Humidity (Relative Humidity % * 100).
+    TSDB_LIGHT,           // Light intensity (Volts * 100).
+    TSDB_SOIL,            // Soil moisture (Volts * 100).
+    TSDB_COLUMNS
+};
+
+/*
+ * tsdb_agg_t structure.
+ *
+ * Aggregate of one column over a time range.
+ */
+typedef struct {
+    u4_t count;           // Rows in the range.
+    s2_t min;             // Smallest value.
+    s2_t max;             // Largest value.
+    long long sum;        // Sum of the values.
+    long long sumSq;      // Sum of the squared values.
+} tsdb_agg_t;
+
+/*
+ * tsdb_open function of type bit_t.
+ *
+ * Opens the store: the segments found in dir are mapped, or deleted first if
+ * fresh is set.
+ *
+ * Input parameters: const char dir
+ *                   bit_t fresh
+ * Return: 1 on success, 0 otherwise.
+ */
+bit_t tsdb_open (const char* dir, bit_t fresh);
+
+/*
+ * tsdb_close function of type void.
+ *
+ * Unmaps all segments.
+ *
+ * Input parameters: None
+ */
+void tsdb_close (void);
+
+/*
+ * tsdb_append function of type bit_t.
+ *
+ * Input parameters: devaddr_t node
+ *                   unsigned int time (s)
+ *                   const short values (TSDB_COLUMNS values)
+ * Return: 1 if stored, 0 if out of order or the store is full.
+ */
+bit_t tsdb_append (devaddr_t node, u4_t time, const s2_t* values);
+
+/*
+ * tsdb_ingest function of type unsigned int.
+ *
+ * Appends count decoded readings, reading i taken by nodes[i] at times[i]
+ * with its values at index i of cols.
+ *
+ * Input parameters: const devaddr_t nodes
+ *                   const unsigned int times
+ *                   const payload_columns_t cols
+ *                   unsigned int count
+ * Return: number of rows stored.
+ */
+u4_t tsdb_ingest (const devaddr_t* nodes, const u4_t* times, const payload_columns_t* cols, u4_t count);
+
+/*
+ * tsdb_aggregate function of type bit_t.
+ *
+ * Input parameters: devaddr_t node
+ *                   unsigned int from (s, inclusive)
+ *                   unsigned int to (s, exclusive)
+ *                   unsigned char column
+ *                   tsdb_agg_t agg
+ * Return: 1 if the range holds any row, 0 otherwise.
+ */
+bit_t tsdb_aggregate (devaddr_t node, u4_t from, u4_t to, u1_t column, tsdb_agg_t* agg);
+
+/*
+ * tsdb_read function of type unsigned int.
+ *
+ * Copies up to max rows of one column in the time range, oldest first.
+ *
+ * Input parameters: devaddr_t node
+ *                   unsigned int from (s, inclusive)
+ *                   unsigned int to (s, exclusive)
+ *                   unsigned char column
+ *                   unsigned int times
+ *                   short values
+ *                   unsigned int max
+ * Return: number of rows copied.
+ */
+u4_t tsdb_read (devaddr_t node, u4_t from, u4_t to, u1_t column, u4_t* times, s2_t* values, u4_t max);
+
+/*
+ * tsdb_benchmark function of type unsigned int.
+ *
+ * Loads days of readings every interval seconds from nodes simulated nodes
+ * through payload_decodeBatch into a fresh store in TSDB_BENCH_DIR, then
+ * writes the ingest rate, the timestamp compression and the latency of
+ * one-day and full-range aggregate queries to stdout, checked against the
+ * generated data.
+ *
+ * Input parameters: unsigned short nodes (at most PAYLOAD_BENCH_BATCH)
+ *                   unsigned short days
+ *                   unsigned short interval (s)
+ * Return: number of aggregates and rows differing from the generated data,
+ *         1 if the store cannot be opened.
+ */
+u4_t tsdb_benchmark (u2_t nodes, u2_t days, u2_t interval);
+
+#endif // _tsdb_hpp_
@@ -44,6 +44,70 @@
  * playload data to All Things Talk Maker API which visualizes the data in 
  * a meaningful way for end-user's reference.  
  *
+ * - The host ingestion tool (host/ingest.cpp) decodes batches of uplink
+ * frames from many nodes into per-measurement columns for ingestion outside
+ * All Things Talk and stores them per node in a columnar time-series store;
+ * neither is part of the firmware image.
+ *
+ * - Activation method, debug level, channel plan and transmit interval are
+ * compile-time policies (config.h); footprint.sh reports the flash/RAM cost
+ * of each variant.
+ *
+ * - Stack high-water, per-subsystem RAM and heap use after start-up are
+ * monitored by memstat.cpp and reported after every transmission (DEBUG_LEVEL 1).
+ *
+ * - Frame counters, cached OTAA session and unsent samples are kept in a
+ * wear-leveled flash journal, so that the node resumes transmitting right after
+ * a reset without reusing frame counters or joining again.
+ *
+ * - Uplink AES-CTR/CMAC can run on cached key schedules (crypto.cpp, MMCAU
+ * when available) by building with CRYPTO_LMIC_AES 1.
+ *
+ * - Each sensor is a driver with its own sample period, read cost and warm-up
+ * time (sensors.cpp); every uplink carries the latest reading of each one.
+ * Sensors are powered through D7 (DHT11), PTC5 (light) and a load switch
+ * enabled by PTC7 (soil) only during their acquisition window.
+ *
+ * - The current drawn by MCU, radio, sensors and UART is modelled per state
+ * and integrated over time (energy.cpp) into mAh per day and battery life.
+ *
+ * - HAL events (DIO edges, SPI traffic, tick readings) can be recorded on the
+ * node and replayed deterministically (trace.cpp, HAL_TRACE / HAL_REPLAY).
+ *
+ * - Uplinks follow an absolute slot schedule and sensors are read just ahead
+ * of each slot, so the radio never waits on acquisition; sample-to-air
+ * latency and slot jitter are measured (timing.cpp).
+ *
+ * - Sensors are sampled at a higher rate than the uplinks; the minimum,
+ * maximum, mean and standard deviation of every channel over each
+ * SUMMARY_WINDOW are computed incrementally (stats.cpp) and sent on port 2,
+ * with the statistics selected per channel in config.h.
+ *
+ * - Single-channel or 8-channel plan with random channel hopping; airtime is
+ * accounted per channel and per duty-cycle sub-band (channels.cpp).
+ *
+ * - Boot phases up to the first completed uplink are timestamped and
+ * reported (DEBUG_LEVEL 1); FAST_START sends the samples restored after a
+ * reset at once instead of at the first slot, without shortening the boot.
+ *
+ * - A hardware watchdog supervises the loop; LMiC assertions and hangs end
+ * in a warm reset that keeps the queued samples in RAM (recovery.cpp).
+ *
+ * - A slot finding the radio busy keeps its sample queued and retries with a
+ * short, growing backoff instead of waiting for the next slot.
+ *
+ * - Uplinks are prioritised by class and port (uplink.cpp): alarms such as
+ * dry soil (port 4) preempt telemetry (port 1), summaries (port 2) and
+ * diagnostics (port 5), carry whatever pending data fits, and summaries and
+ * diagnostics are held to an airtime quota.
+ *
+ * - A RAM shadow of the SX1272 registers keeps LMiC's repeated modem
+ * configuration writes and reads off the SPI bus (regcache.cpp).
+ *
+ * - The hot paths of the application and HAL are timed by a microbenchmark
+ * suite (bench.cpp, RUN_BENCHMARKS) and compared against a stored baseline
+ * (BENCH_COMPARE).
+ *
  * - Fully reset device through RESET BUTTON pressed.       
  * 
  * @Author: Giorgos Tsapparellas
@@ -62,41 +126,106 @@
 #include <SPI.h>
 #include <DHT.h>
 #include <debug.h>
+#include "config.h"
+#include "samples.h"
+#include "persist.h"
+#include "memstat.h"
+#include "crypto.h"
+#include "sensors.h"
+#include "energy.h"
+#include "trace.h"
+#include "timing.h"
+#include "stats.h"
+#include "recovery.h"
+#include "channels.h"
+#include "uplink.h"
+#include "regcache.h"
+#include "bench.h"
+#if HAL_REPLAY == 1
+// Recorded field trace, generated from a trace_dump() capture by trace2h.sh.
+#include "trace_data.h"
+#endif
+#if BENCH_COMPARE == 1
+// Stored benchmark results, generated from a bench_json() capture by bench2h.sh.
+#include "bench_baseline.h"
+#endif
 
-///////////////////////////////////////////////////
-// DEFINITION DECLARATIONS                      //
-/////////////////////////////////////////////////
-
-#define MAX_EU_CHANNELS 16     // Frequency channels automatically initialized for EU reqion. 
-#define SINGLE_CHANNEL_GATEWAY // Force it to use 868.1 MHz frequency band only due to Dragino LG01-P LoRa Gateway hardware limitation.   
-#define TRANSMIT_INTERVAL 300  // Transmit interval in seconds, too often may get traffic ignored.
-#define DEBUG_LEVEL 0          // Set debug level to 1 for outputting messages to the UART Terminal (e.g. Tera Term).
-#define ACTIVATION_METHOD 0    // Set activation method to 0 for ABP (Activation By Personalization)
-                               // Set activation method to 1 for OTAA (Over The Air Activation)
+// MAX_EU_CHANNELS, SINGLE_CHANNEL_GATEWAY, TRANSMIT_INTERVAL, DEBUG_LEVEL,
+// ACTIVATION_METHOD and TX_POWER definitions as well as the app_policy
+// of the variant being built are declared in config.h.
 
 ///////////////////////////////////////////////////
 // GLOBAL VARIABLES DECLARATIONS                //
 /////////////////////////////////////////////////
 
-// Transmit interval in seconds.
-uint16_t transmit_interval = TRANSMIT_INTERVAL;
-
 // Static osjob_t sendjob variable used by loop function
 static osjob_t sendjob;
 
-// Unsigned integer packet counter used by transmit function.
-unsigned int packetCounter = 1;
+// Static osjob_t drainjob variable used for sending queued samples
+// left over after a reset or a completed transmission.
+static osjob_t drainjob;
+
+// Static osjob_t retryjob variable used for retrying a slot that found the
+// channel busy. Kept apart from drainjob, as rescheduling a job cancels it.
+static osjob_t retryjob;
+
+// Absolute time of the next uplink slot. Slots follow each other every
+// TRANSMIT_INTERVAL seconds regardless of how long a cycle takes.
+static ostime_t nextSlot;
+
+// Slot of the last transmission handed over to LMiC, pending until
+// EV_TXCOMPLETE.
+static ostime_t txSlot;
+static bit_t txSlotPending = 0;
+
+// Oldest slot whose sample has not been handed over to LMiC yet, e.g.
+// after finding the radio busy.
+static ostime_t queuedSlot;
+static bit_t queuedSlotPending = 0;
+
+// Sample-to-air latency and deviation of the transmission from its slot.
+static timing_t latencyStats;
+static timing_t slotStats;
 
-// Disable data rate adaption.
-// Set to 1 in order to enable data rate adaption.
-static const bit_t disableAdrMode = 0; 
+// Uplink slots, slots finding the radio busy and backoff retries.
+static u4_t slotCount = 0;
+static u4_t busySlots = 0;
+static u4_t retryCount = 0;
 
-// Disable link check validadtion.
-// Set to 1 in order to enable link check validation.
-static const bit_t disableLinkCheck = 0; 
+// Present retry backoff in milliseconds.
+static u4_t retryBackoff = RETRY_BACKOFF;
 
-// Set LoRa Node's transmission power to 14 dBm.
-static const s1_t txPower = 14;
+// Summarised channels, in summary frame order.
+enum { CH_TEMPERATURE, CH_HUMIDITY, CH_LIGHT, CH_SOIL, CHANNELS };
+
+// Statistics of every reading taken in the present summary window.
+static stats_t windowStats[CHANNELS];
+
+// Slots into the present summary window.
+static u2_t windowSlots = 0;
+
+// Set while the oldest pending sample is part of the uplink handed over to
+// LMiC, on its own or carried by an alarm.
+static bit_t txSample = 0;
+
+// Set while the soil is reported dry.
+static bit_t soilDry = 0;
+
+// Alarm codes, first byte of an alarm frame followed by the 16-bit reading.
+enum { ALARM_SOIL_DRY = 1, ALARM_SOIL_CLEARED };
+
+// Boot phases, from os_init to the completion of the first uplink.
+enum { PHASE_OS_INIT, PHASE_MAC_RESET, PHASE_JOURNAL, PHASE_SESSION, PHASE_RESTORED,
+       PHASE_READY, PHASE_SCHEDULED, PHASE_QUEUED, PHASE_ON_AIR, PHASE_COMPLETE, PHASES };
+
+// Time each boot phase ended at, and mask of the phases passed.
+static ostime_t phaseAt[PHASES];
+static u2_t phaseMask = 0;
+
+#if DEBUG_LEVEL == 1
+// Unsigned integer packet counter used by transmit function.
+unsigned int packetCounter = 1;
+#endif
 
 // Set LoRa Node's network id to 0x1.
 static const u4_t NETID = 0x1;
@@ -109,9 +238,15 @@ static const u1_t LMIC_FRAME_LENGTH = 8;
 // Set listening port to 1.
 static const u1_t LMIC_PORT = 1;
 
-// Disable confirmation of transmitted LMiC data.
-// Set to 1 in order to enable confirmation of transmitted LMiC data.
-static const u1_t LMIC_CONFIRMED = 0;
+// Port of the window summary uplinks.
+static const u1_t SUMMARY_PORT = 2;
+
+// Ports of the alarm and diagnostics uplinks.
+static const u1_t ALARM_PORT = 4;
+static const u1_t DIAG_PORT = 5;
+
+// Port of the downlinks selecting the channel plan (1 byte: 0 single, 1 eight channels).
+static const u1_t CHANNEL_PLAN_PORT = 3;
 
 #if ACTIVATION_METHOD == 1 // if OTAA (Over The Air Activation) is applied.
 
@@ -121,6 +256,10 @@ static const u1_t APPEUI[8]  = { 0x70, 0xB3, 0xD5, 0x7E, 0xD0, 0x00, 0xA4, 0x54
 // LoRaWAN unique device ID (DevEUI) associated with The Things Network Cloud Server.
 static const u1_t DEVEUI[8]  = { 0x00, 0x1D, 0x45, 0x32, 0xEC, 0xA8, 0x01, 0x59 };
 
+// LoRaWAN application key (AppKey) associated with The Things Network Cloud Server.
+// Replace with the AppKey of the device registered for OTAA.
+static const u1_t APPKEY[16] = { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 };
+
 #endif
 
 // Acquired activation method
@@ -148,10 +287,33 @@ AnalogIn sensorLight(A1);
 // Analog Input pin of soil moisture sensor set to A3.
 AnalogIn sensorSoilMoisture(A3);
 
+// Digital Output pins switching the supply of the temperature and humidity,
+// light intensity and soil moisture sensors set to D7, PTC5 and PTC7.
+// Sensors are only powered during their acquisition window.
+// - D7 and PTC5 feed the DHT11 (up to 2.5 mA) and the light sensor (0.5 mA)
+//   directly, within the 5 mA a K64F pin can source.
+// - PTC7 drives the active-high enable of a TPS22917 load switch feeding the
+//   soil probe (up to 35 mA) from the 3.3 V rail.
+// D8 and D9 carry DIO4 and DIO5 of the SX1272MB2xAS shield, hence PTC5 and
+// PTC7 are taken from the outer row of header J1, off the Arduino header.
+DigitalOut powerTempHum(D7, 0);
+DigitalOut powerLight(PTC5, 0);
+DigitalOut powerSoilMoisture(PTC7, 0);
+
 ///////////////////////////////////////////////////
 // LMiC APPLICATION CALLBACKS                   //
 /////////////////////////////////////////////////
 
+void sendPending(osjob_t* j);
+void markPhase(u1_t phase, ostime_t t);
+#if DEBUG_LEVEL == 1
+void reportPhases();
+#endif
+void registerSensors();
+#if RUN_BENCHMARKS == 1
+void benchmarkSuite();
+#endif
+
 /* 
  * os_getArtEui callback of type void.
  *
@@ -164,6 +326,8 @@ AnalogIn sensorSoilMoisture(A3);
 void os_getArtEui (u1_t* buf) {
     #if ACTIVATION_METHOD == 1 // if OTAA (Over The Air Activation) is applied.
         memcpy(buf, APPEUI, 8);
+    #else
+        (void)buf;
     #endif
 }// end of os_getArtEui callback.
 
@@ -179,6 +343,8 @@ void os_getArtEui (u1_t* buf) {
 void os_getDevEui (u1_t* buf) {
     #if ACTIVATION_METHOD == 1 // if OTAA (Over The Air Activation) is applied.
         memcpy(buf, DEVEUI, 8);
+    #else
+        (void)buf;
     #endif
 }// end of os_getDevEui callback.
 
@@ -186,29 +352,33 @@ void os_getDevEui (u1_t* buf) {
  * os_getDevKey callback of type void.
  *
  * Copies device network session ID (16 bytes) of The Things Network Cloud Server
- * into memory.
+ * into memory, or the application key if OTAA(Over The Air Activation) is applied.
  *
- * Input parameters: unsigned char buf of NWKSKEY. 
+ * Input parameters: unsigned char buf of NWKSKEY (APPKEY). 
  *
  */ 
 void os_getDevKey (u1_t* buf) {
-    memcpy(buf, NWKSKEY, 16);
+    #if ACTIVATION_METHOD == 1 // if OTAA (Over The Air Activation) is applied.
+        memcpy(buf, APPKEY, 16);
+    #else
+        memcpy(buf, NWKSKEY, 16);
+    #endif
 }// end of os_getDevKey callback.
 
+#if DEBUG_LEVEL == 1
 /* 
- * onEvent callback of type void.
+ * printEvent function of type void.
  *
  * Outputs UART message depending on
- * related event.
- *
- * NOTICE THAT: Not all events are being
- * used due to significant set up 
- * of LMiC environment.
+ * related event. Only built in when
+ * DEBUG_LEVEL is set to 1, so that none
+ * of the event strings ends up in the
+ * release image.
  *
  * Input parameters: ev_t event. 
  *
  */ 
-void onEvent (ev_t ev) {
+static void printEvent (ev_t ev) {
 
     switch(ev) { // Switch events.
         case EV_SCAN_TIMEOUT:
@@ -271,6 +441,105 @@ void onEvent (ev_t ev) {
             break;
     }
     printf("\n"); // New line.
+}// end of printEvent function.
+#endif
+
+/* 
+ * onEvent callback of type void.
+ *
+ * Outputs UART message depending on
+ * related event (DEBUG_LEVEL 1 only)
+ * and handles session and transmission
+ * completion events.
+ *
+ * NOTICE THAT: Not all events are being
+ * used due to significant set up 
+ * of LMiC environment.
+ *
+ * Input parameters: ev_t event. 
+ *
+ */ 
+void onEvent (ev_t ev) {
+
+    #if DEBUG_LEVEL == 1
+        printEvent(ev);
+    #endif
+
+    switch(ev) { // Switch events.
+        case EV_JOINED:
+            // The join reset the channels and bands: apply the plan again.
+            channels_init(channels_plan());
+            // Cache the new session so that a reset does not cost another join.
+            persist_saveSession();
+            persist_checkpoint();
+            break;
+        case EV_TXCOMPLETE:
+            // Drop the queued frames the uplink carried and account its airtime.
+            uplink_sent(energy_lastTx(), LMIC.txend);
+            if (txSample)
+            {
+                // Age of the sample when it went on air and deviation of the
+                // transmission from its scheduled slot.
+                if (samples_peek() != NULL && samples_peek()->taken != 0)
+                {
+                    timing_add(&latencyStats, energy_lastTx() - samples_peek()->taken);
+                }
+                if (txSlotPending)
+                {
+                    timing_add(&slotStats, energy_lastTx() - txSlot);
+                    txSlotPending = 0;
+                }
+                // The pending sample has been sent, drop it from the queue and
+                // journal.
+                samples_pop();
+                recovery_save();
+                persist_checkpoint();
+                txSample = 0;
+            }
+            // Time from the last fault, if any, to this uplink.
+            recovery_uplink(energy_lastTx());
+            markPhase(PHASE_ON_AIR, energy_lastTx());
+            // Airtime per channel and sub-band.
+            channels_txDone(energy_lastTx(), LMIC.txend);
+            // Channel plan selected by the network.
+            if (LMIC.dataLen != 0 && (LMIC.txrxFlags & TXRX_PORT) &&
+                LMIC.frame[LMIC.dataBeg - 1] == CHANNEL_PLAN_PORT)
+            {
+                channels_select(LMIC.frame[LMIC.dataBeg] ? CHANNELS_EU8 : CHANNELS_SINGLE);
+            }
+            markPhase(PHASE_COMPLETE, os_getTime());
+            // Send any samples or other uplinks still queued right away.
+            if (samples_count() != 0 || uplink_count() != 0)
+            {
+                os_setCallback(&drainjob, sendPending);
+            }
+            #if DEBUG_LEVEL == 1
+                // Peak stack and RAM use after a complete transmission cycle.
+                memstat_report();
+                sensors_report();
+                // Charge per day and battery life against the energy budget.
+                energy_report();
+                printf("Pipeline:\r\n");
+                timing_report("sample-to-air", &latencyStats);
+                timing_report("slot-to-air", &slotStats);
+                printf("  %u of %u slots found the radio busy, %u retries\r\n",
+                       (unsigned int)busySlots, (unsigned int)slotCount, (unsigned int)retryCount);
+                channels_report();
+                uplink_report();
+                regcache_report("Radio", regcache_radio());
+                recovery_report();
+                reportPhases();
+                printf("\r\n");
+            #endif
+            #if HAL_TRACE == 1
+                // HAL events from boot to the first transmission, for
+                // trace2h.sh; later transmissions are not recorded.
+                trace_dump();
+            #endif
+            break;
+        default:
+            break;
+    }
 }// end of onEvent callback.
 
 ///////////////////////////////////////////////////
@@ -292,25 +561,56 @@ void setUp() {
     #if DEBUG_LEVEL == 1
         printf("IoT smart monitoring device for agriculture using LoRaWAN technology\n\n");
     #endif
+    // Start recording HAL events (HAL_TRACE 1 only).
+    trace_init();
+    
     // Initializes OS.
     os_init(); 
     
+    markPhase(PHASE_OS_INIT, os_getTime());
+    
+    // Keep the crash record of a warm restart, clear it after a power-on.
+    recovery_start();
+    
+    // Start integrating the modelled current of MCU, radio, sensors and UART.
+    energy_init();
+    #if DEBUG_LEVEL == 1
+        energy_set(ENERGY_UART, ENERGY_UART_ON);
+    #endif
+    
     #if DEBUG_LEVEL == 1
         printf("OS_INIT\n\n");
     #endif
     
     // Reset the MAC state. Session and pending data transfers are being discarded.
     LMIC_reset();
+    markPhase(PHASE_MAC_RESET, os_getTime());
+    
+    // Open the flash journal holding frame counters, session and pending samples.
+    samples_init();
+    persist_init();
+    markPhase(PHASE_JOURNAL, os_getTime());
   
-    // Set static session parameters. Instead of dynamically establishing a session
-    // by joining the network, precomputed session parameters are be provided.
-    LMIC_setSession (NETID, DEVADDR, (uint8_t*)NWKSKEY, (uint8_t*)APPSKEY);
+    #if ACTIVATION_METHOD == 1 // if OTAA (Over The Air Activation) is applied.
+        // Reuse the session cached after the last successful join. Otherwise
+        // LMiC joins the network automatically when the first packet is queued.
+        if (persist_restoreSession())
+        {
+            #if DEBUG_LEVEL == 1
+                printf("Cached OTAA session restored\n\n");
+            #endif
+        }
+    #else
+        // Set static session parameters. Instead of dynamically establishing a session
+        // by joining the network, precomputed session parameters are be provided.
+        LMIC_setSession (NETID, DEVADDR, (uint8_t*)NWKSKEY, (uint8_t*)APPSKEY);
+    #endif
   
     // Disable data rate adaptation.
-    LMIC_setAdrMode(disableAdrMode);
+    LMIC_setAdrMode(app_policy::adrMode);
   
     // Disable link check validation.
-    LMIC_setLinkCheckMode(disableLinkCheck);
+    LMIC_setLinkCheckMode(app_policy::linkCheck);
   
     // Disable beacon tracking.
     LMIC_disableTracking();
@@ -320,37 +620,135 @@ void setUp() {
     LMIC_stopPingable();
      
     // Set data rate and transmit power.
-    LMIC_setDrTxpow(DR_SF7,txPower);
+    LMIC_setDrTxpow(DR_SF7,app_policy::txPower);
     
     // If single-channel gateway is being used disable 
-    // all the other channels except channel 0. 
-    #ifdef SINGLE_CHANNEL_GATEWAY
-        #if DEBUG_LEVEL == 1
+    // all the other channels except channel 0, otherwise
+    // hop randomly over the channels of an 8-channel gateway.
+    // Set up after the session, as LMIC_setSession resets channels and bands.
+    #if DEBUG_LEVEL == 1
+        if (app_policy::singleChannel)
+        {
             printf("      ----->Disabling all channels but 0 (868.1 MHz) for single-channel gateway compatibility\n\n\n");
-        #endif
+        }
+    #endif
+    channels_init(app_policy::singleChannel ? CHANNELS_SINGLE : CHANNELS_EU8);
+    markPhase(PHASE_SESSION, os_getTime());
+    
+    // Register the sensor drivers, each sampled on its own period, and
+    // select the statistics summarised for each channel.
+    registerSensors();
+    stats_init(&windowStats[CH_TEMPERATURE], SUMMARY_TEMPERATURE);
+    stats_init(&windowStats[CH_HUMIDITY], SUMMARY_HUMIDITY);
+    stats_init(&windowStats[CH_LIGHT], SUMMARY_LIGHT);
+    stats_init(&windowStats[CH_SOIL], SUMMARY_SOIL);
+    timing_init(&latencyStats);
+    timing_init(&slotStats);
+    
+    // Uplink classes, highest priority first: alarms carrying any pending
+    // data that fits, telemetry from the sample queue, and the latest
+    // summary and diagnostics within their airtime quotas.
+    uplink_init();
+    uplink_setup(UPLINK_ALARM, ALARM_PORT, 0, UPLINK_CARRIER);
+    uplink_setup(UPLINK_TELEMETRY, LMIC_PORT, 0, UPLINK_EXTERNAL);
+    uplink_setup(UPLINK_SUMMARY, SUMMARY_PORT, QUOTA_SUMMARY, UPLINK_LATEST);
+    uplink_setup(UPLINK_DIAG, DIAG_PORT, QUOTA_DIAG, UPLINK_LATEST);
     
-        for (int i=1; i < MAX_EU_CHANNELS; i++)
+    // Resume frame counters of the active session and re-queue unsent samples,
+    // then reserve the next block of uplink frame counters.
+    // After a warm restart the samples kept in RAM are newer than the journal.
+    persist_restore();
+    recovery_restore();
+    recovery_save();
+    persist_checkpoint();
+    markPhase(PHASE_RESTORED, os_getTime());
+    
+    #if DEBUG_LEVEL == 1
+        printf("Uplink counter %u, %u pending samples restored\n\n", (unsigned int)LMIC.seqnoUp, samples_count());
+    #endif
+    
+    // Account for the static RAM owned by the application and LMiC, then
+    // make sure nothing is allocated from the heap from now on.
+    memstat_region("LMIC", sizeof(LMIC));
+    memstat_region("jobs", sizeof(sendjob) + sizeof(drainjob) + sizeof(retryjob));
+    memstat_region("window stats", sizeof(windowStats));
+    memstat_region("sensors", sizeof(sensorTempHum) + sizeof(sensorLight) + sizeof(sensorSoilMoisture) +
+                   sizeof(powerTempHum) + sizeof(powerLight) + sizeof(powerSoilMoisture));
+    memstat_heapGuard(1);
+    
+    #if RUN_BENCHMARKS == 1
+        // Not repeated on a warm restart.
+        if (recovery_count() == 0)
         {
-            LMIC_disableChannel(i);
+            benchmarkSuite();
         }
     #endif
   
     #if DEBUG_LEVEL == 1
         printf("//////////Entering into TIME-TRIGGERED packet sending through LoRaWAN//////////\n");
-        printf("---------------------Packets to be sent every %u seconds----------------------\n\n", transmit_interval);
+        printf("---------------------Packets to be sent every %u seconds----------------------\n\n", app_policy::transmitInterval);
     #endif
+    markPhase(PHASE_READY, os_getTime());
 }// end of setUp function.
 
 /* 
- * getTemperatureHumidity function of type void.
+ * markPhase function of type void.
+ *
+ * Records the time the given boot phase ended at,
+ * the first time only, also in the HAL trace.
+ *
+ * Input parameters: unsigned char phase
+ *                   ostime_t t
+ *
+ */ 
+void markPhase(u1_t phase, ostime_t t) {
+    if (phaseMask & (1 << phase))
+    {
+        return;
+    }
+    phaseMask |= 1 << phase;
+    phaseAt[phase] = t;
+    trace_app(TRACE_APP_PHASE, phase);
+}// end of markPhase function.
+
+#if DEBUG_LEVEL == 1
+/* 
+ * reportPhases function of type void.
+ *
+ * Outputs the boot timeline on UART Terminal:
+ * the milliseconds from os_init to the end of
+ * every boot phase passed so far.
+ *
+ * Input parameters: None.
+ *
+ */ 
+void reportPhases() {
+    static const char* const NAMES[PHASES] = { "os_init", "LMIC_reset", "journal", "session",
+                                               "restored", "setUp", "scheduled", "queued",
+                                               "on air", "complete" };
+    printf("Boot timeline (ms from os_init):");
+    for (int i = 1; i < PHASES; i++)
+    {
+        if (phaseMask & (1 << i))
+        {
+            printf(" %s %u,", NAMES[i], (unsigned int)osticks2ms(phaseAt[i] - phaseAt[PHASE_OS_INIT]));
+        }
+    }
+    printf(" fast start %s\r\n", FAST_START ? "on" : "off");
+}// end of reportPhases function.
+#endif
+
+/* 
+ * getTemperatureHumidity function of type bit_t.
  *
  * Gets temperature (celcius) and humidity (relative humidity %)
  * measurements using DHT library. Otherwise, print an error.
  *
  * Input parameters: float temperature
  *                   float humidity
+ * Return: 1 if the measurement succeeded, 0 otherwise.
  */ 
-void getTemperatureHumidity(float& temperature, float& humidity) {
+bit_t getTemperatureHumidity(float& temperature, float& humidity) {
 
     // Set err variable to 0 (none).
     uint8_t err = ERROR_NONE;
@@ -361,14 +759,27 @@ void getTemperatureHumidity(float& temperature, float& humidity) {
     
     // Store sensor data (40 bits(16-bit temperature, 16-bit humidity and 8-bit
     // CRC checksum)) into err variable.
-    err = sensorTempHum.readData();
+    // The result and the reading are logged in the HAL trace (in hundredths)
+    // and served from it on replay, where the sensor itself is not read.
+    #if HAL_REPLAY == 1
+        err = trace_app(TRACE_APP_DHT, ERROR_NOT_PRESENT);
+    #else
+        err = trace_app(TRACE_APP_DHT, sensorTempHum.readData());
+    #endif
     
     if (err == ERROR_NONE) // if err equals to 0.
     { 
-        // Store float temperature value in celcius.
-        temperature = sensorTempHum.ReadTemperature(CELCIUS);
-        // Store float humidity value. 
-        humidity = sensorTempHum.ReadHumidity();
+        #if HAL_REPLAY == 1
+            temperature = (int16_t)trace_app(TRACE_APP_TEMPERATURE, 0) / 100.0f;
+            humidity = trace_app(TRACE_APP_HUMIDITY, 0) / 100.0f;
+        #else
+            // Store float temperature value in celcius.
+            temperature = sensorTempHum.ReadTemperature(CELCIUS);
+            // Store float humidity value. 
+            humidity = sensorTempHum.ReadHumidity();
+            trace_app(TRACE_APP_TEMPERATURE, (u2_t)(int16_t)(temperature * 100.0f));
+            trace_app(TRACE_APP_HUMIDITY, (u2_t)(humidity * 100.0f));
+        #endif
         
         // Output temperature and humidity values on UART Terminal
         #if DEBUG_LEVEL == 1
@@ -383,6 +794,7 @@ void getTemperatureHumidity(float& temperature, float& humidity) {
             printf("Error: %d\r\n", err);
         #endif    
     }
+    return err == ERROR_NONE;
 }// end of getTemperatureHumidity function.
 
 /* 
@@ -447,54 +859,318 @@ void getSoilMoisture(float& soilMoistureVoltage) {
 }// end of getSoilMoisture function.
 
 /* 
- * transmit function of type void.
+ * raiseAlarm function of type void.
  *
- * Checking if channel is ready.
- * If no, waiting until channel becomes free.
- * If yes, calling getTemperatureHumidity,
- * getLightIntensity and getSoilMoisture functions 
- * to gather measuring parameters. Then, prepares 
- * the LoRa packet and finally sending the packet
- * using os_setTimedCallback LMiC callback.
- * 
- * Input parameters: osjob_t* j
+ * Queues an alarm frame (code and 16-bit reading)
+ * and sends it right away, ahead of any other
+ * pending uplink.
  *
+ * Input parameters: unsigned char code
+ *                   short value
  */ 
-void transmit(osjob_t* j)
-{
-    // Define sensor measuring parameters.
-    float temperature, humidity, lightIntensity, soilMoisture;
-    
+static void raiseAlarm(u1_t code, s2_t value) {
+    u1_t alarmFrame[3] = { code, (u1_t)(value >> 8), (u1_t)value };
+    uplink_push(UPLINK_ALARM, alarmFrame, sizeof(alarmFrame));
     #if DEBUG_LEVEL == 1
-        printf("txChannel: %u , Channel Ready? ", LMIC.txChnl);
+        printf("Alarm %u (%d)\r\n", code, value);
     #endif
-    
-    if (LMIC.opmode & (1 << 7)) // Is channel ready for transmission?
+    os_setCallback(&drainjob, sendPending);
+}// end of raiseAlarm function.
+
+/* 
+ * readTemperatureHumidity function of type bit_t.
+ *
+ * Temperature and humidity sensor driver read callback.
+ *
+ * Input parameters: sample_t s
+ * Return: 1 if the measurement succeeded, 0 otherwise.
+ */ 
+static bit_t readTemperatureHumidity(sample_t* s) {
+    float temperature, humidity;
+    if (!getTemperatureHumidity(temperature, humidity))
     {
-        printf("NO, waiting...\n\n");
-    } 
-    else 
+        return 0;
+    }
+    s->temperature = temperature*100;
+    s->humidity = humidity*100;
+    stats_add(&windowStats[CH_TEMPERATURE], s->temperature);
+    stats_add(&windowStats[CH_HUMIDITY], s->humidity);
+    return 1;
+}// end of readTemperatureHumidity function.
+
+/* 
+ * readLightIntensity function of type bit_t.
+ *
+ * Light intensity sensor driver read callback.
+ *
+ * Input parameters: sample_t s
+ * Return: 1.
+ */ 
+static bit_t readLightIntensity(sample_t* s) {
+    float lightIntensity;
+    getLightIntensity(lightIntensity);
+    s->light = lightIntensity*100;
+    stats_add(&windowStats[CH_LIGHT], s->light);
+    return 1;
+}// end of readLightIntensity function.
+
+/* 
+ * readSoilMoisture function of type bit_t.
+ *
+ * Soil moisture sensor driver read callback.
+ *
+ * Input parameters: sample_t s
+ * Return: 1.
+ */ 
+static bit_t readSoilMoisture(sample_t* s) {
+    float soilMoisture;
+    getSoilMoisture(soilMoisture);
+    s->soil = soilMoisture*100;
+    stats_add(&windowStats[CH_SOIL], s->soil);
+    // Raise the alarm when the soil goes dry, clear it once watered again.
+    if (!soilDry && s->soil < SOIL_DRY_ALARM)
+    {
+        soilDry = 1;
+        raiseAlarm(ALARM_SOIL_DRY, s->soil);
+    }
+    else if (soilDry && s->soil > SOIL_DRY_CLEAR)
+    {
+        soilDry = 0;
+        raiseAlarm(ALARM_SOIL_CLEARED, s->soil);
+    }
+    return 1;
+}// end of readSoilMoisture function.
+
+/* 
+ * powerTemperatureHumidity, powerLightIntensity and powerSoilMoisture
+ * functions of type void.
+ *
+ * Sensor driver power callbacks switching the sensor supply pins.
+ *
+ * Input parameters: bit_t on
+ */ 
+static void powerTemperatureHumidity(bit_t on) {
+    powerTempHum = on;
+}// end of powerTemperatureHumidity function.
+
+static void powerLightIntensity(bit_t on) {
+    powerLight = on;
+}// end of powerLightIntensity function.
+
+static void powerSoilProbe(bit_t on) {
+    powerSoilMoisture = on;
+}// end of powerSoilProbe function.
+
+// Sensor drivers: name, period (s), read cost (us), warm-up (ms),
+// supply current (uA), power, read.
+// - DHT11: needs 1 s after power-up before it answers; a read takes an 18 ms
+//   start signal plus the 40-bit transfer; draws up to 2.5 mA while measuring.
+// - Light sensor (LDR and op-amp): settles within 10 ms, about 0.5 mA.
+// - Resistive soil probe: settles within 100 ms, up to 35 mA drawn through the
+//   load switch (turned on within 1 ms); gating it also keeps the probe from
+//   corroding under constant bias.
+// All reads share one grid, so the warm-ups of sensors due together overlap.
+static const sensor_driver_t TEMPHUM_DRIVER = { "temp/hum", TEMPHUM_PERIOD, 23000, 1000, 1500,
+                                                powerTemperatureHumidity, readTemperatureHumidity };
+static const sensor_driver_t LIGHT_DRIVER   = { "light",    LIGHT_PERIOD,   20,    10,   500,
+                                                powerLightIntensity, readLightIntensity };
+static const sensor_driver_t SOIL_DRIVER    = { "soil",     SOIL_PERIOD,    20,    100,  35000,
+                                                powerSoilProbe, readSoilMoisture };
+
+/* 
+ * registerSensors function of type void.
+ *
+ * Registers the sensor drivers with the sampling scheduler.
+ *
+ * Input parameters: None.
+ *
+ */ 
+void registerSensors() {
+    sensors_init();
+    sensors_register(&TEMPHUM_DRIVER);
+    sensors_register(&LIGHT_DRIVER);
+    sensors_register(&SOIL_DRIVER);
+}// end of registerSensors function.
+
+#if RUN_BENCHMARKS == 1
+/* 
+ * benchEncode, benchLight, benchSoil, benchTicks, benchCheckTimer,
+ * benchDebugBuf, benchDebugEvent and benchEvent functions of type void.
+ *
+ * One call of each benchmarked hot path.
+ *
+ * Input parameters: unsigned int i (call index)
+ */ 
+static void benchEncode(u4_t i) {
+    sample_t sample = { (s2_t)(2150 + (i & 0xFF)), (s2_t)(4800 - (i & 0xFF)), 230, 180, 0 };
+    samples_encode(&sample, LMIC.frame);
+}// end of benchEncode function.
+
+static void benchLight(u4_t i) {
+    (void)i;
+    float lightIntensity;
+    getLightIntensity(lightIntensity);
+}// end of benchLight function.
+
+static void benchSoil(u4_t i) {
+    (void)i;
+    float soilMoisture;
+    getSoilMoisture(soilMoisture);
+}// end of benchSoil function.
+
+static void benchTicks(u4_t i) {
+    (void)i;
+    hal_ticks();
+}// end of benchTicks function.
+
+static void benchCheckTimer(u4_t i) {
+    // Goes through deltaticks.
+    hal_checkTimer(hal_ticks() + i);
+}// end of benchCheckTimer function.
+
+static void benchDebugBuf(u4_t i) {
+    (void)i;
+    debug_buf(LMIC.frame, LMIC_FRAME_LENGTH);
+}// end of benchDebugBuf function.
+
+static void benchDebugEvent(u4_t i) {
+    (void)i;
+    debug_event(EV_TXCOMPLETE);
+}// end of benchDebugEvent function.
+
+static void benchEvent(u4_t i) {
+    (void)i;
+    onEvent(EV_LINK_ALIVE);
+}// end of benchEvent function.
+
+/* 
+ * benchmarkSuite function of type void.
+ *
+ * Times the payload packing of transmit, the sensor
+ * conversions, the HAL tick functions, the debug
+ * output and the event dispatch, outputs the results
+ * as one BENCH line for bench2h.sh and compares them
+ * against the stored baseline (BENCH_COMPARE 1 only),
+ * then runs the benchmarks and simulations of the
+ * modules on the timers started by bench_init.
+ * Hardware reads go to the board on target and to the
+ * mocked peripherals on a host build.
+ *
+ * Input parameters: None.
+ *
+ */ 
+void benchmarkSuite() {
+    bench_init(256);
+    bench_run("encode", benchEncode);
+    bench_run("light", benchLight);
+    bench_run("soil", benchSoil);
+    bench_run("ticks", benchTicks);
+    bench_run("checkTimer", benchCheckTimer);
+    // Fewer calls for the functions writing to the UART.
+    bench_rounds(16);
+    bench_run("debug_buf", benchDebugBuf);
+    bench_run("debug_event", benchDebugEvent);
+    bench_run("onEvent", benchEvent);
+    bench_json();
+    #if BENCH_COMPARE == 1
+        bench_compare(BENCH_BASELINE_UNIT, BENCH_BASELINE, BENCH_BASELINE_COUNT, BENCH_THRESHOLD);
+    #endif
+
+    // Window statistics update cost per reading.
+    stats_benchmark(1024);
+    // Collisions and capacity of 200 nodes like this one, on one
+    // channel and on eight.
+    channels_simulate(200, app_policy::transmitInterval, LMIC_FRAME_LENGTH + 13, 50);
+    // Alarm latency with and without priorities for a node sampling
+    // every 6 s, close to the duty-cycle limit.
+    uplink_simulate(6, 120, 24);
+    // Radio SPI traffic per uplink with and without the register
+    // shadow, against a mock SX1272.
+    regcache_benchmark(100, app_policy::singleChannel ? 1 : 8);
+    #if ACTIVATION_METHOD == 0
+        // Uplink crypto cost with and without cached key schedules.
+        crypto_benchmark(256, NWKSKEY, APPSKEY);
+    #endif
+}// end of benchmarkSuite function.
+#endif
+
+/* 
+ * closeWindow function of type void.
+ *
+ * Encodes the selected statistics of every channel
+ * (temperature, humidity, light intensity, soil moisture)
+ * into the summary frame, queues it together with the
+ * diagnostics of the window and starts a new window.
+ * A summary or diagnostics frame not sent yet is replaced.
+ * 
+ * Input parameters: None.
+ *
+ */ 
+void closeWindow()
+{
+    // At most five 16-bit statistics per channel.
+    u1_t summaryFrame[CHANNELS * 10];
+    u1_t summaryLength = 0;
+    
+    for (int i = 0; i < CHANNELS; i++)
     {
         #if DEBUG_LEVEL == 1
-            printf("YES, sensor readings...\n\n");
+            printf("Window %d: %u readings, min %d, max %d, mean %d, stddev %u\r\n", i,
+                   windowStats[i].count, windowStats[i].min, windowStats[i].max,
+                   stats_mean(&windowStats[i]), stats_stddev(&windowStats[i]));
         #endif
-        
-        // Gather sensor readings.
-        getTemperatureHumidity(temperature, humidity);
-        getLightIntensity(lightIntensity);
-        getSoilMoisture(soilMoisture); 
-      
+        summaryLength += stats_encode(&windowStats[i], summaryFrame + summaryLength);
+        stats_reset(&windowStats[i]);
+    }
+    uplink_push(UPLINK_SUMMARY, summaryFrame, summaryLength);
+    
+    // Diagnostics: warm restarts, slots finding the radio busy and retries.
+    u1_t diagFrame[5] = { (u1_t)recovery_count(), (u1_t)(busySlots >> 8), (u1_t)busySlots,
+                          (u1_t)(retryCount >> 8), (u1_t)retryCount };
+    uplink_push(UPLINK_DIAG, diagFrame, sizeof(diagFrame));
+}// end of closeWindow function.
+
+/* 
+ * sendPending function of type void.
+ *
+ * Prepares the LoRa packet of the highest uplink class
+ * pending within its airtime quota: an alarm, which also
+ * carries the oldest pending sample and the queued summary
+ * and diagnostics that fit, in that order, the oldest
+ * pending sample, the window summary or the diagnostics,
+ * and hands it over to LMiC, replacing a lower packet
+ * still waiting there. It stays pending until
+ * EV_TXCOMPLETE is reported.
+ * 
+ * Input parameters: osjob_t* j
+ *
+ */ 
+void sendPending(osjob_t* j)
+{
+    (void)j;
+    const sample_t* sample = samples_peek();
+    u1_t record[SAMPLE_FRAME_LENGTH];
+    u1_t cls;
+    u1_t len;
+    
+    if (LMIC.opmode & (1 << 7)) // Channel busy.
+    {
+        return;
+    }
+    cls = uplink_select(sample != NULL ? 1 << UPLINK_TELEMETRY : 0);
+    if (cls == UPLINK_NONE)
+    {
+        return;
+    }
+    // Random channel for the next uplink.
+    channels_hop();
+    
+    if (cls == UPLINK_TELEMETRY)
+    {
         #if DEBUG_LEVEL == 1
             printf("      ----->Preparing LoRa packet...\n");
         #endif
         
-        // Prepare upstream data transmission at the next possible time.
-        // Multiply all sensor readings by 100.
-        int16_t temp = temperature*100;
-        int16_t hum = humidity*100;
-        int16_t light = lightIntensity*100;
-        int16_t soil = soilMoisture*100;
-      
         // Allocate measurements into LMIC frame array ready for transmission.
         // Each sensor measurement allocates 2 positions in frame array.
         // First, value is right shifted for 8 bits, while on the next 
@@ -504,25 +1180,162 @@ void transmit(osjob_t* j)
         // to the gateway which forwards it to The Things Network Cloud Server.
         // Data will then be converted in a meaningful way through 
         // All Things Talk ABCL custom JSON binary conversion script.  
-        LMIC.frame[0] = temp >> 8;
-        LMIC.frame[1] = temp & 0xFF;
-        LMIC.frame[2] = hum >> 8;
-        LMIC.frame[3] = hum & 0xFF; 
-        LMIC.frame[4] = light >> 8;
-        LMIC.frame[5] = light & 0xFF;
-        LMIC.frame[6] = soil >> 8;
-        LMIC.frame[7] = soil & 0xFF;
-      
-        // Set the transmission data.
-        LMIC_setTxData2(LMIC_PORT, LMIC.frame, LMIC_FRAME_LENGTH, LMIC_CONFIRMED);
-        
+        samples_encode(sample, LMIC.frame);
+        uplink_build(cls, LMIC.frame, UPLINK_NONE, NULL, 0);
+        len = LMIC_FRAME_LENGTH;
+        txSample = 1;
+    }
+    else if (cls == UPLINK_ALARM && sample != NULL)
+    {
+        // The oldest pending sample rides along with an alarm, ahead of the
+        // summary and the diagnostics.
+        samples_encode(sample, record);
+        len = uplink_build(cls, LMIC.frame, UPLINK_TELEMETRY, record, SAMPLE_FRAME_LENGTH);
+        txSample = uplink_carried();
+    }
+    else
+    {
+        len = uplink_build(cls, LMIC.frame, UPLINK_NONE, NULL, 0);
+        txSample = 0;
+    }
+  
+    // Set the transmission data.
+    LMIC_setTxData2(uplink_port(cls), LMIC.frame, len, app_policy::confirmed);
+    markPhase(PHASE_QUEUED, os_getTime());
+    
+    // Time the sample from its slot, also when a retry or the drain after
+    // the previous uplink hands it over.
+    if (txSample && queuedSlotPending && (LMIC.opmode & (1 << 7))) // Handed over to LMiC.
+    {
+        txSlot = queuedSlot;
+        txSlotPending = 1;
+        queuedSlotPending = 0;
+    }
+    
+    #if DEBUG_LEVEL == 1
+        printf("      ----->LoRa Packet READY\n\n");
+        printf("      ----->Sending LoRa packet %u on port %u of byte size %u\n\n", packetCounter++, uplink_port(cls), len);
+    #endif
+}// end of sendPending function.
+
+/* 
+ * retryPending function of type void.
+ *
+ * Sends the oldest pending sample once the radio
+ * is free. While a TX/RX is still pending, retries
+ * after a backoff doubling up to RETRY_BACKOFF_MAX.
+ * 
+ * Input parameters: osjob_t* j
+ *
+ */ 
+void retryPending(osjob_t* j)
+{
+    if (samples_count() == 0 && uplink_count() == 0)
+    {
+        return;
+    }
+    if (LMIC.opmode & (1 << 7)) // Still busy, back off further.
+    {
+        retryCount++;
+        retryBackoff = retryBackoff * 2 < RETRY_BACKOFF_MAX ? retryBackoff * 2 : RETRY_BACKOFF_MAX;
+        os_setTimedCallback(j, os_getTime()+ms2osticks(retryBackoff), retryPending);
+        return;
+    }
+    sendPending(j);
+}// end of retryPending function.
+
+/* 
+ * transmit function of type void.
+ *
+ * Takes the latest readings of every sensor
+ * driver, acquired by the sensor scheduler just
+ * ahead of this slot, and queues the sample.
+ * Checking if channel is ready.
+ * If no, keeping the sample queued and retrying
+ * after a short backoff through retryPending.
+ * If yes, sending the oldest pending sample through
+ * sendPending. Finally, schedules the next transmission
+ * at the next absolute slot using os_setTimedCallback
+ * LMiC callback.
+ * 
+ * Input parameters: osjob_t* j
+ *
+ */ 
+void transmit(osjob_t* j)
+{
+    // Latest sensor readings multiplied by 100.
+    sample_t sample;
+    
+    // Merge the latest reading of every sensor into one sample.
+    if (!sensors_latest(&sample))
+    {
+        #if DEBUG_LEVEL == 1
+            printf("Not every sensor has been read yet\n\n");
+        #endif
+    }
+    
+    // Queue the sample, also when the radio is busy, so that no cycle's data
+    // is lost. The oldest pending one is sent first, hence samples restored
+    // from the flash journal after a reset go out first.
+    samples_push(&sample);
+    recovery_save();
+    slotCount++;
+    if (!queuedSlotPending)
+    {
+        queuedSlot = nextSlot;
+        queuedSlotPending = 1;
+    }
+    
+    #if FAULT_INJECT != 0
+        // Fail once per power-on to exercise the recovery.
+        if (slotCount == FAULT_INJECT_SLOT && recovery_count() == 0)
+        {
+            #if FAULT_INJECT == 1
+                hal_failed();
+            #else
+                while(1);
+            #endif
+        }
+    #endif
+    
+    // Summarise the window every SUMMARY_WINDOW seconds; the summary is sent
+    // after the pending samples.
+    if (++windowSlots >= SUMMARY_WINDOW / app_policy::transmitInterval)
+    {
+        windowSlots = 0;
+        closeWindow();
+    }
+    
+    #if DEBUG_LEVEL == 1
+        printf("txChannel: %u , Channel Ready? ", LMIC.txChnl);
+    #endif
+    
+    if (LMIC.opmode & (1 << 7)) // Is channel ready for transmission?
+    {
+        #if DEBUG_LEVEL == 1
+            printf("NO, retrying in %u ms...\n\n", RETRY_BACKOFF);
+        #endif
+        busySlots++;
+        // Keep the queued sample across a reset and retry shortly.
+        persist_checkpoint();
+        retryBackoff = RETRY_BACKOFF;
+        os_setTimedCallback(&retryjob, os_getTime()+ms2osticks(retryBackoff), retryPending);
+    } 
+    else 
+    {
         #if DEBUG_LEVEL == 1
-            printf("      ----->LoRa Packet READY\n\n");
-            printf("      ----->Sending LoRa packet %u of byte size %u\n\n", packetCounter++, LMIC_FRAME_LENGTH);
+            printf("YES, sending...\n\n");
         #endif
+        
+        sendPending(j);
     }
-    // Schedule a time-triggered job to run based on TRANSMIT_INTERVAL time value.
-    os_setTimedCallback(j, os_getTime()+sec2osticks(TRANSMIT_INTERVAL), transmit);
+    // Schedule a time-triggered job at the next slot, TRANSMIT_INTERVAL after
+    // this one, skipping slots missed by a stalled loop.
+    do
+    {
+        nextSlot += sec2osticks(app_policy::transmitInterval);
+    } while (nextSlot - os_getTime() < 0);
+    os_setTimedCallback(j, nextSlot, transmit);
     
 }// end of transmit function.
 
@@ -531,24 +1344,46 @@ void transmit(osjob_t* j)
  *
  * Calling transmit as well as os_runloop_once functions
  * for a repeatedly time-triggered behaviour 
- * program execution.
+ * program execution. Returns only once a replayed trace
+ * is over (HAL_REPLAY).
  *
  * Input parameters: None.
  *
  */ 
 void loop()
 {
-    // Calling transmit local function for acquiring next transmission
-    // job of LoRa Node.
-    transmit(&sendjob);
+    // Anchor the slot schedule and the sensor read grid, so that every
+    // acquisition completes just ahead of its slot, then run the first
+    // transmission job of LoRa Node at the first slot.
+    nextSlot = os_getTime() + sensors_leadTime();
+    sensors_start(nextSlot);
+    os_setTimedCallback(&sendjob, nextSlot, transmit);
+    #if FAST_START == 1
+        // Samples restored after a reset go out at once, not at the first slot.
+        if (samples_count() != 0)
+        {
+            os_setCallback(&drainjob, sendPending);
+        }
+    #endif
+    markPhase(PHASE_SCHEDULED, os_getTime());
+    
+    // Reset the node if the loop stalls for RECOVERY_TIMEOUT.
+    recovery_watchdog();
 
     // Super loop running os_runloop_once LMiC callback in a time-triggered behaviour. 
     while(1)
     {
-        // Calling LMiC os_runloop_once callback.
+        // Calling LMiC os_runloop_once callback, which sleeps until the next
+        // job is due (hal_sleep) when there is nothing to run.
         os_runloop_once();
-        // Delay of 20 ms.
-        wait_ms(20);
+        recovery_kick();
+        #if HAL_REPLAY == 1
+            // The recorded session is over.
+            if (trace_replayDone())
+            {
+                return;
+            }
+        #endif
     }
     // Never arives here!
     
@@ -567,14 +1402,36 @@ void loop()
  */ 
 int main(int argc, char **argv) 
 {
+    (void)argc;
+    (void)argv;
+    
+    // Paint the unused stack for high-water measurement.
+    memstat_paintStack();
+    
+    #if !defined(__MBED__)
+        // Host builds restart here instead of resetting the MCU.
+        sigsetjmp(recovery_restart, 1);
+    #endif
+    
+    #if HAL_REPLAY == 1
+        // Serve the HAL from the recorded trace instead of the hardware.
+        trace_load(TRACE_DATA, sizeof(TRACE_DATA) / sizeof(TRACE_DATA[0]), TRACE_BASE);
+    #endif
+    
     // Calling setUp local function for OS initialization.
     setUp();
     
-    // Super loop running loop local funcion in a time-triggered behaviour.
-    while(1)
-    { 
+    #if HAL_REPLAY == 1
+        // The replay ends with the trace; fail on any divergence.
         loop();
-    }    
-    // Never arrives here!
+        return trace_replayReport() ? 0 : 1;
+    #else
+        // Super loop running loop local funcion in a time-triggered behaviour.
+        while(1)
+        { 
+            loop();
+        }    
+        // Never arrives here!
+    #endif
     
 } // end of main function. 
\ No newline at end of file
@@ -0,0 +1,334 @@
+/*******************************************************************************
+ * Internet of Things (IoT) smart monitoring
+ * device for agriculture using LoRaWAN technology.
+ *
+ * Static memory budget and stack high-water instrumentation.
+ *
+ * Stack bounds and .data/.bss totals come from the CMSIS GCC linker script
+ * symbols (__StackLimit, __StackTop, __data_start__, ...), less the crash
+ * record kept at __StackLimit. Heap statistics
+ * come from the allocator wrappers (MEMSTAT_HEAP_WRAP 1) or newlib's
+ * mallinfo. Host builds fall back on a window below the stack pointer and
+ * on the GNU ld symbols; with other toolchains the corresponding figures
+ * are reported as 0.
+ *
+ * SEE memstat.h file for the description of each function.
+ *
+ *******************************************************************************/
+
+#include "mbed.h"
+#include "lmic.h"
+#include "hal.h"
+#include "memstat.h"
+
+#if defined(__GNUC__) && !defined(__CC_ARM) && defined(__MBED__)
+#include <malloc.h>
+#define MEMSTAT_GCC 1
+#define MEMSTAT_HOST 0
+extern "C" u4_t __StackLimit[];
+extern "C" u4_t __StackTop[];
+extern "C" u4_t __data_start__[];
+extern "C" u4_t __data_end__[];
+extern "C" u4_t __bss_start__[];
+extern "C" u4_t __bss_end__[];
+#define STACK_BOTTOM ( __StackLimit + MEMSTAT_STACK_RESERVED / 4 )
+#define STACK_TOP __StackTop
+#elif !defined(__MBED__)
+#include <malloc.h>
+#define MEMSTAT_GCC 0
+#define MEMSTAT_HOST 1
+extern "C" char __data_start[];
+extern "C" char _edata[];
+extern "C" char __bss_start[];
+extern "C" char _end[];
+// Window painted by memstat_paintStack (NULL before).
+static u4_t* hostTop = NULL;
+#define STACK_BOTTOM ( hostTop - MEMSTAT_HOST_STACK / 4 )
+#define STACK_TOP hostTop
+#else
+#define MEMSTAT_GCC 0
+#define MEMSTAT_HOST 0
+#endif
+
+#if MEMSTAT_HEAP_WRAP
+extern "C" {
+void* __real_malloc (size_t size);
+void __real_free (void* ptr);
+void* __real_calloc (size_t count, size_t size);
+void* __real_realloc (void* ptr, size_t size);
+}
+#endif
+
+/*
+ * region_t structure.
+ *
+ * Static RAM owned by one subsystem.
+ */
+typedef struct {
+    const char* name;
+    u4_t size;
+} region_t;
+
+static region_t regions[MEMSTAT_MAX_REGIONS];
+static u1_t regionCount = 0;
+
+static bit_t heapArmed = 0;
+static u4_t heapBaseline = 0;
+static u4_t heapPeak = 0;
+#if MEMSTAT_HEAP_WRAP
+static u4_t heapUsed = 0;       // Bytes held by the wrapped allocator.
+static bit_t heapTripped = 0;
+#endif
+
+/*
+ * heapInUse function of type unsigned int.
+ *
+ * Input parameters: None
+ * Return: heap bytes currently allocated.
+ */
+static u4_t heapInUse (void) {
+#if MEMSTAT_HEAP_WRAP
+    return heapUsed;
+#elif MEMSTAT_GCC
+    return mallinfo( ).uordblks;
+#else
+    return 0;
+#endif
+}// end of heapInUse function.
+
+#if MEMSTAT_HEAP_WRAP
+/*
+ * heapChange function of type void.
+ *
+ * Accounts for an allocation (freed bytes first) and trips the guard
+ * beyond MEMSTAT_HEAP_LIMIT.
+ *
+ * Input parameters: unsigned int freed
+ *                   unsigned int allocated
+ */
+static void heapChange (u4_t freed, u4_t allocated) {
+    heapUsed = heapUsed - freed + allocated;
+    if( heapArmed && heapUsed > heapBaseline && heapUsed - heapBaseline > heapPeak ) {
+        heapPeak = heapUsed - heapBaseline;
+        if( heapPeak > MEMSTAT_HEAP_LIMIT && !heapTripped ) {
+            // Once only: the failure report may allocate in turn.
+            heapTripped = 1;
+            hal_failed( );
+        }
+    }
+}// end of heapChange function.
+
+/*
+ * __wrap_malloc function of type void pointer.
+ *
+ * Input parameters: size_t size
+ * Return: allocated block or NULL.
+ *
+ */
+extern "C" void* __wrap_malloc (size_t size) {
+    void* ptr = __real_malloc( size );
+    if( ptr != NULL ) {
+        heapChange( 0, malloc_usable_size( ptr ) );
+    }
+    return ptr;
+}// end of __wrap_malloc function.
+
+/*
+ * __wrap_free function of type void.
+ *
+ * Input parameters: void ptr
+ *
+ */
+extern "C" void __wrap_free (void* ptr) {
+    if( ptr != NULL ) {
+        heapChange( malloc_usable_size( ptr ), 0 );
+    }
+    __real_free( ptr );
+}// end of __wrap_free function.
+
+/*
+ * __wrap_calloc function of type void pointer.
+ *
+ * Input parameters: size_t count
+ *                   size_t size
+ * Return: allocated block or NULL.
+ *
+ */
+extern "C" void* __wrap_calloc (size_t count, size_t size) {
+    void* ptr = __real_calloc( count, size );
+    if( ptr != NULL ) {
+        heapChange( 0, malloc_usable_size( ptr ) );
+    }
+    return ptr;
+}// end of __wrap_calloc function.
+
+/*
+ * __wrap_realloc function of type void pointer.
+ *
+ * Input parameters: void ptr
+ *                   size_t size
+ * Return: reallocated block or NULL (ptr is then left as it was, unless
+ *         size is 0).
+ *
+ */
+extern "C" void* __wrap_realloc (void* ptr, size_t size) {
+    u4_t old = ptr != NULL ? malloc_usable_size( ptr ) : 0;
+    void* block = __real_realloc( ptr, size );
+    if( block != NULL ) {
+        heapChange( old, malloc_usable_size( block ) );
+    } else if( size == 0 ) {
+        heapChange( old, 0 );
+    }
+    return block;
+}// end of __wrap_realloc function.
+#endif
+
+/*
+ * memstat_paintStack function of type void.
+ *
+ * Input parameters: None
+ *
+ */
+void memstat_paintStack (void) {
+#if MEMSTAT_GCC
+    volatile u4_t* p = STACK_BOTTOM;
+    volatile u4_t* sp = (volatile u4_t*)( __get_MSP( ) - MEMSTAT_STACK_MARGIN );
+#elif MEMSTAT_HOST
+    // This frame tops the window; the red zone of the x86-64 ABI (128 bytes
+    // below the stack pointer) is left alone as well.
+    hostTop = (u4_t*)( (size_t)__builtin_frame_address( 0 ) & ~(size_t)3 );
+    volatile u4_t* p = STACK_BOTTOM;
+    volatile u4_t* sp = (volatile u4_t*)( (size_t)&p - 128 - MEMSTAT_STACK_MARGIN );
+#endif
+#if MEMSTAT_GCC || MEMSTAT_HOST
+    while( p < sp ) {
+        *p++ = MEMSTAT_STACK_PATTERN;
+    }
+#endif
+}// end of memstat_paintStack function.
+
+/*
+ * memstat_stackSize function of type unsigned int.
+ *
+ * Input parameters: None
+ * Return: size of the main stack in bytes.
+ *
+ */
+u4_t memstat_stackSize (void) {
+#if MEMSTAT_GCC
+    return (u4_t)( (u1_t*)__StackTop - (u1_t*)__StackLimit ) - MEMSTAT_STACK_RESERVED;
+#elif MEMSTAT_HOST
+    return hostTop != NULL ? MEMSTAT_HOST_STACK : 0;
+#else
+    return 0;
+#endif
+}// end of memstat_stackSize function.
+
+/*
+ * memstat_stackPeak function of type unsigned int.
+ *
+ * Input parameters: None
+ * Return: deepest stack use in bytes.
+ *
+ */
+u4_t memstat_stackPeak (void) {
+#if MEMSTAT_GCC || MEMSTAT_HOST
+#if MEMSTAT_HOST
+    if( hostTop == NULL ) {
+        return 0;
+    }
+#endif
+    const volatile u4_t* p = STACK_BOTTOM;
+    while( p < STACK_TOP && *p == MEMSTAT_STACK_PATTERN ) {
+        p++;
+    }
+    return (u4_t)( (const u1_t*)STACK_TOP - (const volatile u1_t*)p );
+#else
+    return 0;
+#endif
+}// end of memstat_stackPeak function.
+
+/*
+ * memstat_region function of type void.
+ *
+ * Input parameters: const char name
+ *                   unsigned int size
+ *
+ */
+void memstat_region (const char* name, u4_t size) {
+    for( u1_t i = 0; i < regionCount; i++ ) {
+        if( regions[i].name == name || strcmp( regions[i].name, name ) == 0 ) {
+            regions[i].size = size;
+            return;
+        }
+    }
+    if( regionCount < MEMSTAT_MAX_REGIONS ) {
+        regions[regionCount].name = name;
+        regions[regionCount].size = size;
+        regionCount++;
+    }
+}// end of memstat_region function.
+
+/*
+ * memstat_heapGuard function of type void.
+ *
+ * Input parameters: bit_t armed
+ *
+ */
+void memstat_heapGuard (bit_t armed) {
+    heapArmed = armed;
+    heapBaseline = heapInUse( );
+    heapPeak = 0;
+#if MEMSTAT_HEAP_WRAP
+    heapTripped = 0;
+#endif
+}// end of memstat_heapGuard function.
+
+/*
+ * memstat_heapGrowth function of type unsigned int.
+ *
+ * Input parameters: None
+ * Return: peak heap growth in bytes while armed.
+ *
+ */
+u4_t memstat_heapGrowth (void) {
+    if( heapArmed ) {
+        u4_t used = heapInUse( );
+        if( used > heapBaseline && used - heapBaseline > heapPeak ) {
+            heapPeak = used - heapBaseline;
+        }
+    }
+    return heapPeak;
+}// end of memstat_heapGrowth function.
+
+/*
+ * memstat_report function of type void.
+ *
+ * Input parameters: None
+ *
+ */
+void memstat_report (void) {
+    u4_t registered = 0;
+
+    printf("RAM budget:\r\n");
+    for( u1_t i = 0; i < regionCount; i++ ) {
+        printf("  %-12s %6u bytes\r\n", regions[i].name, (unsigned int)regions[i].size);
+        registered += regions[i].size;
+    }
+#if MEMSTAT_GCC || MEMSTAT_HOST
+#if MEMSTAT_GCC
+    u4_t data = (u4_t)( (u1_t*)__data_end__ - (u1_t*)__data_start__ );
+    u4_t bss = (u4_t)( (u1_t*)__bss_end__ - (u1_t*)__bss_start__ );
+#else
+    u4_t data = (u4_t)( _edata - __data_start );
+    u4_t bss = (u4_t)( _end - __bss_start );
+#endif
+    printf("  %-12s %6u bytes\r\n", "other", (unsigned int)( data + bss - registered ));
+    printf("  .data %u + .bss %u = %u bytes static\r\n",
+           (unsigned int)data, (unsigned int)bss, (unsigned int)( data + bss ));
+#endif
+    printf("  heap %u bytes in use, %u bytes allocated after start-up\r\n",
+           (unsigned int)heapInUse( ), (unsigned int)memstat_heapGrowth( ));
+    printf("  stack peak %u of %u bytes\r\n\r\n",
+           (unsigned int)memstat_stackPeak( ), (unsigned int)memstat_stackSize( ));
+}// end of memstat_report function.
@@ -0,0 +1,125 @@
+/*******************************************************************************
+ * Internet of Things (IoT) smart monitoring
+ * device for agriculture using LoRaWAN technology.
+ *
+ * Static memory budget and stack high-water instrumentation.
+ *
+ * - The unused part of the main stack is painted with MEMSTAT_STACK_PATTERN
+ * at start-up. The deepest overwritten word gives the stack high-water mark.
+ * The bottom MEMSTAT_STACK_RESERVED bytes hold the crash record (SEE
+ * recovery.h) and are neither painted nor counted as stack.
+ *
+ * - Subsystems register the static RAM they own, so that the peak RAM use
+ * can be reported per subsystem next to the linker's .data/.bss totals.
+ *
+ * - Once armed, the heap guard tracks any growth of the heap in use, since
+ * the application is meant to run without dynamic allocation after start-up.
+ * Built with MEMSTAT_HEAP_WRAP 1, malloc, free, calloc and realloc are
+ * wrapped at link time, so that the peak counts every allocation, however
+ * short-lived, and the guard trips (hal_failed) as soon as the heap grows
+ * more than MEMSTAT_HEAP_LIMIT bytes beyond the start-up baseline. Otherwise
+ * the heap in use is only sampled (newlib's mallinfo) when read.
+ *
+ * - Host builds have no linker script symbols: the stack is a
+ * MEMSTAT_HOST_STACK window below the stack pointer of memstat_paintStack
+ * and .data/.bss come from the GNU ld symbols (_edata, _end, ...).
+ *
+ *******************************************************************************/
+#ifndef _memstat_hpp_
+#define _memstat_hpp_
+
+#include "lmic.h"
+
+// Word used to paint the unused stack.
+#define MEMSTAT_STACK_PATTERN 0xA5A5A5A5
+
+// Bytes below the current stack pointer left unpainted.
+#define MEMSTAT_STACK_MARGIN 64
+
+// Bytes at the bottom of the main stack kept for the crash record.
+#define MEMSTAT_STACK_RESERVED 128
+
+// Maximum number of registered RAM regions.
+#define MEMSTAT_MAX_REGIONS 12
+
+// Set to 1 when linking with memstat.json (mbed compile --profile release
+// --profile memstat.json), which wraps the allocator:
+// -Wl,--wrap,malloc,--wrap,free,--wrap,calloc,--wrap,realloc.
+#ifndef MEMSTAT_HEAP_WRAP
+#define MEMSTAT_HEAP_WRAP 0
+#endif
+
+// Heap bytes the application may allocate beyond the start-up baseline
+// while the guard is armed (MEMSTAT_HEAP_WRAP 1 only).
+#ifndef MEMSTAT_HEAP_LIMIT
+#define MEMSTAT_HEAP_LIMIT 0
+#endif
+
+// Stack window painted on host builds, in bytes.
+#define MEMSTAT_HOST_STACK 65536
+
+/*
+ * memstat_paintStack function of type void.
+ *
+ * Paints the unused stack. Call first thing in main.
+ *
+ * Input parameters: None
+ */
+void memstat_paintStack (void);
+
+/*
+ * memstat_stackSize function of type unsigned int.
+ *
+ * Input parameters: None
+ * Return: size of the main stack in bytes (0 if unknown).
+ */
+u4_t memstat_stackSize (void);
+
+/*
+ * memstat_stackPeak function of type unsigned int.
+ *
+ * Input parameters: None
+ * Return: deepest stack use in bytes since memstat_paintStack.
+ */
+u4_t memstat_stackPeak (void);
+
+/*
+ * memstat_region function of type void.
+ *
+ * Registers (or updates) the static RAM owned by a subsystem.
+ *
+ * Input parameters: const char name (string literal)
+ *                   unsigned int size
+ */
+void memstat_region (const char* name, u4_t size);
+
+/*
+ * memstat_heapGuard function of type void.
+ *
+ * Arms (1) the no-heap guard, taking the heap currently in use as the
+ * start-up baseline, or disarms it (0).
+ *
+ * Input parameters: bit_t armed
+ */
+void memstat_heapGuard (bit_t armed);
+
+/*
+ * memstat_heapGrowth function of type unsigned int.
+ *
+ * Input parameters: None
+ * Return: peak heap bytes allocated beyond the baseline while armed
+ *         (0 if none or if the C library offers no heap statistics).
+ */
+u4_t memstat_heapGrowth (void);
+
+/*
+ * memstat_report function of type void.
+ *
+ * Writes the RAM budget (per subsystem, .data/.bss, heap, stack peak)
+ * to the UART.
+ *
+ * Input parameters: None
+ */
+void memstat_report (void);
+
+#endif // _memstat_hpp_
@@ -0,0 +1,535 @@
+/*******************************************************************************
+ * Internet of Things (IoT) smart monitoring
+ * device for agriculture using LoRaWAN technology.
+ *
+ * Persistent session and sample-buffer journal.
+ *
+ * Record layout (PERSIST_RECORD_SIZE bytes, little-endian):
+ *   0  magic (2)   2  type (1)   3  sample count (1)   4  sequence (4)
+ *   8  body        PERSIST_RECORD_SIZE-2  CRC-16 over all previous bytes
+ *
+ * State body:   device address (4), reserved uplink counter (4),
+ *               downlink counter (4), encoded samples (8 each).
+ * Session body: network id (4), device address (4), NwkSKey (16), AppSKey (16).
+ *
+ * SEE persist.h file for the description of each function.
+ *
+ *******************************************************************************/
+
+#include "mbed.h"
+#include "lmic.h"
+#include "samples.h"
+#include "persist.h"
+#include "memstat.h"
+
+#define PERSIST_MAGIC        0x4A4C
+#define PERSIST_TYPE_STATE   1
+#define PERSIST_TYPE_SESSION 2
+
+// Record header offsets.
+#define REC_MAGIC 0
+#define REC_TYPE  2
+#define REC_COUNT 3
+#define REC_SEQ   4
+#define REC_BODY  8
+#define REC_CRC   ( PERSIST_RECORD_SIZE - 2 )
+
+// State body offsets.
+#define ST_DEVADDR ( REC_BODY + 0 )
+#define ST_SEQNOUP ( REC_BODY + 4 )
+#define ST_SEQNODN ( REC_BODY + 8 )
+#define ST_SAMPLES ( REC_BODY + 12 )
+
+// Session body offsets.
+#define SS_NETID   ( REC_BODY + 0 )
+#define SS_DEVADDR ( REC_BODY + 4 )
+#define SS_NWKKEY  ( REC_BODY + 8 )
+#define SS_ARTKEY  ( REC_BODY + 24 )
+
+#if PERSIST_SECTORS < 2
+#error "The journal needs a sector to erase ahead"
+#endif
+
+#if ST_SAMPLES + PERSIST_MAX_SAMPLES * SAMPLE_FRAME_LENGTH > REC_CRC
+#error "PERSIST_MAX_SAMPLES does not fit into PERSIST_RECORD_SIZE"
+#endif
+
+#if DEVICE_FLASH
+static FlashIAP flash;
+#endif
+
+static bit_t ready = 0;        // journal opened successfully
+static u4_t base = 0;          // address of the first journal sector
+static u4_t limit = 0;         // address following the last journal sector
+static u4_t sectorSize = 0;    // flash sector size
+static u4_t nextSlot = 0;      // next record slot to be written
+static u4_t seq = 0;           // sequence number of the newest record
+static u4_t stateAddr = 0;     // newest state record (0 if none)
+static u4_t sessionAddr = 0;   // newest session record (0 if none)
+static u4_t seqnoLimit = 0;    // first uplink counter not yet reserved
+
+// Last state record written (or restored), compared against by persist_checkpoint.
+static u1_t image[PERSIST_RECORD_SIZE];
+
+/*
+ * crc16 function of type unsigned short.
+ *
+ * CRC-16/CCITT-FALSE over len bytes of buf.
+ *
+ * Input parameters: const unsigned char buf
+ *                   unsigned short len
+ * Return: crc value
+ */
+static u2_t crc16 (const u1_t* buf, u2_t len) {
+    u2_t crc = 0xFFFF;
+    while( len-- ) {
+        crc ^= (u2_t)( *buf++ << 8 );
+        for( u1_t i = 0; i < 8; i++ ) {
+            crc = ( crc & 0x8000 ) ? (u2_t)( ( crc << 1 ) ^ 0x1021 ) : (u2_t)( crc << 1 );
+        }
+    }
+    return crc;
+}// end of crc16 function.
+
+/*
+ * readRecord function of type unsigned char.
+ *
+ * Input parameters: unsigned int addr
+ *                   unsigned char rec
+ * Return: record type, or 0 if the slot holds no valid record.
+ */
+static u1_t readRecord (u4_t addr, u1_t* rec) {
+#if DEVICE_FLASH
+    if( flash.read( rec, addr, PERSIST_RECORD_SIZE ) != 0 ) {
+        return 0;
+    }
+    if( os_rlsbf2( rec + REC_MAGIC ) != PERSIST_MAGIC ||
+        os_rlsbf2( rec + REC_CRC ) != crc16( rec, REC_CRC ) ) {
+        return 0;
+    }
+    return rec[REC_TYPE];
+#else
+    (void)addr;
+    (void)rec;
+    return 0;
+#endif
+}// end of readRecord function.
+
+/*
+ * slotBlank function of type bit_t.
+ *
+ * Input parameters: unsigned int addr
+ * Return: 1 if the slot is erased, 0 otherwise.
+ */
+static bit_t slotBlank (u4_t addr) {
+#if DEVICE_FLASH
+    u1_t rec[PERSIST_RECORD_SIZE];
+    if( flash.read( rec, addr, PERSIST_RECORD_SIZE ) != 0 ) {
+        return 0;
+    }
+    for( u1_t i = 0; i < PERSIST_RECORD_SIZE; i++ ) {
+        if( rec[i] != 0xFF ) {
+            return 0;
+        }
+    }
+    return 1;
+#else
+    (void)addr;
+    return 0;
+#endif
+}// end of slotBlank function.
+
+/*
+ * sectorOf function of type unsigned int.
+ *
+ * Input parameters: unsigned int addr
+ * Return: address of the journal sector holding addr.
+ */
+static u4_t sectorOf (u4_t addr) {
+    return base + ( addr - base ) / sectorSize * sectorSize;
+}// end of sectorOf function.
+
+/*
+ * sectorBlank function of type bit_t.
+ *
+ * Input parameters: unsigned int sector
+ * Return: 1 if every slot of the sector is erased, 0 otherwise.
+ */
+static bit_t sectorBlank (u4_t sector) {
+    for( u4_t addr = sector; addr < sector + sectorSize; addr += PERSIST_RECORD_SIZE ) {
+        if( !slotBlank( addr ) ) {
+            return 0;
+        }
+    }
+    return 1;
+}// end of sectorBlank function.
+
+/*
+ * advance function of type void.
+ *
+ * Moves nextSlot to the following slot, wrapping around the journal.
+ *
+ * Input parameters: None
+ */
+static void advance (void) {
+    nextSlot += PERSIST_RECORD_SIZE;
+    if( nextSlot >= limit ) {
+        nextSlot = base;
+    }
+}// end of advance function.
+
+/*
+ * programSlot function of type bit_t.
+ *
+ * Programs rec into the slot at addr and reads it back.
+ *
+ * Input parameters: unsigned int addr
+ *                   const unsigned char rec
+ * Return: 1 on success, 0 otherwise.
+ */
+static bit_t programSlot (u4_t addr, const u1_t* rec) {
+#if DEVICE_FLASH
+    u1_t check[PERSIST_RECORD_SIZE];
+    if( flash.program( rec, addr, PERSIST_RECORD_SIZE ) != 0 ) {
+        return 0;
+    }
+    return readRecord( addr, check ) == rec[REC_TYPE] &&
+           memcmp( check, rec, PERSIST_RECORD_SIZE ) == 0;
+#else
+    (void)addr;
+    (void)rec;
+    return 0;
+#endif
+}// end of programSlot function.
+
+/*
+ * eraseSlots function of type bit_t.
+ *
+ * Input parameters: unsigned int sector
+ * Return: 1 if the sector has been erased, 0 otherwise.
+ */
+static bit_t eraseSlots (u4_t sector) {
+#if DEVICE_FLASH
+    return flash.erase( sector, sectorSize ) == 0;
+#else
+    (void)sector;
+    return 0;
+#endif
+}// end of eraseSlots function.
+
+/*
+ * appendRecord function of type unsigned int.
+ *
+ * Stamps rec with the next sequence number and CRC and programs it into
+ * the next blank slot of sector, skipping torn or failed slots.
+ *
+ * Input parameters: unsigned char rec
+ *                   unsigned int sector
+ * Return: address of the written record, or 0 if sector is full.
+ */
+static u4_t appendRecord (u1_t* rec, u4_t sector) {
+    os_wlsbf2( rec + REC_MAGIC, PERSIST_MAGIC );
+    os_wlsbf4( rec + REC_SEQ, seq + 1 );
+    os_wlsbf2( rec + REC_CRC, crc16( rec, REC_CRC ) );
+
+    while( sectorOf( nextSlot ) == sector ) {
+        u4_t addr = nextSlot;
+        advance( );
+        if( slotBlank( addr ) && programSlot( addr, rec ) ) {
+            seq++;
+            return addr;
+        }
+    }
+    return 0;
+}// end of appendRecord function.
+
+/*
+ * carryOver function of type bit_t.
+ *
+ * Copies the newest record of type into sector if it lives in the sector
+ * at from.
+ *
+ * Input parameters: unsigned int from
+ *                   unsigned int sector
+ *                   unsigned char type
+ *                   unsigned int newest (address of the newest record of type)
+ * Return: 0 if the record could not be copied, 1 otherwise.
+ */
+static bit_t carryOver (u4_t from, u4_t sector, u1_t type, u4_t* newest) {
+    u1_t rec[PERSIST_RECORD_SIZE];
+
+    if( *newest == 0 || sectorOf( *newest ) != from || readRecord( *newest, rec ) != type ) {
+        return 1;
+    }
+    u4_t addr = appendRecord( rec, sector );
+    if( addr == 0 ) {
+        return 0;
+    }
+    *newest = addr;
+    return 1;
+}// end of carryOver function.
+
+/*
+ * eraseAhead function of type void.
+ *
+ * Keeps the sector following sector erased for the journal to move on to.
+ * The newest record of each type still living there is copied into sector
+ * before it is erased, so that a power loss at any point leaves either the
+ * record or its copy.
+ *
+ * Input parameters: unsigned int sector
+ */
+static void eraseAhead (u4_t sector) {
+    u4_t ahead = sector + sectorSize >= limit ? base : sector + sectorSize;
+
+    if( sectorBlank( ahead ) ) {
+        return;
+    }
+    if( carryOver( ahead, sector, PERSIST_TYPE_SESSION, &sessionAddr ) &&
+        carryOver( ahead, sector, PERSIST_TYPE_STATE, &stateAddr ) ) {
+        eraseSlots( ahead );
+    }
+}// end of eraseAhead function.
+
+/*
+ * eraseSector function of type void.
+ *
+ * Erases the sector the journal is moving on to when it was not erased
+ * ahead (power loss during eraseAhead, or a journal written by an earlier
+ * firmware). The newest record of each type still living there is held in
+ * RAM and written back after the erase.
+ *
+ * Input parameters: unsigned int sector
+ */
+static void eraseSector (u4_t sector) {
+    u1_t stateRec[PERSIST_RECORD_SIZE];
+    u1_t sessionRec[PERSIST_RECORD_SIZE];
+    bit_t keepState = stateAddr != 0 && sectorOf( stateAddr ) == sector &&
+                      readRecord( stateAddr, stateRec ) == PERSIST_TYPE_STATE;
+    bit_t keepSession = sessionAddr != 0 && sectorOf( sessionAddr ) == sector &&
+                        readRecord( sessionAddr, sessionRec ) == PERSIST_TYPE_SESSION;
+
+    if( !eraseSlots( sector ) ) {
+        return;
+    }
+    if( keepSession ) {
+        sessionAddr = appendRecord( sessionRec, sector );
+    }
+    if( keepState ) {
+        stateAddr = appendRecord( stateRec, sector );
+    }
+}// end of eraseSector function.
+
+/*
+ * writeRecord function of type unsigned int.
+ *
+ * Appends rec to the journal as the newest record of its type. On entering
+ * a sector, the following one is erased ahead once rec is written.
+ *
+ * Input parameters: unsigned char rec
+ * Return: address of the written record, or 0 on failure.
+ */
+static u4_t writeRecord (u1_t* rec) {
+    if( !ready ) {
+        return 0;
+    }
+    for( u1_t n = 0; n < PERSIST_SECTORS; n++ ) {
+        u4_t sector = sectorOf( nextSlot );
+        bit_t entering = nextSlot == sector;
+        if( entering && !sectorBlank( sector ) ) {
+            eraseSector( sector );
+        }
+        u4_t addr = appendRecord( rec, sector );
+        if( addr != 0 ) {
+            if( rec[REC_TYPE] == PERSIST_TYPE_STATE ) {
+                stateAddr = addr;
+            } else {
+                sessionAddr = addr;
+            }
+            if( entering ) {
+                eraseAhead( sector );
+            }
+            return addr;
+        }
+    }
+    return 0;
+}// end of writeRecord function.
+
+/*
+ * persist_init function of type void.
+ *
+ * Input parameters: None
+ *
+ */
+void persist_init (void) {
+    ready = 0;
+    seq = 0;
+    stateAddr = 0;
+    sessionAddr = 0;
+    seqnoLimit = 0;
+    memset( image, 0, sizeof( image ) );
+
+#if DEVICE_FLASH
+    u1_t rec[PERSIST_RECORD_SIZE];
+    u4_t newest = 0;
+    u4_t stateSeq = 0;
+    u4_t sessionSeq = 0;
+
+    memstat_region( "persist", sizeof( image ) + sizeof( flash ) );
+    if( flash.init( ) != 0 ) {
+        return;
+    }
+    limit = flash.get_flash_start( ) + flash.get_flash_size( );
+    sectorSize = flash.get_sector_size( limit - 1 );
+    if( sectorSize == 0 || sectorSize % PERSIST_RECORD_SIZE != 0 ) {
+        return;
+    }
+    base = limit - PERSIST_SECTORS * sectorSize;
+
+    // Scan every slot for the newest record overall and of each type.
+    for( u4_t addr = base; addr < limit; addr += PERSIST_RECORD_SIZE ) {
+        u1_t type = readRecord( addr, rec );
+        if( type == 0 ) {
+            continue;
+        }
+        u4_t s = os_rlsbf4( rec + REC_SEQ );
+        if( newest == 0 || s > seq ) {
+            seq = s;
+            newest = addr;
+        }
+        if( type == PERSIST_TYPE_STATE && ( stateAddr == 0 || s > stateSeq ) ) {
+            stateSeq = s;
+            stateAddr = addr;
+        }
+        if( type == PERSIST_TYPE_SESSION && ( sessionAddr == 0 || s > sessionSeq ) ) {
+            sessionSeq = s;
+            sessionAddr = addr;
+        }
+    }
+    ready = 1;
+    nextSlot = newest;
+    if( newest == 0 ) {
+        nextSlot = base;
+    } else {
+        advance( );
+    }
+    // Finish an erase ahead cut short by a power loss.
+    if( nextSlot != sectorOf( nextSlot ) ) {
+        eraseAhead( sectorOf( nextSlot ) );
+    }
+#endif
+}// end of persist_init function.
+
+/*
+ * persist_restore function of type bit_t.
+ *
+ * Input parameters: None
+ * Return: 1 if a state record was found, 0 otherwise.
+ *
+ */
+bit_t persist_restore (void) {
+    u1_t rec[PERSIST_RECORD_SIZE];
+    sample_t sample;
+
+    if( !ready || stateAddr == 0 || readRecord( stateAddr, rec ) != PERSIST_TYPE_STATE ) {
+        return 0;
+    }
+    if( LMIC.devaddr != 0 && os_rlsbf4( rec + ST_DEVADDR ) == LMIC.devaddr ) {
+        // Any counter below the reserved one may already have been used.
+        seqnoLimit = os_rlsbf4( rec + ST_SEQNOUP );
+        LMIC.seqnoUp = seqnoLimit;
+        LMIC.seqnoDn = os_rlsbf4( rec + ST_SEQNODN );
+    }
+    for( u1_t i = 0; i < rec[REC_COUNT] && i < PERSIST_MAX_SAMPLES; i++ ) {
+        samples_decode( rec + ST_SAMPLES + i * SAMPLE_FRAME_LENGTH, &sample );
+        samples_push( &sample );
+    }
+    memcpy( image, rec, PERSIST_RECORD_SIZE );
+    return 1;
+}// end of persist_restore function.
+
+/*
+ * persist_restoreSession function of type bit_t.
+ *
+ * Input parameters: None
+ * Return: 1 if a cached session was applied, 0 otherwise.
+ *
+ */
+bit_t persist_restoreSession (void) {
+    u1_t rec[PERSIST_RECORD_SIZE];
+
+    if( !ready || sessionAddr == 0 || readRecord( sessionAddr, rec ) != PERSIST_TYPE_SESSION ) {
+        return 0;
+    }
+    LMIC_setSession( os_rlsbf4( rec + SS_NETID ), os_rlsbf4( rec + SS_DEVADDR ),
+                     rec + SS_NWKKEY, rec + SS_ARTKEY );
+    return 1;
+}// end of persist_restoreSession function.
+
+/*
+ * persist_saveSession function of type void.
+ *
+ * Input parameters: None
+ *
+ */
+void persist_saveSession (void) {
+    u1_t rec[PERSIST_RECORD_SIZE];
+
+    memset( rec, 0, sizeof( rec ) );
+    rec[REC_TYPE] = PERSIST_TYPE_SESSION;
+    os_wlsbf4( rec + SS_NETID, LMIC.netid );
+    os_wlsbf4( rec + SS_DEVADDR, LMIC.devaddr );
+    memcpy( rec + SS_NWKKEY, LMIC.nwkKey, 16 );
+    memcpy( rec + SS_ARTKEY, LMIC.artKey, 16 );
+
+    writeRecord( rec );
+    // A new session restarts the frame counters.
+    seqnoLimit = 0;
+}// end of persist_saveSession function.
+
+/*
+ * persist_checkpoint function of type void.
+ *
+ * Input parameters: None
+ *
+ */
+void persist_checkpoint (void) {
+    u1_t rec[PERSIST_RECORD_SIZE];
+    u4_t reserved = seqnoLimit;
+    u1_t count = samples_count( );
+
+    if( !ready ) {
+        return;
+    }
+    // Reserve the next block of uplink counters once the current one is used up.
+    if( LMIC.devaddr != 0 && ( LMIC.seqnoUp >= seqnoLimit ||
+                               os_rlsbf4( image + ST_DEVADDR ) != LMIC.devaddr ) ) {
+        reserved = LMIC.seqnoUp + PERSIST_SEQNO_STEP;
+    }
+    // Keep the newest samples if the queue holds more than a record can.
+    if( count > PERSIST_MAX_SAMPLES ) {
+        count = PERSIST_MAX_SAMPLES;
+    }
+
+    memset( rec, 0, sizeof( rec ) );
+    rec[REC_TYPE] = PERSIST_TYPE_STATE;
+    rec[REC_COUNT] = count;
+    os_wlsbf4( rec + ST_DEVADDR, LMIC.devaddr );
+    os_wlsbf4( rec + ST_SEQNOUP, reserved );
+    os_wlsbf4( rec + ST_SEQNODN, LMIC.seqnoDn );
+    for( u1_t i = 0; i < count; i++ ) {
+        samples_encode( samples_at( samples_count( ) - count + i ),
+                        rec + ST_SAMPLES + i * SAMPLE_FRAME_LENGTH );
+    }
+
+    // Nothing to do if the durable image is unchanged.
+    if( image[REC_TYPE] == PERSIST_TYPE_STATE && image[REC_COUNT] == count &&
+        memcmp( rec + REC_BODY, image + REC_BODY, REC_CRC - REC_BODY ) == 0 ) {
+        return;
+    }
+
+    if( writeRecord( rec ) != 0 ) {
+        seqnoLimit = reserved;
+        memcpy( image, rec, PERSIST_RECORD_SIZE );
+    }
+}// end of persist_checkpoint function.
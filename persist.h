@@ -0,0 +1,93 @@
+/*******************************************************************************
+ * Internet of Things (IoT) smart monitoring
+ * device for agriculture using LoRaWAN technology.
+ *
+ * Persistent session and sample-buffer journal.
+ *
+ * - Frame counters, OTAA session parameters and the pending-sample queue
+ * are kept in a wear-leveled journal occupying the last PERSIST_SECTORS
+ * sectors of the internal flash.
+ *
+ * - Records are appended sequentially and never rewritten in place. The
+ * sector following the one being written is kept erased ahead: the latest
+ * records it still holds are copied forward before it is erased, so that a
+ * power loss at any point never loses them.
+ *
+ * - The uplink frame counter is reserved PERSIST_SEQNO_STEP frames ahead,
+ * so that a record is written only once every PERSIST_SEQNO_STEP uplinks or
+ * when the pending-sample queue actually changes.
+ *
+ *******************************************************************************/
+#ifndef _persist_hpp_
+#define _persist_hpp_
+
+#include "lmic.h"
+
+// Number of flash sectors reserved for the journal at the end of flash
+// (at least 2, one being kept erased).
+#define PERSIST_SECTORS 4
+
+// Size of a journal record in bytes (multiple of the flash program unit).
+#define PERSIST_RECORD_SIZE 64
+
+// Number of uplink frame counters reserved by each journal write.
+#define PERSIST_SEQNO_STEP 16
+
+// Maximum number of pending samples kept in the journal: the newest ones,
+// stored oldest first.
+#define PERSIST_MAX_SAMPLES 5
+
+/*
+ * persist_init function of type void.
+ *
+ * Opens the flash journal and locates the latest state and session
+ * records as well as the next free record slot.
+ *
+ * Input parameters: None
+ */
+void persist_init (void);
+
+/*
+ * persist_restore function of type bit_t.
+ *
+ * Re-queues the pending samples of the latest state record. Frame counters
+ * are restored only if the record belongs to the active session (same
+ * device address), which must therefore be set up beforehand.
+ *
+ * Input parameters: None
+ * Return: 1 if a state record was found, 0 otherwise.
+ */
+bit_t persist_restore (void);
+
+/*
+ * persist_restoreSession function of type bit_t.
+ *
+ * Applies the session cached by persist_saveSession through LMIC_setSession,
+ * so that an OTAA device does not have to join again after a reset.
+ *
+ * Input parameters: None
+ * Return: 1 if a cached session was applied, 0 otherwise.
+ */
+bit_t persist_restoreSession (void);
+
+/*
+ * persist_saveSession function of type void.
+ *
+ * Caches the session established by an OTAA join (network id, device
+ * address, network and application session keys).
+ *
+ * Input parameters: None
+ */
+void persist_saveSession (void);
+
+/*
+ * persist_checkpoint function of type void.
+ *
+ * Writes a state record if the durable image (reserved frame counters and
+ * pending samples) differs from the last one written.
+ *
+ * Input parameters: None
+ */
+void persist_checkpoint (void);
+
+#endif // _persist_hpp_
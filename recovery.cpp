@@ -0,0 +1,335 @@
+/*******************************************************************************
+ * Internet of Things (IoT) smart monitoring
+ * device for agriculture using LoRaWAN technology.
+ *
+ * Watchdog-supervised fault recovery.
+ *
+ * The crash record is sealed with a checksum, so that the random RAM content
+ * found after a power-on is never taken for a record.
+ *
+ * SEE recovery.h file for the description of each function.
+ *
+ *******************************************************************************/
+
+#if defined(__MBED__)
+#include "mbed.h"
+#else
+#include <stdio.h>
+#include <stddef.h>
+#include <string.h>
+#include <signal.h>
+#include <sys/time.h>
+#endif
+#include "lmic.h"
+#include "samples.h"
+#include "memstat.h"
+#include "recovery.h"
+
+#if defined(__GNUC__) && !defined(__CC_ARM) && defined(__MBED__)
+#include <errno.h>
+#include <stddef.h>
+#include <reent.h>
+extern "C" u4_t __StackLimit[];
+// Heap break of the mbed 2 C library (retarget.cpp).
+extern "C" void* _sbrk (int incr);
+#define RECOVERY_STACK 1
+#else
+#define RECOVERY_STACK 0
+#endif
+
+// Marks a sealed crash record.
+#define RECOVERY_MAGIC 0x52435652
+
+/*
+ * crash_record_t structure.
+ *
+ * State carried over a warm reset.
+ */
+typedef struct {
+    u4_t magic;                          // RECOVERY_MAGIC once sealed.
+    u4_t resets;                         // Recoveries since power-on.
+    u4_t pc;                             // Address of the fault.
+    u4_t uptime;                         // Milliseconds from boot to the fault.
+    u1_t cause;                          // Cause of the fault (RECOVERY_NONE if none).
+    u1_t count;                          // Pending samples held.
+    sample_t queue[SAMPLES_QUEUE_SIZE];  // Pending samples, oldest first.
+    u4_t check;                          // Checksum of the fields above.
+} crash_record_t;
+
+// Bottom of the main stack, left alone by the start-up code (SEE memstat.h).
+#if RECOVERY_STACK
+static crash_record_t& record = *(crash_record_t*)__StackLimit;
+#else
+static crash_record_t record;
+#endif
+// The record must fit into the reserved bottom of the stack.
+typedef char recovery_reserved_t[sizeof( crash_record_t ) <= MEMSTAT_STACK_RESERVED ? 1 : -1];
+
+#if RECOVERY_STACK
+/*
+ * _sbrk_r function of type void pointer.
+ *
+ * Replaces newlib's _sbrk_r, through which malloc grows the heap. The mbed 2
+ * _sbrk lets the heap grow up to the stack pointer, across the crash record;
+ * the heap is kept below __StackLimit instead.
+ *
+ * Input parameters: struct _reent r
+ *                   ptrdiff_t incr
+ * Return: previous heap break, or (void*)-1 with ENOMEM.
+ *
+ */
+extern "C" void* _sbrk_r (struct _reent* r, ptrdiff_t incr) {
+    u1_t* brk = (u1_t*)_sbrk( 0 );
+
+    if( incr > 0 && brk + incr > (u1_t*)__StackLimit ) {
+        r->_errno = ENOMEM;
+        return (void*)-1;
+    }
+    errno = 0;
+    void* prev = _sbrk( (int)incr );
+    if( prev == (void*)-1 && errno != 0 ) {
+        r->_errno = errno;
+    }
+    return prev;
+}// end of _sbrk_r function.
+#endif
+
+static bit_t warm = 0;            // Set after a warm restart.
+static bit_t measuring = 0;       // Set until the first uplink after a warm restart.
+static u1_t lastCause = RECOVERY_NONE;
+static u4_t lastPc = 0;
+static u4_t lastUptime = 0;
+static ostime_t bootTime = 0;     // Time of recovery_start.
+static u4_t faultToUplink = 0;    // Milliseconds from the last fault to the next uplink.
+
+#if !defined(__MBED__)
+sigjmp_buf recovery_restart;
+#endif
+
+/*
+ * checksum function of type unsigned int.
+ *
+ * Input parameters: None
+ * Return: checksum of the crash record fields preceding check.
+ */
+static u4_t checksum (void) {
+    const u1_t* p = (const u1_t*)&record;
+    u4_t sum = 0;
+
+    for( u2_t i = 0; i < offsetof( crash_record_t, check ); i++ ) {
+        sum = ( ( sum << 5 ) | ( sum >> 27 ) ) ^ p[i];
+    }
+    return sum;
+}// end of checksum function.
+
+/*
+ * seal function of type void.
+ *
+ * Marks the crash record valid.
+ *
+ * Input parameters: None
+ */
+static void seal (void) {
+    record.magic = RECOVERY_MAGIC;
+    record.check = checksum( );
+}// end of seal function.
+
+/*
+ * recovery_start function of type void.
+ *
+ * Input parameters: None
+ *
+ */
+void recovery_start (void) {
+    bit_t valid = record.magic == RECOVERY_MAGIC && record.check == checksum( );
+    u1_t cause = valid ? record.cause : (u1_t)RECOVERY_NONE;
+
+#if defined(TARGET_K64F)
+    // A hang leaves no cause behind; the reset cause tells the watchdog.
+    if( valid && cause == RECOVERY_NONE && ( RCM->SRS0 & RCM_SRS0_WDOG_MASK ) ) {
+        cause = RECOVERY_WATCHDOG;
+    }
+#endif
+    bootTime = os_getTime( );
+    warm = ( cause != RECOVERY_NONE );
+    if( warm ) {
+        record.resets++;
+        lastCause = cause;
+        lastPc = record.pc;
+        lastUptime = record.uptime;
+        measuring = 1;
+    } else {
+        memset( &record, 0, sizeof( record ) );
+    }
+    record.cause = RECOVERY_NONE;
+    record.pc = 0;
+    seal( );
+    memstat_region( "crash record", sizeof( record ) );
+}// end of recovery_start function.
+
+/*
+ * recovery_restore function of type bit_t.
+ *
+ * Input parameters: None
+ * Return: 1 if samples were restored.
+ *
+ */
+bit_t recovery_restore (void) {
+    if( !warm || record.count == 0 ) {
+        return 0;
+    }
+    samples_init( );
+    for( u1_t i = 0; i < record.count; i++ ) {
+        // Acquisition times refer to the clock before the reset.
+        sample_t s = record.queue[i];
+        s.taken = 0;
+        samples_push( &s );
+    }
+    return 1;
+}// end of recovery_restore function.
+
+/*
+ * recovery_save function of type void.
+ *
+ * Input parameters: None
+ *
+ */
+void recovery_save (void) {
+    record.count = samples_count( );
+    for( u1_t i = 0; i < record.count; i++ ) {
+        record.queue[i] = *samples_at( i );
+    }
+    seal( );
+}// end of recovery_save function.
+
+#if !defined(__MBED__)
+/*
+ * watchdogSignal function of type void.
+ *
+ * Host watchdog timeout.
+ *
+ * Input parameters: int sig
+ */
+static void watchdogSignal (int sig) {
+    (void)sig;
+    recovery_fail( RECOVERY_WATCHDOG, 0 );
+}// end of watchdogSignal function.
+
+/*
+ * armTimer function of type void.
+ *
+ * Input parameters: unsigned int ms (0 stops the host watchdog)
+ */
+static void armTimer (u4_t ms) {
+    struct itimerval t;
+
+    memset( &t, 0, sizeof( t ) );
+    t.it_value.tv_sec = ms / 1000;
+    t.it_value.tv_usec = ( ms % 1000 ) * 1000;
+    setitimer( ITIMER_REAL, &t, NULL );
+}// end of armTimer function.
+#endif
+
+/*
+ * recovery_watchdog function of type void.
+ *
+ * Input parameters: None
+ *
+ */
+void recovery_watchdog (void) {
+#if defined(TARGET_K64F)
+    // The unlock sequence and the update must follow each other closely.
+    __disable_irq( );
+    WDOG->UNLOCK = 0xC520;
+    WDOG->UNLOCK = 0xD928;
+    // 1 kHz LPO clock: the timeout value is in milliseconds.
+    WDOG->PRESC = 0;
+    WDOG->TOVALH = RECOVERY_TIMEOUT >> 16;
+    WDOG->TOVALL = RECOVERY_TIMEOUT & 0xFFFF;
+    WDOG->STCTRLH = WDOG_STCTRLH_WDOGEN_MASK | WDOG_STCTRLH_ALLOWUPDATE_MASK |
+                    WDOG_STCTRLH_WAITEN_MASK | WDOG_STCTRLH_STOPEN_MASK;
+    __enable_irq( );
+#elif !defined(__MBED__)
+    signal( SIGALRM, watchdogSignal );
+    armTimer( RECOVERY_TIMEOUT );
+#endif
+}// end of recovery_watchdog function.
+
+/*
+ * recovery_kick function of type void.
+ *
+ * Input parameters: None
+ *
+ */
+void recovery_kick (void) {
+#if defined(TARGET_K64F)
+    __disable_irq( );
+    WDOG->REFRESH = 0xA602;
+    WDOG->REFRESH = 0xB480;
+    __enable_irq( );
+#elif !defined(__MBED__)
+    armTimer( RECOVERY_TIMEOUT );
+#endif
+}// end of recovery_kick function.
+
+/*
+ * recovery_fail function of type void.
+ *
+ * Input parameters: unsigned char cause
+ *                   unsigned int pc
+ *
+ */
+void recovery_fail (u1_t cause, u4_t pc) {
+    record.cause = cause;
+    record.pc = pc;
+    record.uptime = osticks2ms( os_getTime( ) - bootTime );
+    seal( );
+#if defined(__MBED__)
+    NVIC_SystemReset( );
+    while( 1 );
+#else
+    armTimer( 0 );
+    siglongjmp( recovery_restart, 1 );
+#endif
+}// end of recovery_fail function.
+
+/*
+ * recovery_count function of type unsigned int.
+ *
+ * Input parameters: None
+ * Return: recoveries since power-on.
+ *
+ */
+u4_t recovery_count (void) {
+    return record.resets;
+}// end of recovery_count function.
+
+/*
+ * recovery_uplink function of type void.
+ *
+ * Input parameters: ostime_t airTime
+ *
+ */
+void recovery_uplink (ostime_t airTime) {
+    if( !measuring ) {
+        return;
+    }
+    // A hang is only noticed once the watchdog times out.
+    faultToUplink = osticks2ms( airTime - bootTime ) + ( lastCause == RECOVERY_WATCHDOG ? RECOVERY_TIMEOUT : 0 );
+    measuring = 0;
+}// end of recovery_uplink function.
+
+/*
+ * recovery_report function of type void.
+ *
+ * Input parameters: None
+ *
+ */
+void recovery_report (void) {
+    if( record.resets == 0 ) {
+        return;
+    }
+    printf("Recovery: %u resets, last %s at %08X after %u ms up, next uplink %u ms after the fault\r\n",
+           (unsigned int)record.resets, lastCause == RECOVERY_WATCHDOG ? "watchdog timeout" : "assertion",
+           (unsigned int)lastPc, (unsigned int)lastUptime, (unsigned int)faultToUplink);
+}// end of recovery_report function.
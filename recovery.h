@@ -0,0 +1,144 @@
+/*******************************************************************************
+ * Internet of Things (IoT) smart monitoring
+ * device for agriculture using LoRaWAN technology.
+ *
+ * Watchdog-supervised fault recovery.
+ *
+ * - A crash record is kept in RAM that the start-up code neither zeroes nor
+ * initialises, so that it survives a warm reset. With GCC_ARM this is the
+ * bottom of the main stack (__StackLimit), set aside by memstat.h and only
+ * reached by a stack overflow, which the checksum of the record rejects; the
+ * mbed 2 linker scripts have no .noinit section. The heap, which the mbed 2
+ * _sbrk lets grow up to the stack pointer, is kept below __StackLimit by
+ * the _sbrk_r of recovery.cpp. With other toolchains the
+ * record is plain .bss: every reset is a cold start and the pending samples
+ * come from the flash journal. The record holds the cause and address of
+ * the last fault, the number of recoveries since power-on and a copy of the
+ * pending-sample queue, refreshed by recovery_save whenever the queue
+ * changes.
+ *
+ * - hal_failed (any LMiC assertion) calls recovery_fail, which completes the
+ * record and resets the MCU at once instead of hanging. A hang anywhere else
+ * is caught by the K64F watchdog (WDOG) after RECOVERY_TIMEOUT milliseconds
+ * without recovery_kick, and is told apart by the reset cause (RCM).
+ *
+ * - After the warm restart the pending samples are restored from the record,
+ * which is newer than the flash journal, and the time from the fault to the
+ * next completed uplink is measured.
+ *
+ * - Host builds stand in for the reset with a jump back to the restart point
+ * in main (recovery_restart) and for the watchdog with an interval timer, so
+ * that recovery can be exercised with FAULT_INJECT (SEE config.h).
+ *
+ *******************************************************************************/
+#ifndef _recovery_hpp_
+#define _recovery_hpp_
+
+#include "lmic.h"
+#if !defined(__MBED__)
+#include <setjmp.h>
+#endif
+
+// Watchdog timeout in milliseconds.
+#ifndef RECOVERY_TIMEOUT
+#define RECOVERY_TIMEOUT 4000
+#endif
+
+// Fault causes.
+enum {
+    RECOVERY_NONE = 0,   // Power-on or reset button.
+    RECOVERY_ASSERT,     // hal_failed, e.g. LMiC assertion.
+    RECOVERY_WATCHDOG    // Watchdog timeout.
+};
+
+#if !defined(__MBED__)
+// Restart point of host builds, set in main, standing in for the MCU reset.
+extern sigjmp_buf recovery_restart;
+#endif
+
+/*
+ * recovery_start function of type void.
+ *
+ * Checks the crash record at boot: keeps it after a fault (warm restart)
+ * and clears it after a power-on (cold start).
+ *
+ * Input parameters: None
+ */
+void recovery_start (void);
+
+/*
+ * recovery_restore function of type bit_t.
+ *
+ * Replaces the pending-sample queue with the copy kept in the crash record
+ * after a warm restart.
+ *
+ * Input parameters: None
+ * Return: 1 if samples were restored, 0 otherwise.
+ */
+bit_t recovery_restore (void);
+
+/*
+ * recovery_save function of type void.
+ *
+ * Copies the pending-sample queue into the crash record.
+ *
+ * Input parameters: None
+ */
+void recovery_save (void);
+
+/*
+ * recovery_watchdog function of type void.
+ *
+ * Starts the watchdog with RECOVERY_TIMEOUT.
+ *
+ * Input parameters: None
+ */
+void recovery_watchdog (void);
+
+/*
+ * recovery_kick function of type void.
+ *
+ * Restarts the watchdog timeout.
+ *
+ * Input parameters: None
+ */
+void recovery_kick (void);
+
+/*
+ * recovery_fail function of type void.
+ *
+ * Completes the crash record and resets the MCU. Never returns.
+ *
+ * Input parameters: unsigned char cause (RECOVERY_ASSERT ... RECOVERY_WATCHDOG)
+ *                   unsigned int pc (address of the fault, 0 if unknown)
+ */
+void recovery_fail (u1_t cause, u4_t pc);
+
+/*
+ * recovery_count function of type unsigned int.
+ *
+ * Input parameters: None
+ * Return: number of recoveries since power-on.
+ */
+u4_t recovery_count (void);
+
+/*
+ * recovery_uplink function of type void.
+ *
+ * Records the completion of an uplink; the first one after a warm restart
+ * gives the time from the fault to the next uplink.
+ *
+ * Input parameters: ostime_t airTime (time the uplink went on air)
+ */
+void recovery_uplink (ostime_t airTime);
+
+/*
+ * recovery_report function of type void.
+ *
+ * Writes the recovery count, last fault and fault-to-uplink time to the UART.
+ *
+ * Input parameters: None
+ */
+void recovery_report (void);
+
+#endif // _recovery_hpp_
@@ -0,0 +1,498 @@
+/*******************************************************************************
+ * Internet of Things (IoT) smart monitoring
+ * device for agriculture using LoRaWAN technology.
+ *
+ * SX1272 register shadow cache.
+ *
+ * The address byte of a frame is held back until the first data byte shows
+ * whether the frame can be answered from the shadow. Frames that do go to
+ * the bus are written through to the shadow, so it always follows the
+ * radio.
+ *
+ * SEE regcache.h file for the description of each function.
+ *
+ *******************************************************************************/
+
+#if defined(__MBED__)
+#include "mbed.h"
+#else
+#include <stdio.h>
+#include <string.h>
+#endif
+#include "lmic.h"
+#include "memstat.h"
+#include "regcache.h"
+
+// SX1272 LoRa page registers used here.
+#define REG_FIFO             0x00
+#define REG_OPMODE           0x01
+#define REG_FRF_MSB          0x06
+#define REG_PA_CONFIG        0x09
+#define REG_LNA              0x0C
+#define REG_FIFO_ADDR_PTR    0x0D
+#define REG_FIFO_TX_BASE     0x0E
+#define REG_IRQ_FLAGS_MASK   0x11
+#define REG_IRQ_FLAGS        0x12
+#define REG_MODEM_CONFIG1    0x1D
+#define REG_MODEM_CONFIG2    0x1E
+#define REG_SYMB_TIMEOUT     0x1F
+#define REG_PAYLOAD_LENGTH   0x22
+#define REG_PAYLOAD_MAX      0x23
+#define REG_INVERT_IQ        0x33
+#define REG_SYNC_WORD        0x39
+#define REG_DIO_MAPPING1     0x40
+#define REG_VERSION          0x42
+#define REG_PA_DAC           0x5A
+
+// RegOpMode bits.
+#define OPMODE_LORA          0x80
+#define OPMODE_MASK          0x07
+#define OPMODE_SLEEP         0x00
+#define OPMODE_STANDBY       0x01
+#define OPMODE_TX            0x03
+#define OPMODE_RX_SINGLE     0x06
+
+static regcache_t radio;
+
+/*
+ * cacheable function of type bit_t.
+ *
+ * Input parameters: const regcache_t c
+ *                   unsigned char reg
+ * Return: 1 if the shadow may hold the register, 0 otherwise.
+ */
+static bit_t cacheable (const regcache_t* c, u1_t reg) {
+    if( !c->lora || reg >= 0x70 ) {
+        return 0;
+    }
+    switch( reg ) {
+        case REG_FIFO:
+        case REG_OPMODE:
+        case REG_FIFO_ADDR_PTR:
+        case 0x10:                // RegFifoRxCurrentAddr
+        case REG_IRQ_FLAGS:
+        case 0x13:                // RegRxNbBytes
+        case 0x14: case 0x15:     // RegRxHeaderCnt
+        case 0x16: case 0x17:     // RegRxPacketCnt
+        case 0x18:                // RegModemStat
+        case 0x19:                // RegPktSnrValue
+        case 0x1A:                // RegPktRssiValue
+        case 0x1B:                // RegRssiValue
+        case 0x1C:                // RegHopChannel
+        case 0x25:                // RegFifoRxByteAddr
+        case 0x28: case 0x29:
+        case 0x2A:                // RegFei
+        case 0x2C:                // RegRssiWideband
+            return 0;
+        default:
+            return 1;
+    }
+}// end of cacheable function.
+
+/*
+ * follow function of type void.
+ *
+ * Writes one register access that went to the bus through to the shadow.
+ *
+ * Input parameters: regcache_t c
+ *                   unsigned char reg
+ *                   bit_t write
+ *                   unsigned char val (value written or read)
+ */
+static void follow (regcache_t* c, u1_t reg, bit_t write, u1_t val) {
+    if( reg == REG_OPMODE ) {
+        // The other register page comes up with LongRangeMode.
+        if( ( ( val & OPMODE_LORA ) != 0 ) != c->lora ) {
+            regcache_invalidate( c );
+            c->lora = ( val & OPMODE_LORA ) != 0;
+        }
+        if( write && ( val & OPMODE_MASK ) == OPMODE_TX ) {
+            c->uplinks++;
+        }
+        return;
+    }
+    if( reg < 128 && cacheable( c, reg ) ) {
+        c->shadow[reg] = val;
+        c->valid[reg >> 5] |= (u4_t)1 << ( reg & 31 );
+    }
+}// end of follow function.
+
+/*
+ * transfer function of type unsigned char.
+ *
+ * Input parameters: regcache_t c
+ *                   unsigned char out
+ * Return: byte received over the bus.
+ */
+static u1_t transfer (regcache_t* c, u1_t out) {
+    c->busBytes++;
+    return c->bus( out );
+}// end of transfer function.
+
+/*
+ * regcache_init function of type void.
+ *
+ * Input parameters: regcache_t c
+ *                   regcache_nss_t nss
+ *                   regcache_bus_t bus
+ *                   bit_t enabled
+ *
+ */
+void regcache_init (regcache_t* c, regcache_nss_t nss, regcache_bus_t bus, bit_t enabled) {
+    memset( c, 0, sizeof( *c ) );
+    c->nss = nss;
+    c->bus = bus;
+    c->enabled = enabled;
+    if( c == &radio ) {
+        memstat_region( "radio shadow", sizeof( radio ) );
+    }
+}// end of regcache_init function.
+
+/*
+ * regcache_invalidate function of type void.
+ *
+ * Input parameters: regcache_t c
+ *
+ */
+void regcache_invalidate (regcache_t* c) {
+    memset( c->valid, 0, sizeof( c->valid ) );
+    c->lora = 0;
+    c->invalidations++;
+}// end of regcache_invalidate function.
+
+/*
+ * regcache_select function of type void.
+ *
+ * Input parameters: regcache_t c
+ *                   unsigned char val
+ *
+ */
+void regcache_select (regcache_t* c, u1_t val) {
+    c->index = 0;
+    if( !c->enabled ) {
+        c->nss( val );
+        return;
+    }
+    if( val != 0 && c->open ) {
+        c->nss( 1 );
+    }
+    c->open = 0;
+}// end of regcache_select function.
+
+/*
+ * regcache_spi function of type unsigned char.
+ *
+ * Input parameters: regcache_t c
+ *                   unsigned char out
+ * Return: byte received.
+ *
+ */
+u1_t regcache_spi (regcache_t* c, u1_t out) {
+    u1_t reg = c->addr & 0x7F;
+    bit_t write = ( c->addr & 0x80 ) != 0;
+    u1_t in;
+
+    if( !c->enabled ) {
+        in = transfer( c, out );
+    } else if( c->index == 0 ) {
+        // Address byte, held back.
+        c->addr = out;
+        c->index++;
+        return 0;
+    } else {
+        if( !c->open && c->index == 1 && cacheable( c, reg ) &&
+            ( c->valid[reg >> 5] & ( (u4_t)1 << ( reg & 31 ) ) ) != 0 ) {
+            if( !write ) {
+                c->served++;
+                c->savedBytes += 2;
+                c->first = c->shadow[reg];
+                c->index++;
+                return c->first;
+            }
+            if( c->shadow[reg] == out ) {
+                c->skipped++;
+                c->savedBytes += 2;
+                c->first = out;
+                c->index++;
+                return 0;
+            }
+        }
+        if( !c->open ) {
+            c->open = 1;
+            c->nss( 0 );
+            transfer( c, c->addr );
+            if( c->index == 2 ) {
+                // A burst going on after a byte kept off the bus: replay it.
+                transfer( c, write ? c->first : 0 );
+                c->savedBytes -= 2;
+                if( write ) {
+                    c->skipped--;
+                } else {
+                    c->served--;
+                }
+            }
+        }
+        in = transfer( c, out );
+    }
+    if( c->index != 0 ) {
+        // Bursts advance the address, except on the FIFO.
+        follow( c, reg == REG_FIFO ? REG_FIFO : (u1_t)( reg + c->index - 1 ), write, write ? out : in );
+    } else {
+        c->addr = out;
+    }
+    c->index++;
+    return in;
+}// end of regcache_spi function.
+
+/*
+ * regcache_radio function of type regcache_t pointer.
+ *
+ * Input parameters: None
+ * Return: shadow of the radio driven by the HAL.
+ *
+ */
+regcache_t* regcache_radio (void) {
+    return &radio;
+}// end of regcache_radio function.
+
+/*
+ * regcache_report function of type void.
+ *
+ * Input parameters: const char name
+ *                   const regcache_t c
+ *
+ */
+void regcache_report (const char* name, const regcache_t* c) {
+    u4_t n = c->uplinks ? c->uplinks : 1;
+
+    printf("%s SPI: %u bytes, %u saved (%u writes skipped, %u reads served), %u invalidations\r\n",
+           name, (unsigned int)c->busBytes, (unsigned int)c->savedBytes, (unsigned int)c->skipped,
+           (unsigned int)c->served, (unsigned int)c->invalidations);
+    printf("  per uplink: %u bytes, %u saved, %u us saved\r\n", (unsigned int)( c->busBytes / n ),
+           (unsigned int)( c->savedBytes / n ),
+           (unsigned int)( (unsigned long long)c->savedBytes * 8 * 1000000 / REGCACHE_SPI_HZ / n ));
+}// end of regcache_report function.
+
+///////////////////////////////////////////////////
+// MOCK SX1272                                  //
+/////////////////////////////////////////////////
+
+static u1_t mockRegs[128];
+static u1_t mockFifo[256];
+static u1_t mockIndex = 0;
+static u1_t mockAddr = 0;
+
+/*
+ * mockReset function of type void.
+ *
+ * Input parameters: None
+ */
+static void mockReset (void) {
+    memset( mockRegs, 0, sizeof( mockRegs ) );
+    mockRegs[REG_OPMODE] = OPMODE_STANDBY;
+    mockRegs[REG_VERSION] = 0x22;
+    mockIndex = 0;
+}// end of mockReset function.
+
+/*
+ * mockNss function of type void.
+ *
+ * Input parameters: unsigned char val
+ */
+static void mockNss (u1_t val) {
+    (void)val;
+    mockIndex = 0;
+}// end of mockNss function.
+
+/*
+ * mockBus function of type unsigned char.
+ *
+ * Register access of the mock radio: TX completes and RX times out at once.
+ *
+ * Input parameters: unsigned char out
+ * Return: byte received.
+ */
+static u1_t mockBus (u1_t out) {
+    u1_t reg;
+
+    if( mockIndex++ == 0 ) {
+        mockAddr = out;
+        return 0;
+    }
+    reg = mockAddr & 0x7F;
+    if( reg == REG_FIFO ) {
+        if( mockAddr & 0x80 ) {
+            mockFifo[mockRegs[REG_FIFO_ADDR_PTR]++] = out;
+            return 0;
+        }
+        return mockFifo[mockRegs[REG_FIFO_ADDR_PTR]++];
+    }
+    reg = ( reg + mockIndex - 2 ) & 0x7F;
+    if( ( mockAddr & 0x80 ) == 0 ) {
+        return mockRegs[reg];
+    }
+    if( reg == REG_IRQ_FLAGS ) {
+        mockRegs[reg] &= ~out;
+        return 0;
+    }
+    mockRegs[reg] = out;
+    if( reg == REG_OPMODE && ( out & OPMODE_MASK ) == OPMODE_TX ) {
+        mockRegs[REG_IRQ_FLAGS] |= 0x08;   // TxDone
+        mockRegs[REG_OPMODE] = ( out & ~OPMODE_MASK ) | OPMODE_STANDBY;
+    }
+    if( reg == REG_OPMODE && ( out & OPMODE_MASK ) == OPMODE_RX_SINGLE ) {
+        mockRegs[REG_IRQ_FLAGS] |= 0x80;   // RxTimeout
+        mockRegs[REG_OPMODE] = ( out & ~OPMODE_MASK ) | OPMODE_STANDBY;
+    }
+    return 0;
+}// end of mockBus function.
+
+/*
+ * writeReg function of type void.
+ *
+ * Input parameters: regcache_t c
+ *                   unsigned char addr
+ *                   unsigned char data
+ */
+static void writeReg (regcache_t* c, u1_t addr, u1_t data) {
+    regcache_select( c, 0 );
+    regcache_spi( c, addr | 0x80 );
+    regcache_spi( c, data );
+    regcache_select( c, 1 );
+}// end of writeReg function.
+
+/*
+ * readReg function of type unsigned char.
+ *
+ * Input parameters: regcache_t c
+ *                   unsigned char addr
+ * Return: register value.
+ */
+static u1_t readReg (regcache_t* c, u1_t addr) {
+    regcache_select( c, 0 );
+    regcache_spi( c, addr & 0x7F );
+    u1_t val = regcache_spi( c, 0x00 );
+    regcache_select( c, 1 );
+    return val;
+}// end of readReg function.
+
+/*
+ * opmode function of type void.
+ *
+ * Input parameters: regcache_t c
+ *                   unsigned char mode
+ */
+static void opmode (regcache_t* c, u1_t mode) {
+    writeReg( c, REG_OPMODE, ( readReg( c, REG_OPMODE ) & ~OPMODE_MASK ) | mode );
+}// end of opmode function.
+
+/*
+ * setup function of type void.
+ *
+ * Common modem set-up of LMiC's txlora and rxlora: LoRa mode, modem
+ * configuration and channel.
+ *
+ * Input parameters: regcache_t c
+ *                   unsigned int freq
+ *                   unsigned char mc1
+ *                   unsigned char mc2
+ */
+static void setup (regcache_t* c, u4_t freq, u1_t mc1, u1_t mc2) {
+    unsigned long long frf = ( (unsigned long long)freq << 19 ) / 32000000;
+
+    opmode( c, OPMODE_SLEEP );
+    writeReg( c, REG_OPMODE, OPMODE_LORA | OPMODE_SLEEP );
+    readReg( c, REG_OPMODE );
+    writeReg( c, REG_MODEM_CONFIG1, mc1 );
+    writeReg( c, REG_MODEM_CONFIG2, mc2 );
+    writeReg( c, REG_FRF_MSB, (u1_t)( frf >> 16 ) );
+    writeReg( c, REG_FRF_MSB + 1, (u1_t)( frf >> 8 ) );
+    writeReg( c, REG_FRF_MSB + 2, (u1_t)frf );
+}// end of setup function.
+
+/*
+ * mockUplink function of type void.
+ *
+ * LMiC's register sequence of one uplink and its RX1 and RX2 windows.
+ *
+ * Input parameters: regcache_t c
+ *                   unsigned int freq
+ */
+static void mockUplink (regcache_t* c, u4_t freq) {
+    static const u1_t FRAME[21] = { 0x40, 0x39, 0x1B, 0x01, 0x26 };
+
+    // TX at SF7, 14 dBm.
+    setup( c, freq, 0x72, 0x74 );
+    writeReg( c, REG_SYNC_WORD, 0x34 );
+    writeReg( c, REG_PA_CONFIG, 0x80 | 12 );
+    writeReg( c, REG_PA_DAC, readReg( c, REG_PA_DAC ) | 0x04 );
+    writeReg( c, REG_DIO_MAPPING1, 0x40 );
+    writeReg( c, REG_IRQ_FLAGS, 0xFF );
+    writeReg( c, REG_IRQ_FLAGS_MASK, 0xF7 );
+    writeReg( c, REG_FIFO_TX_BASE, 0x00 );
+    writeReg( c, REG_FIFO_ADDR_PTR, 0x00 );
+    writeReg( c, REG_PAYLOAD_LENGTH, sizeof( FRAME ) );
+    regcache_select( c, 0 );
+    regcache_spi( c, REG_FIFO | 0x80 );
+    for( u1_t i = 0; i < sizeof( FRAME ); i++ ) {
+        regcache_spi( c, FRAME[i] );
+    }
+    regcache_select( c, 1 );
+    opmode( c, OPMODE_TX );
+    // TxDone interrupt.
+    readReg( c, REG_IRQ_FLAGS );
+    writeReg( c, REG_IRQ_FLAGS_MASK, 0xFF );
+    writeReg( c, REG_IRQ_FLAGS, 0xFF );
+    opmode( c, OPMODE_SLEEP );
+    // RX1 on the uplink channel at SF7, RX2 on 869.525 MHz at SF9.
+    for( u1_t w = 0; w < 2; w++ ) {
+        setup( c, w == 0 ? freq : 869525000, 0x72, w == 0 ? 0x74 : 0x94 );
+        writeReg( c, REG_LNA, 0x23 );
+        writeReg( c, REG_SYNC_WORD, 0x34 );
+        writeReg( c, REG_INVERT_IQ, readReg( c, REG_INVERT_IQ ) | 0x40 );
+        writeReg( c, REG_SYMB_TIMEOUT, 8 );
+        writeReg( c, REG_PAYLOAD_MAX, 64 );
+        writeReg( c, REG_DIO_MAPPING1, 0x00 );
+        writeReg( c, REG_IRQ_FLAGS, 0xFF );
+        writeReg( c, REG_IRQ_FLAGS_MASK, 0x3F );
+        opmode( c, OPMODE_RX_SINGLE );
+        // RxTimeout interrupt.
+        readReg( c, REG_IRQ_FLAGS );
+        writeReg( c, REG_IRQ_FLAGS_MASK, 0xFF );
+        writeReg( c, REG_IRQ_FLAGS, 0xFF );
+        opmode( c, OPMODE_SLEEP );
+    }
+}// end of mockUplink function.
+
+/*
+ * regcache_benchmark function of type bit_t.
+ *
+ * Input parameters: unsigned short uplinks
+ *                   unsigned char channels
+ * Return: 1 if the radio registers are identical.
+ *
+ */
+bit_t regcache_benchmark (u2_t uplinks, u1_t channels) {
+    static const u4_t FREQ[] = { 868100000, 868300000, 868500000,
+                                 867100000, 867300000, 867500000, 867700000, 867900000 };
+    static regcache_t runs[2];
+    static u1_t final[2][128];
+
+    if( channels == 0 || channels > sizeof( FREQ ) / sizeof( FREQ[0] ) ) {
+        return 0;
+    }
+    printf("Register shadow against a mock SX1272, %u uplinks on %u channel%s:\r\n",
+           uplinks, channels, channels > 1 ? "s" : "");
+    for( u1_t k = 0; k < 2; k++ ) {
+        mockReset( );
+        regcache_init( &runs[k], mockNss, mockBus, k );
+        for( u2_t u = 0; u < uplinks; u++ ) {
+            mockUplink( &runs[k], FREQ[u % channels] );
+        }
+        memcpy( final[k], mockRegs, sizeof( mockRegs ) );
+        regcache_report( k ? "  with shadow" : "  without shadow", &runs[k] );
+    }
+    bit_t identical = memcmp( final[0], final[1], sizeof( final[0] ) ) == 0;
+    printf("  radio registers %s\r\n", identical ? "identical" : "DIFFER");
+    return identical;
+}// end of regcache_benchmark function.
@@ -0,0 +1,145 @@
+/*******************************************************************************
+ * Internet of Things (IoT) smart monitoring
+ * device for agriculture using LoRaWAN technology.
+ *
+ * SX1272 register shadow cache.
+ *
+ * - LMiC rewrites the whole modem configuration (spreading factor,
+ * bandwidth, frequency, power, sync word, DIO mapping) before every uplink
+ * and receive window, although most of it never changes. A regcache_t sits
+ * between the HAL and the SPI bus and keeps a RAM shadow of the LoRa
+ * register page: a single-register write of the value the shadow already
+ * holds is skipped, and a read of a configuration register is served from
+ * the shadow. Either way the frame never reaches the bus, not even NSS.
+ *
+ * - Registers the radio changes on its own (FIFO and its pointers, IRQ
+ * flags, RSSI, SNR, modem status, packet counters, RegOpMode) always go to
+ * the bus. Nothing is cached in FSK mode, whose register page differs.
+ *
+ * - The shadow is invalidated on a radio reset and whenever the
+ * LongRangeMode bit of RegOpMode changes.
+ *
+ * - The SPI bytes on the bus and the bytes saved are counted per uplink
+ * (RegOpMode writes to TX); regcache_benchmark runs LMiC's register
+ * sequence of an uplink with its two receive windows against a mock SX1272,
+ * with and without the cache, and checks both leave the same registers.
+ *
+ *******************************************************************************/
+#ifndef _regcache_hpp_
+#define _regcache_hpp_
+
+#include "lmic.h"
+
+// Set to 0 to send every register access to the radio.
+#ifndef HAL_REGCACHE
+#define HAL_REGCACHE 1
+#endif
+
+// SPI clock of the radio in Hz, for the time saved.
+#define REGCACHE_SPI_HZ 8000000
+
+// Drives the NSS line (0 selects the radio).
+typedef void (*regcache_nss_t) (u1_t val);
+
+// Exchanges one byte over the SPI bus.
+typedef u1_t (*regcache_bus_t) (u1_t out);
+
+/*
+ * regcache_t structure.
+ *
+ * Register shadow and SPI frame state of one radio.
+ */
+typedef struct {
+    regcache_nss_t nss;   // NSS line.
+    regcache_bus_t bus;   // SPI bus.
+    bit_t enabled;        // Shadow in use.
+    bit_t lora;           // LongRangeMode (LoRa register page) set.
+    bit_t open;           // NSS driven low for the present frame.
+    u1_t index;           // Byte position within the present frame.
+    u1_t addr;            // First byte (address and write bit) of the frame.
+    u1_t first;           // First data byte of a frame kept off the bus.
+    u1_t shadow[128];     // Register values.
+    u4_t valid[4];        // Bit map of the valid shadow registers.
+    u4_t busBytes;        // Bytes exchanged on the bus.
+    u4_t savedBytes;      // Bytes kept off the bus.
+    u4_t skipped;         // Writes skipped.
+    u4_t served;          // Reads served from the shadow.
+    u4_t invalidations;   // Shadow invalidations.
+    u4_t uplinks;         // RegOpMode writes to TX.
+} regcache_t;
+
+/*
+ * regcache_init function of type void.
+ *
+ * Input parameters: regcache_t c
+ *                   regcache_nss_t nss
+ *                   regcache_bus_t bus
+ *                   bit_t enabled (0 passes every access through)
+ */
+void regcache_init (regcache_t* c, regcache_nss_t nss, regcache_bus_t bus, bit_t enabled);
+
+/*
+ * regcache_invalidate function of type void.
+ *
+ * Forgets all register values, e.g. when the radio is reset.
+ *
+ * Input parameters: regcache_t c
+ */
+void regcache_invalidate (regcache_t* c);
+
+/*
+ * regcache_select function of type void.
+ *
+ * Starts (val 0) or ends (val 1) an SPI frame. NSS is only driven once the
+ * frame has to reach the bus.
+ *
+ * Input parameters: regcache_t c
+ *                   unsigned char val
+ */
+void regcache_select (regcache_t* c, u1_t val);
+
+/*
+ * regcache_spi function of type unsigned char.
+ *
+ * Exchanges one byte of the present frame, from the shadow or over the bus.
+ *
+ * Input parameters: regcache_t c
+ *                   unsigned char out
+ * Return: byte received.
+ */
+u1_t regcache_spi (regcache_t* c, u1_t out);
+
+/*
+ * regcache_radio function of type regcache_t pointer.
+ *
+ * Input parameters: None
+ * Return: shadow of the radio driven by the HAL.
+ */
+regcache_t* regcache_radio (void);
+
+/*
+ * regcache_report function of type void.
+ *
+ * Writes the bytes on the bus and saved, in total and per uplink, and the
+ * SPI time saved to the UART.
+ *
+ * Input parameters: const char name
+ *                   const regcache_t c
+ */
+void regcache_report (const char* name, const regcache_t* c);
+
+/*
+ * regcache_benchmark function of type bit_t.
+ *
+ * Runs the register sequence of uplinks LMiC uplinks with both receive
+ * windows, hopping over channels channels, against a mock SX1272 without and
+ * with the shadow and writes the SPI traffic of both to the UART.
+ *
+ * Input parameters: unsigned short uplinks
+ *                   unsigned char channels (1 ... 8)
+ * Return: 1 if both runs left the same radio registers, 0 otherwise or if
+ *         channels is out of range.
+ */
+bit_t regcache_benchmark (u2_t uplinks, u1_t channels);
+
+#endif // _regcache_hpp_
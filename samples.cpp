@@ -0,0 +1,131 @@
+/*******************************************************************************
+ * Internet of Things (IoT) smart monitoring
+ * device for agriculture using LoRaWAN technology.
+ *
+ * Pending-sample queue.
+ *
+ * SEE samples.h file for the description of each function.
+ *
+ *******************************************************************************/
+
+#include "lmic.h"
+#include "samples.h"
+#include "memstat.h"
+
+static sample_t queue[SAMPLES_QUEUE_SIZE];
+static u1_t head = 0;
+static u1_t count = 0;
+
+/*
+ * samples_init function of type void.
+ *
+ * Input parameters: None
+ *
+ */
+void samples_init (void) {
+    head = 0;
+    count = 0;
+    memstat_region( "samples", sizeof( queue ) );
+}// end of samples_init function.
+
+/*
+ * samples_push function of type bit_t.
+ *
+ * Input parameters: const sample_t s
+ * Return: 1 if no sample was discarded, 0 otherwise.
+ *
+ */
+bit_t samples_push (const sample_t* s) {
+    bit_t kept = 1;
+
+    if( count == SAMPLES_QUEUE_SIZE ) { // queue full, drop the oldest
+        head = ( head + 1 ) % SAMPLES_QUEUE_SIZE;
+        count--;
+        kept = 0;
+    }
+    queue[( head + count ) % SAMPLES_QUEUE_SIZE] = *s;
+    count++;
+    return kept;
+}// end of samples_push function.
+
+/*
+ * samples_peek function of type sample_t pointer.
+ *
+ * Input parameters: None
+ * Return: oldest queued sample or NULL.
+ *
+ */
+const sample_t* samples_peek (void) {
+    return samples_at( 0 );
+}// end of samples_peek function.
+
+/*
+ * samples_at function of type sample_t pointer.
+ *
+ * Input parameters: unsigned char idx
+ * Return: queued sample or NULL.
+ *
+ */
+const sample_t* samples_at (u1_t idx) {
+    if( idx >= count ) {
+        return NULL;
+    }
+    return &queue[( head + idx ) % SAMPLES_QUEUE_SIZE];
+}// end of samples_at function.
+
+/*
+ * samples_pop function of type void.
+ *
+ * Input parameters: None
+ *
+ */
+void samples_pop (void) {
+    if( count != 0 ) {
+        head = ( head + 1 ) % SAMPLES_QUEUE_SIZE;
+        count--;
+    }
+}// end of samples_pop function.
+
+/*
+ * samples_count function of type unsigned char.
+ *
+ * Input parameters: None
+ * Return: number of queued samples.
+ *
+ */
+u1_t samples_count (void) {
+    return count;
+}// end of samples_count function.
+
+/*
+ * samples_encode function of type void.
+ *
+ * Input parameters: const sample_t s
+ *                   unsigned char buf
+ *
+ */
+void samples_encode (const sample_t* s, u1_t* buf) {
+    buf[0] = s->temperature >> 8;
+    buf[1] = s->temperature & 0xFF;
+    buf[2] = s->humidity >> 8;
+    buf[3] = s->humidity & 0xFF;
+    buf[4] = s->light >> 8;
+    buf[5] = s->light & 0xFF;
+    buf[6] = s->soil >> 8;
+    buf[7] = s->soil & 0xFF;
+}// end of samples_encode function.
+
+/*
+ * samples_decode function of type void.
+ *
+ * Input parameters: const unsigned char buf
+ *                   sample_t s
+ *
+ */
+void samples_decode (const u1_t* buf, sample_t* s) {
+    s->temperature = (s2_t)( ( buf[0] << 8 ) | buf[1] );
+    s->humidity    = (s2_t)( ( buf[2] << 8 ) | buf[3] );
+    s->light       = (s2_t)( ( buf[4] << 8 ) | buf[5] );
+    s->soil        = (s2_t)( ( buf[6] << 8 ) | buf[7] );
+    s->taken       = 0;
+}// end of samples_decode function.
@@ -0,0 +1,116 @@
+/*******************************************************************************
+ * Internet of Things (IoT) smart monitoring
+ * device for agriculture using LoRaWAN technology.
+ *
+ * Pending-sample queue.
+ *
+ * - Sensor readings are queued as fixed-point samples (value * 100) until
+ * their uplink has been completed by LMiC (EV_TXCOMPLETE).
+ *
+ * - The queue is a fixed-size FIFO ring; when full the oldest sample is
+ * dropped so that the freshest readings always survive.
+ *
+ * - Each sample carries the time of its acquisition, so that its age can be
+ * measured when it goes on air. The time is not part of the encoded frame.
+ *
+ *******************************************************************************/
+#ifndef _samples_hpp_
+#define _samples_hpp_
+
+#include "lmic.h"
+
+// Maximum number of samples kept in RAM while waiting for transmission.
+#define SAMPLES_QUEUE_SIZE 8
+
+// Encoded sample size in bytes (four big-endian 16-bit values).
+#define SAMPLE_FRAME_LENGTH 8
+
+/*
+ * sample_t structure.
+ *
+ * Holds one set of sensor readings multiplied by 100.
+ */
+typedef struct {
+    s2_t temperature; // Temperature (Celcius * 100).
+    s2_t humidity;    // Humidity (Relative Humidity % * 100).
+    s2_t light;       // Light intensity (Volts * 100).
+    s2_t soil;        // Soil moisture (Volts * 100).
+    ostime_t taken;   // Time of the acquisition (0 if unknown, e.g. restored).
+} sample_t;
+
+/*
+ * samples_init function of type void.
+ *
+ * Empties the pending-sample queue.
+ *
+ * Input parameters: None
+ */
+void samples_init (void);
+
+/*
+ * samples_push function of type bit_t.
+ *
+ * Appends a sample at the tail of the queue. If the queue is full
+ * the oldest sample is discarded.
+ *
+ * Input parameters: const sample_t s
+ * Return: 1 if no sample was discarded, 0 otherwise.
+ */
+bit_t samples_push (const sample_t* s);
+
+/*
+ * samples_peek function of type sample_t pointer.
+ *
+ * Input parameters: None
+ * Return: oldest queued sample or NULL if the queue is empty.
+ */
+const sample_t* samples_peek (void);
+
+/*
+ * samples_at function of type sample_t pointer.
+ *
+ * Input parameters: unsigned char idx (0 is the oldest sample)
+ * Return: queued sample or NULL if idx is out of range.
+ */
+const sample_t* samples_at (u1_t idx);
+
+/*
+ * samples_pop function of type void.
+ *
+ * Removes the oldest sample from the queue.
+ *
+ * Input parameters: None
+ */
+void samples_pop (void);
+
+/*
+ * samples_count function of type unsigned char.
+ *
+ * Input parameters: None
+ * Return: number of queued samples.
+ */
+u1_t samples_count (void);
+
+/*
+ * samples_encode function of type void.
+ *
+ * Writes sample as four big-endian 16-bit values (8 bytes) into buf.
+ * This is the uplink payload format decoded by All Things Talk.
+ *
+ * Input parameters: const sample_t s
+ *                   unsigned char buf
+ */
+void samples_encode (const sample_t* s, u1_t* buf);
+
+/*
+ * samples_decode function of type void.
+ *
+ * Reads sample from four big-endian 16-bit values (8 bytes) of buf.
+ * The acquisition time is unknown and set to 0.
+ *
+ * Input parameters: const unsigned char buf
+ *                   sample_t s
+ */
+void samples_decode (const u1_t* buf, sample_t* s);
+
+#endif // _samples_hpp_
@@ -0,0 +1,241 @@
+/*******************************************************************************
+ * Internet of Things (IoT) smart monitoring
+ * device for agriculture using LoRaWAN technology.
+ *
+ * Sensor driver registry and per-sensor sampling scheduler.
+ *
+ * SEE sensors.h file for the description of each function.
+ *
+ *******************************************************************************/
+
+#if defined(__MBED__)
+#include "mbed.h"
+#else
+#include <stdio.h>
+#include <string.h>
+#endif
+#include "lmic.h"
+#include "samples.h"
+#include "memstat.h"
+#include "energy.h"
+#include "sensors.h"
+
+/*
+ * sensor_slot_t structure.
+ *
+ * Scheduling state of one registered driver. The job comes first, so that
+ * the job handed to the callback is also the slot.
+ */
+typedef struct {
+    osjob_t job;                     // LMiC job running the driver.
+    const sensor_driver_t* driver;   // Registered driver.
+    ostime_t due;                    // Time of the next read.
+    bit_t warming;                   // Set between power-up and read.
+    u4_t reads;                      // Successful reads.
+    u4_t failures;                   // Failed reads.
+    ostime_t busy;                   // Time spent in read().
+    ostime_t onSince;                // Time of the last power-up.
+    u4_t onTime;                     // Accumulated powered time in milliseconds.
+    ostime_t lastRead;               // Time of the most recent successful read.
+} sensor_slot_t;
+
+static sensor_slot_t slots[SENSORS_MAX_DRIVERS];
+static u1_t slotCount = 0;
+static sample_t latest;
+static u1_t validMask = 0;
+static u4_t poweredCurrent = 0; // Supply current of the powered sensors.
+
+/*
+ * sensors_init function of type void.
+ *
+ * Input parameters: None
+ *
+ */
+void sensors_init (void) {
+    for( u1_t i = 0; i < slotCount; i++ ) {
+        os_clearCallback( &slots[i].job );
+    }
+    memset( slots, 0, sizeof( slots ) );
+    memset( &latest, 0, sizeof( latest ) );
+    slotCount = 0;
+    validMask = 0;
+    poweredCurrent = 0;
+    memstat_region( "sensor jobs", sizeof( slots ) + sizeof( latest ) );
+}// end of sensors_init function.
+
+/*
+ * sensors_register function of type bit_t.
+ *
+ * Input parameters: const sensor_driver_t driver
+ * Return: 1 on success, 0 if the registry is full.
+ *
+ */
+bit_t sensors_register (const sensor_driver_t* driver) {
+    if( slotCount == SENSORS_MAX_DRIVERS ) {
+        return 0;
+    }
+    slots[slotCount].driver = driver;
+    slotCount++;
+    return 1;
+}// end of sensors_register function.
+
+/*
+ * leadTime function of type ostime_t.
+ *
+ * Input parameters: const sensor_driver_t drv
+ * Return: time between power-up and read of drv.
+ */
+static ostime_t leadTime (const sensor_driver_t* drv) {
+    return drv->power != NULL ? ms2osticks( drv->warmup ) : 0;
+}// end of leadTime function.
+
+/*
+ * runDriver function of type void.
+ *
+ * Job callback of a driver: powers the sensor up warm-up milliseconds
+ * ahead of the due time, reads it and powers it down at the due time and
+ * schedules the next run one period later.
+ *
+ * Input parameters: osjob_t j
+ */
+static void runDriver (osjob_t* j) {
+    sensor_slot_t* slot = (sensor_slot_t*)j;
+    const sensor_driver_t* drv = slot->driver;
+    u1_t bit = (u1_t)( 1 << ( slot - slots ) );
+    ostime_t now = os_getTime( );
+
+    if( !slot->warming && drv->power != NULL ) {
+        drv->power( 1 );
+        poweredCurrent += drv->current;
+        energy_set( ENERGY_SENSORS, poweredCurrent );
+        slot->onSince = now;
+        slot->warming = 1;
+        os_setTimedCallback( j, slot->due, runDriver );
+        return;
+    }
+    slot->warming = 0;
+
+    // Read into a copy so that a failed read leaves the latest values intact.
+    sample_t s = latest;
+    if( drv->read( &s ) ) {
+        latest = s;
+        slot->lastRead = now;
+        validMask |= bit;
+        slot->reads++;
+    } else {
+        slot->failures++;
+    }
+    slot->busy += os_getTime( ) - now;
+    if( drv->power != NULL ) {
+        drv->power( 0 );
+        poweredCurrent -= drv->current;
+        energy_set( ENERGY_SENSORS, poweredCurrent );
+        slot->onTime += osticks2ms( os_getTime( ) - slot->onSince );
+    }
+
+    // Keep the period grid, skipping periods missed by a stalled loop.
+    now = os_getTime( );
+    do {
+        slot->due += sec2osticks( drv->period );
+    } while( slot->due - leadTime( drv ) - now < 0 );
+    os_setTimedCallback( j, slot->due - leadTime( drv ), runDriver );
+}// end of runDriver function.
+
+/*
+ * readTime function of type ostime_t.
+ *
+ * Input parameters: None
+ * Return: time taken by the reads of all drivers plus the guard time.
+ */
+static ostime_t readTime (void) {
+    u4_t cost = 0;
+
+    // Reads due at the same time run one after the other.
+    for( u1_t i = 0; i < slotCount; i++ ) {
+        cost += slots[i].driver->cost;
+    }
+    return us2osticks( cost ) + ms2osticks( SENSORS_GUARD );
+}// end of readTime function.
+
+/*
+ * sensors_leadTime function of type ostime_t.
+ *
+ * Input parameters: None
+ * Return: time from power-up to the end of acquisition.
+ *
+ */
+ostime_t sensors_leadTime (void) {
+    ostime_t lead = 0;
+
+    for( u1_t i = 0; i < slotCount; i++ ) {
+        if( leadTime( slots[i].driver ) > lead ) {
+            lead = leadTime( slots[i].driver );
+        }
+    }
+    return lead + readTime( );
+}// end of sensors_leadTime function.
+
+/*
+ * sensors_start function of type void.
+ *
+ * Input parameters: ostime_t slot
+ *
+ */
+void sensors_start (ostime_t slot) {
+    // Common read grid, ending acquisition just ahead of every slot.
+    ostime_t due = slot - readTime( );
+
+    for( u1_t i = 0; i < slotCount; i++ ) {
+        slots[i].warming = 0;
+        slots[i].due = due;
+        os_setTimedCallback( &slots[i].job, due - leadTime( slots[i].driver ), runDriver );
+    }
+}// end of sensors_start function.
+
+/*
+ * sensors_latest function of type bit_t.
+ *
+ * Input parameters: sample_t s
+ * Return: 1 if every driver has been read successfully at least once.
+ *
+ */
+bit_t sensors_latest (sample_t* s) {
+    *s = latest;
+    // The sample is as old as its oldest value.
+    s->taken = 0;
+    for( u1_t i = 0; i < slotCount; i++ ) {
+        if( i == 0 || slots[i].lastRead - s->taken < 0 ) {
+            s->taken = slots[i].lastRead;
+        }
+    }
+    return validMask == (u1_t)( ( 1 << slotCount ) - 1 );
+}// end of sensors_latest function.
+
+/*
+ * sensors_report function of type void.
+ *
+ * Input parameters: None
+ *
+ */
+void sensors_report (void) {
+    printf("Sensors:\r\n");
+    for( u1_t i = 0; i < slotCount; i++ ) {
+        const sensor_slot_t* slot = &slots[i];
+        const sensor_driver_t* drv = slot->driver;
+        u4_t runs = slot->reads + slot->failures;
+        u4_t window = runs ? slot->onTime / runs : 0;
+        // Charge per day in microampere-hours: I * 24 h, scaled by the duty
+        // cycle (mean on-window over the period) when gated.
+        u4_t alwaysOn = drv->current * 24;
+        u4_t gated = drv->power == NULL ? alwaysOn :
+                     (u4_t)( (unsigned long long)alwaysOn * window / ( drv->period * 1000 ) );
+        printf("  %-12s every %5u s, %u reads, %u failed, %u us per read (%u declared)\r\n",
+               drv->name, (unsigned int)drv->period, (unsigned int)slot->reads,
+               (unsigned int)slot->failures,
+               (unsigned int)( runs ? osticks2us( slot->busy ) / runs : 0 ),
+               (unsigned int)drv->cost);
+        printf("  %-12s on %u ms per read, %u uAh/day (%u uAh/day always on)\r\n", "",
+               (unsigned int)window, (unsigned int)gated, (unsigned int)alwaysOn);
+    }
+    printf("\r\n");
+}// end of sensors_report function.
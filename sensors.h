@@ -0,0 +1,124 @@
+/*******************************************************************************
+ * Internet of Things (IoT) smart monitoring
+ * device for agriculture using LoRaWAN technology.
+ *
+ * Sensor driver registry and per-sensor sampling scheduler.
+ *
+ * - Each sensor is described by a sensor_driver_t declaring its own sample
+ * period, acquisition cost, warm-up time and supply current, along with the
+ * callbacks that switch its power and read it.
+ *
+ * - Every registered driver runs on its own LMiC job: the sensor is powered
+ * up, the warm-up time elapses, read() stores the measurement in the latest
+ * sample, the sensor is powered down again and the job is rescheduled one
+ * period after the previous run. Slowly changing quantities (e.g. soil
+ * moisture) are therefore read far less often than the uplink interval, and
+ * every sensor is only powered for its acquisition window.
+ *
+ * - All drivers share one read grid anchored on the uplink slots: reads are
+ * due SENSORS_GUARD milliseconds plus the read costs ahead of a slot, so
+ * that acquisition is complete when the slot starts and the radio never
+ * waits on the sensors. Reads of drivers whose periods are multiples of each
+ * other coincide and their on-times overlap instead of waking the node
+ * several times.
+ *
+ * - The on-time of every sensor is accounted, so that the charge drawn per
+ * day can be compared with keeping the sensor powered all the time.
+ *
+ * - The uplink takes a copy of the latest sample (sensors_latest) and
+ * queues it, merging the values of all drivers into one frame. Every
+ * driver keeps the time of its last successful read, and the sample is
+ * stamped with the oldest of them, so that the latency of an uplink covers
+ * its stalest value.
+ *
+ *******************************************************************************/
+#ifndef _sensors_hpp_
+#define _sensors_hpp_
+
+#include "lmic.h"
+#include "samples.h"
+
+// Maximum number of registered sensor drivers.
+#define SENSORS_MAX_DRIVERS 4
+
+// Time in milliseconds between the end of acquisition and the uplink slot.
+#define SENSORS_GUARD 5
+
+/*
+ * sensor_driver_t structure.
+ *
+ * Describes one sensor. power may be NULL for a sensor that is always
+ * powered, in which case warmup is not applied.
+ */
+typedef struct {
+    const char* name;              // Sensor name used in reports.
+    u4_t period;                   // Sample period in seconds.
+    u4_t cost;                     // Acquisition cost (read time) in microseconds.
+    u2_t warmup;                   // Time from power-up to read in milliseconds.
+    u4_t current;                  // Supply current while powered in microamperes.
+    void (*power) (bit_t on);      // Switches the sensor supply.
+    bit_t (*read) (sample_t* s);   // Stores the measurement in s, 1 on success.
+} sensor_driver_t;
+
+/*
+ * sensors_init function of type void.
+ *
+ * Removes all registered drivers and clears the latest sample.
+ *
+ * Input parameters: None
+ */
+void sensors_init (void);
+
+/*
+ * sensors_register function of type bit_t.
+ *
+ * Adds a driver to the registry. The driver must stay valid (e.g. be static).
+ *
+ * Input parameters: const sensor_driver_t driver
+ * Return: 1 on success, 0 if the registry is full.
+ */
+bit_t sensors_register (const sensor_driver_t* driver);
+
+/*
+ * sensors_leadTime function of type ostime_t.
+ *
+ * Input parameters: None
+ * Return: time needed from power-up of the slowest sensor to the end of
+ *         acquisition of all sensors, plus SENSORS_GUARD.
+ */
+ostime_t sensors_leadTime (void);
+
+/*
+ * sensors_start function of type void.
+ *
+ * Anchors the read grid on the given uplink slot and schedules the first
+ * acquisition of every registered driver ahead of it. The slot must be at
+ * least sensors_leadTime() ahead.
+ *
+ * Input parameters: ostime_t slot
+ */
+void sensors_start (ostime_t slot);
+
+/*
+ * sensors_latest function of type bit_t.
+ *
+ * Copies the most recent value read by every driver into s, stamped with
+ * the time of the oldest of the drivers' last successful reads (0 while a
+ * driver has never been read).
+ *
+ * Input parameters: sample_t s
+ * Return: 1 if every driver has been read successfully at least once.
+ */
+bit_t sensors_latest (sample_t* s);
+
+/*
+ * sensors_report function of type void.
+ *
+ * Writes the reads, failures, acquisition time, on-time and charge per day
+ * (gated and always powered) of every driver to the UART.
+ *
+ * Input parameters: None
+ */
+void sensors_report (void);
+
+#endif // _sensors_hpp_
@@ -0,0 +1,224 @@
+/*******************************************************************************
+ * Internet of Things (IoT) smart monitoring
+ * device for agriculture using LoRaWAN technology.
+ *
+ * Incremental window statistics.
+ *
+ * Welford's update in fixed point: with x the reading in Q8,
+ *     delta = x - mean; mean += delta / n; m2 += delta * (x - mean)
+ * keeps the mean within a Q8 rounding step of the exact value and the
+ * squared deviations exact to Q16, without the cancellation of a running
+ * sum of squares.
+ *
+ * SEE stats.h file for the description of each function.
+ *
+ *******************************************************************************/
+
+#if defined(__MBED__)
+#include "mbed.h"
+#else
+#include <stdio.h>
+#include <string.h>
+#endif
+#include "lmic.h"
+#include "stats.h"
+#include "bench.h"
+
+/*
+ * stats_init function of type void.
+ *
+ * Input parameters: stats_t s
+ *                   unsigned char select
+ *
+ */
+void stats_init (stats_t* s, u1_t select) {
+    s->select = select;
+    stats_reset( s );
+}// end of stats_init function.
+
+/*
+ * stats_reset function of type void.
+ *
+ * Input parameters: stats_t s
+ *
+ */
+void stats_reset (stats_t* s) {
+    s->count = 0;
+    s->min = 0;
+    s->max = 0;
+    s->mean = 0;
+    s->m2 = 0;
+}// end of stats_reset function.
+
+/*
+ * stats_add function of type void.
+ *
+ * Input parameters: stats_t s
+ *                   signed short x
+ *
+ */
+void stats_add (stats_t* s, s2_t x) {
+    if( s->count == 0 ) {
+        s->min = s->max = x;
+    } else if( x < s->min ) {
+        s->min = x;
+    } else if( x > s->max ) {
+        s->max = x;
+    }
+    // A saturated count keeps weighting new readings by 1/65535.
+    if( s->count != 0xFFFF ) {
+        s->count++;
+    }
+    if( s->select & ( STATS_MEAN | STATS_STDDEV ) ) {
+        s4_t xq = (s4_t)x * ( 1 << STATS_FRAC );
+        s4_t delta = xq - s->mean;
+        s->mean += delta / (s4_t)s->count;
+        if( s->select & STATS_STDDEV ) {
+            s->m2 += (long long)delta * ( xq - s->mean );
+        }
+    }
+}// end of stats_add function.
+
+/*
+ * stats_mean function of type signed short.
+ *
+ * Input parameters: const stats_t s
+ * Return: rounded mean reading.
+ *
+ */
+s2_t stats_mean (const stats_t* s) {
+    return (s2_t)( ( s->mean + ( 1 << ( STATS_FRAC - 1 ) ) ) >> STATS_FRAC );
+}// end of stats_mean function.
+
+/*
+ * isqrt function of type unsigned int.
+ *
+ * Input parameters: unsigned long long v
+ * Return: integer square root of v (rounded down).
+ */
+static u4_t isqrt (unsigned long long v) {
+    unsigned long long root = 0;
+    unsigned long long bit = 1ULL << 62;
+
+    while( bit > v ) {
+        bit >>= 2;
+    }
+    for( ; bit != 0; bit >>= 2 ) {
+        if( v >= root + bit ) {
+            v -= root + bit;
+            root = ( root >> 1 ) + bit;
+        } else {
+            root >>= 1;
+        }
+    }
+    return (u4_t)root;
+}// end of isqrt function.
+
+/*
+ * stats_stddev function of type unsigned short.
+ *
+ * Input parameters: const stats_t s
+ * Return: sample standard deviation.
+ *
+ */
+u2_t stats_stddev (const stats_t* s) {
+    if( s->count < 2 || s->m2 <= 0 ) {
+        return 0;
+    }
+    // Variance in Q16, its root in Q8.
+    u4_t sd = ( isqrt( (unsigned long long)s->m2 / ( s->count - 1 ) ) + ( 1 << ( STATS_FRAC - 1 ) ) ) >> STATS_FRAC;
+    return sd > 0xFFFF ? 0xFFFF : (u2_t)sd;
+}// end of stats_stddev function.
+
+/*
+ * stats_length function of type unsigned char.
+ *
+ * Input parameters: const stats_t s
+ * Return: encoded length in bytes.
+ *
+ */
+u1_t stats_length (const stats_t* s) {
+    u1_t n = 0;
+
+    for( u1_t bit = STATS_COUNT; bit <= STATS_STDDEV; bit <<= 1 ) {
+        if( s->select & bit ) {
+            n += 2;
+        }
+    }
+    return n;
+}// end of stats_length function.
+
+/*
+ * stats_encode function of type unsigned char.
+ *
+ * Input parameters: const stats_t s
+ *                   unsigned char buf
+ * Return: number of bytes written.
+ *
+ */
+u1_t stats_encode (const stats_t* s, u1_t* buf) {
+    u1_t n = 0;
+
+    for( u1_t bit = STATS_COUNT; bit <= STATS_STDDEV; bit <<= 1 ) {
+        u2_t v;
+
+        if( !( s->select & bit ) ) {
+            continue;
+        }
+        switch( bit ) {
+            case STATS_COUNT:
+                v = s->count;
+                break;
+            case STATS_MIN:
+                v = s->min;
+                break;
+            case STATS_MAX:
+                v = s->max;
+                break;
+            case STATS_MEAN:
+                v = stats_mean( s );
+                break;
+            default:
+                v = stats_stddev( s );
+                break;
+        }
+        buf[n++] = v >> 8;
+        buf[n++] = v;
+    }
+    return n;
+}// end of stats_encode function.
+
+/*
+ * stats_benchmark function of type void.
+ *
+ * Input parameters: unsigned int rounds
+ *
+ */
+void stats_benchmark (u4_t rounds) {
+    static const u1_t SELECT[] = { STATS_MIN | STATS_MAX,
+                                   STATS_MIN | STATS_MAX | STATS_MEAN,
+                                   STATS_COUNT | STATS_MIN | STATS_MAX | STATS_MEAN | STATS_STDDEV };
+    u4_t cost[sizeof( SELECT )];
+    u4_t check = 0;
+
+    if( rounds == 0 ) {
+        return;
+    }
+    for( u1_t i = 0; i < sizeof( SELECT ); i++ ) {
+        stats_t s;
+        u4_t seed = 1;
+
+        stats_init( &s, SELECT[i] );
+        u4_t start = bench_counter( );
+        for( u4_t r = 0; r < rounds; r++ ) {
+            // Readings around 21.50 with a spread of +-5.12.
+            seed = seed * 1664525 + 1013904223;
+            stats_add( &s, (s2_t)( 2150 + (s2_t)( ( seed >> 16 ) & 0x3FF ) - 512 ) );
+        }
+        cost[i] = bench_counter( ) - start;
+        check += s.min + s.max + stats_mean( &s ) + stats_stddev( &s );
+    }
+    printf("Window stats update (%s per reading): min/max %u, mean %u, all %u (%08X)\r\n", bench_unit( ),
+           (unsigned int)( cost[0] / rounds ), (unsigned int)( cost[1] / rounds ),
+           (unsigned int)( cost[2] / rounds ), (unsigned int)check);
+}// end of stats_benchmark function.
@@ -0,0 +1,129 @@
+/*******************************************************************************
+ * Internet of Things (IoT) smart monitoring
+ * device for agriculture using LoRaWAN technology.
+ *
+ * Incremental window statistics.
+ *
+ * - A stats_t summarises one sensor channel over a window of readings in
+ * constant memory: count, minimum, maximum, mean and variance, updated with
+ * Welford's algorithm in fixed point (mean in Q8 hundredths, squared
+ * deviations in 64 bits), so that no reading is kept and no float is used.
+ *
+ * - The statistics kept by a channel are selected when it is initialised;
+ * unselected ones are neither updated nor encoded, e.g. a channel reporting
+ * only its minimum and maximum skips the Welford update.
+ *
+ * - stats_encode writes the selected statistics of a channel as big-endian
+ * 16-bit values into a window summary frame; the variance is sent as the
+ * standard deviation so that it keeps the units (value * 100) of the
+ * readings.
+ *
+ *******************************************************************************/
+#ifndef _stats_hpp_
+#define _stats_hpp_
+
+#include "lmic.h"
+
+// Fractional bits of the fixed-point mean.
+#define STATS_FRAC 8
+
+// Selectable statistics, encoded in this order.
+enum {
+    STATS_COUNT  = 0x01,  // Number of readings in the window.
+    STATS_MIN    = 0x02,  // Smallest reading.
+    STATS_MAX    = 0x04,  // Largest reading.
+    STATS_MEAN   = 0x08,  // Mean reading.
+    STATS_STDDEV = 0x10   // Sample standard deviation.
+};
+
+/*
+ * stats_t structure.
+ *
+ * Running statistics of one channel over the present window.
+ */
+typedef struct {
+    u1_t select;          // Statistics kept (STATS_COUNT ... STATS_STDDEV).
+    u2_t count;           // Readings in the window.
+    s2_t min;             // Smallest reading.
+    s2_t max;             // Largest reading.
+    s4_t mean;            // Mean reading (Q8).
+    long long m2;         // Sum of squared deviations from the mean (Q16).
+} stats_t;
+
+/*
+ * stats_init function of type void.
+ *
+ * Selects the statistics kept by a channel and starts an empty window.
+ *
+ * Input parameters: stats_t s
+ *                   unsigned char select (STATS_COUNT | ... | STATS_STDDEV)
+ */
+void stats_init (stats_t* s, u1_t select);
+
+/*
+ * stats_reset function of type void.
+ *
+ * Starts a new, empty window keeping the selected statistics.
+ *
+ * Input parameters: stats_t s
+ */
+void stats_reset (stats_t* s);
+
+/*
+ * stats_add function of type void.
+ *
+ * Adds one reading to the window in constant time.
+ *
+ * Input parameters: stats_t s
+ *                   signed short x (value * 100)
+ */
+void stats_add (stats_t* s, s2_t x);
+
+/*
+ * stats_mean function of type signed short.
+ *
+ * Input parameters: const stats_t s
+ * Return: rounded mean reading, 0 for an empty window.
+ */
+s2_t stats_mean (const stats_t* s);
+
+/*
+ * stats_stddev function of type unsigned short.
+ *
+ * Input parameters: const stats_t s
+ * Return: sample standard deviation, 0 for fewer than two readings.
+ */
+u2_t stats_stddev (const stats_t* s);
+
+/*
+ * stats_length function of type unsigned char.
+ *
+ * Input parameters: const stats_t s
+ * Return: number of bytes stats_encode writes for the channel.
+ */
+u1_t stats_length (const stats_t* s);
+
+/*
+ * stats_encode function of type unsigned char.
+ *
+ * Writes the selected statistics of the window as big-endian 16-bit values
+ * (count, minimum, maximum, mean, standard deviation) into buf.
+ *
+ * Input parameters: const stats_t s
+ *                   unsigned char buf
+ * Return: number of bytes written.
+ */
+u1_t stats_encode (const stats_t* s, u1_t* buf);
+
+/*
+ * stats_benchmark function of type void.
+ *
+ * Measures the cost of stats_add per reading, averaged over rounds, for
+ * minimum/maximum only, with the mean and with every statistic, and writes
+ * it to the UART (CPU cycles on Cortex-M, nanoseconds elsewhere).
+ *
+ * Input parameters: unsigned int rounds
+ */
+void stats_benchmark (u4_t rounds);
+
+#endif // _stats_hpp_
@@ -0,0 +1,64 @@
+/*******************************************************************************
+ * Internet of Things (IoT) smart monitoring
+ * device for agriculture using LoRaWAN technology.
+ *
+ * Timing statistics.
+ *
+ * SEE timing.h file for the description of each function.
+ *
+ *******************************************************************************/
+
+#if defined(__MBED__)
+#include "mbed.h"
+#else
+#include <stdio.h>
+#include <string.h>
+#endif
+#include "lmic.h"
+#include "timing.h"
+
+/*
+ * timing_init function of type void.
+ *
+ * Input parameters: timing_t t
+ *
+ */
+void timing_init (timing_t* t) {
+    memset( t, 0, sizeof( *t ) );
+}// end of timing_init function.
+
+/*
+ * timing_add function of type void.
+ *
+ * Input parameters: timing_t t
+ *                   ostime_t d
+ *
+ */
+void timing_add (timing_t* t, ostime_t d) {
+    if( t->count == 0 || d < t->min ) {
+        t->min = d;
+    }
+    if( t->count == 0 || d > t->max ) {
+        t->max = d;
+    }
+    t->last = d;
+    t->sum += d;
+    t->count++;
+}// end of timing_add function.
+
+/*
+ * timing_report function of type void.
+ *
+ * Input parameters: const char name
+ *                   const timing_t t
+ *
+ */
+void timing_report (const char* name, const timing_t* t) {
+    if( t->count == 0 ) {
+        printf("  %-14s no measurements\r\n", name);
+        return;
+    }
+    printf("  %-14s n %u, mean %d ms, min %d ms, max %d ms, jitter %d ms\r\n", name,
+           (unsigned int)t->count, (int)osticks2ms( t->sum / t->count ), (int)osticks2ms( t->min ),
+           (int)osticks2ms( t->max ), (int)osticks2ms( t->max - t->min ));
+}// end of timing_report function.
@@ -0,0 +1,59 @@
+/*******************************************************************************
+ * Internet of Things (IoT) smart monitoring
+ * device for agriculture using LoRaWAN technology.
+ *
+ * Timing statistics.
+ *
+ * - A timing_t accumulates the count, minimum, maximum and mean of a
+ * duration measured in os ticks, e.g. the sample-to-air latency or the
+ * deviation of each transmission from its scheduled slot. The spread
+ * (maximum - minimum) is the jitter.
+ *
+ *******************************************************************************/
+#ifndef _timing_hpp_
+#define _timing_hpp_
+
+#include "lmic.h"
+
+/*
+ * timing_t structure.
+ *
+ * Statistics of one measured duration.
+ */
+typedef struct {
+    u4_t count;           // Number of measurements.
+    ostime_t min;         // Shortest duration.
+    ostime_t max;         // Longest duration.
+    ostime_t last;        // Latest duration.
+    long long sum;        // Sum of all durations.
+} timing_t;
+
+/*
+ * timing_init function of type void.
+ *
+ * Input parameters: timing_t t
+ */
+void timing_init (timing_t* t);
+
+/*
+ * timing_add function of type void.
+ *
+ * Adds one measured duration.
+ *
+ * Input parameters: timing_t t
+ *                   ostime_t d
+ */
+void timing_add (timing_t* t, ostime_t d);
+
+/*
+ * timing_report function of type void.
+ *
+ * Writes the count, mean, minimum, maximum and jitter (in milliseconds)
+ * to the UART.
+ *
+ * Input parameters: const char name
+ *                   const timing_t t
+ */
+void timing_report (const char* name, const timing_t* t);
+
+#endif // _timing_hpp_
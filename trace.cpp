@@ -0,0 +1,357 @@
+/*******************************************************************************
+ * Internet of Things (IoT) smart monitoring
+ * device for agriculture using LoRaWAN technology.
+ *
+ * HAL event recorder and deterministic replay.
+ *
+ * Recording stops once the buffer is full or has been dumped, so that a
+ * dump always starts at trace_init: the LMiC and application state before
+ * the first record is the boot state, and the trace replays from boot.
+ *
+ * SEE trace.h file for the description of each function.
+ *
+ *******************************************************************************/
+
+#if defined(__MBED__)
+#include "mbed.h"
+#else
+#include <stdio.h>
+#include <string.h>
+#endif
+#include "lmic.h"
+#include "hal.h"
+#include "memstat.h"
+#include "trace.h"
+
+// Largest value held by the 24-bit record fields.
+#define TRACE_MAX24 0xFFFFFF
+
+#if HAL_TRACE
+
+static trace_rec_t ring[TRACE_RING_SIZE];
+static u2_t count = 0;      // records held
+static u4_t base = 0;       // ticks preceding the first record
+static u4_t lastTicks = 0;  // last recorded reading
+static bit_t haveTicks = 0; // set once a reading has been recorded
+static bit_t stopped = 0;   // buffer full or dumped
+
+/*
+ * get24 function of type unsigned int.
+ *
+ * Input parameters: const trace_rec_t r
+ * Return: 24-bit value held in a..c (a least significant).
+ */
+static u4_t get24 (const trace_rec_t* r) {
+    return r->a | ( (u4_t)r->b << 8 ) | ( (u4_t)r->c << 16 );
+}// end of get24 function.
+
+/*
+ * append function of type void.
+ *
+ * Adds a record, stopping the recording once the buffer is full.
+ *
+ * Input parameters: unsigned char kind
+ *                   unsigned int data (a..c, a least significant)
+ */
+static void append (u1_t kind, u4_t data) {
+    hal_disableIRQs( );
+    if( !stopped ) {
+        trace_rec_t* r = &ring[count++];
+        r->kind = kind;
+        r->a = data;
+        r->b = data >> 8;
+        r->c = data >> 16;
+        stopped = count == TRACE_RING_SIZE;
+    }
+    hal_enableIRQs( );
+}// end of append function.
+
+/*
+ * trace_init function of type void.
+ *
+ * Input parameters: None
+ *
+ */
+void trace_init (void) {
+    hal_disableIRQs( );
+    count = 0;
+    base = 0;
+    haveTicks = 0;
+    stopped = 0;
+    hal_enableIRQs( );
+    memstat_region( "trace", sizeof( ring ) );
+}// end of trace_init function.
+
+/*
+ * trace_irq function of type void.
+ *
+ * Input parameters: unsigned char dio
+ *
+ */
+void trace_irq (u1_t dio) {
+    append( TRACE_IRQ, dio );
+}// end of trace_irq function.
+
+/*
+ * trace_spi function of type void.
+ *
+ * Input parameters: unsigned char out
+ *                   unsigned char in
+ *
+ */
+void trace_spi (u1_t out, u1_t in) {
+    append( TRACE_SPI, out | ( (u4_t)in << 8 ) );
+}// end of trace_spi function.
+
+/*
+ * trace_ticks function of type void.
+ *
+ * Input parameters: unsigned int ticks
+ *
+ */
+void trace_ticks (u4_t ticks) {
+    hal_disableIRQs( );
+    if( stopped ) {
+        hal_enableIRQs( );
+        return;
+    }
+    if( !haveTicks ) {
+        // No reading precedes the records held, so the first one is the base.
+        haveTicks = 1;
+        base = lastTicks = ticks;
+    }
+    if( ticks == lastTicks && count != 0 ) {
+        // Fold busy-wait readings of the same tick into one record.
+        trace_rec_t* prev = &ring[count - 1];
+        u4_t n = get24( prev );
+        if( prev->kind == TRACE_REPEAT && n < TRACE_MAX24 ) {
+            n++;
+            prev->a = n;
+            prev->b = n >> 8;
+            prev->c = n >> 16;
+        } else {
+            append( TRACE_REPEAT, 1 );
+        }
+    } else {
+        u4_t delta = ticks - lastTicks;
+        for( ; delta > TRACE_MAX24; delta -= TRACE_MAX24 ) {
+            append( TRACE_SKIP, 0 );
+        }
+        append( TRACE_TICKS, delta );
+        lastTicks = ticks;
+    }
+    hal_enableIRQs( );
+}// end of trace_ticks function.
+
+/*
+ * trace_dump function of type void.
+ *
+ * Input parameters: None
+ *
+ */
+void trace_dump (void) {
+    static bit_t dumped = 0;
+
+    hal_disableIRQs( );
+    bit_t again = dumped;
+    dumped = 1;
+    stopped = 1;
+    hal_enableIRQs( );
+    if( again ) {
+        return;
+    }
+
+    printf("TRACE %08X %u\r\n", (unsigned int)base, count);
+    for( u2_t i = 0; i < count; i++ ) {
+        const trace_rec_t* r = &ring[i];
+        printf("%02X%02X%02X%02X%s", r->kind, r->a, r->b, r->c, ( i % 8 == 7 || i == count - 1 ) ? "\r\n" : " ");
+    }
+    printf("END\r\n");
+}// end of trace_dump function.
+
+#else // !HAL_TRACE
+
+void trace_init (void) {
+}
+
+void trace_irq (u1_t dio) {
+    (void)dio;
+}
+
+void trace_spi (u1_t out, u1_t in) {
+    (void)out;
+    (void)in;
+}
+
+void trace_ticks (u4_t ticks) {
+    (void)ticks;
+}
+
+void trace_dump (void) {
+}
+
+#endif // HAL_TRACE
+
+#if HAL_REPLAY
+
+static const trace_rec_t* replay = NULL;
+static u4_t replayCount = 0;  // records in the loaded trace
+static u4_t cursor = 0;       // next record replayed
+static u4_t replayTicks = 0;  // last reading served
+static u4_t repeatLeft = 0;   // repetitions of replayTicks still to serve
+static u4_t divergences = 0;  // requests not matching the trace
+static bit_t ended = 0;       // a request went past the end of the trace
+
+/*
+ * trace_load function of type void.
+ *
+ * Input parameters: const trace_rec_t recs
+ *                   unsigned int count
+ *                   unsigned int base
+ *
+ */
+void trace_load (const trace_rec_t* recs, u4_t n, u4_t start) {
+    replay = recs;
+    replayCount = n;
+    cursor = 0;
+    replayTicks = start;
+    repeatLeft = 0;
+    divergences = 0;
+    ended = 0;
+}// end of trace_load function.
+
+/*
+ * trace_replayIrq function of type bit_t.
+ *
+ * Input parameters: unsigned char dio
+ * Return: 1 if an interrupt is due.
+ *
+ */
+bit_t trace_replayIrq (u1_t* dio) {
+    if( repeatLeft != 0 || cursor >= replayCount || replay[cursor].kind != TRACE_IRQ ) {
+        return 0;
+    }
+    *dio = replay[cursor++].a;
+    return 1;
+}// end of trace_replayIrq function.
+
+/*
+ * trace_replayTicks function of type unsigned int.
+ *
+ * Input parameters: None
+ * Return: next recorded reading.
+ *
+ */
+u4_t trace_replayTicks (void) {
+    u4_t skipped = 0;
+
+    if( repeatLeft != 0 ) {
+        repeatLeft--;
+        return replayTicks;
+    }
+    while( cursor < replayCount ) {
+        const trace_rec_t* r = &replay[cursor];
+        if( r->kind == TRACE_SKIP ) {
+            skipped += TRACE_MAX24;
+        } else if( r->kind == TRACE_TICKS ) {
+            cursor++;
+            replayTicks += skipped + ( r->a | ( (u4_t)r->b << 8 ) | ( (u4_t)r->c << 16 ) );
+            return replayTicks;
+        } else if( r->kind == TRACE_REPEAT ) {
+            cursor++;
+            repeatLeft = ( r->a | ( (u4_t)r->b << 8 ) | ( (u4_t)r->c << 16 ) ) - 1;
+            return replayTicks;
+        } else {
+            break;
+        }
+        cursor++;
+    }
+    // Past the end of the trace or off the recorded path: keep time moving
+    // so that busy waits end.
+    if( cursor >= replayCount ) {
+        ended = 1;
+    } else {
+        divergences++;
+    }
+    return ++replayTicks;
+}// end of trace_replayTicks function.
+
+/*
+ * trace_replaySpi function of type unsigned char.
+ *
+ * Input parameters: unsigned char out
+ * Return: recorded received byte.
+ *
+ */
+u1_t trace_replaySpi (u1_t out) {
+    if( repeatLeft != 0 ) { // fewer tick readings than recorded
+        divergences++;
+        repeatLeft = 0;
+    }
+    if( cursor >= replayCount ) {
+        ended = 1;
+        return 0;
+    }
+    if( replay[cursor].kind != TRACE_SPI ) {
+        divergences++;
+        return 0;
+    }
+    const trace_rec_t* r = &replay[cursor++];
+    if( r->a != out ) {
+        divergences++;
+    }
+    return r->b;
+}// end of trace_replaySpi function.
+
+/*
+ * trace_replayDone function of type bit_t.
+ *
+ * Input parameters: None
+ * Return: 1 once a request went past the end of the trace.
+ *
+ */
+bit_t trace_replayDone (void) {
+    return ended;
+}// end of trace_replayDone function.
+
+/*
+ * trace_replayReport function of type bit_t.
+ *
+ * Input parameters: None
+ * Return: 1 if the whole trace has been replayed without divergence.
+ *
+ */
+bit_t trace_replayReport (void) {
+    printf("Replay: %u of %u records, %u divergences\r\n", (unsigned int)cursor,
+           (unsigned int)replayCount, (unsigned int)divergences);
+    return cursor >= replayCount && divergences == 0;
+}// end of trace_replayReport function.
+
+#endif // HAL_REPLAY
+
+/*
+ * trace_app function of type unsigned short.
+ *
+ * Input parameters: unsigned char id
+ *                   unsigned short value
+ * Return: value, or the recorded value when replaying.
+ *
+ */
+u2_t trace_app (u1_t id, u2_t value) {
+#if HAL_REPLAY
+    if( repeatLeft == 0 && cursor < replayCount && replay[cursor].kind == TRACE_APP && replay[cursor].a == id ) {
+        const trace_rec_t* r = &replay[cursor++];
+        return r->b | ( r->c << 8 );
+    }
+    if( cursor >= replayCount ) {
+        ended = 1;
+    } else {
+        divergences++;
+    }
+#elif HAL_TRACE
+    append( TRACE_APP, id | ( (u4_t)value << 8 ) );
+#else
+    (void)id;
+#endif
+    return value;
+}// end of trace_app function.
@@ -0,0 +1,191 @@
+/*******************************************************************************
+ * Internet of Things (IoT) smart monitoring
+ * device for agriculture using LoRaWAN technology.
+ *
+ * HAL event recorder and deterministic replay.
+ *
+ * - With HAL_TRACE set to 1 the HAL logs every DIO interrupt edge, every
+ * byte exchanged by hal_spi() and every hal_ticks() reading into a RAM
+ * buffer of 4-byte records, from trace_init() until the buffer is full. Tick readings are stored as deltas, and repeated
+ * readings of the same tick (busy waits) are folded into one record.
+ * Application events, such as the DHT11 error code and reading, are logged
+ * with trace_app().
+ *
+ * - trace_dump() writes the buffer to the UART as hex lines once and stops
+ * the recording; trace2h.sh turns such a capture into trace_data.h.
+ *
+ * - With HAL_REPLAY set to 1 the HAL serves hal_ticks(), hal_spi() and the
+ * DIO interrupts from a loaded trace instead of the hardware, and
+ * trace_app() returns the recorded values. LMiC and the application then run
+ * the recorded field session deterministically, e.g. on a host, and the
+ * trace can be reused as a timing or regression benchmark. Any deviation
+ * from the recorded SPI traffic is counted as a divergence. The replay
+ * ends when the HAL is asked for more than the trace holds.
+ *
+ *******************************************************************************/
+#ifndef _trace_hpp_
+#define _trace_hpp_
+
+#include "lmic.h"
+
+// Set to 1 to record HAL events into the trace buffer.
+#ifndef HAL_TRACE
+#define HAL_TRACE 0
+#endif
+
+// Set to 1 to replay a recorded trace (trace_data.h) instead of the hardware.
+#ifndef HAL_REPLAY
+#define HAL_REPLAY 0
+#endif
+
+// Number of 4-byte records kept in the trace buffer.
+#ifndef TRACE_RING_SIZE
+#define TRACE_RING_SIZE 1024
+#endif
+
+// Record kinds.
+enum {
+    TRACE_IRQ = 1,      // DIO interrupt edge: a = DIO line.
+    TRACE_SPI,          // SPI byte: a = sent, b = received.
+    TRACE_TICKS,        // hal_ticks() reading: a..c = 24-bit delta to the previous reading.
+    TRACE_SKIP,         // Adds 0xFFFFFF ticks to the next reading.
+    TRACE_REPEAT,       // Previous reading repeated a..c (24-bit) more times.
+    TRACE_APP           // Application event: a = id, b..c = 16-bit value.
+};
+
+// Application event ids.
+enum {
+    TRACE_APP_DHT = 1,      // DHT11 readData() result.
+    TRACE_APP_PHASE,        // Boot or cycle phase marker.
+    TRACE_APP_TEMPERATURE,  // DHT11 temperature in hundredths of a degree (signed).
+    TRACE_APP_HUMIDITY      // DHT11 humidity in hundredths of a percent.
+};
+
+/*
+ * trace_rec_t structure.
+ *
+ * One trace record.
+ */
+typedef struct {
+    u1_t kind;  // Record kind.
+    u1_t a;     // Kind-specific data.
+    u1_t b;
+    u1_t c;
+} trace_rec_t;
+
+/*
+ * trace_init function of type void.
+ *
+ * Empties the trace buffer and starts recording.
+ *
+ * Input parameters: None
+ */
+void trace_init (void);
+
+/*
+ * trace_irq function of type void.
+ *
+ * Records a DIO interrupt edge.
+ *
+ * Input parameters: unsigned char dio
+ */
+void trace_irq (u1_t dio);
+
+/*
+ * trace_spi function of type void.
+ *
+ * Records one SPI byte exchange.
+ *
+ * Input parameters: unsigned char out
+ *                   unsigned char in
+ */
+void trace_spi (u1_t out, u1_t in);
+
+/*
+ * trace_ticks function of type void.
+ *
+ * Records a hal_ticks() reading.
+ *
+ * Input parameters: unsigned int ticks
+ */
+void trace_ticks (u4_t ticks);
+
+/*
+ * trace_app function of type unsigned short.
+ *
+ * Records an application event; when replaying, returns the recorded value
+ * of the next event with the same id instead.
+ *
+ * Input parameters: unsigned char id
+ *                   unsigned short value
+ * Return: value, or the recorded value when replaying.
+ */
+u2_t trace_app (u1_t id, u2_t value);
+
+/*
+ * trace_dump function of type void.
+ *
+ * Writes the buffer to the UART as hex lines preceded by the absolute tick
+ * value the first delta refers to, and stops the recording. Later calls do
+ * nothing.
+ *
+ * Input parameters: None
+ */
+void trace_dump (void);
+
+/*
+ * trace_load function of type void.
+ *
+ * Selects a recorded trace for replay.
+ *
+ * Input parameters: const trace_rec_t recs
+ *                   unsigned int count
+ *                   unsigned int base (absolute ticks before the first record)
+ */
+void trace_load (const trace_rec_t* recs, u4_t count, u4_t base);
+
+/*
+ * trace_replayIrq function of type bit_t.
+ *
+ * Consumes the next record if it is an interrupt edge.
+ *
+ * Input parameters: unsigned char dio (output)
+ * Return: 1 if an interrupt is due, 0 otherwise.
+ */
+bit_t trace_replayIrq (u1_t* dio);
+
+/*
+ * trace_replayTicks function of type unsigned int.
+ *
+ * Input parameters: None
+ * Return: next recorded hal_ticks() reading.
+ */
+u4_t trace_replayTicks (void);
+
+/*
+ * trace_replaySpi function of type unsigned char.
+ *
+ * Input parameters: unsigned char out
+ * Return: byte received in the next recorded SPI exchange.
+ */
+u1_t trace_replaySpi (u1_t out);
+
+/*
+ * trace_replayDone function of type bit_t.
+ *
+ * Input parameters: None
+ * Return: 1 once the HAL asked for more than the trace holds.
+ */
+bit_t trace_replayDone (void);
+
+/*
+ * trace_replayReport function of type bit_t.
+ *
+ * Writes the replay progress and divergence count to the UART.
+ *
+ * Input parameters: None
+ * Return: 1 if the whole trace has been replayed without divergence.
+ */
+bit_t trace_replayReport (void);
+
+#endif // _trace_hpp_
@@ -0,0 +1,42 @@
+#!/bin/sh
+###############################################################################
+# Internet of Things (IoT) smart monitoring
+# device for agriculture using LoRaWAN technology.
+#
+# Converts a trace_dump() capture into trace_data.h for HAL_REPLAY builds.
+#
+# The capture is the UART output between the "TRACE <base> <count>" and
+# "END" lines (any other terminal output is ignored). When the capture
+# holds several dumps, the last one is used.
+#
+# Usage: ./trace2h.sh capture.txt > trace_data.h
+###############################################################################
+
+if [ $# -ne 1 ] || [ ! -r "$1" ]; then
+    echo "usage: $0 capture.txt > trace_data.h" >&2
+    exit 1
+fi
+
+tr -d '\r' < "$1" | awk '
+/^TRACE [0-9A-Fa-f]+ [0-9]+$/ { base = $2; n = 0; body = ""; inside = 1; next }
+/^END$/ { if( inside ) { lastBase = base; lastN = n; lastBody = body; found = 1 } inside = 0; next }
+inside {
+    for( i = 1; i <= NF; i++ ) {
+        r = $i
+        body = body sprintf("    { 0x%s, 0x%s, 0x%s, 0x%s },\n",
+                            substr(r, 1, 2), substr(r, 3, 2), substr(r, 5, 2), substr(r, 7, 2))
+        n++
+    }
+}
+END {
+    if( !found ) { print "no complete trace found" > "/dev/stderr"; exit 1 }
+    print "// Generated by trace2h.sh, do not edit."
+    print "#ifndef _trace_data_hpp_"
+    print "#define _trace_data_hpp_"
+    print ""
+    print "#include \"trace.h\""
+    print ""
+    printf "// Ticks preceding the first record.\nstatic const u4_t TRACE_BASE = 0x%s;\n\n", lastBase
+    printf "// %d recorded HAL events.\nstatic const trace_rec_t TRACE_DATA[] = {\n%s};\n\n", lastN, lastBody
+    print "#endif // _trace_data_hpp_"
+}'
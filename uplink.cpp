@@ -0,0 +1,500 @@
+/*******************************************************************************
+ * Internet of Things (IoT) smart monitoring
+ * device for agriculture using LoRaWAN technology.
+ *
+ * Priority uplink queue.
+ *
+ * Queued frames live in a fixed pool; the order within a class is kept by a
+ * sequence number, so that any frame can leave the pool when it is
+ * coalesced into a carrier frame.
+ *
+ * SEE uplink.h file for the description of each function.
+ *
+ *******************************************************************************/
+
+#if defined(__MBED__)
+#include "mbed.h"
+#else
+#include <stdio.h>
+#include <string.h>
+#endif
+#include "lmic.h"
+#include "memstat.h"
+#include "timing.h"
+#include "channels.h"
+#include "uplink.h"
+
+/*
+ * entry_t structure.
+ *
+ * One queued frame.
+ */
+typedef struct {
+    u1_t cls;             // Class, UPLINK_NONE if the entry is free.
+    u1_t len;             // Frame length.
+    u1_t inflight;        // Part of the uplink handed over to LMiC.
+    u2_t seq;             // Queueing order.
+    ostime_t queued;      // Time the frame was queued.
+    u1_t data[UPLINK_FRAME_MAX - 2];
+} entry_t;
+
+static const char* const NAMES[UPLINK_CLASSES] = { "alarm", "telemetry", "summary", "diag" };
+
+static entry_t queue[UPLINK_DEPTH];
+static u2_t seq = 0;
+static u1_t ports[UPLINK_CLASSES];
+static u1_t flags[UPLINK_CLASSES];
+static u2_t quota[UPLINK_CLASSES];      // Airtime quota (ms per period).
+static u4_t air[UPLINK_CLASSES];        // Airtime in the present period (ms).
+static u4_t uplinks[UPLINK_CLASSES];    // Uplinks of the class.
+static u4_t coalesced[UPLINK_CLASSES];  // Frames carried by a higher class.
+static u4_t preempted[UPLINK_CLASSES];  // Frames displaced at LMiC.
+static u4_t deferred[UPLINK_CLASSES];   // Selections skipped over the quota.
+static u4_t dropped[UPLINK_CLASSES];    // Frames dropped from a full queue.
+static u1_t inflight = UPLINK_NONE;     // Class handed over to LMiC.
+static u1_t heldInflight = UPLINK_NONE; // Class of the caller's frame carried by it.
+static ostime_t periodStart = 0;
+static timing_t alarmLatency;
+
+/*
+ * oldest function of type entry_t pointer.
+ *
+ * Input parameters: unsigned char cls
+ *                   bit_t idle (skip the frames handed over to LMiC)
+ * Return: oldest queued frame of the class or NULL.
+ */
+static entry_t* oldest (u1_t cls, bit_t idle) {
+    entry_t* e = NULL;
+
+    for( u1_t i = 0; i < UPLINK_DEPTH; i++ ) {
+        if( queue[i].cls == cls && !( idle && queue[i].inflight ) &&
+            ( e == NULL || (s2_t)( queue[i].seq - e->seq ) < 0 ) ) {
+            e = &queue[i];
+        }
+    }
+    return e;
+}// end of oldest function.
+
+/*
+ * rollPeriod function of type void.
+ *
+ * Starts a new quota period once the present one has passed.
+ *
+ * Input parameters: ostime_t now
+ */
+static void rollPeriod (ostime_t now) {
+    if( now - periodStart >= sec2osticks( UPLINK_QUOTA_PERIOD ) ) {
+        memset( air, 0, sizeof( air ) );
+        periodStart = now;
+    }
+}// end of rollPeriod function.
+
+/*
+ * uplink_init function of type void.
+ *
+ * Input parameters: None
+ *
+ */
+void uplink_init (void) {
+    for( u1_t i = 0; i < UPLINK_DEPTH; i++ ) {
+        queue[i].cls = UPLINK_NONE;
+    }
+    memset( air, 0, sizeof( air ) );
+    memset( uplinks, 0, sizeof( uplinks ) );
+    memset( coalesced, 0, sizeof( coalesced ) );
+    memset( preempted, 0, sizeof( preempted ) );
+    memset( deferred, 0, sizeof( deferred ) );
+    memset( dropped, 0, sizeof( dropped ) );
+    inflight = UPLINK_NONE;
+    heldInflight = UPLINK_NONE;
+    periodStart = os_getTime( );
+    timing_init( &alarmLatency );
+    memstat_region( "uplink queue", sizeof( queue ) );
+}// end of uplink_init function.
+
+/*
+ * uplink_setup function of type void.
+ *
+ * Input parameters: unsigned char cls
+ *                   unsigned char port
+ *                   unsigned short q
+ *                   unsigned char f
+ *
+ */
+void uplink_setup (u1_t cls, u1_t port, u2_t q, u1_t f) {
+    ports[cls] = port;
+    quota[cls] = q;
+    flags[cls] = f;
+}// end of uplink_setup function.
+
+/*
+ * uplink_push function of type bit_t.
+ *
+ * Input parameters: unsigned char cls
+ *                   const unsigned char data
+ *                   unsigned char len
+ * Return: 1 if queued, 0 otherwise.
+ *
+ */
+bit_t uplink_push (u1_t cls, const u1_t* data, u1_t len) {
+    entry_t* e = NULL;
+
+    if( len > sizeof( queue[0].data ) ) {
+        return 0;
+    }
+    if( flags[cls] & UPLINK_LATEST ) {
+        e = oldest( cls, 1 );
+    }
+    for( u1_t i = 0; e == NULL && i < UPLINK_DEPTH; i++ ) {
+        if( queue[i].cls == UPLINK_NONE ) {
+            e = &queue[i];
+        }
+    }
+    // Queue full, drop the oldest frame of the lowest class not above cls.
+    for( u1_t c = UPLINK_CLASSES; e == NULL && c-- > cls; ) {
+        e = oldest( c, 1 );
+        if( e != NULL ) {
+            dropped[c]++;
+        }
+    }
+    if( e == NULL ) {
+        dropped[cls]++;
+        return 0;
+    }
+    e->cls = cls;
+    e->len = len;
+    e->inflight = 0;
+    e->seq = seq++;
+    e->queued = os_getTime( );
+    memcpy( e->data, data, len );
+    return 1;
+}// end of uplink_push function.
+
+/*
+ * uplink_count function of type unsigned char.
+ *
+ * Input parameters: None
+ * Return: number of queued frames.
+ *
+ */
+u1_t uplink_count (void) {
+    u1_t n = 0;
+
+    for( u1_t i = 0; i < UPLINK_DEPTH; i++ ) {
+        n += queue[i].cls != UPLINK_NONE;
+    }
+    return n;
+}// end of uplink_count function.
+
+/*
+ * uplink_select function of type unsigned char.
+ *
+ * Input parameters: unsigned char external
+ * Return: class of the next uplink or UPLINK_NONE.
+ *
+ */
+u1_t uplink_select (u1_t external) {
+    rollPeriod( os_getTime( ) );
+    for( u1_t c = 0; c < UPLINK_CLASSES; c++ ) {
+        bit_t pending = ( flags[c] & UPLINK_EXTERNAL ) ? ( external & ( 1 << c ) ) != 0
+                                                       : oldest( c, 0 ) != NULL;
+        if( !pending ) {
+            continue;
+        }
+        if( quota[c] != 0 && air[c] >= quota[c] ) {
+            deferred[c]++;
+            continue;
+        }
+        return c;
+    }
+    return UPLINK_NONE;
+}// end of uplink_select function.
+
+/*
+ * uplink_append function of type unsigned char.
+ *
+ * Input parameters: unsigned char buf
+ *                   unsigned char len
+ *                   unsigned char port
+ *                   const unsigned char data
+ *                   unsigned char dlen
+ * Return: new frame length.
+ *
+ */
+u1_t uplink_append (u1_t* buf, u1_t len, u1_t port, const u1_t* data, u1_t dlen) {
+    if( len + 2 + dlen > UPLINK_FRAME_MAX ) {
+        return len;
+    }
+    buf[len] = port;
+    buf[len + 1] = dlen;
+    memcpy( buf + len + 2, data, dlen );
+    return len + 2 + dlen;
+}// end of uplink_append function.
+
+/*
+ * uplink_build function of type unsigned char.
+ *
+ * Input parameters: unsigned char cls
+ *                   unsigned char buf
+ *                   unsigned char held
+ *                   const unsigned char data
+ *                   unsigned char dlen
+ * Return: frame length.
+ *
+ */
+u1_t uplink_build (u1_t cls, u1_t* buf, u1_t held, const u1_t* data, u1_t dlen) {
+    entry_t* e;
+    u1_t len;
+
+    // A lower frame not on air yet is replaced at LMiC and stays queued.
+    if( inflight != UPLINK_NONE && inflight > cls ) {
+        preempted[inflight]++;
+    }
+    for( u1_t i = 0; i < UPLINK_DEPTH; i++ ) {
+        queue[i].inflight = 0;
+    }
+    inflight = cls;
+    heldInflight = UPLINK_NONE;
+    if( flags[cls] & UPLINK_EXTERNAL ) {
+        return 0;
+    }
+    e = oldest( cls, 0 );
+    if( e == NULL ) {
+        inflight = UPLINK_NONE;
+        return 0;
+    }
+    e->inflight = 1;
+    if( ( flags[cls] & UPLINK_CARRIER ) == 0 ) {
+        memcpy( buf, e->data, e->len );
+        return e->len;
+    }
+    len = uplink_append( buf, 0, ports[cls], e->data, e->len );
+    // Lower pending frames ride along, highest class and oldest first.
+    for( u1_t c = cls + 1; c < UPLINK_CLASSES; c++ ) {
+        if( c == held && ( flags[c] & UPLINK_EXTERNAL ) ) {
+            u1_t n = uplink_append( buf, len, ports[c], data, dlen );
+            if( n != len ) {
+                heldInflight = c;
+                len = n;
+            }
+            continue;
+        }
+        while( ( e = oldest( c, 1 ) ) != NULL ) {
+            u1_t n = uplink_append( buf, len, ports[c], e->data, e->len );
+            if( n == len ) {
+                break;
+            }
+            e->inflight = 1;
+            len = n;
+        }
+    }
+    return len;
+}// end of uplink_build function.
+
+/*
+ * uplink_carried function of type bit_t.
+ *
+ * Input parameters: None
+ * Return: 1 if the uplink handed over to LMiC carries the held frame.
+ *
+ */
+bit_t uplink_carried (void) {
+    return heldInflight != UPLINK_NONE;
+}// end of uplink_carried function.
+
+/*
+ * uplink_port function of type unsigned char.
+ *
+ * Input parameters: unsigned char cls
+ * Return: port of the class.
+ *
+ */
+u1_t uplink_port (u1_t cls) {
+    return ports[cls];
+}// end of uplink_port function.
+
+/*
+ * uplink_sent function of type unsigned char.
+ *
+ * Input parameters: ostime_t start
+ *                   ostime_t end
+ * Return: class of the completed uplink or UPLINK_NONE.
+ *
+ */
+u1_t uplink_sent (ostime_t start, ostime_t end) {
+    u1_t cls = inflight;
+
+    if( cls == UPLINK_NONE ) {
+        return UPLINK_NONE;
+    }
+    rollPeriod( end );
+    air[cls] += osticks2ms( end - start );
+    uplinks[cls]++;
+    if( heldInflight != UPLINK_NONE ) {
+        coalesced[heldInflight]++;
+    }
+    for( u1_t i = 0; i < UPLINK_DEPTH; i++ ) {
+        entry_t* e = &queue[i];
+        if( e->cls == UPLINK_NONE || !e->inflight ) {
+            continue;
+        }
+        if( e->cls != cls ) {
+            coalesced[e->cls]++;
+        }
+        if( e->cls == UPLINK_ALARM ) {
+            timing_add( &alarmLatency, start - e->queued );
+        }
+        e->cls = UPLINK_NONE;
+        e->inflight = 0;
+    }
+    inflight = UPLINK_NONE;
+    heldInflight = UPLINK_NONE;
+    return cls;
+}// end of uplink_sent function.
+
+/*
+ * uplink_report function of type void.
+ *
+ * Input parameters: None
+ *
+ */
+void uplink_report (void) {
+    printf("Uplink classes:\r\n");
+    for( u1_t c = 0; c < UPLINK_CLASSES; c++ ) {
+        printf("  %-9s port %u: %u uplinks, %u coalesced, %u preempted, %u deferred, %u dropped, %u ms on air",
+               NAMES[c], ports[c], (unsigned int)uplinks[c], (unsigned int)coalesced[c],
+               (unsigned int)preempted[c], (unsigned int)deferred[c], (unsigned int)dropped[c],
+               (unsigned int)air[c]);
+        if( quota[c] != 0 ) {
+            printf(" of %u ms/h", quota[c]);
+        }
+        printf("\r\n");
+    }
+    timing_report( "alarm latency", &alarmLatency );
+}// end of uplink_report function.
+
+/*
+ * simRandom function of type unsigned int.
+ *
+ * Input parameters: unsigned int seed
+ * Return: next pseudo-random value, deterministic across runs.
+ */
+static u4_t simRandom (u4_t* seed) {
+    *seed = *seed * 1664525 + 1013904223;
+    return *seed;
+}// end of simRandom function.
+
+/*
+ * uplink_simulate function of type void.
+ *
+ * Input parameters: unsigned short interval
+ *                   unsigned short alarmEvery
+ *                   unsigned short hours
+ *
+ */
+void uplink_simulate (u2_t interval, u2_t alarmEvery, u2_t hours) {
+    // Frame lengths of alarm, sample, default summary and diagnostics.
+    static const u1_t LENGTH[UPLINK_CLASSES] = { 3, 8, 22, 5 };
+    static const char* const POLICY[] = { "FIFO", "priority" };
+    static u1_t simClass[UPLINK_DEPTH * 4];
+    static u4_t simAt[UPLINK_DEPTH * 4];
+    const u1_t depth = sizeof( simClass );
+    u4_t end = (u4_t)hours * 3600000;
+
+    if( interval == 0 || alarmEvery == 0 || hours == 0 || hours > 1000 ) {
+        return;
+    }
+    printf("Uplink queue: sample every %u s, alarm every %u s on average, 1%% duty cycle at SF7, %u h\r\n",
+           interval, alarmEvery, hours);
+    for( u1_t p = 0; p < 2; p++ ) {
+        u4_t seed = 1;
+        u4_t t = 0, freeAt = 0;
+        u4_t nextSample = 0, nextHour = 3600000, nextAlarm = simRandom( &seed ) % ( alarmEvery * 2000UL );
+        u4_t frames = 0, lost = 0;
+        u4_t count[2] = { 0, 0 }, worst[2] = { 0, 0 };
+        unsigned long long sum[2] = { 0, 0 };
+        u1_t n = 0;
+
+        while( t < end ) {
+            // Arrivals; a full queue drops its oldest frame, of the lowest
+            // class with priorities.
+            u1_t arriving[UPLINK_CLASSES] = { 0, 0, 0, 0 };
+            if( t >= nextAlarm ) {
+                arriving[UPLINK_ALARM] = 1;
+                nextAlarm += 1 + simRandom( &seed ) % ( alarmEvery * 2000UL );
+            }
+            if( t >= nextSample ) {
+                arriving[UPLINK_TELEMETRY] = 1;
+                nextSample += interval * 1000UL;
+            }
+            if( t >= nextHour ) {
+                arriving[UPLINK_SUMMARY] = arriving[UPLINK_DIAG] = 1;
+                nextHour += 3600000;
+            }
+            for( u1_t c = 0; c < UPLINK_CLASSES; c++ ) {
+                if( !arriving[c] ) {
+                    continue;
+                }
+                if( n == depth ) {
+                    u1_t drop = 0;
+                    for( u1_t i = 1; p == 1 && i < n; i++ ) {
+                        if( simClass[i] > simClass[drop] ) {
+                            drop = i;
+                        }
+                    }
+                    memmove( simClass + drop, simClass + drop + 1, depth - 1 - drop );
+                    memmove( simAt + drop, simAt + drop + 1, ( depth - 1 - drop ) * sizeof( simAt[0] ) );
+                    n--;
+                    lost++;
+                }
+                simClass[n] = c;
+                simAt[n++] = t;
+            }
+            // The radio takes the oldest frame, or the oldest of the highest
+            // class carrying what fits of the rest.
+            if( n != 0 && t >= freeAt ) {
+                u1_t pick = 0;
+                u1_t len = 0;
+                if( p == 1 ) {
+                    for( u1_t i = 1; i < n; i++ ) {
+                        if( simClass[i] < simClass[pick] ) {
+                            pick = i;
+                        }
+                    }
+                }
+                u1_t k = 0;
+                for( u1_t i = 0; i < n; i++ ) {
+                    u1_t c = simClass[i];
+                    bit_t carrier = p == 1 && simClass[pick] == UPLINK_ALARM;
+                    if( i == pick || ( carrier && c != UPLINK_ALARM &&
+                                       len + 2 + LENGTH[c] <= UPLINK_FRAME_MAX ) ) {
+                        len += ( carrier ? 2 : 0 ) + LENGTH[c];
+                        if( c <= UPLINK_TELEMETRY ) {
+                            count[c]++;
+                            sum[c] += t - simAt[i];
+                            worst[c] = t - simAt[i] > worst[c] ? t - simAt[i] : worst[c];
+                        }
+                        continue;
+                    }
+                    simClass[k] = c;
+                    simAt[k++] = simAt[i];
+                }
+                n = k;
+                frames++;
+                // Off time of the 1% duty cycle: 99 times the airtime.
+                freeAt = t + channels_airtime( 7, len + 13 ) / 10;
+            }
+            // Next arrival, or the radio getting free.
+            u4_t next = nextAlarm < nextSample ? nextAlarm : nextSample;
+            next = nextHour < next ? nextHour : next;
+            if( n != 0 && freeAt > t && freeAt < next ) {
+                next = freeAt;
+            }
+            t = next;
+        }
+        printf("  %-8s %u uplinks, %u dropped; alarm latency mean %u ms, max %u ms; sample latency mean %u ms, max %u ms\r\n",
+               POLICY[p], (unsigned int)frames, (unsigned int)lost,
+               (unsigned int)( count[0] ? sum[0] / count[0] : 0 ), (unsigned int)worst[0],
+               (unsigned int)( count[1] ? sum[1] / count[1] : 0 ), (unsigned int)worst[1]);
+    }
+}// end of uplink_simulate function.
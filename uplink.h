@@ -0,0 +1,200 @@
+/*******************************************************************************
+ * Internet of Things (IoT) smart monitoring
+ * device for agriculture using LoRaWAN technology.
+ *
+ * Priority uplink queue.
+ *
+ * - Every uplink belongs to a class with its own port: alarms, telemetry,
+ * window summaries and diagnostics, in that order of priority. The next
+ * uplink is always taken from the highest class with a pending frame, so an
+ * alarm never waits behind routine data.
+ *
+ * - A frame handed over to LMiC that has not gone on air yet (e.g. waiting
+ * for the duty cycle) is preempted by a frame of a higher class; the lower
+ * frame stays queued and is sent afterwards.
+ *
+ * - Each class may get an airtime quota in milliseconds per
+ * UPLINK_QUOTA_PERIOD; a class over its quota is deferred until the next
+ * period, so that summaries and diagnostics cannot eat the airtime of the
+ * telemetry.
+ *
+ * - Frames of carrier classes (UPLINK_CARRIER) are a sequence of records
+ * (port, length, data): first their own frame, then as many pending frames of
+ * lower classes as fit into UPLINK_FRAME_MAX, in class order, the frame held
+ * by the caller for an external class included. Pending low-priority data
+ * thus rides along with an alarm instead of costing an uplink of its own.
+ *
+ * - The delay from queueing an alarm to its transmission is measured.
+ *
+ * - uplink_simulate compares the alarm latency of the priority queue against
+ * a single FIFO for a node loaded up to its duty-cycle limit.
+ *
+ *******************************************************************************/
+#ifndef _uplink_hpp_
+#define _uplink_hpp_
+
+#include "lmic.h"
+
+// Maximum number of frames queued across all classes.
+#define UPLINK_DEPTH 8
+
+// Largest uplink payload in bytes (EU868, any data rate).
+#define UPLINK_FRAME_MAX 51
+
+// Period of the airtime quotas in seconds.
+#define UPLINK_QUOTA_PERIOD 3600
+
+// No class.
+#define UPLINK_NONE 0xFF
+
+// Uplink classes, highest priority first.
+enum {
+    UPLINK_ALARM = 0,     // Urgent conditions.
+    UPLINK_TELEMETRY,     // Periodic samples.
+    UPLINK_SUMMARY,       // Window summaries.
+    UPLINK_DIAG,          // Diagnostics.
+    UPLINK_CLASSES
+};
+
+// Class flags.
+#define UPLINK_LATEST   0x01  // A new frame replaces the queued one.
+#define UPLINK_CARRIER  0x02  // Frames carry queued frames of lower classes.
+#define UPLINK_EXTERNAL 0x04  // Frames are held by the caller, not queued here.
+
+/*
+ * uplink_init function of type void.
+ *
+ * Empties the queue and clears the statistics.
+ *
+ * Input parameters: None
+ */
+void uplink_init (void);
+
+/*
+ * uplink_setup function of type void.
+ *
+ * Input parameters: unsigned char cls
+ *                   unsigned char port
+ *                   unsigned short quota (airtime in ms per UPLINK_QUOTA_PERIOD, 0 unlimited)
+ *                   unsigned char flags
+ */
+void uplink_setup (u1_t cls, u1_t port, u2_t quota, u1_t flags);
+
+/*
+ * uplink_push function of type bit_t.
+ *
+ * Queues a frame. When the queue is full, the oldest frame of the lowest
+ * class (not above cls) is dropped.
+ *
+ * Input parameters: unsigned char cls
+ *                   const unsigned char data
+ *                   unsigned char len (at most UPLINK_FRAME_MAX - 2)
+ * Return: 1 if queued, 0 otherwise.
+ */
+bit_t uplink_push (u1_t cls, const u1_t* data, u1_t len);
+
+/*
+ * uplink_count function of type unsigned char.
+ *
+ * Input parameters: None
+ * Return: number of queued frames.
+ */
+u1_t uplink_count (void);
+
+/*
+ * uplink_select function of type unsigned char.
+ *
+ * Input parameters: unsigned char external (mask of the external classes
+ *                   with a frame pending at the caller)
+ * Return: class of the next uplink, or UPLINK_NONE if nothing is pending
+ *         within its quota.
+ */
+u1_t uplink_select (u1_t external);
+
+/*
+ * uplink_build function of type unsigned char.
+ *
+ * Builds the frame of the oldest queued frame of cls, coalescing lower
+ * classes into carrier frames, and records it as handed over to LMiC,
+ * preempting any lower frame handed over before. For an external class only
+ * the class is recorded; the caller supplies the frame.
+ *
+ * Input parameters: unsigned char cls
+ *                   unsigned char buf (UPLINK_FRAME_MAX bytes)
+ *                   unsigned char held (class of the frame held by the
+ *                   caller, UPLINK_NONE for none)
+ *                   const unsigned char data (held frame)
+ *                   unsigned char len (held frame length)
+ * Return: frame length.
+ */
+u1_t uplink_build (u1_t cls, u1_t* buf, u1_t held, const u1_t* data, u1_t len);
+
+/*
+ * uplink_carried function of type bit_t.
+ *
+ * Input parameters: None
+ * Return: 1 if the uplink handed over to LMiC carries the frame held by the
+ *         caller, 0 otherwise.
+ */
+bit_t uplink_carried (void);
+
+/*
+ * uplink_append function of type unsigned char.
+ *
+ * Appends one record to a carrier frame if it fits into UPLINK_FRAME_MAX.
+ *
+ * Input parameters: unsigned char buf
+ *                   unsigned char len (present frame length)
+ *                   unsigned char port
+ *                   const unsigned char data
+ *                   unsigned char dlen
+ * Return: new frame length.
+ */
+u1_t uplink_append (u1_t* buf, u1_t len, u1_t port, const u1_t* data, u1_t dlen);
+
+/*
+ * uplink_port function of type unsigned char.
+ *
+ * Input parameters: unsigned char cls
+ * Return: port of the class.
+ */
+u1_t uplink_port (u1_t cls);
+
+/*
+ * uplink_sent function of type unsigned char.
+ *
+ * Drops the frames of the completed uplink from the queue and accounts its
+ * airtime to its class. To be called on EV_TXCOMPLETE.
+ *
+ * Input parameters: ostime_t start (time the transmission started)
+ *                   ostime_t end (time the transmission ended)
+ * Return: class of the completed uplink, or UPLINK_NONE.
+ */
+u1_t uplink_sent (ostime_t start, ostime_t end);
+
+/*
+ * uplink_report function of type void.
+ *
+ * Writes the uplinks, coalesced frames, preemptions, deferrals and airtime
+ * against the quota of every class and the alarm latency to the UART.
+ *
+ * Input parameters: None
+ */
+void uplink_report (void);
+
+/*
+ * uplink_simulate function of type void.
+ *
+ * Simulates a node sending an 8-byte sample every interval seconds, a
+ * summary and a diagnostics frame every hour and an alarm at random every
+ * alarmEvery seconds on average, under the 1% duty cycle at SF7, for the
+ * given hours, and writes the alarm and sample latency with a single FIFO
+ * and with the priority queue to the UART.
+ *
+ * Input parameters: unsigned short interval (s)
+ *                   unsigned short alarmEvery (s)
+ *                   unsigned short hours
+ */
+void uplink_simulate (u2_t interval, u2_t alarmEvery, u2_t hours);
+
+#endif // _uplink_hpp_